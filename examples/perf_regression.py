@@ -0,0 +1,264 @@
+#!/usr/bin/env python3
+#************************************************************************
+#
+#	Copyright 2007-2010 Emre Sozer
+#
+#	Contact: emresozer@freecfd.com
+#
+#	This file is a part of Free CFD
+#
+#	Free CFD is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    Free CFD is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    For a copy of the GNU General Public License,
+#    see <http://www.gnu.org/licenses/>.
+#
+#************************************************************************
+"""End-to-end performance regression harness
+
+Runs the shipped examples (and generated box grids) for a fixed number of time steps
+at several rank counts, collects the phase timers, the linear iteration counts and
+residuals from convergence.dat and the peak resident memory, and writes a JSON report.
+When a baseline report is given, the runs are compared against it and the regressions
+beyond the tolerances are listed. The exit status is 1 if there is any.
+
+Typical use:
+	python3 perf_regression.py --fcfd ../build/fcfd --ranks 1,2,4 --save-baseline baseline.json
+	(after a change)
+	python3 perf_regression.py --fcfd ../build/fcfd --ranks 1,2,4 --baseline baseline.json
+
+Only the python standard library is needed.
+"""
+
+import argparse
+import json
+import math
+import os
+import re
+import resource
+import shutil
+import subprocess
+import sys
+import time
+
+EXAMPLES=os.path.dirname(os.path.abspath(__file__))
+
+# Case name -> (example directory, input name without .in, input text substitutions)
+CASES={
+	"cylinder": ("cylinder","cylinder",{}),
+	"wedge": ("wedge","wedge",{}),
+	"hypersonic_cylinder": ("hypersonic_cylinder","cylinder",{}),
+	"box_hex": ("box","box",{}),
+	"box_tet": ("box","box",{"cells=[40,40,40];":"cells=[24,24,24];","elements=hex;":"elements=tet;"}),
+	"box_mixed": ("box","box",{"cells=[40,40,40];":"cells=[30,30,30];","elements=hex;":"elements=mixed; perturbation=0.2;"}),
+}
+
+# Default relative tolerances (fractions) for the comparison against the baseline
+TOLERANCES={
+	"time": 0.15, # wall, setup and per step times
+	"iterations": 0.10, # linear iterations
+	"memory": 0.10, # peak RSS
+	"residual": 0.5, # orders of magnitude of residual drop that can be lost
+}
+
+def prepare_case(name,workdir,steps):
+	"""Copy an example to a scratch directory, limit the steps and turn on the timers"""
+	example,inputName,substitutions=CASES[name]
+	rundir=os.path.join(workdir,name)
+	if os.path.exists(rundir): shutil.rmtree(rundir)
+	shutil.copytree(os.path.join(EXAMPLES,example),rundir)
+	path=os.path.join(rundir,inputName+".in")
+	with open(path) as f: text=f.read()
+	for old,new in substitutions.items():
+		if old not in text: raise RuntimeError("%s: could not find '%s' in %s.in" % (name,old,inputName))
+		text=text.replace(old,new)
+	# The time marching section comes first in all the examples
+	text=re.sub(r"(number\s*of\s*steps\s*=\s*)\d+",r"\g<1>%d" % steps,text,count=1)
+	text+="\nprofiling {timers=on;}\n"
+	with open(path,"w") as f: f.write(text)
+	return rundir,inputName
+
+def measure(command,cwd,logName):
+	"""Run a command, return the exit code, the wall time and the peak RSS [kB] of its processes
+
+	The peak RSS is the largest of the descendant processes (i.e. the largest rank), which is what
+	getrusage reports for the waited for children. It is only separated per run because each run
+	goes through a fresh copy of this script (see --measure).
+	"""
+	wrapper=[sys.executable,os.path.abspath(__file__),"--measure","--"]+command
+	begin=time.time()
+	with open(os.path.join(cwd,logName),"w") as log:
+		status=subprocess.call(wrapper,cwd=cwd,stdout=log,stderr=subprocess.STDOUT)
+	wall=time.time()-begin
+	rss=0
+	rssFile=os.path.join(cwd,"maxrss.txt")
+	if os.path.exists(rssFile):
+		with open(rssFile) as f: rss=int(f.read().strip() or 0)
+	return status,wall,rss
+
+def parse_timers(log):
+	"""Phase timer table printed by fcfd at the end of the run -> {path: {calls,min,max,mean}}"""
+	phases={}
+	stack=[]
+	inTable=False
+	for line in log.splitlines():
+		if line.startswith("[I] Phase timers"):
+			inTable=True
+			continue
+		if not inTable: continue
+		if line.startswith("phase") or line.strip()=="": continue
+		fields=line.split()
+		if len(fields)<6 or line.startswith("["):
+			inTable=False
+			continue
+		try: values=[float(v) for v in fields[-5:-1]]
+		except ValueError:
+			inTable=False
+			continue
+		name=" ".join(fields[:-5])
+		# Phases are indented by two spaces per level below the total
+		depth=(len(line)-len(line.lstrip(" ")))//2
+		stack=stack[:depth]+[name]
+		path="/".join(stack[1:]) if depth>0 else name
+		phases[path]={"calls":values[0],"min":values[1],"max":values[2],"mean":values[3]}
+	return phases
+
+def parse_convergence(path):
+	"""Time step lines of convergence.dat (step grid time cfl iterations residual ...) per grid"""
+	grids={}
+	if not os.path.exists(path): return grids
+	with open(path) as f:
+		for line in f:
+			# Pseudo time lines start with a tab
+			if line.startswith("\t") or line.strip()=="": continue
+			fields=line.split()
+			if len(fields)<6: continue
+			gid=fields[1]
+			grids.setdefault(gid,{"steps":0,"iterations":0,"residuals":[]})
+			grids[gid]["steps"]+=1
+			grids[gid]["iterations"]+=int(float(fields[4]))
+			grids[gid]["residuals"].append(float(fields[5]))
+	summary={}
+	for gid,data in grids.items():
+		res=[r for r in data["residuals"] if r>0.]
+		drop=math.log10(res[0]/res[-1]) if len(res)>1 else 0.
+		summary["grid_"+gid]={
+			"steps": data["steps"],
+			"linear_iterations": data["iterations"],
+			"iterations_per_step": data["iterations"]/max(data["steps"],1),
+			"final_residual": data["residuals"][-1] if data["residuals"] else None,
+			"residual_drop": drop, # orders of magnitude over the run
+		}
+	return summary
+
+def run_case(args,name,ranks):
+	rundir,inputName=prepare_case(name,os.path.join(args.work,"np%d" % ranks),args.steps)
+	command=args.mpirun.split()+[str(ranks),os.path.abspath(args.fcfd),inputName]
+	status,wall,rss=measure(command,rundir,"fcfd.log")
+	with open(os.path.join(rundir,"fcfd.log"),errors="replace") as f: log=f.read()
+	phases=parse_timers(log)
+	result={
+		"case": name,
+		"ranks": ranks,
+		"status": status,
+		"wall_time": wall,
+		"peak_rss_kb": rss,
+		"setup_time": phases.get("setup",{}).get("max"),
+		"time_loop": phases.get("time loop",{}).get("max"),
+		"phases": phases,
+		"convergence": parse_convergence(os.path.join(rundir,"convergence.dat")),
+	}
+	if result["time_loop"] is not None: result["time_per_step"]=result["time_loop"]/args.steps
+	print("[I] %-22s np=%-3d status=%d wall=%.2fs step=%s rss=%dMB" % (name,ranks,status,wall,
+		"%.4fs" % result["time_per_step"] if "time_per_step" in result else "-",rss//1024))
+	return result
+
+def compare(report,baseline,tol):
+	"""List the regressions of report against baseline"""
+	regressions=[]
+	base={(r["case"],r["ranks"]): r for r in baseline["runs"]}
+	def check(key,metric,current,reference,tolerance,larger_is_worse=True):
+		if current is None or reference is None or reference==0: return
+		change=(current-reference)/abs(reference)
+		if (larger_is_worse and change>tolerance) or (not larger_is_worse and change<-tolerance):
+			regressions.append("%s np=%d %s: %.4g -> %.4g (%+.1f%%)" % (key[0],key[1],metric,reference,current,100.*change))
+	for run in report["runs"]:
+		key=(run["case"],run["ranks"])
+		if key not in base: continue
+		ref=base[key]
+		if run["status"]!=0:
+			if ref["status"]==0: regressions.append("%s np=%d: run failed (status %d)" % (key[0],key[1],run["status"]))
+			continue
+		check(key,"setup time",run.get("setup_time"),ref.get("setup_time"),tol["time"])
+		check(key,"time per step",run.get("time_per_step"),ref.get("time_per_step"),tol["time"])
+		check(key,"peak RSS",run.get("peak_rss_kb"),ref.get("peak_rss_kb"),tol["memory"])
+		for phase,data in run["phases"].items():
+			refPhase=ref["phases"].get(phase)
+			# Skip the phases too short to time reliably
+			if refPhase is None or refPhase["max"]<0.05*(ref.get("time_loop") or 0.) or refPhase["max"]<0.1: continue
+			check(key,"phase '%s'" % phase,data["max"],refPhase["max"],tol["time"])
+		for gid,data in run["convergence"].items():
+			refData=ref["convergence"].get(gid)
+			if refData is None: continue
+			check(key,gid+" linear iterations",data["linear_iterations"],refData["linear_iterations"],tol["iterations"])
+			if data["residual_drop"]<refData["residual_drop"]-tol["residual"]:
+				regressions.append("%s np=%d %s residual drop: %.2f -> %.2f orders" % (key[0],key[1],gid,refData["residual_drop"],data["residual_drop"]))
+	return regressions
+
+def main():
+	parser=argparse.ArgumentParser(description="Free CFD performance regression harness")
+	parser.add_argument("--fcfd",default="fcfd",help="fcfd executable")
+	parser.add_argument("--mpirun",default="mpirun -np",help="MPI launcher, the rank count is appended")
+	parser.add_argument("--ranks",default="1,2,4",help="comma separated rank counts")
+	parser.add_argument("--cases",default=",".join(CASES.keys()),help="comma separated cases: "+",".join(CASES.keys()))
+	parser.add_argument("--steps",type=int,default=20,help="time steps per run")
+	parser.add_argument("--work",default="perf_runs",help="scratch directory for the runs")
+	parser.add_argument("--report",default="perf_report.json",help="JSON report of this run")
+	parser.add_argument("--baseline",help="baseline report to compare against")
+	parser.add_argument("--save-baseline",help="also store this report as a baseline")
+	for name,value in TOLERANCES.items():
+		parser.add_argument("--tol-"+name,type=float,default=value,help="tolerance for %s (default %g)" % (name,value))
+	args=parser.parse_args()
+
+	report={"date": time.strftime("%Y-%m-%dT%H:%M:%S"),"fcfd": os.path.abspath(args.fcfd),"steps": args.steps,"runs": []}
+	for ranks in [int(r) for r in args.ranks.split(",")]:
+		for name in args.cases.split(","):
+			if name not in CASES: sys.exit("[E] Unknown case: "+name)
+			report["runs"].append(run_case(args,name,ranks))
+
+	with open(args.report,"w") as f: json.dump(report,f,indent=2)
+	print("[I] Wrote the report to "+args.report)
+	if args.save_baseline:
+		shutil.copyfile(args.report,args.save_baseline)
+		print("[I] Saved the baseline to "+args.save_baseline)
+
+	status=0
+	if args.baseline:
+		with open(args.baseline) as f: baseline=json.load(f)
+		tol={name: getattr(args,"tol_"+name) for name in TOLERANCES}
+		regressions=compare(report,baseline,tol)
+		if regressions:
+			print("[W] %d regressions against %s:" % (len(regressions),args.baseline))
+			for r in regressions: print("[W]\t"+r)
+			status=1
+		else: print("[I] No regressions against "+args.baseline)
+	for run in report["runs"]:
+		if run["status"]!=0:
+			print("[W] %s np=%d failed, see %s" % (run["case"],run["ranks"],os.path.join(args.work,"np%d" % run["ranks"],run["case"],"fcfd.log")))
+			status=1
+	sys.exit(status)
+
+if __name__=="__main__":
+	# Helper mode: run the command and store the peak RSS of its processes
+	if len(sys.argv)>2 and sys.argv[1]=="--measure":
+		status=subprocess.call(sys.argv[3:])
+		with open("maxrss.txt","w") as f: f.write("%d\n" % resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss)
+		sys.exit(status)
+	main()
@@ -20,64 +20,248 @@
  see <http://www.gnu.org/licenses/>.
  
  *************************************************************************/
+#include <algorithm>
 #include "bc_interface.h"
+#include "kdtree.h"
+#include "comm_profile.h"
+
+#define INTERFACE_STENCIL 4 // Maximum number of donor faces per receiving face
+#define INTERFACE_TAG 11
+
+// Donor matching
+// Each rank's donor faces are summarized by their bounding box. A receiving face only queries
+// the ranks whose box may hold a donor within d+h of it, where d bounds the nearest donor
+// distance (farthest corner of the closest box) and h is the receiving face size. The donor
+// ranks search their faces with a kd-tree and return the nearest few. The stencil of a
+// receiving face is made of the donors within d0+h, d0 being the nearest donor distance,
+// with inverse distance squared weights (a single weight if a donor coincides).
+// The donor values needed are then requested once, and the exchange at each time step
+// runs over persistent point to point messages between the ranks involved only.
+
+static inline double box_distance2(const double p[],const double box[]) {
+	double d2=0.,d;
+	for (int i=0;i<3;++i) {
+		d=max(max(box[i]-p[i],p[i]-box[3+i]),0.);
+		d2+=d*d;
+	}
+	return d2;
+}
+
+static inline double box_max_distance2(const double p[],const double box[]) {
+	double d2=0.,d;
+	for (int i=0;i<3;++i) {
+		d=max(fabs(p[i]-box[i]),fabs(p[i]-box[3+i]));
+		d2+=d*d;
+	}
+	return d2;
+}
+
+// Alltoallv of doubles with the counts given per rank, returns the received counts
+static void exchange_lists(vector<vector<double> > &out,vector<double> &in,vector<int> &inCounts,vector<int> &inDispls) {
+	int np=out.size();
+	vector<int> outCounts (np),outDispls (np,0);
+	inCounts.assign(np,0); inDispls.assign(np,0);
+	for (int p=0;p<np;++p) outCounts[p]=out[p].size();
+	MPI_Alltoall(&outCounts[0],1,MPI_INT,&inCounts[0],1,MPI_INT,MPI_COMM_WORLD);
+	for (int p=1;p<np;++p) {
+		outDispls[p]=outDispls[p-1]+outCounts[p-1];
+		inDispls[p]=inDispls[p-1]+inCounts[p-1];
+	}
+	vector<double> outBuffer (outDispls[np-1]+outCounts[np-1]+1);
+	for (int p=0;p<np;++p) for (int i=0;i<out[p].size();++i) outBuffer[outDispls[p]+i]=out[p][i];
+	in.resize(inDispls[np-1]+inCounts[np-1]+1);
+	MPI_Alltoallv(&outBuffer[0],&outCounts[0],&outDispls[0],MPI_DOUBLE,&in[0],&inCounts[0],&inDispls[0],MPI_DOUBLE,MPI_COMM_WORLD);
+	return;
+}
 
 void BC_Interface::setup(void) {
 	
-	int Rank=grid[recv_grid].Rank;
-	int np=grid[recv_grid].np;
+	// The donor and receiving grids may live on different ranks, so the matching runs over
+	// all the ranks (the ones holding no part of a grid have no faces on its side)
+	vector<int> none;
+	vector<int> &donorFaces=(grid[donor_grid].active) ? grid[donor_grid].boundaryFaces[donor_bc] : none;
+	vector<int> &recvFaces=(grid[recv_grid].active) ? grid[recv_grid].boundaryFaces[recv_bc] : none;
 	
-	int	recvSize=3*grid[donor_grid].globalBoundaryFaceCount[donor_bc];
-	donor_data.resize(recvSize/3);
-	donor_point.resize(recvSize/3);
-	vector<double> sendBuffer;
-	vector<double> recvBuffer (recvSize,0.);
+	// Bounding boxes of the donor faces of each rank (the last entry is the face count)
+	double box[7]={1.e20,1.e20,1.e20,-1.e20,-1.e20,-1.e20,0.};
+	for (int bf=0;bf<donorFaces.size();++bf) {
+		Vec3D &centroid=grid[donor_grid].face[donorFaces[bf]].centroid;
+		for (int i=0;i<3;++i) {
+			box[i]=min(box[i],centroid[i]);
+			box[3+i]=max(box[3+i],centroid[i]);
+		}
+	}
+	box[6]=donorFaces.size();
+	vector<double> boxes (7*np);
+	MPI_Allgather(box,7,MPI_DOUBLE,&boxes[0],7,MPI_DOUBLE,MPI_COMM_WORLD);
+	
+	// Queries (point and face size) of the receiving faces to the candidate donor ranks
+	vector<vector<double> > queries (np);
+	vector<vector<int> > queryFace (np); // Receiving face of each query
+	for (int bf=0;bf<recvFaces.size();++bf) {
+		int f=recvFaces[bf];
+		double point[3]={grid[recv_grid].face[f].centroid[0],grid[recv_grid].face[f].centroid[1],grid[recv_grid].face[f].centroid[2]};
+		double h=sqrt(grid[recv_grid].face[f].area);
+		double bound2=1.e40;
+		for (int p=0;p<np;++p) if (boxes[7*p+6]>0) bound2=min(bound2,box_max_distance2(point,&boxes[7*p]));
+		double reach=sqrt(bound2)+h;
+		for (int p=0;p<np;++p) {
+			if (boxes[7*p+6]==0 || box_distance2(point,&boxes[7*p])>reach*reach) continue;
+			for (int i=0;i<3;++i) queries[p].push_back(point[i]);
+			queries[p].push_back(h);
+			queryFace[p].push_back(bf);
+		}
+	}
+	vector<double> in;
+	vector<int> inCounts,inDispls;
+	exchange_lists(queries,in,inCounts,inDispls);
 	
-	vector<int> recvSizes (np,0);
-	vector<int> displs (np,0);
+	// Answer with the nearest donors of this rank (distance and donor face position pairs)
+	kdtree *kd=kd_create(3);
+	vector<int> position (donorFaces.size());
+	for (int bf=0;bf<donorFaces.size();++bf) {
+		position[bf]=bf;
+		Vec3D &centroid=grid[donor_grid].face[donorFaces[bf]].centroid;
+		kd_insert3(kd,centroid[0],centroid[1],centroid[2],&position[bf]);
+	}
+	vector<vector<double> > answers (np);
+	vector<pair<double,int> > found;
 	for (int p=0;p<np;++p) {
-		recvSizes[p]=grid[donor_grid].boundaryFaceCount[donor_bc][p];
-		if (p>0) displs[p]=recvSizes[p-1];
+		for (int q=0;q<inCounts[p]/4;++q) {
+			double *point=&in[inDispls[p]+4*q];
+			double h=point[3];
+			kdres *result=kd_nearest(kd,point);
+			int nearest=*(int *)kd_res_item_data(result);
+			kd_res_free(result);
+			double distance=fabs(grid[donor_grid].face[donorFaces[nearest]].centroid-Vec3D(point[0],point[1],point[2]));
+			found.clear();
+			result=kd_nearest_range(kd,point,distance+h);
+			while (!kd_res_end(result)) {
+				double pos[3];
+				int bf=*(int *)kd_res_item(result,pos);
+				found.push_back(make_pair(sqrt(pow(pos[0]-point[0],2)+pow(pos[1]-point[1],2)+pow(pos[2]-point[2],2)),bf));
+				kd_res_next(result);
+			}
+			kd_res_free(result);
+			if (found.empty()) found.push_back(make_pair(distance,nearest));
+			sort(found.begin(),found.end());
+			int count=min(int(found.size()),INTERFACE_STENCIL);
+			answers[p].push_back(count);
+			for (int i=0;i<count;++i) {
+				answers[p].push_back(found[i].first);
+				answers[p].push_back(found[i].second);
+			}
+		}
 	}
-
-	for (int f=0;f<grid[donor_grid].faceCount;++f) {
-		if (grid[donor_grid].face[f].bc==donor_bc) {
-			sendBuffer.push_back(grid[donor_grid].face[f].centroid[0]);
-			sendBuffer.push_back(grid[donor_grid].face[f].centroid[1]);
-			sendBuffer.push_back(grid[donor_grid].face[f].centroid[2]);
+	kd_free(kd);
+	exchange_lists(answers,in,inCounts,inDispls);
+	
+	// Gather the candidates of each receiving face over the ranks that answered
+	// (distance, rank, donor face position)
+	vector<vector<pair<double,pair<int,int> > > > candidates (recvFaces.size());
+	for (int p=0;p<np;++p) {
+		int index=inDispls[p];
+		for (int q=0;q<queryFace[p].size();++q) {
+			int count=int(in[index++]);
+			for (int i=0;i<count;++i) {
+				candidates[queryFace[p][q]].push_back(make_pair(in[index],make_pair(p,int(in[index+1]))));
+				index+=2;
+			}
 		}
 	}
-
-	MPI_Allgatherv(&sendBuffer[0],sendBuffer.size(),MPI_DOUBLE,&recvBuffer[0],&recvSizes[0],&displs[0],MPI_DOUBLE,MPI_COMM_WORLD);
-
 	
-	for (int i=0;i<donor_point.size();++i) {
-		donor_point[i][0]=recvBuffer[3*i];
-		donor_point[i][1]=recvBuffer[3*i+1];
-		donor_point[i][2]=recvBuffer[3*i+2];
+	// Pick the stencils and list the donor faces needed from each rank
+	vector<map<int,int> > needed (np); // donor face position -> order of request
+	vector<vector<pair<int,int> > > stencil (recvFaces.size()); // (rank, order of request)
+	vector<vector<double> > stencilWeight (recvFaces.size());
+	for (int bf=0;bf<recvFaces.size();++bf) {
+		sort(candidates[bf].begin(),candidates[bf].end());
+		if (candidates[bf].empty()) {
+			cerr << "[E] No donor found for a face of interface BC_" << recv_bc+1 << " of grid " << recv_grid+1 << endl;
+			exit(1);
+		}
+		double h=sqrt(grid[recv_grid].face[recvFaces[bf]].area);
+		double nearest=candidates[bf][0].first;
+		int count=1;
+		if (nearest>1.e-6*h) {
+			while (count<candidates[bf].size() && count<INTERFACE_STENCIL && candidates[bf][count].first<=nearest+h) count++;
+		}
+		double sum=0.;
+		for (int i=0;i<count;++i) {
+			int p=candidates[bf][i].second.first;
+			int donor=candidates[bf][i].second.second;
+			map<int,int>::iterator it=needed[p].find(donor);
+			if (it==needed[p].end()) it=needed[p].insert(make_pair(donor,int(needed[p].size()))).first;
+			stencil[bf].push_back(make_pair(p,it->second));
+			double w=(count==1) ? 1. : 1./(candidates[bf][i].first*candidates[bf][i].first);
+			stencilWeight[bf].push_back(w);
+			sum+=w;
+		}
+		for (int i=0;i<count;++i) stencilWeight[bf][i]/=sum;
 	}
 	
-	// TODO: For now, establish only single closest point search
-	// In the future, add LTI
-	donor_index.resize(grid[recv_grid].boundaryFaceCount[recv_bc][Rank]);
-	double min_distance,distance;
-	int i_closest;
-	int counter=0;
-	for (int f=0;f<grid[recv_grid].faceCount;++f) {
-		if (grid[recv_grid].face[f].bc==recv_bc) {
-			// Search for the closest point in the donor point cloud
-			min_distance=1.e20;
-			for (int i=0;i<donor_point.size();++i) {
-				distance=fabs(donor_point[i]-grid[recv_grid].face[f].centroid);
-				if (distance<min_distance) {
-					min_distance=distance;
-					i_closest=i;
-				}
-			}
-			donor_index[counter]=i_closest;
-			counter++;
+	// Receive layout and the stencils in terms of it
+	recv_proc.clear(); recv_offset.clear();
+	vector<int> rankOffset (np,0);
+	int total=0;
+	for (int p=0;p<np;++p) {
+		rankOffset[p]=total;
+		if (needed[p].empty()) continue;
+		recv_proc.push_back(p);
+		recv_offset.push_back(total);
+		total+=needed[p].size();
+	}
+	recv_offset.push_back(total);
+	donor_data.assign(total,0.);
+	weight_offset.assign(1,0); weight_index.clear(); weight.clear();
+	for (int bf=0;bf<recvFaces.size();++bf) {
+		for (int i=0;i<stencil[bf].size();++i) {
+			weight_index.push_back(rankOffset[stencil[bf][i].first]+stencil[bf][i].second);
+			weight.push_back(stencilWeight[bf][i]);
 		}
+		weight_offset.push_back(weight_index.size());
+	}
+	
+	// Tell the donors which faces to send, in the order of request
+	vector<vector<double> > requests (np);
+	for (int p=0;p<np;++p) {
+		requests[p].resize(needed[p].size());
+		for (map<int,int>::iterator it=needed[p].begin();it!=needed[p].end();++it) requests[p][it->second]=it->first;
 	}
+	exchange_lists(requests,in,inCounts,inDispls);
+	send_proc.clear(); send_offset.clear(); send_face.clear();
+	for (int p=0;p<np;++p) {
+		if (inCounts[p]==0) continue;
+		send_proc.push_back(p);
+		send_offset.push_back(send_face.size());
+		for (int i=0;i<inCounts[p];++i) send_face.push_back(int(in[inDispls[p]+i]));
+	}
+	send_offset.push_back(send_face.size());
+	send_data.assign(send_face.size(),0.);
+	
+	// Persistent messages
+	request.resize(recv_proc.size()+send_proc.size());
+	for (int p=0;p<recv_proc.size();++p) {
+		MPI_Recv_init(&donor_data[recv_offset[p]],recv_offset[p+1]-recv_offset[p],MPI_DOUBLE,recv_proc[p],INTERFACE_TAG,MPI_COMM_WORLD,&request[p]);
+	}
+	for (int p=0;p<send_proc.size();++p) {
+		MPI_Send_init(&send_data[send_offset[p]],send_offset[p+1]-send_offset[p],MPI_DOUBLE,send_proc[p],INTERFACE_TAG,MPI_COMM_WORLD,&request[recv_proc.size()+p]);
+	}
+	
+	int counts[2]={int(send_face.size()),int(send_proc.size())};
+	MPI_Allreduce(MPI_IN_PLACE,counts,2,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+	if (Rank==0) cout << "[I] Interface BC_" << recv_bc+1 << " of grid " << recv_grid+1 << ": at most " << counts[0] << " donor values sent to " << counts[1] << " ranks per rank" << endl;
+	
+	return;
+}
 
+// Send the donor values in send_data and receive donor_data
+void BC_Interface::exchange(void) {
+	
+	if (request.empty()) return;
+	MPI_Startall(request.size(),&request[0]);
+	for (int p=0;p<send_proc.size();++p) comm_profile.send(send_proc[p],(send_offset[p+1]-send_offset[p])*sizeof(double));
+	comm_profile.waitall(request.size(),&request[0],MPI_STATUSES_IGNORE);
+	
 	return;
 }
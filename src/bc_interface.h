@@ -38,13 +38,25 @@ public:
 	string recv_var;
 	int donor_grid,donor_bc,donor_eqn;
 	string donor_var;
-	// These two contain essentially a point cloud and the associated data at each point
+	// Sparse exchange pattern built by setup
+	// Donor side: positions in the donor boundary face list that are sent to each rank
+	vector<int> send_proc,send_offset,send_face;
+	vector<double> send_data; // Filled by the caller before exchange, in send_face order
+	// Receiver side: values received from recv_proc[p] land in donor_data[recv_offset[p]...]
+	vector<int> recv_proc,recv_offset;
 	vector<double> donor_data;
-	vector<Vec3D> donor_point;
-	// Current index of the faces in the bc (in order) --> index in donor data
-	vector<int> donor_index;
+	vector<MPI_Request> request; // Persistent requests of the above messages
+	// Interpolation stencil of each receiving face (in boundary face order) into donor_data
+	vector<int> weight_offset,weight_index;
+	vector<double> weight;
 	
 	void setup(void);
+	void exchange(void);
+	double value(int bf) {
+		double result=0.;
+		for (int i=weight_offset[bf];i<weight_offset[bf+1];++i) result+=weight[i]*donor_data[weight_index[i]];
+		return result;
+	}
 };
 
 #endif
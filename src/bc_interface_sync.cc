@@ -42,60 +42,49 @@ void bc_interface_sync(void) {
 	// Loop all the interfaces 
 	for (int gid=0;gid<grid.size();++gid) {
 		for (int i=0;i<interface[gid].size();++i) {
-			int Rank=grid[gid].Rank;
-			int np=grid[gid].np;
-			int donor_bc=interface[gid][i].donor_bc;
-			int donor_grid=interface[gid][i].donor_grid;
-			int	recvSize=grid[donor_grid].globalBoundaryFaceCount[donor_bc];
-			vector<double> sendBuffer;
-			vector<double> recvBuffer (recvSize,0.);
-			vector<int> recvSizes (np,0);
-			vector<int> displs (np,0);
-			for (int p=0;p<np;++p) {
-				recvSizes[p]=grid[donor_grid].boundaryFaceCount[donor_bc][p];
-				if (p>0) displs[p]=recvSizes[p-1];
-			}
-			int counter=0;
-			for (int f=0;f<grid[donor_grid].faceCount;++f) {
-				if (grid[donor_grid].face[f].bc==donor_bc) {
-					//cout << ns[donor_grid].qdot.face(f) << endl;
-					// TODO: generalize by adding and equation int to the bc_interface class
-					//cout << interface[gid][i].donor_var << "\t" << ns[donor_grid].qdot.face(f) << endl;
-					if (interface[gid][i].donor_var=="T") {
-						if (interface[gid][i].donor_eqn==NS) sendBuffer.push_back(ns[donor_grid].T.face(f));
-						else if (interface[gid][i].donor_eqn==HEAT) sendBuffer.push_back(hc[donor_grid].T.face(f));
-					}
-					else if (interface[gid][i].donor_var=="qdot") {
-						//if (interface[gid][i].donor_eqn==NS) sendBuffer.push_back(ns[donor_grid].qdot.bc(interface[gid][i].donor_bc,f));
-						if (interface[gid][i].donor_eqn==NS) sendBuffer.push_back(ns[donor_grid].qdot.face(f));
-						else if (interface[gid][i].donor_eqn==HEAT) sendBuffer.push_back(hc[donor_grid].qdot.face(f));
+			BC_Interface &face_link=interface[gid][i];
+			int donor_grid=face_link.donor_grid;
+			// Only the donor faces that some rank interpolates from are sent
+			// (none if this rank holds no part of the donor grid)
+			for (int s=0;s<face_link.send_face.size();++s) {
+				int f=grid[donor_grid].boundaryFaces[face_link.donor_bc][face_link.send_face[s]];
+				double &data=face_link.send_data[s];
+				// TODO: generalize by adding and equation int to the bc_interface class
+				if (face_link.donor_var=="T") {
+					// Boundary state from the last Navier-Stokes face loop
+					if (face_link.donor_eqn==NS) {
+						if (ns[donor_grid].face_store.filled) data=ns[donor_grid].face_store.T[1][f];
+						else data=ns[donor_grid].T.face(f);
 					}
-					counter++;
+					else if (face_link.donor_eqn==HEAT) data=hc[donor_grid].T.face(f);
+				}
+				else if (face_link.donor_var=="qdot") {
+					//if (face_link.donor_eqn==NS) data=ns[donor_grid].qdot.bc(face_link.donor_bc,f);
+					if (face_link.donor_eqn==NS) data=ns[donor_grid].qdot.face(f);
+					else if (face_link.donor_eqn==HEAT) data=hc[donor_grid].qdot.face(f);
 				}
 			}
 
-			MPI_Allgatherv(&sendBuffer[0],sendBuffer.size(),MPI_DOUBLE,&recvBuffer[0],&recvSizes[0],&displs[0],MPI_DOUBLE,MPI_COMM_WORLD);
-
-			for (int j=0;j<interface[gid][i].donor_point.size();++j) interface[gid][i].donor_data[j]=recvBuffer[j];
-			
+			face_link.exchange();
 		}
 
 	}
 
 	for (int gid=0;gid<grid.size();++gid) {
-		int count=0;
+		if (!grid[gid].active) continue;
 		for (int i=0;i<interface[gid].size();++i) {
-			for (int f=0;f<grid[gid].faceCount;++f) {
-				if (grid[gid].face[f].bc==interface[gid][i].recv_bc) {
-					if (interface[gid][i].donor_var=="T") {
-						if (interface[gid][i].recv_eqn==NS) ns[gid].T.face(f)=interface[gid][i].donor_data[interface[gid][i].donor_index[count]];
-						else if (interface[gid][i].recv_eqn==HEAT) hc[gid].T.face(f)=interface[gid][i].donor_data[interface[gid][i].donor_index[count]];
-					}
-					else if (interface[gid][i].donor_var=="qdot") {
-						if (interface[gid][i].recv_eqn==NS) ns[gid].qdot.face(f)=interface[gid][i].donor_data[interface[gid][i].donor_index[count]];
-						else if (interface[gid][i].recv_eqn==HEAT) hc[gid].qdot.face(f)=interface[gid][i].donor_data[interface[gid][i].donor_index[count]];
-					}
-					count++;
+			// The interpolation stencils follow the order of the receiving boundary face list
+			vector<int> &recvFaces=grid[gid].boundaryFaces[interface[gid][i].recv_bc];
+			for (int bf=0;bf<recvFaces.size();++bf) {
+				int f=recvFaces[bf];
+				double value=interface[gid][i].value(bf);
+				if (interface[gid][i].donor_var=="T") {
+					if (interface[gid][i].recv_eqn==NS) ns[gid].T.face(f)=value;
+					else if (interface[gid][i].recv_eqn==HEAT) hc[gid].T.face(f)=value;
+				}
+				else if (interface[gid][i].donor_var=="qdot") {
+					if (interface[gid][i].recv_eqn==NS) ns[gid].qdot.face(f)=value;
+					else if (interface[gid][i].recv_eqn==HEAT) hc[gid].qdot.face(f)=value;
 				}
 			}
 		}
@@ -0,0 +1,54 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <mpi.h>
+using namespace std;
+
+// Result of one benchmark, work counts are per iteration and summed over the ranks
+class Bench_Result {
+public:
+	string name;
+	int iterations;
+	double time; // Wall time per iteration [s], slowest rank
+	double items; // Faces, cells, ... processed
+	double bytes; // Estimated memory (or network) traffic
+};
+
+// Reporting (bench_report.cc)
+void bench_record(string name,int iterations,double time,double items,double bytes,bool collective=true);
+void bench_print_header(string title);
+void bench_write_json(string fileName,string caseName);
+
+// Kernel microbenchmarks
+void bench_flux(int nFaces,int repeat);
+// These need a case to be set up first (see fcfd_bench.cc)
+void bench_mesh(int gid,int repeat);
+void bench_ns(int gid,int repeat);
+
+#endif
@@ -0,0 +1,140 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "bench.h"
+#include "ns.h"
+#include "ns_flux_batch.h"
+#include "utilities.h"
+
+extern void roe_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Gamma,double &weightL);
+extern void vanLeer_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Gamma,double Pref,double &weightL);
+extern void AUSMplusUP_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Gamma,double Pref,double Minf,double &weightL);
+extern void SD_SLAU_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Pref,double &weightL);
+extern void Stegger_Warming_flux(NS_Cell_State &left,NS_Cell_State &right,double diss_factor,double closest_wall_distance,double wdiss,double bl_height,MATERIAL &material,double fluxNormal[],double &weightL);
+
+// Random face states of an ideal gas around standard conditions
+static void random_state(NS_Cell_State &state,double gamma,double R) {
+	state.T=250.+100.*drand48();
+	state.p=8.e4+4.e4*drand48();
+	state.rho=state.p/(R*state.T);
+	state.a=sqrt(gamma*state.p/state.rho);
+	state.Vn[0]=-400.+800.*drand48();
+	state.Vn[1]=-100.+200.*drand48();
+	state.Vn[2]=-100.+200.*drand48();
+	state.V=state.Vn;
+	state.H=state.a*state.a/(gamma-1.)+0.5*state.V.dot(state.V);
+	return;
+}
+
+void bench_flux(int nFaces,int repeat) {
+
+	int W=FLUX_BATCH_WIDTH;
+	int nBatches=(nFaces+W-1)/W;
+	nFaces=nBatches*W;
+	
+	double gamma=1.4;
+	double R=287.;
+	double Minf=0.5;
+	double Pref=0.;
+	
+	MATERIAL material;
+	material.eos_model=IDEAL_GAS;
+	material.visc_model=CONSTANT;
+	material.lambda_model=CONSTANT;
+	material.Mw=UNIV_GAS_CONST/R;
+	material.R=R;
+	material.Pref=Pref;
+	material.Tref=0.;
+	material.gamma=gamma;
+	material.Cp_model=CONSTANT;
+	material.Cp_value=gamma*R/(gamma-1.);
+	material.setup();
+	
+	srand48(1);
+	vector<NS_Cell_State> left (nFaces),right (nFaces);
+	vector<NS_State_Batch> leftBatch (nBatches),rightBatch (nBatches);
+	vector<double> diss_factor (W,1.),wall_distance (W,1.);
+	for (int i=0;i<nFaces;++i) {
+		random_state(left[i],gamma,R);
+		random_state(right[i],gamma,R);
+		load_state_batch(leftBatch[i/W],i%W,left[i]);
+		load_state_batch(rightBatch[i/W],i%W,right[i]);
+	}
+	
+	vector<double> scalarFlux (nFaces*5);
+	NS_Flux_Batch batchFlux;
+	double weightL;
+	
+	string names[5]={"Roe","vanLeer","AUSM+up","SD-SLAU","SW"};
+	
+	bench_print_header("Convective flux kernels, items are faces (batch width "+int2str(W)+")");
+	
+	// Traffic per face: two input states and the flux
+	double scalarBytes=double(nFaces)*(2*sizeof(NS_Cell_State)+5*sizeof(double));
+	double batchBytes=double(nBatches)*(2*sizeof(NS_State_Batch)+sizeof(NS_Flux_Batch));
+	
+	for (int scheme=0;scheme<5;++scheme) {
+		
+		// Scalar kernels, one face at a time
+		double timeRef=MPI_Wtime();
+		for (int r=0;r<repeat;++r) {
+			for (int i=0;i<nFaces;++i) {
+				double *f=&scalarFlux[i*5];
+				if (scheme==0) roe_flux(left[i],right[i],f,gamma,weightL);
+				else if (scheme==1) vanLeer_flux(left[i],right[i],f,gamma,Pref,weightL);
+				else if (scheme==2) AUSMplusUP_flux(left[i],right[i],f,gamma,Pref,Minf,weightL);
+				else if (scheme==3) SD_SLAU_flux(left[i],right[i],f,Pref,weightL);
+				else if (scheme==4) Stegger_Warming_flux(left[i],right[i],1.,1.,0.3,0.,material,f,weightL);
+			}
+		}
+		double scalarTime=MPI_Wtime()-timeRef;
+		
+		// Batched kernels
+		double maxDiff=0.;
+		timeRef=MPI_Wtime();
+		for (int r=0;r<repeat;++r) {
+			for (int b=0;b<nBatches;++b) {
+				if (scheme==0) roe_flux_batch(leftBatch[b],rightBatch[b],batchFlux,gamma);
+				else if (scheme==1) vanLeer_flux_batch(leftBatch[b],rightBatch[b],batchFlux,gamma,Pref);
+				else if (scheme==2) AUSMplusUP_flux_batch(leftBatch[b],rightBatch[b],batchFlux,gamma,Pref,Minf);
+				else if (scheme==3) SD_SLAU_flux_batch(leftBatch[b],rightBatch[b],batchFlux,Pref);
+				else if (scheme==4) Stegger_Warming_flux_batch(leftBatch[b],rightBatch[b],&diss_factor[0],&wall_distance[0],0.3,0.,material,batchFlux);
+				// Compare against the scalar results on the last pass
+				if (r==repeat-1) {
+					for (int l=0;l<W;++l) for (int i=0;i<5;++i) {
+						double ref=scalarFlux[(b*W+l)*5+i];
+						maxDiff=max(maxDiff,fabs(batchFlux.f[i][l]-ref)/max(1.,fabs(ref)));
+					}
+				}
+			}
+		}
+		double batchTime=MPI_Wtime()-timeRef;
+		
+		bench_record("flux/"+names[scheme]+"/scalar",repeat,scalarTime,nFaces,scalarBytes,false);
+		bench_record("flux/"+names[scheme]+"/batch",repeat,batchTime,nFaces,batchBytes,false);
+		cout << "[I]\t" << names[scheme] << " batch speedup " << fixed << setprecision(2) << scalarTime/max(batchTime,1.e-12)
+		     << ", max relative difference " << scientific << setprecision(2) << maxDiff << endl;
+		cout.unsetf(ios::floatfield);
+	}
+	
+	return;
+}
@@ -0,0 +1,133 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "bench.h"
+#include "grid.h"
+#include "variable.h"
+#include "utilities.h"
+
+extern vector<Grid> grid;
+extern int Rank;
+
+void face_interpolation_weights(int gid);
+void node_interpolation_weights(int gid);
+void gradient_maps(int gid);
+void lsqr_grad_map(int gid,int c,map<int,Vec3D> &gradMap);
+void curvilinear_grad_map(int gid,int c,map<int,Vec3D> &gradMap);
+
+// Preprocessing and stencil kernels of the grid
+// The byte counts are estimates of the traffic of the stencil data structures
+void bench_mesh(int gid,int repeat) {
+	
+	Grid &g=grid[gid];
+	string prefix="grid_"+int2str(gid+1)+"/";
+	
+	bench_print_header("Grid kernels of grid_"+int2str(gid+1));
+	
+	// A linear test field
+	Variable<double> phi;
+	phi.allocate(gid);
+	for (int c=0;c<g.cell.size();++c) phi.cell(c)=g.cell[c].centroid.dot(Vec3D(1.,2.,3.));
+	
+	double timeRef,time,sink=0.;
+	double entries;
+	
+	// Cell gradients from the gradient maps (or Green-Gauss where there is no map)
+	entries=0.;
+	for (int c=0;c<g.cellCount;++c) {
+		if (g.gradMap.size(c)!=0) entries+=g.gradMap.size(c);
+		else entries+=g.cell[c].faces.size();
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+	timeRef=MPI_Wtime();
+	for (int r=0;r<repeat;++r) {
+		for (int c=0;c<g.cellCount;++c) sink+=phi.cell_gradient(c)[0];
+	}
+	time=MPI_Wtime()-timeRef;
+	bench_record(prefix+"variable/cell_gradient",repeat,time,g.cellCount,entries*(sizeof(int)+sizeof(Vec3D)+sizeof(double))+g.cellCount*sizeof(Vec3D));
+	
+	// Face values from the face averaging stencils
+	entries=0.;
+	for (int f=0;f<g.faceCount;++f) entries+=g.faceAverage.size(f);
+	MPI_Barrier(MPI_COMM_WORLD);
+	timeRef=MPI_Wtime();
+	for (int r=0;r<repeat;++r) {
+		for (int f=0;f<g.faceCount;++f) sink+=phi.face_calculate(f);
+	}
+	time=MPI_Wtime()-timeRef;
+	bench_record(prefix+"variable/face_calculate",repeat,time,g.faceCount,entries*(sizeof(int)+2*sizeof(double))+g.faceCount*sizeof(double));
+	
+	// Interpolation weights, each pass replaces the stencils of the previous one
+	time=0.;
+	for (int r=0;r<repeat;++r) {
+		MPI_Barrier(MPI_COMM_WORLD);
+		timeRef=MPI_Wtime();
+		face_interpolation_weights(gid);
+		time+=MPI_Wtime()-timeRef;
+	}
+	entries=g.faceAverage.index.size();
+	bench_record(prefix+"interpolate/face_weights",repeat,time,g.faceCount,entries*(sizeof(Vec3D)+sizeof(int)+sizeof(double)));
+	
+	time=0.;
+	for (int r=0;r<repeat;++r) {
+		MPI_Barrier(MPI_COMM_WORLD);
+		timeRef=MPI_Wtime();
+		node_interpolation_weights(gid);
+		time+=MPI_Wtime()-timeRef;
+	}
+	entries=g.nodeAverage.index.size();
+	bench_record(prefix+"interpolate/node_weights",repeat,time,g.nodeCount,entries*(sizeof(Vec3D)+sizeof(int)+sizeof(double)));
+	
+	// Gradient maps of single cells (serial)
+	map<int,Vec3D> row;
+	for (int method=0;method<2;++method) {
+		int count=0;
+		time=0.;
+		entries=0.;
+		for (int r=0;r<repeat;++r) {
+			MPI_Barrier(MPI_COMM_WORLD);
+			timeRef=MPI_Wtime();
+			for (int c=0;c<g.cellCount;++c) {
+				if (method==0) lsqr_grad_map(gid,c,row);
+				// The curvilinear maps are only for hex and prism cells
+				else if (g.cell[c].nodes.size()==8 || g.cell[c].nodes.size()==6) curvilinear_grad_map(gid,c,row);
+				else continue;
+				if (r==0) { count++; entries+=row.size(); }
+			}
+			time+=MPI_Wtime()-timeRef;
+		}
+		bench_record(prefix+((method==0) ? "gradient_map/lsqr" : "gradient_map/curvilinear"),repeat,time,count,entries*(sizeof(int)+sizeof(Vec3D)));
+	}
+	
+	// All the gradient maps chosen in the input, this also restores them
+	MPI_Barrier(MPI_COMM_WORLD);
+	timeRef=MPI_Wtime();
+	gradient_maps(gid);
+	time=MPI_Wtime()-timeRef;
+	entries=g.gradMap.index.size();
+	bench_record(prefix+"gradient_map/all",1,time,g.cellCount,entries*(sizeof(int)+sizeof(Vec3D)));
+	
+	// Keep the compiler from dropping the loops above
+	if (sink==1.2345) cout << sink << endl;
+	
+	return;
+}
@@ -0,0 +1,133 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "bench.h"
+#include "ns.h"
+#include "utilities.h"
+
+extern int Rank;
+extern vector<Grid> grid;
+extern vector<NavierStokes> ns;
+
+// Navier-Stokes solver kernels on an initialized case
+// The byte counts are estimates of the cell, face and matrix data touched by each kernel
+void bench_ns(int gid,int repeat) {
+	
+	Grid &g=grid[gid];
+	NavierStokes &solver=ns[gid];
+	string prefix="grid_"+int2str(gid+1)+"/ns/";
+	double timeRef,time;
+	
+	bench_print_header("Navier-Stokes kernels of grid_"+int2str(gid+1));
+	
+	// Primitives, gradients and limiters of a cell
+	double cellBytes=(5+15+5)*sizeof(double);
+	
+	// Limiters, one pass over the cells each
+	int limiter_function=solver.limiter_function;
+	int limiters[3]={BJ,VK,MINMOD};
+	string limiterNames[3]={"barth_jespersen","venkatakrishnan","minmod"};
+	double neighbors=solver.limiterOffset[g.cellCount];
+	for (int l=0;l<3;++l) {
+		solver.limiter_function=limiters[l];
+		MPI_Barrier(MPI_COMM_WORLD);
+		timeRef=MPI_Wtime();
+		for (int r=0;r<repeat;++r) {
+			solver.limiter_prepare();
+			for (int c=0;c<g.cellCount;++c) solver.limit_cell(c);
+		}
+		time=MPI_Wtime()-timeRef;
+		bench_record(prefix+"limiter/"+limiterNames[l],repeat,time,g.cellCount,g.cellCount*cellBytes+neighbors*(5*sizeof(double)+sizeof(int)+sizeof(Vec3D)));
+	}
+	solver.limiter_function=limiter_function;
+	
+	// The complete gradient and limiter sweep of the solver
+	MPI_Barrier(MPI_COMM_WORLD);
+	timeRef=MPI_Wtime();
+	for (int r=0;r<repeat;++r) solver.calc_cell_grads();
+	time=MPI_Wtime()-timeRef;
+	bench_record(prefix+"calc_cell_grads",repeat,time,g.cellCount,g.cellCount*cellBytes);
+	
+	// Face loop alone and the whole assembly including the matrix insertion
+	// Each face reads both cells, its geometry and writes two rhs rows (and a 5x10 Jacobian block)
+	double faceBytes=2*cellBytes+(2*3+1)*sizeof(double)+10*sizeof(double);
+	if (solver.linear_solver==KRYLOV) faceBytes+=50*sizeof(double);
+	solver.assemble_linear_system(); // warm up
+	VecAssemblyBegin(solver.rhs);
+	VecAssemblyEnd(solver.rhs);
+	VecSet(solver.rhs,0.);
+	
+	MPI_Barrier(MPI_COMM_WORLD);
+	timeRef=MPI_Wtime();
+	for (int r=0;r<repeat;++r) solver.face_loop(solver.face_kernel,false);
+	time=MPI_Wtime()-timeRef;
+	bench_record(prefix+"face_loop",repeat,time,g.faceCount,g.faceCount*faceBytes);
+	
+	// The same loop with the reference kernels that dispatch the options at run time
+	MPI_Barrier(MPI_COMM_WORLD);
+	timeRef=MPI_Wtime();
+	for (int r=0;r<repeat;++r) solver.face_loop(solver.reference_kernel,false);
+	double genericTime=MPI_Wtime()-timeRef;
+	bench_record(prefix+"face_loop_generic",repeat,genericTime,g.faceCount,g.faceCount*faceBytes);
+	double times[2]={time,genericTime};
+	double maxTimes[2];
+	MPI_Allreduce(times,maxTimes,2,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+	if (Rank==0) {
+		cout << "[I]	specialized face loop speedup " << fixed << setprecision(2) << maxTimes[1]/max(maxTimes[0],1.e-12) << endl;
+		cout.unsetf(ios::floatfield);
+	}
+	
+	time=0.;
+	for (int r=0;r<repeat;++r) {
+		MPI_Barrier(MPI_COMM_WORLD);
+		timeRef=MPI_Wtime();
+		solver.assemble_linear_system();
+		if (solver.linear_solver==KRYLOV) {
+			MatAssemblyBegin(solver.impOP,MAT_FINAL_ASSEMBLY);
+			MatAssemblyEnd(solver.impOP,MAT_FINAL_ASSEMBLY);
+		}
+		VecAssemblyBegin(solver.rhs);
+		VecAssemblyEnd(solver.rhs);
+		time+=MPI_Wtime()-timeRef;
+		VecSet(solver.rhs,0.);
+	}
+	bench_record(prefix+"assemble_linear_system",repeat,time,g.faceCount,g.faceCount*faceBytes);
+	
+	// Halo exchanges, items are the received ghost cells
+	double sent=0.,received=0.;
+	for (int proc=0;proc<g.sendCells.size();++proc) sent+=g.sendCells[proc].size();
+	for (int proc=0;proc<g.recvCells.size();++proc) received+=g.recvCells[proc].size();
+	
+	MPI_Barrier(MPI_COMM_WORLD);
+	timeRef=MPI_Wtime();
+	for (int r=0;r<repeat;++r) solver.mpi_update_ghost_primitives();
+	time=MPI_Wtime()-timeRef;
+	bench_record(prefix+"halo/primitives",repeat,time,received,(sent+received)*5*sizeof(double));
+	
+	MPI_Barrier(MPI_COMM_WORLD);
+	timeRef=MPI_Wtime();
+	for (int r=0;r<repeat;++r) solver.mpi_update_ghost_gradients();
+	time=MPI_Wtime()-timeRef;
+	bench_record(prefix+"halo/gradients",repeat,time,received,(sent+received)*15*sizeof(double));
+	
+	return;
+}
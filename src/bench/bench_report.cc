@@ -0,0 +1,112 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <fstream>
+#include <time.h>
+#include "bench.h"
+#include "utilities.h"
+
+extern int Rank,np;
+
+static vector<Bench_Result> results;
+
+void bench_print_header(string title) {
+	
+	if (Rank!=0) return;
+	cout << "[I] " << title << endl;
+	cout << setw(40) << left << "benchmark" << right << setw(8) << "iter" << setw(14) << "time [s]" << setw(14) << "items [1/s]" << setw(14) << "bytes [1/s]" << endl;
+	
+	return;
+}
+
+// The timings of the collective benchmarks are reduced to the slowest rank, the work is summed
+void bench_record(string name,int iterations,double time,double items,double bytes,bool collective) {
+	
+	Bench_Result result;
+	result.name=name;
+	result.iterations=iterations;
+	result.time=time/double(max(iterations,1));
+	result.items=items;
+	result.bytes=bytes;
+	
+	if (collective) {
+		MPI_Allreduce(&time,&result.time,1,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+		result.time/=double(max(iterations,1));
+		MPI_Allreduce(&items,&result.items,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+		MPI_Allreduce(&bytes,&result.bytes,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+	}
+	
+	if (Rank!=0) return;
+	
+	results.push_back(result);
+	double time_=max(result.time,1.e-300);
+	cout << setw(40) << left << name << right << setw(8) << iterations << scientific << setprecision(3)
+	     << setw(14) << result.time << setw(14) << result.items/time_ << setw(14) << result.bytes/time_ << endl;
+	cout.unsetf(ios::floatfield);
+	
+	return;
+}
+
+// Google Benchmark style output so that runs of different builds can be diffed or compared with its tools
+void bench_write_json(string fileName,string caseName) {
+	
+	if (Rank!=0 || fileName=="") return;
+	
+	char date[64];
+	time_t now=time(NULL);
+	strftime(date,sizeof(date),"%Y-%m-%dT%H:%M:%S",localtime(&now));
+	
+	ofstream file;
+	file.open(fileName.c_str(),ios::out);
+	file << "{" << endl;
+	file << "  \"context\": {" << endl;
+	file << "    \"date\": \"" << date << "\"," << endl;
+	file << "    \"executable\": \"fcfd_bench\"," << endl;
+	file << "    \"case\": \"" << caseName << "\"," << endl;
+	file << "    \"mpi_ranks\": " << np << "," << endl;
+	file << "    \"threads\": " << thread_count() << endl;
+	file << "  }," << endl;
+	file << "  \"benchmarks\": [" << endl;
+	file << setprecision(8);
+	for (int r=0;r<results.size();++r) {
+		double time_=max(results[r].time,1.e-300);
+		file << "    {" << endl;
+		file << "      \"name\": \"" << results[r].name << "\"," << endl;
+		file << "      \"iterations\": " << results[r].iterations << "," << endl;
+		file << "      \"real_time\": " << results[r].time*1.e9 << "," << endl;
+		file << "      \"time_unit\": \"ns\"," << endl;
+		file << "      \"items_per_iteration\": " << results[r].items << "," << endl;
+		file << "      \"bytes_per_iteration\": " << results[r].bytes << "," << endl;
+		file << "      \"items_per_second\": " << results[r].items/time_ << "," << endl;
+		file << "      \"bytes_per_second\": " << results[r].bytes/time_ << endl;
+		file << "    }";
+		if (r!=results.size()-1) file << ",";
+		file << endl;
+	}
+	file << "  ]" << endl;
+	file << "}" << endl;
+	file.close();
+	
+	cout << "[I] Wrote benchmark results to " << fileName << endl;
+	
+	return;
+}
@@ -0,0 +1,152 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <stdlib.h>
+#include "inputs.h"
+#include "grid.h"
+#include "ns.h"
+#include "hc.h"
+#include "rans.h"
+#include "bc.h"
+#include "commons.h"
+#include "bc_interface.h"
+#include "loads.h"
+#include "bench.h"
+
+void read_inputs(void);
+void read_grid(int gid);
+void set_interfaces(int gid);
+void setup_grid(int gid);
+
+// Globals referenced by the solver libraries
+InputFile input;
+vector<InputFile> material_input;
+vector<Grid> grid;
+vector<vector<BCregion> > bc;
+vector<NavierStokes> ns;
+vector<HeatConduction> hc;
+vector<RANS> rans;
+vector<bool> turbulent;
+vector<Variable<double> > dt;
+vector<Variable<double> > dtau;
+vector<int> equations;
+vector<vector<BC_Interface> > interface;
+vector<Loads> loads;
+int Rank,np;
+int gradient_test;
+double min_x,max_x;
+
+static char help[] = "Free CFD kernel benchmarks";
+
+// Set up the grids and solvers of a case the same way fcfd does, up to the time loop
+static void setup_case(string caseName) {
+	
+	input.setFile(caseName+".in");
+	read_inputs();
+	
+	int gridCount=input.section("grid",0).count;
+	equations.resize(gridCount);
+	turbulent.resize(gridCount);
+	for (int gid=0;gid<gridCount;++gid) {
+		if (input.section("grid",gid).get_string("equations")=="navierstokes") equations[gid]=NS;
+		else if (input.section("grid",gid).get_string("equations")=="heatconduction") equations[gid]=HEAT;
+		turbulent[gid]=input.section("grid",gid).subsection("turbulence").is_found;
+	}
+	
+	grid.resize(gridCount);
+	ns.resize(gridCount);
+	rans.resize(gridCount);
+	hc.resize(gridCount);
+	bc.resize(gridCount);
+	interface.resize(gridCount);
+	loads.resize(gridCount);
+	
+	for (int gid=0;gid<gridCount;++gid) {
+		read_grid(gid);
+		set_interfaces(gid);
+		setup_grid(gid);
+	}
+	for (int gid=0;gid<gridCount;++gid) {
+		for (int i=0;i<interface[gid].size();++i) interface[gid][i].setup();
+	}
+	
+	int ps_step_max=input.section("pseudotime").get_int("numberofsteps");
+	for (int gid=0;gid<gridCount;++gid) {
+		if (equations[gid]==NS) {
+			ns[gid].gid=gid;
+			ns[gid].initialize(ps_step_max);
+			if (turbulent[gid]) {
+				rans[gid].gid=gid;
+				rans[gid].initialize(ps_step_max);
+			}
+		} else if (equations[gid]==HEAT) {
+			hc[gid].gid=gid;
+			hc[gid].initialize();
+		}
+	}
+	
+	return;
+}
+
+int main(int argc, char *argv[]) {
+
+	MPI_Init(&argc,&argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &np);
+	PetscInitialize(&argc,&argv,(char *)0,help);
+
+	// Usage: fcfd_bench [-case name] [-repeat count] [-faces count] [-json file]
+	// Without a case, only the flux kernels are timed on random face states
+	// With a case (input file name without the .in as for fcfd, e.g. a format=box grid),
+	// the grid and solver kernels of each grid are timed as well
+	string caseName="";
+	string jsonFile="";
+	int nFaces=1<<16;
+	int repeat=50;
+	for (int i=1;i<argc-1;++i) {
+		string arg=argv[i];
+		if (arg=="-case") caseName=argv[++i];
+		else if (arg=="-repeat") repeat=atoi(argv[++i]);
+		else if (arg=="-faces") nFaces=atoi(argv[++i]);
+		else if (arg=="-json") jsonFile=argv[++i];
+	}
+
+	if (Rank==0) {
+		cout << "[I] Kernel benchmarks with " << repeat << " repeats on " << np << " ranks" << endl;
+		bench_flux(nFaces,repeat);
+	}
+	
+	if (caseName!="") {
+		setup_case(caseName);
+		for (int gid=0;gid<grid.size();++gid) {
+			bench_mesh(gid,repeat);
+			if (equations[gid]==NS) bench_ns(gid,repeat);
+		}
+	}
+	
+	bench_write_json(jsonFile,caseName);
+
+	PetscFinalize();
+	MPI_Finalize();
+	
+	return 0;
+}
@@ -25,7 +25,8 @@ using namespace std;
 
 extern vector<Grid> grid;
 	
-void curvilinear_grad_map(int gid,int c) {
+// The map of the cell is returned in gradMap (called from threads, only reads the grid)
+void curvilinear_grad_map(int gid,int c,map<int,Vec3D> &gradMap) {
 
 	set<int> stencil;
 	set<int>::iterator sit,sit1,sit2,sit3,sit4,sit5,sit6;
@@ -200,7 +201,7 @@ void curvilinear_grad_map(int gid,int c) {
 	 
 	*/
 	
-	map<int,Vec3D> gradMap;
+	gradMap.clear();
 	
 	gradMap.insert(pair<int,Vec3D>(cell_pairs[0],-1.*Jac_invT[0]));
 	
@@ -219,9 +220,6 @@ void curvilinear_grad_map(int gid,int c) {
 	if (gradMap.find(cell_pairs[5])==gradMap.end())	gradMap.insert(pair<int,Vec3D>(cell_pairs[5],Jac_invT[2]));		
 	else gradMap[cell_pairs[5]]+=Jac_invT[2];
 	
-	grid[gid].cell[c].gradMap=gradMap;
-	
-	gradMap.clear();
 	stencil.clear();
 	
 	return;
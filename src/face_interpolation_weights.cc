@@ -31,35 +31,47 @@ extern InputFile input;
 
 void face_interpolation_weights(int gid) {
 
-	Interpolate interpolation; // Declare interpolation object
-	
-	interpolation.init();
-
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="wtli") interpolation.method=WTLI;
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="idw") interpolation.method=IDW;
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="simple") interpolation.method=SIMPLE;
+	int method=WTLI;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="wtli") method=WTLI;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="idw") method=IDW;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="simple") method=SIMPLE;
 	
-	interpolation.max_stencil_size=input.section("grid",gid).subsection("interpolation").get_int("stencilsize");
-	interpolation.skewness_tolerance=input.section("grid",gid).subsection("interpolation").get_double("skewnesstolerance");
-	interpolation.dimension=grid[gid].dimension;
+	int max_stencil_size=input.section("grid",gid).subsection("interpolation").get_int("stencilsize");
+	double skewness_tolerance=input.section("grid",gid).subsection("interpolation").get_double("skewnesstolerance");
+	int dimension=grid[gid].dimension;
 
-	if (interpolation.max_stencil_size<1) { // Means auto based on dimension
-		if (interpolation.dimension==3) interpolation.max_stencil_size=12;
-		else if (interpolation.dimension==2) interpolation.max_stencil_size=6; 
-		else if (interpolation.dimension==1) interpolation.max_stencil_size=2;
+	if (max_stencil_size<1) { // Means auto based on dimension
+		if (dimension==3) max_stencil_size=12;
+		else if (dimension==2) max_stencil_size=6; 
+		else if (dimension==1) max_stencil_size=2;
 	}
 	
-	if (interpolation.method==IDW) interpolation.max_stencil_size=99;
+	if (method==IDW) max_stencil_size=99;
 
 	int tetra_intp_count=0;		
 	int tri_intp_count=0;		
 	int line_intp_count=0;		
 	int point_intp_count=0;
 	
+	// Each thread fills the rows of its own (contiguous) range of faces
+	vector<Stencil<double> > part (thread_count());
+	
+	#pragma omp parallel reduction(+:tetra_intp_count,tri_intp_count,line_intp_count,point_intp_count)
+	{
+	Interpolate interpolation; // Declare interpolation object
+	
+	interpolation.init();
+	interpolation.method=method;
+	interpolation.max_stencil_size=max_stencil_size;
+	interpolation.skewness_tolerance=skewness_tolerance;
+	interpolation.dimension=dimension;
+	
+	Stencil<double> &average=part[thread_id()];
 	set<int> stencil;
 	set<int>::iterator sit;
 	// Loop all the faces
 	bool is_internal=true;
+	#pragma omp for schedule(static)
 	for (int f=0;f<grid[gid].faceCount;++f) {
 		interpolation.point=grid[gid].face[f].centroid;
 		int c=grid[gid].face[f].parent;
@@ -95,10 +107,9 @@ void face_interpolation_weights(int gid) {
 		if (interpolation.method==WTLI) {
 			
 			interpolation.calculate_weights(is_internal);
-			double weightSum=0.;
 			for (int i=0;i<interpolation.weights.size();++i) {
-				grid[gid].face[f].average.insert(pair<int,double>(interpolation.stencil_indices[i],interpolation.weights[i]));
-				weightSum+=interpolation.weights[i];
+				average.index.push_back(interpolation.stencil_indices[i]);
+				average.weight.push_back(interpolation.weights[i]);
 			}
 
 			if      (interpolation.kind==4) tetra_intp_count++;
@@ -108,24 +119,32 @@ void face_interpolation_weights(int gid) {
 			
 		} else if (interpolation.method==IDW) {
 			// Loop the stencil
-			vector<double> weights(interpolation.stencil.size(),0.);
+			vector<double> &weights=interpolation.weights;
+			weights.assign(interpolation.stencil.size(),0.);
 			double weightSum=0.;
 			for (int s=0;s<interpolation.stencil.size();++s) {
 				weights[s]=fabs(grid[gid].face[f].centroid-interpolation.stencil[s]);
 				weightSum+=weights[s];
 			}		
 			for (int s=0;s<interpolation.stencil.size();++s) weights[s]/=weightSum;
-			for (int s=0;s<interpolation.stencil.size();++s) grid[gid].face[f].average.insert(pair<int,double>(interpolation.stencil_indices[s],weights[s])); 
+			for (int s=0;s<interpolation.stencil.size();++s) {
+				average.index.push_back(interpolation.stencil_indices[s]);
+				average.weight.push_back(weights[s]);
+			}
 
 		} else if (interpolation.method==SIMPLE) {		
 	
-			grid[gid].face[f].average.insert(pair<int,double>(interpolation.stencil_indices[0],0.5));
-			grid[gid].face[f].average.insert(pair<int,double>(interpolation.stencil_indices[1],0.5));
+			average.index.push_back(interpolation.stencil_indices[0]); average.weight.push_back(0.5);
+			average.index.push_back(interpolation.stencil_indices[1]); average.weight.push_back(0.5);
 		}
+		average.end_row();
 	
 		interpolation.flush();
 		stencil.clear();
 	}
+	} // end parallel
+	
+	grid[gid].faceAverage.join(part);
 	
 /*	
 	cout << "[I rank=" << Rank << "] Face centers for which tetra interpolation method was used = " << tetra_intp_count << endl; 
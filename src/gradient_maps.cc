@@ -22,6 +22,7 @@
 *************************************************************************/
 #include "grid.h"
 #include "inputs.h"
+#include "utilities.h"
 
 #define CURVILINEAR 1
 #define LSQR 2
@@ -33,8 +34,8 @@ using namespace std;
 
 extern vector<Grid> grid;
 extern InputFile input;
-extern void lsqr_grad_map(int gid,int c);
-extern void curvilinear_grad_map(int gid,int c);
+extern void lsqr_grad_map(int gid,int c,map<int,Vec3D> &gradMap);
+extern void curvilinear_grad_map(int gid,int c,map<int,Vec3D> &gradMap);
 
 void gradient_maps(int gid) {
 
@@ -52,27 +53,42 @@ void gradient_maps(int gid) {
 	else if (input.section("grid",0).subsection("gradients").get_string("othermethod")=="lsqr") other_method=LSQR;
 	else if (input.section("grid",0).subsection("gradients").get_string("othermethod")=="greengauss") other_method=GREENGAUSS;
 
-	for (int c=0;c<grid[gid].cellCount;++c) {
-		if (grid[gid].cell[c].nodes.size()==8) {
-			if (hex_method==CURVILINEAR) curvilinear_grad_map(gid,c);
-			else if (hex_method==LSQR) lsqr_grad_map(gid,c);
+	// Each thread fills the rows of its own (contiguous) range of cells
+	// Ghost cells get empty rows
+	vector<Stencil<Vec3D> > part (thread_count());
+	
+	#pragma omp parallel
+	{
+	Stencil<Vec3D> &gradMap=part[thread_id()];
+	map<int,Vec3D> row;
+	#pragma omp for schedule(static)
+	for (int c=0;c<grid[gid].cell.size();++c) {
+		if (c>=grid[gid].cellCount) {
+			// Nothing to do for ghost cells
+		} else if (grid[gid].cell[c].nodes.size()==8) {
+			if (hex_method==CURVILINEAR) curvilinear_grad_map(gid,c,row);
+			else if (hex_method==LSQR) lsqr_grad_map(gid,c,row);
 			else if (hex_method==GREENGAUSS) { 
 				// if gradMap is not filled, this will be used automatically, so don't need to do anything here 
 			}
 		} else if (grid[gid].cell[c].nodes.size()==6) {
-			if (prism_method==CURVILINEAR) curvilinear_grad_map(gid,c);
-			else if (prism_method==LSQR) lsqr_grad_map(gid,c);
+			if (prism_method==CURVILINEAR) curvilinear_grad_map(gid,c,row);
+			else if (prism_method==LSQR) lsqr_grad_map(gid,c,row);
 			else if (prism_method==GREENGAUSS) { 
 				// if gradMap is not filled, this will be used automatically, so don't need to do anything here 
 			}
 		} else {
-			if (other_method==CURVILINEAR) curvilinear_grad_map(gid,c);
-			else if (other_method==LSQR) lsqr_grad_map(gid,c);
+			if (other_method==CURVILINEAR) curvilinear_grad_map(gid,c,row);
+			else if (other_method==LSQR) lsqr_grad_map(gid,c,row);
 			else if (other_method==GREENGAUSS) { 
 				// if gradMap is not filled, this will be used automatically, so don't need to do anything here 
 			}
 		}
+		gradMap.append(row);
 	}
+	} // end parallel
+	
+	grid[gid].gradMap.join(part);
 		
 	return;
 }
@@ -21,17 +21,42 @@
 
 *************************************************************************/
 #include "grid.h"
+#include "timers.h"
+#include "memory_usage.h"
+#include "comm_profile.h"
 
 string int2str(int number) ;
 
 Grid::Grid() {
+	// All the ranks hold a part of the grid until set_communicator says otherwise
+	set_communicator(MPI_COMM_WORLD,0);
+}
+
+void Grid::set_communicator(MPI_Comm gridComm,int offset) {
+	comm=gridComm;
+	active=(comm!=MPI_COMM_NULL);
+	worldOffset=offset;
+	Rank=0; np=0;
+	if (!active) {
+		// Nothing of the grid is kept on this rank
+		GridRawData empty;
+		swap(raw,empty);
+		nodeCount=0; cellCount=0; faceCount=0;
+		return;
+	}
 	// Just get the current processor's rank
-	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+	MPI_Comm_rank(comm, &Rank);
 	// And total number of processors
-	MPI_Comm_size(MPI_COMM_WORLD, &np);
+	MPI_Comm_size(comm, &np);
+	return;
 }
 
 void Grid::read(string fname, string format) {
+	if (format=="box") {
+		// No file needed, each rank generates its part of the grid once the grid's ranks are known
+		box_size();
+		return;
+	}
 	if (read_raw()) return;
 	fstream file;
 	fileName=fname;
@@ -53,31 +78,49 @@ void Grid::read(string fname, string format) {
 }
 
 void Grid::setup(void) {
-      if (Rank==0) cout << "[I] Partitioning the grid" << endl;
-	partition();
+	string stage="grid "+int2str(gid+1)+"/";
+	if (memory_usage.enabled) account_memory(); // raw data, released by trim_memory
+	memory_usage.stage(stage+"read");
+	if (!raw.slice) { // A slice comes partitioned (generateBox)
+	      if (Rank==0) cout << "[I] Partitioning the grid" << endl;
+		timers.start("partition"); partition(); timers.stop(); memory_usage.stage(stage+"partition");
+	}
       if (Rank==0) cout << "[I] Creating nodes and cells" << endl;
+	timers.start("nodes and cells");
 	create_nodes_cells();
-	raw.node.clear();
-      if (Rank==0) cout << "[I] Computing mesh dual" << endl;
-	mesh2dual();
+	vector<Vec3D> ().swap(raw.node);
+	raw.nodeIndex.clear();
+	timers.stop(); memory_usage.stage(stage+"nodes and cells");
+	if (!raw.slice) { // A slice holds the cells around the partition already
+	      if (Rank==0) cout << "[I] Computing mesh dual" << endl;
+		timers.start("mesh dual"); mesh2dual(); timers.stop(); memory_usage.stage(stage+"mesh dual");
+	}
       if (Rank==0) cout << "[I] Creating faces" << endl;
+	timers.start("faces");
 	if (raw.type==CELL) create_faces();
 	else if (raw.type==FACE) create_faces2();
+	timers.stop(); memory_usage.stage(stage+"faces");
       if (Rank==0) cout << "[I] Creating inter-partition ghost cells" << endl;
-	create_partition_ghosts();
+	timers.start("partition ghosts"); create_partition_ghosts(); timers.stop(); memory_usage.stage(stage+"partition ghosts");
+      if (Rank==0) cout << "[I] Sorting faces" << endl;
+	timers.start("sort faces"); sort_faces(); timers.stop(); memory_usage.stage(stage+"sort faces");
       if (Rank==0) cout << "[I] Computing output node id's" << endl;
+	timers.start("output ids");
 	get_volume_output_ids();
 	get_bc_output_ids();
+	timers.stop(); memory_usage.stage(stage+"output ids");
       if (Rank==0) cout << "[I] Trimming memory" << endl;
-	trim_memory();
+	timers.start("trim memory"); trim_memory(); timers.stop(); memory_usage.stage(stage+"trim memory");
       if (Rank==0) cout << "[I] Calculating areas and volumes" << endl;
-	areas_volumes();
+	timers.start("areas and volumes"); areas_volumes(); timers.stop(); memory_usage.stage(stage+"areas and volumes");
       if (Rank==0) cout << "[I] Creating boundary ghost cells" << endl;
-	create_boundary_ghosts();
+	timers.start("boundary ghosts"); create_boundary_ghosts(); timers.stop(); memory_usage.stage(stage+"boundary ghosts");
+      if (Rank==0) cout << "[I] Coloring faces" << endl;
+	timers.start("color faces"); color_faces(); timers.stop(); memory_usage.stage(stage+"color faces");
       if (Rank==0) cout << "[I] MPI handshake" << endl;
-	mpi_handshake();
+	timers.start("mpi handshake"); mpi_handshake(); timers.stop(); memory_usage.stage(stage+"mpi handshake");
       if (Rank==0) cout << "[I] Getting ghost geometries" << endl;
-	mpi_get_ghost_geometry();
+	timers.start("ghost geometry"); mpi_get_ghost_geometry(); timers.stop(); memory_usage.stage(stage+"ghost geometry");
 	return;
 }
 	
@@ -105,17 +148,62 @@ void Grid::trim_memory() {
 	
 	vector<int> (partitionOffset).swap(partitionOffset);
 		
-	// Destroy grid raw data
-	raw.node.clear();
-	raw.cellConnIndex.clear();
-	raw.cellConnectivity.clear();
-	raw.bocoNodes.clear();
+	// Destroy grid raw data (swapping with empty containers releases the capacity too)
+	vector<Vec3D> ().swap(raw.node);
+	vector<int> ().swap(raw.cellConnIndex);
+	vector<int> ().swap(raw.cellConnectivity);
+	vector<set<int> > ().swap(raw.bocoNodes);
 	raw.bocoNameMap.clear();
-	raw.faceNodeCount.clear();
-	raw.faceConnIndex.clear();
-	raw.faceConnectivity.clear();
-	raw.left.clear();
-	raw.right.clear();
+	vector<int> ().swap(raw.faceNodeCount);
+	vector<int> ().swap(raw.faceConnIndex);
+	vector<int> ().swap(raw.faceConnectivity);
+	vector<int> ().swap(raw.left);
+	vector<int> ().swap(raw.right);
+	vector<int> ().swap(raw.cellGlobalId);
+	vector<int> ().swap(raw.cellOwner);
+	raw.nodeIndex.clear();
+	
+	return;
+}
+
+void Grid::account_memory() {
+	
+	string prefix="grid "+int2str(gid+1)+"/";
+	double size;
+	
+	size=container_bytes(raw.node)+container_bytes(raw.bocoNodes)+container_bytes(raw.bocoNameMap)
+		+container_bytes(raw.cellConnIndex)+container_bytes(raw.cellConnectivity)
+		+container_bytes(raw.faceNodeCount)+container_bytes(raw.faceConnIndex)+container_bytes(raw.faceConnectivity)
+		+container_bytes(raw.left)+container_bytes(raw.right)
+		+container_bytes(raw.cellGlobalId)+container_bytes(raw.cellOwner)+container_bytes(raw.nodeIndex);
+	memory_usage.account(prefix+"raw data",size);
+	
+	size=container_bytes(maps.cellOwner)+container_bytes(maps.nodeGlobal2Local)
+		+container_bytes(maps.cellGlobal2Local)+container_bytes(maps.face2bc);
+	memory_usage.account(prefix+"index maps",size);
+	
+	size=container_bytes(node);
+	for (int n=0;n<node.size();++n) size+=container_bytes(node[n].cells)+container_bytes(node[n].faces);
+	memory_usage.account(prefix+"nodes",size);
+	
+	size=container_bytes(face);
+	for (int f=0;f<face.size();++f) size+=container_bytes(face[f].nodes);
+	memory_usage.account(prefix+"faces",size);
+	
+	size=container_bytes(cell);
+	for (int c=0;c<cell.size();++c) size+=container_bytes(cell[c].nodes)+container_bytes(cell[c].faces)+container_bytes(cell[c].neighborCells);
+	memory_usage.account(prefix+"cells",size);
+	
+	size=container_bytes(faceAverage.offset)+container_bytes(faceAverage.index)+container_bytes(faceAverage.weight)
+		+container_bytes(nodeAverage.offset)+container_bytes(nodeAverage.index)+container_bytes(nodeAverage.weight);
+	memory_usage.account(prefix+"interpolation weights",size);
+	
+	size=container_bytes(gradMap.offset)+container_bytes(gradMap.index)+container_bytes(gradMap.weight);
+	memory_usage.account(prefix+"gradient maps",size);
+	
+	size=container_bytes(boundaryFaces)+container_bytes(boundaryNodes)+container_bytes(boundaryTypeFaces)
+		+container_bytes(faceColors)+container_bytes(boundaryColorTypeOffset)+container_bytes(boundaryFaceCount)+container_bytes(sendCells)+container_bytes(recvCells);
+	memory_usage.account(prefix+"face lists and halos",size);
 	
 	return;
 }
@@ -177,7 +265,7 @@ int Grid::areas_volumes() {
 		totalVolume+=cell[c].volume;
 	}
 	globalTotalVolume=0.;
-	MPI_Allreduce (&totalVolume,&globalTotalVolume,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+	comm_profile.allreduce("grid volume",&totalVolume,&globalTotalVolume,1,MPI_DOUBLE,MPI_SUM,comm);
 	if (Rank==0) cout << "[I] Total Volume= " << globalTotalVolume << endl;
 	
 	int count=0;
@@ -282,13 +370,13 @@ void Grid::mpi_handshake(void) {
 	// I don't even know how many to send
 	// First communicate to figure out which processor request how many ghost cell data
 	
-	MPI_Alltoall(&recvCount[0],1,MPI_INT,&sendCount[0],1,MPI_INT,MPI_COMM_WORLD);
+	MPI_Alltoall(&recvCount[0],1,MPI_INT,&sendCount[0],1,MPI_INT,comm);
 	
 
 	for (int p=0;p<np;++p) {
 		sendCells[p].resize(sendCount[p]);
 		MPI_Sendrecv(&recvCells[p][0],recvCount[p],MPI_INT,p,0,
-					 &sendCells[p][0],sendCount[p],MPI_INT,p,0,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+					 &sendCells[p][0],sendCount[p],MPI_INT,p,0,comm,MPI_STATUS_IGNORE);
 	}
 
 	// Commit MPI_VEC3D
@@ -327,7 +415,7 @@ void Grid::mpi_get_ghost_geometry(void) {
 				sendBuffer[g].data[3]=cell[id].volume;
 			}
 			
-			MPI_Sendrecv(sendBuffer,sendCells[p].size(),MPI_GEOM_PACK,p,0,recvBuffer,recvCells[p].size(),MPI_GEOM_PACK,p,MPI_ANY_TAG,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+			MPI_Sendrecv(sendBuffer,sendCells[p].size(),MPI_GEOM_PACK,p,0,recvBuffer,recvCells[p].size(),MPI_GEOM_PACK,p,MPI_ANY_TAG,comm,MPI_STATUS_IGNORE);
 			
 			for (int g=0;g<recvCells[p].size();++g) {
 				id=recvCells[p][g];
@@ -339,12 +427,17 @@ void Grid::mpi_get_ghost_geometry(void) {
 		}
 	}
 	
-	MPI_Barrier(MPI_COMM_WORLD);
+	MPI_Barrier(comm);
 	return;
 } 
 
 void Grid::write_raw(void) {
 	
+	if (raw.slice) {
+		cout << "[W] Box grids are generated at run time, grid.raw is not written for grid_" << gid+1 << endl;
+		return;
+	}
+	
 	ofstream file;
 	int int_size=sizeof(int);
 	int vec3d_size=sizeof(Vec3D);
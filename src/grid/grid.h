@@ -75,6 +75,24 @@ public:
 	std::vector<int> faceConnIndex,faceConnectivity;
 	std::vector<int> left,right;
 
+	// A slice (format=box) only holds the cells of this rank followed by the cells around them,
+	// and the nodes of this rank's cells
+	bool slice;
+	std::vector<int> cellGlobalId,cellOwner; // Global id and owner rank of each raw cell
+	std::map<int,int> nodeIndex; // Global node id to the index in node
+	
+	GridRawData(void) { slice=false; }
+};
+
+class BoxMesh { // Parameters of the built-in box grid generator (format=box)
+public:
+	int cells[3];
+	Vec3D corner_1,corner_2;
+	Vec3D stretching; // Ratio of consecutive cell sizes in each direction
+	string elements; // hex, prism, tet or mixed
+	double perturbation; // Random node displacement as a fraction of the local spacing
+	int seed;
+	std::vector<string> patches; // Names of the xmin,xmax,ymin,ymax,zmin,zmax patches
 };
 
 class IndexMaps {
@@ -93,7 +111,6 @@ public:
 	int output_id,bc_output_id;
 	std::vector<int> cells; // list of cells (ids) sharing this node
 	std::vector<int> faces; // list of faces touching this node
-	std::map<int,double> average; // indices of cells in the averaging stencil and corresponding weights
 	Node(double x=0., double y=0., double z=0.);
 };
 
@@ -106,7 +123,6 @@ public:
 	// The other cell is called the neighbor
 	Vec3D centroid;
 	Vec3D normal; // This should point outwards from the parent cell center
-	std::map<int,double> average; // indices of cells in the averaging stenceil and corresponding weights
 	double area; 
 	std::vector<int> nodes; // Nodes of this face
 	double closest_wall_distance,dissipation_factor;
@@ -123,11 +139,62 @@ public:
 	std::vector<int> nodes;
 	std::vector<int> faces;
 	std::vector<int> neighborCells;
-	std::map<int,Vec3D> gradMap;
 	Cell(void);
 	bool HaveNodes(int const nodelistsize, int nodelist[]) ;
 };
 
+// Weighted cell stencils of all the nodes, faces or cells in compressed row storage
+// Row i holds the entries offset[i] to offset[i+1]-1 of index (cell ids) and weight
+template <class T>
+class Stencil {
+public:
+	std::vector<int> offset;
+	std::vector<int> index;
+	std::vector<T> weight;
+	Stencil(void) { offset.assign(1,0); }
+	int size(int i) const { return offset[i+1]-offset[i]; }
+	// Close the row after pushing its entries
+	void end_row(void) { offset.push_back(index.size()); return; }
+	// Append a row built in a map and empty the map
+	void append(std::map<int,T> &row) {
+		typename std::map<int,T>::iterator it;
+		for (it=row.begin();it!=row.end();it++) {
+			index.push_back((*it).first);
+			weight.push_back((*it).second);
+		}
+		end_row();
+		row.clear();
+		return;
+	}
+	// Replace the contents with the rows of the parts, one after the other
+	// The parts are built by threads on consecutive row ranges, each copied into its own slot
+	void join(std::vector<Stencil<T> > &parts) {
+		std::vector<int> rowBegin (parts.size()+1,0),entryBegin (parts.size()+1,0);
+		for (int p=0;p<parts.size();++p) {
+			rowBegin[p+1]=rowBegin[p]+parts[p].offset.size()-1;
+			entryBegin[p+1]=entryBegin[p]+parts[p].index.size();
+		}
+		offset.resize(rowBegin.back()+1);
+		index.resize(entryBegin.back());
+		weight.resize(entryBegin.back());
+		offset[0]=0;
+		#pragma omp parallel for schedule(static,1)
+		for (int p=0;p<parts.size();++p) {
+			for (int i=1;i<parts[p].offset.size();++i) offset[rowBegin[p]+i]=entryBegin[p]+parts[p].offset[i];
+			std::copy(parts[p].index.begin(),parts[p].index.end(),index.begin()+entryBegin[p]);
+			std::copy(parts[p].weight.begin(),parts[p].weight.end(),weight.begin()+entryBegin[p]);
+			parts[p]=Stencil<T> (); // Release the part
+		}
+		return;
+	}
+	void clear(void) {
+		offset.assign(1,0);
+		index.clear();
+		weight.clear();
+		return;
+	}
+};
+
 class Grid {
 public:
 	int gid;
@@ -135,12 +202,18 @@ public:
 	int bcCount;
 	double lengthScale;
 	GridRawData raw;
+	BoxMesh box;
 	IndexMaps maps;
 	string fileName;
 	int myOffset,Rank,np;
+	// Ranks holding a part of this grid (all ranks unless the grids run concurrently)
+	MPI_Comm comm;
+	bool active; // false if the current rank holds no part of this grid
+	int worldOffset; // World rank of the grid's rank 0 (the grid's ranks are contiguous)
 	vector<int> partitionOffset;
 	int node_output_offset,node_bc_output_offset;
 	int nodeCount,cellCount,faceCount;
+	int interiorFaceCount; // Internal and partition faces come first, boundary faces follow
 	int partition_ghosts_begin,partition_ghosts_end;
 	vector<int> boundary_ghosts_begin,boundary_ghosts_end;
 	int globalNodeCount,global_bc_nodeCount,globalCellCount,globalFaceCount;
@@ -152,15 +225,25 @@ public:
 	std::vector<Face> face;
 	std::vector<Cell> cell;
 	std::vector<vector<int> > boundaryFaces,boundaryNodes;
+	std::vector<vector<int> > boundaryTypeFaces; // Boundary faces of each bc type (filled in set_bcs)
+	// Face and node averaging weights and cell gradient maps
+	Stencil<double> faceAverage,nodeAverage;
+	Stencil<Vec3D> gradMap; // An empty row means Green-Gauss gradient
+	std::vector<vector<int> > faceColors; // Groups of faces that don't share any local cell
+	int interiorColorCount; // Colors below this hold interior faces only, the rest boundary faces only
+	std::vector<vector<int> > boundaryColorTypeOffset; // Start of each bc type batch in the boundary colors (filled in set_bcs)
 	// Maps for MPI exchanges
 	std::vector< std::vector<int> > sendCells;
 	std::vector< std::vector<int> > recvCells;
 	MPI_Datatype MPI_GEOM_PACK;
 	Grid();
+	void set_communicator(MPI_Comm gridComm,int offset);
 	void read(string fileName,string format);
 	void setup(void);
 	int readCGNS();
 	int readTEC();
+	int box_size();
+	int generateBox();
 	int translate(Vec3D begin, Vec3D end);
 	int scale(Vec3D anchor, Vec3D factor);
 	int rotate(Vec3D anchor, Vec3D axis, double angle);
@@ -170,11 +253,14 @@ public:
 	int create_faces();
 	int create_faces2();
 	int create_partition_ghosts();
+	int sort_faces();
 	int get_volume_output_ids();
 	int get_bc_output_ids();
 	void trim_memory();
+	void account_memory();
 	int areas_volumes();
 	int create_boundary_ghosts();
+	int color_faces();
 	void nodeAverages();
 	void sortStencil(Node& n);
 	void sortStencil(int f);
@@ -21,6 +21,8 @@
 
 *************************************************************************/
 #include "grid.h"
+#include "comm_profile.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -32,24 +34,29 @@ int Grid::create_nodes_cells() {
 	// This stores the total node count in the current partition
 	nodeCount=0;
 	
-	for (int c=0;c<globalCellCount;++c) {
-		if (maps.cellOwner[c]==Rank) { // If the cell belongs to current proc
+	// The raw cell index is the global id unless the raw data is a slice
+	int rawCellCount=raw.cellConnIndex.size();
+	for (int r=0;r<rawCellCount;++r) {
+		int c=(raw.slice) ? raw.cellGlobalId[r] : r;
+		int owner=(raw.slice) ? raw.cellOwner[r] : maps.cellOwner[c];
+		if (owner==Rank) { // If the cell belongs to current proc
 			int cellNodeCount; // Find the number of nodes of the cell from raw grid data
-			if (c<globalCellCount-1) {
-				cellNodeCount=raw.cellConnIndex[c+1]-raw.cellConnIndex[c];
+			if (r<rawCellCount-1) {
+				cellNodeCount=raw.cellConnIndex[r+1]-raw.cellConnIndex[r];
 			} else {
-				cellNodeCount=raw.cellConnectivity.size()-raw.cellConnIndex[globalCellCount-1];
+				cellNodeCount=raw.cellConnectivity.size()-raw.cellConnIndex[rawCellCount-1];
 			}
 			int cellNodes[cellNodeCount];
 			for (int n=0;n<cellNodeCount;++n) { // Loop the cell  nodes
-				int ngid=raw.cellConnectivity[raw.cellConnIndex[c]+n]; // node globalId
+				int ngid=raw.cellConnectivity[raw.cellConnIndex[r]+n]; // node globalId
 				if (maps.nodeGlobal2Local.find(ngid)==maps.nodeGlobal2Local.end() ) { // If the node is not already found
 					// Create the node
 					Node temp;
 					temp.globalId=ngid;
-					temp.comp[0]=raw.node[temp.globalId][0];
-					temp.comp[1]=raw.node[temp.globalId][1];
-					temp.comp[2]=raw.node[temp.globalId][2];
+					int rn=(raw.slice) ? raw.nodeIndex[ngid] : ngid;
+					temp.comp[0]=raw.node[rn][0];
+					temp.comp[1]=raw.node[rn][1];
+					temp.comp[2]=raw.node[rn][2];
 					maps.nodeGlobal2Local[temp.globalId]=nodeCount;
 					node.push_back(temp);
 					++nodeCount;
@@ -564,87 +571,92 @@ int Grid::create_partition_ghosts() {
 	// Create ghost elemets to hold the data from other partitions
 
 	if (np>1) {
-		int counter=0;
-		int cellCountOffset[np];
-
-		// Find out other partition's cell counts
-		int otherCellCounts[np];
-		for (int i=0;i<np;++i) otherCellCounts[i]=0;
-		for (int c=0;c<globalCellCount;++c) otherCellCounts[maps.cellOwner[c]]++;
-		
-		for (int p=0;p<np;++p) {
-			cellCountOffset[p]=counter;
-			counter+=otherCellCounts[p];
-		}
-		// Now find metis2global index mapping
-		int metis2global[globalCellCount];
-		int counter2[np];
-		for (int p=0;p<np;++p) counter2[p]=0;
-		for (int c=0;c<globalCellCount;++c) {
-			metis2global[cellCountOffset[maps.cellOwner[c]]+counter2[maps.cellOwner[c]]]=c;
-			counter2[maps.cellOwner[c]]++;
+		// Raw cells that may touch each partition face: the adjacency of the face parent
+		// after ParMETIS, or the halo cells sharing a node with it when the raw data is a slice
+		vector<vector<int> > candidates (faceCount);
+		if (raw.slice) {
+			vector<vector<int> > nodeRawCells (nodeCount);
+			for (int r=cellCount;r<raw.cellConnIndex.size();++r) {
+				int end=(r<raw.cellConnIndex.size()-1) ? raw.cellConnIndex[r+1] : raw.cellConnectivity.size();
+				for (int i=raw.cellConnIndex[r];i<end;++i) {
+					map<int,int>::iterator it=maps.nodeGlobal2Local.find(raw.cellConnectivity[i]);
+					if (it!=maps.nodeGlobal2Local.end()) nodeRawCells[it->second].push_back(r);
+				}
+			}
+			for (int f=0;f<faceCount;++f) {
+				if (face[f].bc==INTERNAL_FACE) continue;
+				for (int fn=0;fn<face[f].nodes.size();++fn) {
+					candidates[f].insert(candidates[f].end(),nodeRawCells[face[f].nodes[fn]].begin(),nodeRawCells[face[f].nodes[fn]].end());
+				}
+				sort(candidates[f].begin(),candidates[f].end());
+				candidates[f].erase(unique(candidates[f].begin(),candidates[f].end()),candidates[f].end());
+			}
+		} else {
+			// Now find metis2global index mapping
+			vector<int> metis2global (globalCellCount);
+			vector<int> counter (np,0);
+			for (int c=0;c<globalCellCount;++c) {
+				metis2global[partitionOffset[maps.cellOwner[c]]+counter[maps.cellOwner[c]]]=c;
+				counter[maps.cellOwner[c]]++;
+			}
+			for (int f=0;f<faceCount;++f) {
+				if (face[f].bc==INTERNAL_FACE) continue;
+				int parent=face[f].parent;
+				for (int adjCount=0;adjCount<(maps.adjIndex[parent+1]-maps.adjIndex[parent]);++adjCount)  {
+					int metisIndex=maps.adjacency[maps.adjIndex[parent]+adjCount];
+					// If the adjacent cell is not on the current partition
+					if (metisIndex<myOffset || metisIndex>=(cellCount+myOffset)) {
+						candidates[f].push_back(metis2global[metisIndex]);
+					}
+				}
+			}
 		}
 
-		bool foundFlag[globalCellCount];
-		for (int c=0; c<globalCellCount;++c) foundFlag[c]=false;
-
-		int parent, metisIndex, gg, matchCount;
-		
-		Vec3D nodeVec;
-		
+		int rawCellCount=raw.cellConnIndex.size();
 		// Loop faces
 		for (int f=0;f<faceCount;++f) {
-			if (face[f].bc!=INTERNAL_FACE) { 
-				parent=face[f].parent;
-				// Loop through the cells that are adjacent to the current face's parent
-				for (int adjCount=0;adjCount<(maps.adjIndex[parent+1]-maps.adjIndex[parent]);++adjCount)  {
-					metisIndex=maps.adjacency[maps.adjIndex[parent]+adjCount];
-					// Get global id of the adjacent cell
-					gg=metis2global[metisIndex];
-					// If the adjacent cell is not on the current partition
-					if (metisIndex<cellCountOffset[Rank] || metisIndex>=(cellCount+cellCountOffset[Rank])) {
-						int cellNodeCount; // Find the number of nodes of the cell from raw grid data
-						if (gg<globalCellCount-1) {
-							cellNodeCount=raw.cellConnIndex[gg+1]-raw.cellConnIndex[gg];
-						} else {
-							cellNodeCount=raw.cellConnectivity.size()-raw.cellConnIndex[globalCellCount-1];
-						}
-						// Count number of matches in node lists of the current face and the adjacent cell
-						vector<int> matchedNodes;
-						for (int fn=0;fn<face[f].nodes.size();++fn) {
-							for (int gn=0;gn<cellNodeCount;++gn) {
-								if (raw.cellConnectivity[raw.cellConnIndex[gg]+gn]==faceNode(f,fn).globalId) {
-									matchedNodes.push_back(fn);
-									break;
-								}
-							}
+			for (int k=0;k<candidates[f].size();++k) {
+				int r=candidates[f][k]; // raw index of the candidate cell
+				int gg=(raw.slice) ? raw.cellGlobalId[r] : r; // global id of the candidate cell
+				int cellNodeCount; // Find the number of nodes of the cell from raw grid data
+				if (r<rawCellCount-1) {
+					cellNodeCount=raw.cellConnIndex[r+1]-raw.cellConnIndex[r];
+				} else {
+					cellNodeCount=raw.cellConnectivity.size()-raw.cellConnIndex[rawCellCount-1];
+				}
+				// Count number of matches in node lists of the current face and the adjacent cell
+				vector<int> matchedNodes;
+				for (int fn=0;fn<face[f].nodes.size();++fn) {
+					for (int gn=0;gn<cellNodeCount;++gn) {
+						if (raw.cellConnectivity[raw.cellConnIndex[r]+gn]==faceNode(f,fn).globalId) {
+							matchedNodes.push_back(fn);
+							break;
 						}
+					}
+				}
 
-						if (matchedNodes.size()>0 && !foundFlag[gg]) {
-							foundFlag[gg]=true;
-							Cell temp;
-							temp.globalId=gg;
-							temp.partition=maps.cellOwner[gg];
-							maps.cellGlobal2Local[temp.globalId]=cell.size();
-							cell.push_back(temp);
-						}
-							
-						if (matchedNodes.size()==face[f].nodes.size()) {
-							// If that ghost was found before, now we discovered another face also neighbors the same ghost
-							face[f].bc=PARTITION_FACE;
-							face[f].neighbor=maps.cellGlobal2Local[gg];
-						}
-				
-						for (int i=0;i<matchedNodes.size();++i) {
-							bool flag=true;
-							for (int ic=0;ic<faceNode(f,matchedNodes[i]).cells.size();++ic) {
-								if (faceNode(f,matchedNodes[i]).cells[ic]==maps.cellGlobal2Local[gg]) flag=false;
-							}
-							if (flag) faceNode(f,matchedNodes[i]).cells.push_back(maps.cellGlobal2Local[gg]);
-						}
-						matchedNodes.clear();
+				if (matchedNodes.size()>0 && maps.cellGlobal2Local.find(gg)==maps.cellGlobal2Local.end()) {
+					Cell temp;
+					temp.globalId=gg;
+					temp.partition=(raw.slice) ? raw.cellOwner[r] : maps.cellOwner[gg];
+					maps.cellGlobal2Local[temp.globalId]=cell.size();
+					cell.push_back(temp);
+				}
+					
+				if (matchedNodes.size()==face[f].nodes.size()) {
+					// If that ghost was found before, now we discovered another face also neighbors the same ghost
+					face[f].bc=PARTITION_FACE;
+					face[f].neighbor=maps.cellGlobal2Local[gg];
+				}
+		
+				for (int i=0;i<matchedNodes.size();++i) {
+					bool flag=true;
+					for (int ic=0;ic<faceNode(f,matchedNodes[i]).cells.size();++ic) {
+						if (faceNode(f,matchedNodes[i]).cells[ic]==maps.cellGlobal2Local[gg]) flag=false;
 					}
+					if (flag) faceNode(f,matchedNodes[i]).cells.push_back(maps.cellGlobal2Local[gg]);
 				}
+				matchedNodes.clear();
 			}
 		}
 
@@ -691,14 +703,55 @@ int Grid::create_partition_ghosts() {
 		}
 	}
 
-        MPI_Allreduce (&globalNumFaceNodes,&globalNumFaceNodes,1,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
-        MPI_Allreduce (&globalFaceCount,&globalFaceCount,1,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+        comm_profile.allreduce("grid counts",MPI_IN_PLACE,&globalNumFaceNodes,1,MPI_INT,MPI_SUM,comm);
+        comm_profile.allreduce("grid counts",MPI_IN_PLACE,&globalFaceCount,1,MPI_INT,MPI_SUM,comm);
 
 	partition_ghosts_begin=cellCount;
 	partition_ghosts_end=cell.size()-1;
 
 } // end int Grid::create_partition_ghosts
 
+int Grid::sort_faces (void) {
+
+	// Place the internal and partition faces first and the boundary faces after them,
+	// grouped by boundary region. The boundary faces then form a contiguous tail of
+	// the face list and face loops don't need to check for boundaries in the interior.
+	vector<int> order;
+	vector<vector<int> > bcFaces;
+	vector<int> unassigned;
+	order.reserve(faceCount);
+	for (int f=0;f<faceCount;++f) {
+		if (face[f].bc==INTERNAL_FACE || face[f].bc==PARTITION_FACE) {
+			order.push_back(f);
+		} else if (face[f].bc>=0) {
+			if (face[f].bc>=bcFaces.size()) bcFaces.resize(face[f].bc+1);
+			bcFaces[face[f].bc].push_back(f);
+		} else {
+			unassigned.push_back(f);
+		}
+	}
+	interiorFaceCount=order.size();
+	for (int b=0;b<bcFaces.size();++b) order.insert(order.end(),bcFaces[b].begin(),bcFaces[b].end());
+	order.insert(order.end(),unassigned.begin(),unassigned.end());
+	
+	vector<int> newIndex (faceCount);
+	for (int i=0;i<faceCount;++i) newIndex[order[i]]=i;
+	
+	vector<Face> sorted (faceCount);
+	for (int i=0;i<faceCount;++i) sorted[i]=face[order[i]];
+	face.swap(sorted);
+	
+	// Renumber the face references
+	for (int c=0;c<cell.size();++c) {
+		for (int cf=0;cf<cell[c].faces.size();++cf) cell[c].faces[cf]=newIndex[cell[c].faces[cf]];
+	}
+	for (int n=0;n<nodeCount;++n) {
+		for (int nf=0;nf<node[n].faces.size();++nf) node[n].faces[nf]=newIndex[node[n].faces[nf]];
+	}
+	
+	return 0;
+} // end Grid::sort_faces
+
 int Grid::create_boundary_ghosts (void) {
 
 	boundary_ghosts_begin.resize(bcCount);
@@ -707,7 +760,7 @@ int Grid::create_boundary_ghosts (void) {
 	// Create boundary ghost cells
 	for (int b=0;b<bcCount;++b) {
 		boundary_ghosts_begin[b]=cell.size();
-		for (int f=0;f<faceCount;++f) {
+		for (int f=interiorFaceCount;f<faceCount;++f) {
 			if (face[f].bc==b) {
 				int parent=face[f].parent;
 				Cell temp;
@@ -796,7 +849,7 @@ int Grid::get_volume_output_ids() {
 	output_node_counts[Rank]=count;
 	MPI_Allgather(MPI_IN_PLACE,0,MPI_INT, 
 				  &output_node_counts[0],1,MPI_INT, 
-				  MPI_COMM_WORLD);
+				  comm);
 	
 	// A sanity check here:
 	int sum=0;
@@ -818,10 +871,10 @@ int Grid::get_volume_output_ids() {
 				for (int n=0;n<nodeCount;++n) if (node[n].output_id==-1) exchange_nodes.push_back(node[n].globalId);
 				// Send the size of the list
 				size=exchange_nodes.size();
-				MPI_Send(&size,1,MPI_INT,pr,p,MPI_COMM_WORLD);
+				MPI_Send(&size,1,MPI_INT,pr,p,comm);
 				// Send the list
-				MPI_Send(&exchange_nodes[0],size,MPI_INT,pr,p,MPI_COMM_WORLD);
-				MPI_Recv(&exchange_nodes[0],size,MPI_INT,pr,p,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+				MPI_Send(&exchange_nodes[0],size,MPI_INT,pr,p,comm);
+				MPI_Recv(&exchange_nodes[0],size,MPI_INT,pr,p,comm,MPI_STATUS_IGNORE);
 				// Fill in the node output id's
 				int count=0;
 				for (int n=0;n<nodeCount;++n) {
@@ -834,11 +887,11 @@ int Grid::get_volume_output_ids() {
 			}
 			if (Rank==pr) {
 				// Receive the list size
-				MPI_Recv(&size,1,MPI_INT,p,p,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+				MPI_Recv(&size,1,MPI_INT,p,p,comm,MPI_STATUS_IGNORE);
 				vector<int> exchange_nodes;
 				exchange_nodes.resize(size);
 				// Receive the list
-				MPI_Recv(&exchange_nodes[0],size,MPI_INT,p,p,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+				MPI_Recv(&exchange_nodes[0],size,MPI_INT,p,p,comm,MPI_STATUS_IGNORE);
 				// Fill in the output_id's of exchange nodes
 				for (int i=0;i<size;++i) {
 					if (maps.nodeGlobal2Local.find(exchange_nodes[i])!=maps.nodeGlobal2Local.end()) {
@@ -846,7 +899,7 @@ int Grid::get_volume_output_ids() {
 					} else { exchange_nodes[i]=-1; }
 				}
 				// Send back the list
-				MPI_Send(&exchange_nodes[0],size,MPI_INT,p,p,MPI_COMM_WORLD);
+				MPI_Send(&exchange_nodes[0],size,MPI_INT,p,p,comm);
 				exchange_nodes.clear();
 			}
 		}
@@ -859,7 +912,7 @@ int Grid::get_volume_output_ids() {
 	vector<set<int> > bcnodeset;
 	set<int>::iterator it;
 	bcnodeset.resize(bcCount);
-	for (int f=0;f<faceCount;++f) {
+	for (int f=interiorFaceCount;f<faceCount;++f) {
 		if (face[f].bc>=0) {
 			boundaryFaces[face[f].bc].push_back(f);
 			for (int fn=0;fn<face[f].nodes.size();++fn) {
@@ -887,7 +940,7 @@ int Grid::get_bc_output_ids() {
 	set<int>::iterator sit;
 	int n;
 	
-	for (int f=0;f<faceCount;++f) {
+	for (int f=interiorFaceCount;f<faceCount;++f) {
 		if (face[f].bc>=0) {
 			for (int fn=0;fn<face[f].nodes.size();++fn) {
 				bc_nodes.insert(face[f].nodes[fn]);
@@ -920,7 +973,7 @@ int Grid::get_bc_output_ids() {
 	output_node_counts[Rank]=count;
 	MPI_Allgather(MPI_IN_PLACE,0,MPI_INT, 
 				  &output_node_counts[0],1,MPI_INT, 
-				  MPI_COMM_WORLD);
+				  comm);
 	
 	node_bc_output_offset=0;
 	for (int p=0;p<Rank;++p) node_bc_output_offset+=output_node_counts[p];
@@ -938,10 +991,10 @@ int Grid::get_bc_output_ids() {
 				for (sit=bc_nodes.begin();sit!=bc_nodes.end();sit++) if (node[*sit].bc_output_id==-1) exchange_nodes.push_back(node[*sit].globalId);
 				// Send the size of the list
 				size=exchange_nodes.size();
-				MPI_Send(&size,1,MPI_INT,pr,p,MPI_COMM_WORLD);
+				MPI_Send(&size,1,MPI_INT,pr,p,comm);
 				// Send the list
-				MPI_Send(&exchange_nodes[0],size,MPI_INT,pr,p,MPI_COMM_WORLD);
-				MPI_Recv(&exchange_nodes[0],size,MPI_INT,pr,p,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+				MPI_Send(&exchange_nodes[0],size,MPI_INT,pr,p,comm);
+				MPI_Recv(&exchange_nodes[0],size,MPI_INT,pr,p,comm,MPI_STATUS_IGNORE);
 				// Fill in the node output id's
 				int count=0;
 				for (sit=bc_nodes.begin();sit!=bc_nodes.end();sit++) {
@@ -954,11 +1007,11 @@ int Grid::get_bc_output_ids() {
 			}
 			if (Rank==pr) {
 				// Receive the list size
-				MPI_Recv(&size,1,MPI_INT,p,p,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+				MPI_Recv(&size,1,MPI_INT,p,p,comm,MPI_STATUS_IGNORE);
 				vector<int> exchange_nodes;
 				exchange_nodes.resize(size);
 				// Receive the list
-				MPI_Recv(&exchange_nodes[0],size,MPI_INT,p,p,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+				MPI_Recv(&exchange_nodes[0],size,MPI_INT,p,p,comm,MPI_STATUS_IGNORE);
 				// Fill in the bc_output_id's of exchange nodes
 				for (int i=0;i<size;++i) {
 					if (maps.nodeGlobal2Local.find(exchange_nodes[i])!=maps.nodeGlobal2Local.end()) {
@@ -966,7 +1019,7 @@ int Grid::get_bc_output_ids() {
 					} else { exchange_nodes[i]=-1; }
 				}
 				// Send back the list
-				MPI_Send(&exchange_nodes[0],size,MPI_INT,p,p,MPI_COMM_WORLD);
+				MPI_Send(&exchange_nodes[0],size,MPI_INT,p,p,comm);
 				exchange_nodes.clear();
 			}
 		}
@@ -984,3 +1037,44 @@ bool Cell::HaveNodes(int nodelistsize, int nodelist []) {
 	}
 	return true;
 }
+
+int Grid::color_faces (void) {
+
+	// Greedy coloring of the faces such that faces of the same color don't share
+	// any local cell. Face loops can then be run concurrently within each color
+	// without write conflicts on the cell data.
+	// Interior and boundary faces are colored separately so that each color can be
+	// handled by a kernel specialized for either one.
+	vector<int> faceColor (faceCount,-1);
+	vector<bool> used;
+	int nColors=0;
+	int firstColor=0;
+	int c,color;
+	
+	for (int f=0;f<faceCount;++f) {
+		if (f==interiorFaceCount) {
+			interiorColorCount=nColors;
+			firstColor=nColors;
+		}
+		used.assign(nColors+1,false);
+		for (int side=0;side<2;++side) {
+			c=(side==0) ? face[f].parent : face[f].neighbor;
+			if (c>=cellCount) continue; // ghost cells are never written to
+			for (int cf=0;cf<cell[c].faces.size();++cf) {
+				color=faceColor[cell[c].faces[cf]];
+				if (color>=0) used[color]=true;
+			}
+		}
+		color=firstColor;
+		while (used[color]) color++;
+		faceColor[f]=color;
+		nColors=max(nColors,color+1);
+	}
+	if (interiorFaceCount==faceCount) interiorColorCount=nColors;
+	
+	faceColors.clear();
+	faceColors.resize(nColors);
+	for (int f=0;f<faceCount;++f) faceColors[faceColor[f]].push_back(f);
+	
+	return 0;
+} // end Grid::color_faces
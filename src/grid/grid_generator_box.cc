@@ -0,0 +1,390 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <climits>
+#include "grid.h"
+
+// Built-in generator for box shaped test meshes
+// Node spacing along each direction follows a geometric progression set by the stretching ratio
+// (ratio of consecutive spacings). Each hex of the structured layout can be kept as is or split into
+// 2 prisms or 6 tetrahedra. The splits share the same diagonals everywhere so that the resulting
+// mesh is conforming, including the interfaces between the element types of a "mixed" mesh.
+// The hex slots are split into blocks, one for each rank of the grid, instead of going through
+// partition(). Each rank generates only the cells of its block followed by the cells of the other
+// blocks around it (needed to find the partition ghosts), so no rank ever holds the whole grid.
+// Cell and node ids don't depend on the number of ranks. The generation is deterministic
+// (including the node perturbations) so no communication is needed.
+
+enum {HEX,PRISM,TET,TRANSITION,MIXED};
+
+// Reproducible pseudo random number in [-1,1] for a given integer key
+static double box_random(unsigned int key,unsigned int seed) {
+	unsigned int h=key+seed*0x9e3779b9u;
+	h^=h>>16; h*=0x85ebca6bu;
+	h^=h>>13; h*=0xc2b2ae35u;
+	h^=h>>16;
+	return 2.*double(h)/4294967295.-1.;
+}
+
+// Node coordinates along one direction
+static void box_coordinates(int n,double begin,double end,double ratio,vector<double> &x) {
+	x.resize(n+1);
+	for (int i=0;i<=n;++i) {
+		if (fabs(ratio-1.)<1.e-12) x[i]=begin+(end-begin)*double(i)/double(n);
+		else x[i]=begin+(end-begin)*(pow(ratio,i)-1.)/(pow(ratio,n)-1.);
+	}
+	return;
+}
+
+// Element layout of the hex slots and the global cell numbering
+// The cells are numbered slot by slot with i running fastest, then j and k, as if the whole grid
+// was generated at once. The element type of a slot only depends on i and k, so the numbering
+// follows from the cell counts of each row of a layer.
+class Box_Layout {
+public:
+	int n[3];
+	int elements;
+	int tetNodes[6][4];
+	vector<int> rowStart; // Cells before slot i in a row of layer k, at k*(n[0]+1)+i
+	vector<int> layerStart; // Cells before layer k
+	bool set(BoxMesh &box);
+	int slot_type(int i,int k);
+	int slot_cells(int type);
+	int cell_id(int i,int j,int k) { return layerStart[k]+j*rowStart[k*(n[0]+1)+n[0]]+rowStart[k*(n[0]+1)+i]; }
+	void append_cells(int i,int j,int k,GridRawData &raw);
+};
+
+// Returns false if the cells don't fit the int ids
+bool Box_Layout::set(BoxMesh &box) {
+	
+	for (int d=0;d<3;++d) n[d]=box.cells[d];
+	if (box.elements=="prism") elements=PRISM;
+	else if (box.elements=="tet") elements=TET;
+	else if (box.elements=="mixed") elements=MIXED;
+	else elements=HEX;
+	
+	// Kuhn subdivision of a hex into 6 tets, all sharing the 0-6 diagonal
+	// Each permutation of the axes gives one tet. Odd permutations have their 2nd and 3rd nodes swapped
+	// to keep the positive orientation.
+	int axisPerm[6][3]={{0,1,2},{0,2,1},{1,0,2},{1,2,0},{2,0,1},{2,1,0}};
+	for (int t=0;t<6;++t) {
+		// Walk from corner 0 to corner 6 along the axes in the permutation order
+		int bits=0;
+		tetNodes[t][0]=0;
+		for (int s=0;s<2;++s) {
+			bits|=(1<<axisPerm[t][s]);
+			int a=bits&1,b=(bits>>1)&1,c=(bits>>2)&1;
+			// Hex local node numbering: bottom 0-3 counter clockwise, top 4-7 above them
+			int local=(b==0) ? a : 3-a;
+			tetNodes[t][s+1]=local+4*c;
+		}
+		tetNodes[t][3]=6;
+		if (t==1 || t==2 || t==5) swap(tetNodes[t][1],tetNodes[t][2]);
+	}
+	
+	// Cell counts, kept in doubles until the total is known to fit the int ids
+	double total=0.;
+	rowStart.resize(n[2]*(n[0]+1));
+	layerStart.resize(n[2]+1);
+	for (int k=0;k<n[2];++k) {
+		double row=0.;
+		for (int i=0;i<n[0];++i) row+=slot_cells(slot_type(i,k));
+		total+=row*double(n[1]);
+	}
+	if (total>double(INT_MAX)) return false;
+	layerStart[0]=0;
+	for (int k=0;k<n[2];++k) {
+		rowStart[k*(n[0]+1)]=0;
+		for (int i=0;i<n[0];++i) rowStart[k*(n[0]+1)+i+1]=rowStart[k*(n[0]+1)+i]+slot_cells(slot_type(i,k));
+		layerStart[k+1]=layerStart[k]+n[1]*rowStart[k*(n[0]+1)+n[0]];
+	}
+	
+	return true;
+}
+
+// Element type of each hex slot
+// A mixed mesh has hexes in the first third along x. The rest is prisms in the lower half along z
+// and tets in the upper half. Hexes only conform to prisms through their sides and tets only conform
+// to prisms through their triangles, so the tets next to the hexes are merged two by two into
+// pyramids. With a single layer along z, it is split into hex/prism halves along x instead.
+int Box_Layout::slot_type(int i,int k) {
+	if (elements!=MIXED) return elements;
+	if (n[2]>1 && n[0]>1) {
+		if (3*i<n[0]) return HEX;
+		if (2*k<n[2]) return PRISM;
+		return (3*(i-1)<n[0]) ? TRANSITION : TET;
+	}
+	return (2*i<n[0]) ? HEX : PRISM;
+}
+
+int Box_Layout::slot_cells(int type) {
+	switch (type) {
+		case PRISM: return 2;
+		case TET: return 6;
+		case TRANSITION: return 5;
+	}
+	return 1;
+}
+
+// Append the cells of a slot to the raw connectivity
+void Box_Layout::append_cells(int i,int j,int k,GridRawData &raw) {
+	
+	// The transition slot replaces the two tets touching the xmin face of the hex by a pyramid on that face
+	int transitionTets[4]={0,1,2,4};
+	int pyraNodes[5]={0,3,7,4,6};
+	int prismNodes[2][6]= {
+		{0,1,2,4,5,6},
+		{0,2,3,4,6,7}
+	};
+	
+	int hexNodes[8];
+	int base=i+(n[0]+1)*(j+(n[1]+1)*k);
+	hexNodes[0]=base;
+	hexNodes[1]=base+1;
+	hexNodes[2]=base+1+(n[0]+1);
+	hexNodes[3]=base+(n[0]+1);
+	for (int hn=0;hn<4;++hn) hexNodes[hn+4]=hexNodes[hn]+(n[0]+1)*(n[1]+1);
+	
+	switch (slot_type(i,k)) {
+		case HEX:
+			raw.cellConnIndex.push_back(raw.cellConnectivity.size());
+			for (int hn=0;hn<8;++hn) raw.cellConnectivity.push_back(hexNodes[hn]);
+			break;
+		case PRISM:
+			for (int p=0;p<2;++p) {
+				raw.cellConnIndex.push_back(raw.cellConnectivity.size());
+				for (int pn=0;pn<6;++pn) raw.cellConnectivity.push_back(hexNodes[prismNodes[p][pn]]);
+			}
+			break;
+		case TET:
+			for (int t=0;t<6;++t) {
+				raw.cellConnIndex.push_back(raw.cellConnectivity.size());
+				for (int tn=0;tn<4;++tn) raw.cellConnectivity.push_back(hexNodes[tetNodes[t][tn]]);
+			}
+			break;
+		case TRANSITION:
+			raw.cellConnIndex.push_back(raw.cellConnectivity.size());
+			for (int pn=0;pn<5;++pn) raw.cellConnectivity.push_back(hexNodes[pyraNodes[pn]]);
+			for (int t=0;t<4;++t) {
+				raw.cellConnIndex.push_back(raw.cellConnectivity.size());
+				for (int tn=0;tn<4;++tn) raw.cellConnectivity.push_back(hexNodes[tetNodes[transitionTets[t]][tn]]);
+			}
+			break;
+	}
+	
+	return;
+}
+
+// Check the box parameters and get the grid size
+// Called by read(), before the ranks of the grid are known. The cells are generated by generateBox.
+int Grid::box_size() {
+	
+	raw.type=CELL;
+	raw.slice=true;
+	
+	if (box.cells[0]<1 || box.cells[1]<1 || box.cells[2]<1) {
+		if (Rank==0) cerr << "[E] Box grid needs at least one cell in each direction" << endl;
+		exit(1);
+	}
+	if (box.perturbation<0. || box.perturbation>=1.) {
+		if (Rank==0) cerr << "[E] Box grid perturbation should be in [0,1)" << endl;
+		exit(1);
+	}
+	if (box.elements!="hex" && box.elements!="prism" && box.elements!="tet" && box.elements!="mixed") {
+		if (Rank==0) cerr << "[E] Unrecognized box grid element type: " << box.elements << endl;
+		exit(1);
+	}
+	if (box.patches.size()!=6) {
+		if (Rank==0) cerr << "[E] Box grid needs 6 patch names (xmin,xmax,ymin,ymax,zmin,zmax)" << endl;
+		exit(1);
+	}
+	if (double(box.cells[0]+1)*double(box.cells[1]+1)*double(box.cells[2]+1)>double(INT_MAX)) {
+		if (Rank==0) cerr << "[E] Box grid has too many nodes for the integer node ids" << endl;
+		exit(1);
+	}
+	
+	Box_Layout layout;
+	if (!layout.set(box)) {
+		if (Rank==0) cerr << "[E] Box grid has too many cells for the integer cell ids" << endl;
+		exit(1);
+	}
+	globalCellCount=layout.layerStart[box.cells[2]];
+	globalNodeCount=(box.cells[0]+1)*(box.cells[1]+1)*(box.cells[2]+1);
+	
+	// Boundary patches, patches sharing a name are merged into one bc region
+	raw.bocoNameMap.clear();
+	raw.bocoNodes.clear();
+	for (int p=0;p<6;++p) {
+		if (raw.bocoNameMap.find(box.patches[p])==raw.bocoNameMap.end()) {
+			raw.bocoNameMap.insert(pair<string,int>(box.patches[p],raw.bocoNameMap.size()));
+		}
+	}
+	raw.bocoNodes.resize(raw.bocoNameMap.size());
+	
+	if (Rank==0) {
+		cout << "[I] Box grid of " << box.cells[0] << "x" << box.cells[1] << "x" << box.cells[2] << " " << box.elements << " slots" << endl;
+		cout << "[I] Total Cell Count= " << globalCellCount << endl;
+		cout << "[I] Total Node Count= " << globalNodeCount << endl;
+		cout << "[I] Boundary condition summary:" << endl;
+		map<string,int>::iterator mit;
+		for (mit=raw.bocoNameMap.begin();mit!=raw.bocoNameMap.end();mit++) cout << "[I]\t" << (*mit).first << " -> BC_" << (*mit).second+1 << endl;
+	}
+	
+	return 0;
+}
+
+// Generate the block of this rank and the cells around it
+// Also sets up what partition() would: cellCount, partitionOffset and myOffset
+int Grid::generateBox() {
+	
+	Box_Layout layout;
+	layout.set(box);
+	int *n=layout.n;
+	
+	// Split the slots into parts[0]*parts[1]*parts[2]=np blocks, picking the split with the least
+	// interface area
+	int parts[3]={0,0,0};
+	double bestArea=-1.;
+	for (int px=1;px<=np;++px) {
+		if (np%px!=0 || px>n[0]) continue;
+		for (int py=1;py<=np/px;++py) {
+			int pz=np/(px*py);
+			if ((np/px)%py!=0 || py>n[1] || pz>n[2]) continue;
+			double area=double(px-1)*n[1]*n[2]+double(py-1)*n[0]*n[2]+double(pz-1)*n[0]*n[1];
+			if (bestArea<0. || area<bestArea) {
+				bestArea=area;
+				parts[0]=px; parts[1]=py; parts[2]=pz;
+			}
+		}
+	}
+	if (bestArea<0.) {
+		if (Rank==0) cerr << "[E] Box grid of " << n[0] << "x" << n[1] << "x" << n[2] << " slots can't be split into " << np << " blocks" << endl;
+		exit(1);
+	}
+	
+	// Cut positions along each direction, balancing the number of cells since the element type
+	// (and the cell count) of a slot changes along x and z in a mixed mesh
+	vector<double> weight[3];
+	for (int d=0;d<3;++d) weight[d].assign(n[d],0.);
+	for (int k=0;k<n[2];++k) for (int i=0;i<n[0];++i) {
+		double cells=layout.slot_cells(layout.slot_type(i,k));
+		weight[0][i]+=cells;
+		weight[2][k]+=cells;
+	}
+	weight[1].assign(n[1],1.);
+	vector<int> cut[3],part[3];
+	for (int d=0;d<3;++d) {
+		double total=0.;
+		for (int s=0;s<n[d];++s) total+=weight[d][s];
+		cut[d].assign(parts[d]+1,n[d]);
+		cut[d][0]=0;
+		double sum=0.;
+		int s=0;
+		for (int p=1;p<parts[d];++p) {
+			while (s<n[d] && sum+0.5*weight[d][s]<total*double(p)/double(parts[d])) sum+=weight[d][s++];
+			// Each block gets at least one slot
+			int c=min(max(s,cut[d][p-1]+1),n[d]-(parts[d]-p));
+			for (;s<c;++s) sum+=weight[d][s];
+			for (;s>c;--s) sum-=weight[d][s-1];
+			cut[d][p]=c;
+		}
+		part[d].resize(n[d]);
+		for (int p=0;p<parts[d];++p) for (int s=cut[d][p];s<cut[d][p+1];++s) part[d][s]=p;
+	}
+	
+	int block[3]={Rank%parts[0],(Rank/parts[0])%parts[1],Rank/(parts[0]*parts[1])};
+	int lo[3],hi[3],haloLo[3],haloHi[3];
+	for (int d=0;d<3;++d) {
+		lo[d]=cut[d][block[d]];
+		hi[d]=cut[d][block[d]+1];
+		haloLo[d]=max(lo[d]-1,0);
+		haloHi[d]=min(hi[d]+1,n[d]);
+	}
+	
+	// Cells of the block first, then the cells of the slots around it
+	vector<int>().swap(raw.cellConnIndex);
+	vector<int>().swap(raw.cellConnectivity);
+	vector<int>().swap(raw.cellGlobalId);
+	vector<int>().swap(raw.cellOwner);
+	for (int pass=0;pass<2;++pass) {
+		for (int k=haloLo[2];k<haloHi[2];++k) for (int j=haloLo[1];j<haloHi[1];++j) for (int i=haloLo[0];i<haloHi[0];++i) {
+			bool inside=(i>=lo[0] && i<hi[0] && j>=lo[1] && j<hi[1] && k>=lo[2] && k<hi[2]);
+			if (inside!=(pass==0)) continue;
+			int first=raw.cellConnIndex.size();
+			layout.append_cells(i,j,k,raw);
+			int owner=part[0][i]+parts[0]*(part[1][j]+parts[1]*part[2][k]);
+			int id=layout.cell_id(i,j,k);
+			for (int c=first;c<raw.cellConnIndex.size();++c) {
+				raw.cellGlobalId.push_back(id++);
+				raw.cellOwner.push_back(owner);
+			}
+		}
+		if (pass==0) cellCount=raw.cellConnIndex.size();
+	}
+	
+	// Nodes of the block
+	vector<double> x[3];
+	for (int d=0;d<3;++d) box_coordinates(n[d],box.corner_1[d],box.corner_2[d],box.stretching[d],x[d]);
+	vector<Vec3D>().swap(raw.node);
+	raw.node.reserve((hi[0]-lo[0]+1)*(hi[1]-lo[1]+1)*(hi[2]-lo[2]+1));
+	raw.nodeIndex.clear();
+	int patchBC[6];
+	for (int p=0;p<6;++p) patchBC[p]=raw.bocoNameMap[box.patches[p]];
+	int index[3];
+	for (int k=lo[2];k<=hi[2];++k) for (int j=lo[1];j<=hi[1];++j) for (int i=lo[0];i<=hi[0];++i) {
+		int id=i+(n[0]+1)*(j+(n[1]+1)*k);
+		index[0]=i; index[1]=j; index[2]=k;
+		Vec3D coord;
+		for (int d=0;d<3;++d) {
+			coord[d]=x[d][index[d]];
+			// Only move the nodes in the directions they are interior to, so that boundaries stay planar
+			if (box.perturbation>0. && index[d]>0 && index[d]<n[d]) {
+				double h=min(x[d][index[d]]-x[d][index[d]-1],x[d][index[d]+1]-x[d][index[d]]);
+				coord[d]+=0.5*box.perturbation*h*box_random(3*id+d,box.seed);
+			}
+		}
+		raw.nodeIndex[id]=raw.node.size();
+		raw.node.push_back(coord);
+		if (i==0) raw.bocoNodes[patchBC[0]].insert(id);
+		if (i==n[0]) raw.bocoNodes[patchBC[1]].insert(id);
+		if (j==0) raw.bocoNodes[patchBC[2]].insert(id);
+		if (j==n[1]) raw.bocoNodes[patchBC[3]].insert(id);
+		if (k==0) raw.bocoNodes[patchBC[4]].insert(id);
+		if (k==n[2]) raw.bocoNodes[patchBC[5]].insert(id);
+	}
+	
+	// Partition offsets as partition() would set them
+	vector<int> counts (np,0);
+	MPI_Allgather(&cellCount,1,MPI_INT,&counts[0],1,MPI_INT,comm);
+	partitionOffset.assign(np,0);
+	for (int p=1;p<np;++p) partitionOffset[p]=partitionOffset[p-1]+counts[p-1];
+	myOffset=partitionOffset[Rank];
+	
+	if (Rank==0) {
+		int minCount=*min_element(counts.begin(),counts.end());
+		int maxCount=*max_element(counts.begin(),counts.end());
+		cout << "[I grid=" << gid+1 << " ] Generated the box grid in " << parts[0] << "x" << parts[1] << "x" << parts[2] << " blocks, ";
+		cout << minCount << " to " << maxCount << " cells per rank" << endl;
+	}
+	
+	return 0;
+}
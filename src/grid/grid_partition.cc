@@ -50,7 +50,7 @@ int Grid::partition() {
 	options- [0 1 15] for default
 	edgecut- output, # of edges cut (measure of communication)
 	part- output, where our elements should be
-	comm- most likely MPI_COMM_WORLD
+	comm- the communicator of the grid (MPI_COMM_WORLD unless the grids run concurrently)
 	*/
 
 	idxtype elmdist[np+1];
@@ -93,11 +93,11 @@ int Grid::partition() {
 		eind[i]=raw.cellConnectivity[raw.cellConnIndex[offset]+i];
 	}
 
-	MPI_Comm commWorld=MPI_COMM_WORLD;
+	MPI_Comm gridComm=comm;
 	ParMETIS_V3_PartMeshKway(elmdist,eptr,eind, elmwgt,
 	                         &wgtflag, &numflag, &ncon, &ncommonnodes,
 	                         &np, tpwgts, &ubvec, options, &edgecut,
-	                         part,&commWorld) ;
+	                         part,&gridComm) ;
 	delete[] eptr;
 	delete[] eind;
 
@@ -113,7 +113,7 @@ int Grid::partition() {
 	
 	maps.cellOwner.resize(globalCellCount);
 	//cellMap of a cell returns which processor it is assigned to
-	MPI_Allgatherv(part,cellCount,MPI_INT,&maps.cellOwner[0],recvCounts,displs,MPI_INT,MPI_COMM_WORLD);
+	MPI_Allgatherv(part,cellCount,MPI_INT,&maps.cellOwner[0],recvCounts,displs,MPI_INT,comm);
 
 	// Find new local cellCount after ParMetis distribution
 	cellCount=0.;
@@ -155,7 +155,7 @@ int Grid::mesh2dual() {
 	int eindSize=0;
 	int ncommonnodes=1;
 	int numflag=0; // C-style numbering
-	MPI_Comm commWorld=MPI_COMM_WORLD;
+	MPI_Comm gridComm=comm;
 
 	for (int c=0;c<cellCount;++c) {
 		eindSize+=cell[c].nodes.size();
@@ -175,7 +175,7 @@ int Grid::mesh2dual() {
 		}
 	}
 
-	ParMETIS_V3_Mesh2Dual(elmdist, eptr, eind, &numflag, &ncommonnodes, &maps.adjIndex, &maps.adjacency, &commWorld);
+	ParMETIS_V3_Mesh2Dual(elmdist, eptr, eind, &numflag, &ncommonnodes, &maps.adjIndex, &maps.adjacency, &gridComm);
 
 	delete[] eptr;
 	delete[] eind;
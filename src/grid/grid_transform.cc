@@ -25,7 +25,7 @@
 int Grid::translate(Vec3D begin, Vec3D end) {
 	Vec3D diff;
 	diff=end-begin;
-	for (int n=0;n<globalNodeCount;++n) {
+	for (int n=0;n<raw.node.size();++n) {
 		raw.node[n]+=diff;
 	}
 	if (Rank==0) cout << "[I grid=" << gid+1 << "] Translated from " << begin << " to " << end << endl;
@@ -33,7 +33,7 @@ int Grid::translate(Vec3D begin, Vec3D end) {
 }
 
 int Grid::scale(Vec3D anchor, Vec3D factor) {
-	for (int n=0;n<globalNodeCount;++n) {
+	for (int n=0;n<raw.node.size();++n) {
 		for (int i=0;i<3;++i) raw.node[n][i]=anchor[i]+factor[i]*(raw.node[n][i]-anchor[i]);
 	}
 	if (Rank==0) cout << "[I grid=" << gid+1 << "] scaled by " << factor << " with anchor = " << anchor << endl;
@@ -46,7 +46,7 @@ int Grid::rotate(Vec3D anchor, Vec3D axis, double angle) {
 	// Normalize axis;
 	axis=axis.norm();
 	Vec3D p;
-	for (int n=0;n<globalNodeCount;++n) {
+	for (int n=0;n<raw.node.size();++n) {
 		p=raw.node[n];
 		p-=anchor;
 		raw.node[n][0]=axis[0]*(axis.dot(p))+(p[0]*(1.-axis[0]*axis[0])-axis[0]*(axis[1]*p[1]+axis[2]*p[2]))*cos(angle)+(-axis[2]*p[1]+axis[1]*p[2])*sin(angle);
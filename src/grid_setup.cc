@@ -0,0 +1,254 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "inputs.h"
+using namespace std;
+#include "grid.h"
+#include "bc.h"
+#include "commons.h"
+#include "timers.h"
+#include "memory_usage.h"
+
+// Grid read and preprocessing steps, shared by fcfd and fcfd_bench
+
+extern InputFile input;
+extern vector<Grid> grid;
+extern vector<vector<BCregion> > bc;
+extern vector<int> equations;
+extern vector<bool> turbulent;
+
+void set_bcs(int gid);
+void face_interpolation_weights(int gid);
+void node_interpolation_weights(int gid);
+void gradient_maps(int gid);
+void set_lengthScales(int gid);
+void wall_distance(int gid);
+unsigned long long metrics_cache_key(int gid);
+bool read_metrics_cache(int gid,unsigned long long key);
+void write_metrics_cache(int gid,unsigned long long key);
+string int2str(int number);
+
+// Read (or generate) the raw grid data
+void read_grid(int gid) {
+	grid[gid].dimension=input.section("grid",gid).get_int("dimension");
+	grid[gid].gid=gid;
+	if (input.section("grid",gid).get_string("format")=="box") {
+		Vec3D cells=input.section("grid",gid).subsection("box").get_Vec3D("cells");
+		for (int i=0;i<3;++i) grid[gid].box.cells[i]=int(cells[i]+0.5);
+		grid[gid].box.corner_1=input.section("grid",gid).subsection("box").get_Vec3D("corner_1");
+		grid[gid].box.corner_2=input.section("grid",gid).subsection("box").get_Vec3D("corner_2");
+		grid[gid].box.stretching=input.section("grid",gid).subsection("box").get_Vec3D("stretching");
+		grid[gid].box.elements=input.section("grid",gid).subsection("box").get_string("elements");
+		grid[gid].box.perturbation=input.section("grid",gid).subsection("box").get_double("perturbation");
+		grid[gid].box.seed=input.section("grid",gid).subsection("box").get_int("seed");
+		if (input.section("grid",gid).subsection("box").stringLists["patches"].is_found) {
+			grid[gid].box.patches=input.section("grid",gid).subsection("box").get_stringList("patches");
+		} else {
+			string names[6]={"xmin","xmax","ymin","ymax","zmin","zmax"};
+			grid[gid].box.patches.assign(names,names+6);
+		}
+	}
+	// Read the grid raw data from file (or generate it)
+	grid[gid].read(input.section("grid",gid).get_string("file"),input.section("grid",gid).get_string("format"));
+	
+	return;
+}
+
+// Assign the ranks to the grids after the raw grids are read
+// By default every grid is partitioned over all the ranks and the grids are solved one after
+// the other. With "multiple grids -> execution=concurrent", each grid gets a contiguous block
+// of ranks and its own communicator, and the grids are solved at the same time, coupled only
+// through the interface exchanges. The block size is the grid's "ranks" input if given,
+// otherwise the remaining ranks are shared in proportion to the cost of the grids, estimated
+// as the cell count times the number of variables solved.
+// Returns true if the grids run concurrently.
+bool split_grids(void) {
+	
+	int gridCount=grid.size();
+	if (input.section("multiplegrids").get_string("execution")!="concurrent" || gridCount==1) return false;
+	if (np<gridCount) {
+		if (Rank==0) cout << "[W] Running the grids concurrently needs at least one rank per grid, they will be solved one after the other" << endl;
+		return false;
+	}
+	
+	vector<int> ranks (gridCount,0);
+	vector<double> cost (gridCount,0.);
+	int fixed=0,automatic=0;
+	double totalCost=0.;
+	for (int gid=0;gid<gridCount;++gid) {
+		ranks[gid]=input.section("grid",gid).get_int("ranks");
+		if (ranks[gid]>0) {
+			fixed+=ranks[gid];
+		} else {
+			double variables=1.;
+			if (equations[gid]==NS) variables=(turbulent[gid]) ? 7. : 5.;
+			cost[gid]=double(grid[gid].globalCellCount)*variables;
+			totalCost+=cost[gid];
+			automatic++;
+		}
+	}
+	int spare=np-fixed-automatic; // ranks left after one for each automatic grid
+	if (spare<0 || (automatic==0 && spare>0)) {
+		if (Rank==0) cerr << "[E] The ranks given to the grids (" << fixed << ") don't fit the " << np << " ranks of the run" << endl;
+		exit(1);
+	}
+	// Largest remainder shares of the spare ranks
+	vector<pair<double,int> > remainder;
+	int given=0;
+	for (int gid=0;gid<gridCount;++gid) {
+		if (ranks[gid]>0) continue;
+		double share=(totalCost>0.) ? spare*cost[gid]/totalCost : double(spare)/double(automatic);
+		ranks[gid]=1+int(share);
+		given+=int(share);
+		remainder.push_back(make_pair(share-int(share),gid));
+	}
+	sort(remainder.rbegin(),remainder.rend());
+	for (int i=0;i<spare-given;++i) ranks[remainder[i].second]++;
+	
+	int color=0,offset=0;
+	vector<int> offsets (gridCount,0);
+	for (int gid=0;gid<gridCount;++gid) {
+		offsets[gid]=offset;
+		if (Rank>=offset && Rank<offset+ranks[gid]) color=gid;
+		offset+=ranks[gid];
+	}
+	MPI_Comm comm;
+	MPI_Comm_split(MPI_COMM_WORLD,color,Rank,&comm);
+	for (int gid=0;gid<gridCount;++gid) {
+		grid[gid].set_communicator((gid==color) ? comm : MPI_COMM_NULL,offsets[gid]);
+		if (Rank==0) cout << "[I grid=" << gid+1 << " ] Solved on ranks " << offsets[gid] << "-" << offsets[gid]+ranks[gid]-1 << endl;
+	}
+	
+	return true;
+}
+
+// Transform the raw grid, establish the connectivity and compute the metrics, bc's and stencils
+void setup_grid(int gid) {
+	// Box grids are generated now that the ranks of the grid are known, each rank only its own part
+	if (grid[gid].raw.slice) {
+		timers.start("grid generation"); grid[gid].generateBox(); timers.stop();
+	}
+	
+	// Do the transformations
+	int tcount=input.section("grid",gid).subsection("transform",0).count;
+	
+	for (int t=0;t<tcount;++t) {
+		if (input.section("grid",gid).subsection("transform",t).get_string("function")=="translate") {
+			Vec3D begin=input.section("grid",gid).subsection("transform",t).get_Vec3D("anchor");
+			Vec3D end=input.section("grid",gid).subsection("transform",t).get_Vec3D("end");
+			grid[gid].translate(begin,end);
+		} else if (input.section("grid",gid).subsection("transform",t).get_string("function")=="scale") {
+			Vec3D anchor=input.section("grid",gid).subsection("transform",t).get_Vec3D("anchor");
+			Vec3D factor=input.section("grid",gid).subsection("transform",t).get_Vec3D("factor");
+			grid[gid].scale(anchor,factor);
+		} else if (input.section("grid",gid).subsection("transform",t).get_string("function")=="rotate") {
+			Vec3D anchor=input.section("grid",gid).subsection("transform",t).get_Vec3D("anchor");
+			Vec3D axis=input.section("grid",gid).subsection("transform",t).get_Vec3D("axis");
+			double angle=input.section("grid",gid).subsection("transform",t).get_double("angle");
+			grid[gid].rotate(anchor,axis,angle);
+		} 
+	}
+
+	// Establish connectivity, area, volume etc... all the needed information
+	timers.start("grid setup"); grid[gid].setup(); timers.stop();
+	timers.start("boundary conditions"); set_bcs(gid); timers.stop();
+	
+	// The rest only depends on the geometry, bc types and inputs and may come from the cache
+	bool cache=(input.section("grid",gid).get_string("metricscache")=="on");
+	bool cached=false;
+	unsigned long long key=0;
+	if (cache) {
+		timers.start("metrics cache");
+		key=metrics_cache_key(gid);
+		cached=read_metrics_cache(gid,key);
+		timers.stop();
+	}
+	
+	if (cached) {
+		if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Read the wall distances, length scales and stencils from the metrics cache" << endl;
+	} else {
+		set_lengthScales(gid);
+		if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Calculating face averaging metrics" << endl;
+
+		timers.start("interpolation weights");
+		face_interpolation_weights(gid);
+		node_interpolation_weights(gid);
+		timers.stop();
+		timers.start("gradient maps"); gradient_maps(gid); timers.stop();
+		
+		// The poisson method uses the interpolation weights and gradient maps
+		if (grid[gid].Rank==0) cout << "[I] Finding closest wall distances" << endl;
+		wall_distance(gid);
+		
+		if (cache) {
+			timers.start("metrics cache"); write_metrics_cache(gid,key); timers.stop();
+			if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Wrote the metrics cache" << endl;
+		}
+	}
+	
+	string stage="grid "+int2str(gid+1)+"/";
+	memory_usage.stage(stage+"interpolation weights and gradient maps");
+	if (memory_usage.enabled) grid[gid].account_memory();
+	
+	return;
+}
+
+void set_lengthScales(int gid) {
+	// Loop through the cells and calculate length scales for each cell
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		grid[gid].cell[c].lengthScale=1.e20;
+		double height;
+		int f;
+		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
+			f=grid[gid].cell[c].faces[cf];
+			height=fabs(grid[gid].face[f].normal.dot(grid[gid].face[f].centroid-grid[gid].cell[c].centroid));
+			bool skipScale=false;
+			if (grid[gid].face[f].bc>=0) {
+				if (bc[gid][grid[gid].face[f].bc].type==SYMMETRY) {
+					skipScale=true;
+				}
+			}
+			if (!skipScale) grid[gid].cell[c].lengthScale=min(grid[gid].cell[c].lengthScale,height);
+		}
+	}
+	
+	// Find out the global, grid cell length scale
+	if (grid[gid].dimension==3) {
+		grid[gid].lengthScale=pow(grid[gid].globalTotalVolume,1./3.);
+		if (grid[gid].Rank==0) cout << "[I] Grid length scale is set to " << grid[gid].lengthScale << endl;
+	} else {
+		
+		// If the problem is 2D, finding the grid length scale is a bit more challenging
+		// Find the symmetry BC region with the largest area, and take the square root
+	        grid[gid].lengthScale=0.;	
+		for (int b=0;b<bc[gid].size();++b) {
+			if (bc[gid][b].type==SYMMETRY) grid[gid].lengthScale=max(grid[gid].lengthScale,sqrt(0.5*bc[gid][b].total_area));
+		}
+		if (grid[gid].Rank==0) cout << "[I] Grid length scale is set to " << grid[gid].lengthScale << endl;
+	}
+	
+	return;
+} 
@@ -21,6 +21,8 @@
  
  *************************************************************************/
 #include "hc.h"
+#include "timers.h"
+#include "comm_profile.h"
 
 HeatConduction::HeatConduction (void) {
 	// Empty constructor
@@ -35,6 +37,7 @@ void HeatConduction::initialize (void) {
 	abstol=input.section("grid",gid).subsection("heatconduction").get_double("absolutetolerance");
 	// Max linear solver iterations
 	maxits=input.section("grid",gid).subsection("heatconduction").get_int("maximumiterations");
+	operator_refresh=input.section("grid",gid).subsection("heatconduction").get_int("operatorrefresh");
 
 	mpi_init();
 	material.set(gid);
@@ -45,6 +48,16 @@ void HeatConduction::initialize (void) {
 	calc_cell_grads();
 	mpi_update_ghost_gradients();
 	petsc_init();
+	
+	// The diffusive fluxes (lambda/(rho*Cp)*grad(T)) are linear in T if the conductivity is constant
+	// Cp() is constant for the ideal gas and only follows Cp_model otherwise
+	bool constant_Cp=(material.eos_model==IDEAL_GAS || material.Cp_model==CONSTANT);
+	constant_operator=(material.lambda_model==CONSTANT && constant_Cp);
+	operator_age=0;
+	if (Rank==0) {
+		if (constant_operator && operator_refresh==0) cout << "[I grid=" << gid+1 << " ] Heat conduction operator is reused until the time step changes" << endl;
+		else if (operator_refresh>0) cout << "[I grid=" << gid+1 << " ] Heat conduction operator is rebuilt every " << operator_refresh << " steps" << endl;
+	}
 
 	return;
 }
@@ -52,17 +65,50 @@ void HeatConduction::initialize (void) {
 void HeatConduction::solve (int ts) {
 	
 	timeStep=ts;
-	initialize_linear_system();
+	timers.start("assembly");
+	rebuild_operator=operator_needs_rebuild();
+	if (rebuild_operator) initialize_linear_system();
 	assemble_linear_system();
-	petsc_solve();
-	update_variables();
-	mpi_update_ghost_primitives();
-	calc_cell_grads();
-	mpi_update_ghost_gradients();
+	timers.stop();
+	timers.start("linear solve"); petsc_solve(); timers.stop();
+	timers.start("update"); update_variables(); timers.stop();
+	timers.start("ghost exchange"); mpi_update_ghost_primitives(); timers.stop();
+	timers.start("gradients"); calc_cell_grads(); timers.stop();
+	timers.start("gradient exchange"); mpi_update_ghost_gradients(); timers.stop();
 	
 	return;
 }
 
+bool HeatConduction::operator_needs_rebuild (void) {
+	
+	int rebuild=0;
+	if (operator_dt.empty()) {
+		rebuild=1;
+	} else if (operator_refresh>0 && operator_age>=operator_refresh) {
+		rebuild=1;
+	} else if (!constant_operator && operator_refresh==0) {
+		rebuild=1;
+	} else {
+		for (int c=0;c<grid[gid].cellCount;++c) {
+			if (dt[gid].cell(c)!=operator_dt[c]) {
+				rebuild=1;
+				break;
+			}
+		}
+	}
+	// The assembly is collective, all partitions have to agree
+	comm_profile.allreduce("hc operator check",MPI_IN_PLACE,&rebuild,1,MPI_INT,MPI_MAX,grid[gid].comm);
+	
+	if (rebuild) {
+		operator_dt.resize(grid[gid].cellCount);
+		for (int c=0;c<grid[gid].cellCount;++c) operator_dt[c]=dt[gid].cell(c);
+		operator_age=0;
+	}
+	operator_age++;
+	
+	return rebuild;
+}
+
 void HeatConduction::create_vars (void) {
 	// Allocate variables
 	// Default option is to store on cell centers and ghosts only
@@ -142,7 +188,7 @@ void HeatConduction::update_variables(void) {
 		
 	} // cell loop
 	
-	MPI_Allreduce(&residual,&totalResidual,1, MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+	comm_profile.allreduce("hc residuals",&residual,&totalResidual,1,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
 	if (timeStep==1 || first_residual<0.) first_residual=sqrt(totalResidual);
 
 	res=sqrt(totalResidual)/first_residual;
@@ -63,6 +63,13 @@ public:
 	double rtol,abstol;
 	int maxits;
 	double sqrt_machine_error;
+	int operator_refresh; // Rebuild period of the implicit operator (0: automatic)
+	
+	// Implicit operator reuse
+	bool constant_operator; // Operator only depends on the time step (constant properties)
+	bool rebuild_operator; // Operator is assembled at this step
+	int operator_age; // Steps since the operator was assembled
+	vector<double> operator_dt; // Time steps the operator was assembled with
 	
 	// Total residuals
 	double first_residual;
@@ -91,11 +98,13 @@ public:
 	void set_bcs(void);
 	
 	void petsc_init(void);
+	void account_memory(void);
 	void petsc_solve(void);
 	void petsc_destroy(void);
 	
 	void solve(int timeStep);
 	
+	bool operator_needs_rebuild(void);
 	void initialize_linear_system();
 	void assemble_linear_system(void);
 
@@ -94,6 +94,9 @@ void HeatConduction::assemble_linear_system(void) {
 			VecSetValues(rhs,1,&row,&value,ADD_VALUES);
 		}
 
+		// The reused operator only needs the rhs
+		if (!rebuild_operator) continue;
+		
 		//if (implicit) { // TODO: Get this working
 
 		sourceJacLeft=0.;
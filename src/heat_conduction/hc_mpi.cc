@@ -21,12 +21,13 @@
  
  *************************************************************************/
 #include "hc.h"
+#include "comm_profile.h"
 
 void HeatConduction::mpi_init(void) {
 	
 	// Current processor number and the total number of processors
-	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
-	MPI_Comm_size(MPI_COMM_WORLD, &np);
+	MPI_Comm_rank(grid[gid].comm, &Rank);
+	MPI_Comm_size(grid[gid].comm, &np);
 	
 	long unsigned int max_send_size=0;
 	long unsigned int max_recv_size=0;
@@ -78,19 +79,20 @@ void HeatConduction::mpi_update_ghost_primitives(void) {
 					sendBuffer[offset+g]=T.cell(id);
 				}
 				
-				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size(),MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&send_request[send_req_count]);
+				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size(),MPI_DOUBLE,proc,0,grid[gid].comm,&send_request[send_req_count]);
+				comm_profile.send(grid[gid].worldOffset+proc,grid[gid].sendCells[proc].size()*sizeof(double));
 				send_req_count++;
 			}
 			
 			if (grid[gid].recvCells[proc].size()!=0) {
 				offset=mpi_recv_offset[proc];
-				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size(),MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&recv_request[recv_req_count]);
+				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size(),MPI_DOUBLE,proc,0,grid[gid].comm,&recv_request[recv_req_count]);
 				recv_req_count++;
 			}
 		}
 	}
 	
-    MPI_Waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
+    comm_profile.waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
 	
 	for (int proc=0;proc<np;++proc) { 
 		if (Rank!=proc) {
@@ -125,19 +127,20 @@ void HeatConduction::mpi_update_ghost_gradients(void) {
 					}
 				}
 				
-				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*3,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&send_request[send_req_count]);
+				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*3,MPI_DOUBLE,proc,0,grid[gid].comm,&send_request[send_req_count]);
+				comm_profile.send(grid[gid].worldOffset+proc,grid[gid].sendCells[proc].size()*3*sizeof(double));
 				send_req_count++;
 			}
 			
 			if (grid[gid].recvCells[proc].size()!=0) {
 				offset=mpi_recv_offset[proc];
-				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*3,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&recv_request[recv_req_count]);
+				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*3,MPI_DOUBLE,proc,0,grid[gid].comm,&recv_request[recv_req_count]);
 				recv_req_count++;
 			}
 		}
 	}
 	
-	MPI_Waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
+	comm_profile.waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
 	
 	for (int proc=0;proc<np;++proc) { 
 		if (Rank!=proc) {
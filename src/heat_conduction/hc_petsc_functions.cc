@@ -21,6 +21,9 @@
 
 *************************************************************************/
 #include "hc.h"
+#include "memory_usage.h"
+
+#define GMRES_RESTART 100
 
 void HeatConduction::petsc_init(void) {
 
@@ -28,9 +31,9 @@ void HeatConduction::petsc_init(void) {
 	vector<int>::iterator it;
 	
 	//Create nonlinear solver context
-	KSPCreate(PETSC_COMM_WORLD,&ksp);
+	KSPCreate(grid[gid].comm,&ksp);
 	
-	VecCreateMPI(PETSC_COMM_WORLD,grid[gid].cellCount*nVars,grid[gid].globalCellCount*nVars,&rhs);
+	VecCreateMPI(grid[gid].comm,grid[gid].cellCount*nVars,grid[gid].globalCellCount*nVars,&rhs);
 	VecSetFromOptions(rhs);
 	VecDuplicate(rhs,&deltaU);
 	VecSet(rhs,0.);
@@ -56,7 +59,7 @@ void HeatConduction::petsc_init(void) {
 	}
 	
 	MatCreateMPIAIJ(
-					PETSC_COMM_WORLD,
+					grid[gid].comm,
 					grid[gid].cellCount*nVars,
 					grid[gid].cellCount*nVars,
 					grid[gid].globalCellCount*nVars,
@@ -71,21 +74,47 @@ void HeatConduction::petsc_init(void) {
 	KSPSetTolerances(ksp,rtol,abstol,1.e15,maxits);
 	KSPSetInitialGuessKnoll(ksp,PETSC_TRUE);
 	KSPSetType(ksp,KSPFGMRES);
-	KSPGMRESSetRestart(ksp,100);
+	KSPGMRESSetRestart(ksp,GMRES_RESTART);
 	KSPSetFromOptions(ksp);
 	
 	return;
 } 
 
+void HeatConduction::account_memory(void) {
+	
+	string prefix="grid "+int2str(gid+1)+"/heat conduction/";
+	double size;
+	
+	size=T.bytes()+update.bytes()+qdot.bytes()+gradT.bytes()+dt[gid].bytes();
+	memory_usage.account(prefix+"variables",size);
+	memory_usage.account(prefix+"work arrays",container_bytes(sendBuffer)+container_bytes(recvBuffer)+grid[gid].cellCount*sizeof(double)); // operator_dt is filled at the first step
+	
+	double rows=grid[gid].cellCount*nVars;
+	memory_usage.account(prefix+"petsc vectors",rows*sizeof(PetscScalar)*2);
+	
+	MatInfo info;
+	MatGetInfo(impOP,MAT_LOCAL,&info);
+	size=info.nz_allocated*(sizeof(PetscScalar)+sizeof(PetscInt))+2.*rows*sizeof(PetscInt);
+	memory_usage.account(prefix+"matrix",size);
+	// Allocated at the first solve, see NavierStokes::account_memory
+	memory_usage.account(prefix+"krylov workspace",(2.*GMRES_RESTART+4.)*rows*sizeof(PetscScalar),true);
+	memory_usage.account(prefix+"preconditioner",size,true);
+	
+	return;
+}
+
 void HeatConduction::petsc_solve(void) {
 
-	MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
-	MatAssemblyEnd(impOP,MAT_FINAL_ASSEMBLY);
+	if (rebuild_operator) {
+		MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
+		MatAssemblyEnd(impOP,MAT_FINAL_ASSEMBLY);
+	}
 	
 	VecAssemblyBegin(rhs);
 	VecAssemblyEnd(rhs);
 	
-	KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
+	// Keep the factored preconditioner along with a reused operator
+	KSPSetOperators(ksp,impOP,impOP,(rebuild_operator) ? SAME_NONZERO_PATTERN : SAME_PRECONDITIONER);
 	KSPSolve(ksp,rhs,deltaU);
 	
 	KSPGetIterationNumber(ksp,&nIter);
@@ -24,11 +24,8 @@
 
 void Interpolate::init(void) {
 	
-	a3.resize(3); b3.resize(3); weights3.resize(3);
-	for (int i=0;i<3;++i) a3[i].resize(3);
-	
-	a4.resize(4); b4.resize(4); weights4.resize(4);
-	for (int i=0;i<4;++i) a4[i].resize(4);
+	// Each thread uses its own object, nothing here is shared
+	stencil.reserve(16); stencil_indices.reserve(16); weights.reserve(16);
 	
 	return;
 }
@@ -62,60 +59,43 @@ void Interpolate::flush(void) {
 void Interpolate::sort_stencil(bool is_internal) {
 
 	int stencil_size=stencil.size();
-	vector<double> distances;
-	vector<int> order (min(stencil_size,max_stencil_size),0);
-	vector<double> min_distances (order.size(),1.e20);
+	int size=min(stencil_size,max_stencil_size);
+	order.assign(size,0);
+	min_distances.assign(size,1.e20);
 	
 	// Store distances to the point
-	for (vit=stencil.begin();vit!=stencil.end();vit++) distances.push_back(fabs(*vit-point));
-	
-	vector<Vec3D> new_stencil (order.size(),0.);
-	vector<int> new_stencil_indices (order.size(),0);
-
-	//is_internal=false;
+	distances.resize(stencil_size);
+	for (int s=0;s<stencil_size;++s) distances[s]=fabs(stencil[s]-point);
 	
 	// Sort distances
-	if (is_internal) { // Keep the first 2 (parent and neighbor) in the stencil unchanged
+	// If internal, keep the first 2 (parent and neighbor) in the stencil unchanged
+	int first=0;
+	if (is_internal) {
 		order[0]=0;
 		order[1]=1;
-		for (int d=2;d<distances.size();++d) {
-			for (int m=2;m<min_distances.size();++m) {
-				if (distances[d]<=min_distances[m]) {
-					for (int i=order.size()-1;i>m;--i) order[i]=order[i-1];
-					for (int i=order.size()-1;i>m;--i) min_distances[i]=min_distances[i-1];
-					order[m]=d;
-					min_distances[m]=distances[d];
-					break;
-				}
-			}
-		}
-	} else {
-		for (int d=0;d<distances.size();++d) {
-			for (int m=0;m<min_distances.size();++m) {
-				if (distances[d]<=min_distances[m]) {
-					for (int i=order.size()-1;i>m;--i) order[i]=order[i-1];
-					for (int i=order.size()-1;i>m;--i) min_distances[i]=min_distances[i-1];
-					order[m]=d;
-					min_distances[m]=distances[d];
-					break;
-				}
+		first=2;
+	}
+	for (int d=first;d<distances.size();++d) {
+		for (int m=first;m<min_distances.size();++m) {
+			if (distances[d]<=min_distances[m]) {
+				for (int i=order.size()-1;i>m;--i) order[i]=order[i-1];
+				for (int i=order.size()-1;i>m;--i) min_distances[i]=min_distances[i-1];
+				order[m]=d;
+				min_distances[m]=distances[d];
+				break;
 			}
 		}
-
 	}
 
-	for (int i=0;i<order.size();++i) {
+	new_stencil.resize(size);
+	new_stencil_indices.resize(size);
+	for (int i=0;i<size;++i) {
 		new_stencil[i]=stencil[order[i]];
 		new_stencil_indices[i]=stencil_indices[order[i]];
 	}
 
-	stencil=new_stencil;
-	stencil_indices=new_stencil_indices;
-	
-	distances.clear();
-	order.clear();
-	min_distances.clear();
-	new_stencil.clear();
+	stencil.swap(new_stencil);
+	stencil_indices.swap(new_stencil_indices);
 	
 	return;
 }
@@ -215,7 +195,7 @@ bool Interpolate::interpolate_tetra(void) {
 					//b4[3]=1.;
 					
 					// Solve the 4x4 linear system by Gaussion Elimination
-					gelimd(a4,b4,weights4);
+					if (gelimd(a4,b4,weights4)) continue;
 					// Let's see if the linear system solution is good
 					weightSum=0.;
 					for (int i=0;i<4;++i) weightSum+=weights4[i];
@@ -294,7 +274,7 @@ bool Interpolate::interpolate_tri(void) {
 				b3[2]=1.;
 				
 				// Solve the 3x3 linear system by Gaussion Elimination
-				gelimd(a3,b3,weights3);
+				if (gelimd(a3,b3,weights3)) continue;
 				// Let's see if the linear system solution is good
 				weightSum=0.;
 				for (int i=0;i<3;++i) weightSum+=weights3[i];
@@ -41,9 +41,14 @@ using namespace std;
 
 class Interpolate {
 private:
-	vector<Vec3D>::iterator vit;
-	vector<vector<double> > a3,a4;
-	vector<double> b3,b4,weights3,weights4;
+	// Small linear systems are solved on the stack
+	double a3[3][3],a4[4][4];
+	double b3[3],b4[4],weights3[3],weights4[4];
+	// Scratch space of sort_stencil, reused from one point to the next
+	vector<double> distances,min_distances;
+	vector<int> order;
+	vector<Vec3D> new_stencil;
+	vector<int> new_stencil_indices;
 	
 	Vec3D planeNormal,edge1,edge2,edge3,edge4,edge5,edge6,p_point,centroid;
 	Vec3D basis1,basis2,basis3;
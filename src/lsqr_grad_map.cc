@@ -29,7 +29,8 @@ extern vector<Grid> grid;
 extern InputFile input;
 extern vector<vector<BCregion> > bc;
 
-void lsqr_grad_map(int gid,int ci) {
+// The map of the cell is returned in gradMap (called from threads, only reads the grid)
+void lsqr_grad_map(int gid,int ci,map<int,Vec3D> &gradMap) {
 
 	vector<int> stencil;
 	vector<double> w;
@@ -83,15 +84,15 @@ void lsqr_grad_map(int gid,int ci) {
 	det=a*d*f-a*e*e-b*b*f-c*c*d+2.*b*c*e;
 	
 	weight=0.;
-	grid[gid].cell[ci].gradMap.clear();
+	gradMap.clear();
 	for (int k=0;k<stencil.size();k++) {
 		weight[0]=w[k]*(distance[k][0]*(d*f-e*e)+distance[k][1]*(c*e-b*f)+distance[k][2]*(b*e-c*d));
 		weight[1]=w[k]*(distance[k][0]*(c*e-b*f)+distance[k][1]*(a*f-c*c)+distance[k][2]*(b*c-a*e));
 		weight[2]=w[k]*(distance[k][0]*(b*e-c*d)+distance[k][1]*(b*c-a*e)+distance[k][2]*(a*d-b*b));		
 		weight/=det;
-		grid[gid].cell[ci].gradMap.insert(pair<int,Vec3D>(stencil[k],weight));
-		if (grid[gid].cell[ci].gradMap.find(ci)==grid[gid].cell[ci].gradMap.end()) grid[gid].cell[ci].gradMap.insert(pair<int,Vec3D>(ci,-1.*weight));	
-		else grid[gid].cell[ci].gradMap[ci]-=weight;
+		gradMap.insert(pair<int,Vec3D>(stencil[k],weight));
+		if (gradMap.find(ci)==gradMap.end()) gradMap.insert(pair<int,Vec3D>(ci,-1.*weight));	
+		else gradMap[ci]-=weight;
 		
 	}
 
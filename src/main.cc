@@ -41,16 +41,21 @@ using namespace std;
 #include "commons.h"
 #include "bc_interface.h"
 #include "loads.h"
+#include "timers.h"
+#include "memory_usage.h"
+#include "comm_profile.h"
 
 // Function prototypes
 void read_inputs(void);
-void set_bcs(int gid);
 void write_volume_output(int gid, int step);
 void write_surface_output(int gid, int step);
 void write_restart(int gid,int timeStep,double time);
 void write_loads(int gid,int timeStep,double time);
 void read_restart(int gid,int restart_step,double &time);
-void set_lengthScales(int gid);
+void read_grid(int gid);
+bool split_grids(void);
+void set_interfaces(int gid);
+void setup_grid(int gid);
 
 void set_time_step_options(void);
 void update_time_step_options(void);
@@ -61,9 +66,6 @@ void update_pseudo_time_step_options(void);
 void update_pseudo_time_step(int ps_tep,double &max_cfl,int gid);
 
 void bc_interface_sync(void);
-void face_interpolation_weights(int gid);
-void node_interpolation_weights(int gid);
-void gradient_maps(int gid);
 	
 // Global declerations
 InputFile input;
@@ -95,6 +97,27 @@ int PetscPrintError(const char error[],...){
 	return 0;
 }
 
+// When the grids run concurrently, world rank 0 gets the screen output values of the
+// grids it holds no part of from their first rank
+static void gather_status(int gid,double &time,double &max_cfl) {
+	if (grid[gid].worldOffset==0) return;
+	double status[8];
+	if (Rank==grid[gid].worldOffset) {
+		status[0]=time; status[1]=max_cfl;
+		status[2]=ns[gid].nIter; status[3]=ns[gid].res;
+		status[4]=rans[gid].nIter; status[5]=rans[gid].res;
+		status[6]=hc[gid].nIter; status[7]=hc[gid].res;
+		MPI_Send(status,8,MPI_DOUBLE,0,gid,MPI_COMM_WORLD);
+	} else if (Rank==0) {
+		MPI_Recv(status,8,MPI_DOUBLE,grid[gid].worldOffset,gid,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+		time=status[0]; max_cfl=status[1];
+		ns[gid].nIter=int(status[2]); ns[gid].res=status[3];
+		rans[gid].nIter=int(status[4]); rans[gid].res=status[5];
+		hc[gid].nIter=int(status[6]); hc[gid].res=status[7];
+	}
+	return;
+}
+
 int main(int argc, char *argv[]) {
 
 	// Initialize mpi
@@ -113,6 +136,7 @@ int main(int argc, char *argv[]) {
 	int restart_step=0;	
 	bool PREP=false;
 	bool OUTPUT_ONLY=false;
+	bool MEMORY_ONLY=false;
 	if (argc>2) {
 		string str_arg;
 		str_arg=argv[2];
@@ -125,11 +149,17 @@ int main(int argc, char *argv[]) {
 		} else if (str_arg=="prep") {
 			PREP=true;
 			remove("grid.raw");
+		} else if (str_arg=="memory") {
+			// Dry run: set up the grids and the solvers, report the memory usage and quit
+			MEMORY_ONLY=true;
 		}
 	}
 	// Read the input file
 	input.setFile(inputFileName);
 	read_inputs();
+	timers.initialize(input.section("profiling").get_string("timers")=="on",input.section("profiling").get_string("trace")=="on");
+	memory_usage.initialize(MEMORY_ONLY || input.section("profiling").get_string("memory")=="on");
+	comm_profile.initialize(input.section("profiling").get_string("communication")=="on");
 	
 	equations.resize(input.section("grid",0).count);
 	turbulent.resize(input.section("grid",0).count);
@@ -151,51 +181,28 @@ int main(int argc, char *argv[]) {
 	interface.resize(grid.size());
 	
 	// Read the grid and initialize
+	timers.start("setup");
 	for (int gid=0;gid<grid.size();++gid) {
-		grid[gid].dimension=input.section("grid",gid).get_int("dimension");
-		grid[gid].gid=gid;
-		// Read the grid raw data from file
-		grid[gid].read(input.section("grid",gid).get_string("file"),input.section("grid",gid).get_string("format"));
-		if (PREP && Rank==0) {grid[gid].write_raw(); continue;}
-		// Do the transformations
-		int tcount=input.section("grid",gid).subsection("transform",0).count;
-		
-		for (int t=0;t<tcount;++t) {
-			if (input.section("grid",gid).subsection("transform",t).get_string("function")=="translate") {
-				Vec3D begin=input.section("grid",gid).subsection("transform",t).get_Vec3D("anchor");
-				Vec3D end=input.section("grid",gid).subsection("transform",t).get_Vec3D("end");
-				grid[gid].translate(begin,end);
-			} else if (input.section("grid",gid).subsection("transform",t).get_string("function")=="scale") {
-				Vec3D anchor=input.section("grid",gid).subsection("transform",t).get_Vec3D("anchor");
-				Vec3D factor=input.section("grid",gid).subsection("transform",t).get_Vec3D("factor");
-				grid[gid].scale(anchor,factor);
-			} else if (input.section("grid",gid).subsection("transform",t).get_string("function")=="rotate") {
-				Vec3D anchor=input.section("grid",gid).subsection("transform",t).get_Vec3D("anchor");
-				Vec3D axis=input.section("grid",gid).subsection("transform",t).get_Vec3D("axis");
-				double angle=input.section("grid",gid).subsection("transform",t).get_double("angle");
-				grid[gid].rotate(anchor,axis,angle);
-			} 
-		}
-
-		// Establish connectivity, area, volume etc... all the needed information
-		grid[gid].setup();
-		set_bcs(gid);
-		
-		set_lengthScales(gid);
-		if (Rank==0) cout << "[I grid=" << gid+1 << " ] Calculating face averaging metrics" << endl;
-
-		face_interpolation_weights(gid);
-		node_interpolation_weights(gid);
-		gradient_maps(gid);
+		timers.start("grid read"); read_grid(gid); timers.stop();
+		if (PREP && Rank==0) grid[gid].write_raw();
 	}
 
 	if (PREP) return 0;
 	
+	// Give each grid its own ranks if the grids are to be solved concurrently
+	bool concurrent=split_grids();
+	for (int gid=0;gid<grid.size();++gid) {
+		set_interfaces(gid);
+		if (grid[gid].active) setup_grid(gid);
+	}
+	
+	timers.start("interface setup");
 	for (int gid=0;gid<grid.size();++gid) {
 		for (int i=0;i<interface[gid].size();++i) {
 			interface[gid][i].setup();
 		}
 	}
+	timers.stop();
 
 	vector<double> time (grid.size(),0.);
 	vector<double> max_cfl (grid.size(),0.);
@@ -204,23 +211,44 @@ int main(int argc, char *argv[]) {
 	int ps_step_max=input.section("pseudotime").get_int("numberofsteps");
 	int ps_step;
 	
+	timers.start("solver initialization");
 	for (int gid=0;gid<grid.size();++gid) {
+		if (!grid[gid].active) continue;
 		if (equations[gid]==NS) {
-			if (Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing Navier Stokes solver" << endl; 
+			if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing Navier Stokes solver" << endl; 
 			ns[gid].gid=gid;
 			ns[gid].initialize(ps_step_max);
+			if (memory_usage.enabled) ns[gid].account_memory();
+			memory_usage.stage("grid "+int2str(gid+1)+"/navier stokes initialization");
 			if (turbulent[gid]) {
-				if (Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing RANS solver" << endl; 
+				if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing RANS solver" << endl; 
 				rans[gid].gid=gid;
 				rans[gid].initialize(ps_step_max);
+				if (memory_usage.enabled) rans[gid].account_memory();
+				memory_usage.stage("grid "+int2str(gid+1)+"/rans initialization");
 			}
 		}
 		if (equations[gid]==HEAT) {
-			if (Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing Heat Conduction solver" << endl;
+			if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing Heat Conduction solver" << endl;
 			hc[gid].gid=gid;
 			hc[gid].initialize();
+			if (memory_usage.enabled) hc[gid].account_memory();
+			memory_usage.stage("grid "+int2str(gid+1)+"/heat conduction initialization");
+		}
+		if (restart_step>0) {
+			timers.start("restart read");
+			read_restart(gid,restart_step,time[gid]);
+			timers.stop();
 		}
-		if (restart_step>0) read_restart(gid,restart_step,time[gid]);
+	}
+	timers.stop();
+	timers.stop(); // setup
+	
+	if (MEMORY_ONLY) {
+		memory_usage.report();
+		PetscFinalize();
+		MPI_Finalize();
+		return 0;
 	}
 
 	set_time_step_options();
@@ -283,9 +311,10 @@ int main(int argc, char *argv[]) {
 	
 	if (OUTPUT_ONLY==true) {
 		for (int gid=0;gid<grid.size();++gid) {
-			if (Rank==0) cout << "[I] Writing surface output for grid=" << gid+1 << endl;
+			if (!grid[gid].active) continue;
+			if (grid[gid].Rank==0) cout << "[I] Writing surface output for grid=" << gid+1 << endl;
 			write_surface_output(gid,restart_step);
-			if (Rank==0) cout << "[I] Writing volume output for grid=" << gid+1 << endl;
+			if (grid[gid].Rank==0) cout << "[I] Writing volume output for grid=" << gid+1 << endl;
 			write_volume_output(gid, restart_step);
 		}
 		exit(0);
@@ -314,10 +343,13 @@ int main(int argc, char *argv[]) {
 
 	bool lastTimeStep=false;
 	
+	timers.start("time loop");
 	for (int timeStep=restart_step+1;timeStep<=timeStepMax+restart_step;++timeStep) {
 		if (timeStep==(timeStepMax+restart_step)) lastTimeStep=true;
+		comm_profile.step();
 		for (int gid=0;gid<grid.size();++gid) {
-			update_time_step(timeStep,time[gid],max_cfl[gid],gid);
+			if (!grid[gid].active) continue;
+			timers.start("time step"); update_time_step(timeStep,time[gid],max_cfl[gid],gid); timers.stop();
 			if (equations[gid]==NS) {
 				for (ps_step=1;ps_step<=ps_step_max;++ps_step) {
 					for (int b=0;b<loads[gid].include_bcs.size();++b) {
@@ -325,18 +357,18 @@ int main(int argc, char *argv[]) {
 						loads[gid].moment[b]=0.;
 					}
 					if (ps_step_max>1) update_pseudo_time_step(ps_step,ps_max_cfl[gid],gid);
-					 ns[gid].solve(timeStep,ps_step);
+					timers.start("navier stokes");
+					ns[gid].solve(timeStep,ps_step);
+					timers.stop();
 					// Write screen output for pseudo time iteration
-					if (Rank==0 && ps_step_max>1) {
-						cout        << "\t" << ps_step << "\t" << ps_max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].ps_res;
-						convergence << "\t" << ps_step << "\t" << ps_max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].ps_res;
-						if (turbulent[gid]) {
-							cout        << "\t" << rans[gid].nIter << "\t" << rans[gid].ps_res;
-							convergence << "\t" << rans[gid].nIter << "\t" << rans[gid].ps_res;
-
-						}
-						cout        << endl;
-						convergence << endl;
+					// (from the grid's first rank, only world rank 0 writes the convergence file)
+					if (grid[gid].Rank==0 && ps_step_max>1) {
+						ostringstream line;
+						line << setprecision(3) << scientific;
+						line << "\t" << ps_step << "\t" << ps_max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].ps_res;
+						if (turbulent[gid]) line << "\t" << rans[gid].nIter << "\t" << rans[gid].ps_res;
+						cout << line.str() << endl;
+						if (Rank==0) convergence << line.str() << endl;
 					}
 					if (ps_step_max>1) {
 						if (ns[gid].ps_res < ps_tolerance) {
@@ -346,8 +378,19 @@ int main(int argc, char *argv[]) {
 					}
 				}
 			}
-			if (equations[gid]==HEAT) hc[gid].solve(timeStep);
-			bc_interface_sync();
+			if (equations[gid]==HEAT) {
+				timers.start("heat conduction");
+				hc[gid].solve(timeStep);
+				timers.stop();
+			}
+			// A grid solved after another one sees its updated interface values in the same step
+			if (!concurrent) { timers.start("interface sync"); bc_interface_sync(); timers.stop(); }
+		} // end grid solve loop
+		// Concurrent grids exchange the interface values once all of them are done with the step
+		if (concurrent) { timers.start("interface sync"); bc_interface_sync(); timers.stop(); }
+		
+		for (int gid=0;gid<grid.size();++gid) {
+			if (concurrent) gather_status(gid,time[gid],max_cfl[gid]);
 			// Screen output
 			if (Rank==0) {
 				cout        << timeStep << "\t" << gid+1 << "\t" << time[gid];
@@ -367,20 +410,21 @@ int main(int argc, char *argv[]) {
 				cout        << endl;
 				convergence << endl;
 			}
+			if (!grid[gid].active) continue;
 			if (timeStep%volume_plot_freq[gid]==0 || lastTimeStep) {
-				if (Rank==0) cout << "[I] Writing volume output for grid=" << gid+1 << endl;
-				write_volume_output(gid,timeStep);
+				if (grid[gid].Rank==0) cout << "[I] Writing volume output for grid=" << gid+1 << endl;
+				timers.start("volume output"); write_volume_output(gid,timeStep); timers.stop();
 			} // end if
 			if (timeStep%surface_plot_freq[gid]==0 || lastTimeStep) {
-				if (Rank==0) cout << "[I] Writing surface output for grid=" << gid+1 << endl;
-				write_surface_output(gid,timeStep);
+				if (grid[gid].Rank==0) cout << "[I] Writing surface output for grid=" << gid+1 << endl;
+				timers.start("surface output"); write_surface_output(gid,timeStep); timers.stop();
 			} // end if
 			if (timeStep%restart_freq[gid]==0 || lastTimeStep) {
-				if (Rank==0) cout << "[I] Writing restart for grid=" << gid+1 << endl;
-				write_restart(gid,timeStep,time[gid]);
+				if (grid[gid].Rank==0) cout << "[I] Writing restart for grid=" << gid+1 << endl;
+				timers.start("restart write"); write_restart(gid,timeStep,time[gid]); timers.stop();
 			} // end if
 			if (timeStep%loads[gid].frequency==0) {
-				write_loads(gid,timeStep,time[gid]);
+				timers.start("loads output"); write_loads(gid,timeStep,time[gid]); timers.stop();
 			} // end if
 			if (timeStep%time_step_update_freq==0) {
 				update_time_step_options();
@@ -405,19 +449,19 @@ int main(int argc, char *argv[]) {
 		
 		if (fexists("dump_restart")) {
 			if (Rank==0) cout << "[I] Writing restart for all grids" << endl;
-			for (int gid=0;gid<grid.size();++gid) write_restart(gid,timeStep,time[gid]);
+			for (int gid=0;gid<grid.size();++gid) if (grid[gid].active) write_restart(gid,timeStep,time[gid]);
 			MPI_Barrier(MPI_COMM_WORLD);
 			if (Rank==0) remove("dump_restart");
 		} 
 		if (fexists("dump_volume")) {
 			if (Rank==0) cout << "[I] Writing volume output for all grids" << endl;
-			for (int gid=0;gid<grid.size();++gid) write_volume_output(gid,timeStep);
+			for (int gid=0;gid<grid.size();++gid) if (grid[gid].active) write_volume_output(gid,timeStep);
 			MPI_Barrier(MPI_COMM_WORLD);
 			if (Rank==0) remove("dump_volume");
 		} 
 		if (fexists("dump_surface")) {
 			if (Rank==0) cout << "[I] Writing surface output for all grids" << endl;
-			for (int gid=0;gid<grid.size();++gid) write_surface_output(gid,timeStep);
+			for (int gid=0;gid<grid.size();++gid) if (grid[gid].active) write_surface_output(gid,timeStep);
 			MPI_Barrier(MPI_COMM_WORLD);
 			if (Rank==0) remove("dump_surface");
 		} 
@@ -428,6 +472,7 @@ int main(int argc, char *argv[]) {
 				cout << "[I] Writing surface output for all grids" << endl;
 			}
 			for (int gid=0;gid<grid.size();++gid) {
+				if (!grid[gid].active) continue;
 				write_restart(gid,timeStep,time[gid]);
 				write_volume_output(gid,timeStep);
 				write_surface_output(gid,timeStep);
@@ -436,6 +481,7 @@ int main(int argc, char *argv[]) {
 			if (Rank==0) remove("dump_all");
 		} 	
 	}
+	timers.stop();
 	/*****************************************************************************************/
 	// End time loop
 	/*****************************************************************************************/	
@@ -446,46 +492,14 @@ int main(int argc, char *argv[]) {
       	      timeEnd=MPI_Wtime();
       	      cout << "[I] Wall time = " << timeEnd-timeRef << " second" << endl;
       	}
+	
+	timers.report();
+	timers.write_trace();
+	memory_usage.report();
+	comm_profile.report();
 
 	PetscFinalize();
 	MPI_Finalize();
 	
 	return 0;
-}                	
-                 	
-void set_lengthScales(int gid) {
-	// Loop through the cells and calculate length scales for each cell
-	for (int c=0;c<grid[gid].cellCount;++c) {
-		grid[gid].cell[c].lengthScale=1.e20;
-		double height;
-		int f;
-		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
-			f=grid[gid].cell[c].faces[cf];
-			height=fabs(grid[gid].face[f].normal.dot(grid[gid].face[f].centroid-grid[gid].cell[c].centroid));
-			bool skipScale=false;
-			if (grid[gid].face[f].bc>=0) {
-				if (bc[gid][grid[gid].face[f].bc].type==SYMMETRY) {
-					skipScale=true;
-				}
-			}
-			if (!skipScale) grid[gid].cell[c].lengthScale=min(grid[gid].cell[c].lengthScale,height);
-		}
-	}
-	
-	// Find out the global, grid cell length scale
-	if (grid[gid].dimension==3) {
-		grid[gid].lengthScale=pow(grid[gid].globalTotalVolume,1./3.);
-		if (Rank==0) cout << "[I] Grid length scale is set to " << grid[gid].lengthScale << endl;
-	} else {
-		
-		// If the problem is 2D, finding the grid length scale is a bit more challenging
-		// Find the symmetry BC region with the largest area, and take the square root
-	        grid[gid].lengthScale=0.;	
-		for (int b=0;b<bc[gid].size();++b) {
-			if (bc[gid][b].type==SYMMETRY) grid[gid].lengthScale=max(grid[gid].lengthScale,sqrt(0.5*bc[gid][b].total_area));
-		}
-		if (Rank==0) cout << "[I] Grid length scale is set to " << grid[gid].lengthScale << endl;
-	}
-	
-	return;
-} 
+}
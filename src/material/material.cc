@@ -23,7 +23,7 @@
 #include "material.h"
 
 MATERIAL::MATERIAL() {
-	;
+	use_tables=false;
 }
 
 void MATERIAL::set(int gid) {
@@ -103,51 +103,82 @@ void MATERIAL::set(int gid) {
 	}
 	Pref=input.section("reference").get_double("p");
   	Tref=input.section("reference").get_double("T");
+	
+	setup();
+	
+	if (input.section("grid",gid).get_string("material").is_found) {
+		if (material_input[gid].section("propertytables").is_found) {
+			build_tables(material_input[gid].section("propertytables").get_double("Tmin"),
+				     material_input[gid].section("propertytables").get_double("Tmax"),
+				     material_input[gid].section("propertytables").get_double("tolerance"));
+		}
+	}
+	
+	return;
 }
 
-double MATERIAL::rho (double p, double T) { 
-	return (p+Pref)/(R*(T+Tref));
-}
-
-double MATERIAL::p (double rho, double T) {
-	return rho*R*(T+Tref)-Pref;
+void MATERIAL::setup(void) {
+	
+	Cp_ideal=gamma*R/(gamma-1.);
+	gammaR=gamma*R;
+	if (visc_model==SUTHERLANDS) sut_factor=sut_mu_ref*(sut_T_ref+sut_S)/(sut_T_ref*sqrt(sut_T_ref));
+	
+	return;
 }
 
-double MATERIAL::T (double p, double rho) {
-	return (p+Pref)/(R*rho)-Tref;
+void MATERIAL::build_tables(double Tmin,double Tmax,double tolerance) {
+	
+	if (visc_model!=CONSTANT) build_table(mu_table,&MATERIAL::viscosity_model,Tmin,Tmax,tolerance);
+	if (lambda_model!=CONSTANT) build_table(lambda_table,&MATERIAL::therm_cond_model,Tmin,Tmax,tolerance);
+	use_tables=true;
+	
+	return;
 }
 
-double MATERIAL::a (double p, double T) { 
-	return sqrt(gamma*(p+Pref)/rho(p,T));
+void MATERIAL::build_table(Property_Table &table,double (MATERIAL::*property)(double),double Tmin,double Tmax,double tolerance) {
+	
+	// Refine the table until the linear interpolation error at the interval midpoints
+	// is below the relative tolerance
+	int n=64;
+	int nMax=1<<20;
+	double error;
+	table.Tmin=Tmin;
+	table.Tmax=Tmax;
+	
+	while (true) {
+		double dT=(Tmax-Tmin)/double(n);
+		table.dT_inv=1./dT;
+		table.value.resize(n+1);
+		for (int i=0;i<=n;++i) table.value[i]=(this->*property)(Tmin+double(i)*dT-Tref);
+		error=0.;
+		for (int i=0;i<n;++i) {
+			double exact=(this->*property)(Tmin+(double(i)+0.5)*dT-Tref);
+			error=max(error,fabs(0.5*(table.value[i]+table.value[i+1])-exact)/max(fabs(exact),1.e-300));
+		}
+		if (error<=tolerance || n>=nMax) break;
+		n*=2;
+	}
+	// Keep the last point out of the range so that eval never reads past the end
+	table.Tmax=Tmax-1.e-12*(Tmax-Tmin);
+	
+	if (Rank==0 && error>tolerance) {
+		cerr << "[W] Property table couldn't reach the requested tolerance, error=" << error << endl;
+	}
+	
+	return;
 }
 
-double MATERIAL::viscosity (double T) {
-	if (visc_model==CONSTANT) {
-		return mu;
-	} else if (visc_model==SUTHERLANDS) {
-		return sut_mu_ref*pow((T+Tref)/sut_T_ref,1.5)*(sut_T_ref+sut_S)/(T+Tref+sut_S);
+double MATERIAL::viscosity_model (double T) {
+	if (visc_model==SUTHERLANDS) {
+		double Tabs=T+Tref;
+		return sut_factor*Tabs*sqrt(Tabs)/(Tabs+sut_S);
 	}
 	return mu;
 }
 
-double MATERIAL::therm_cond (double T) {
-	if (lambda_model==CONSTANT) {
-		return lambda;
-	} else if (lambda_model==PRANDTL) {
-		return Cp(T)*viscosity(T)/Pr;
+double MATERIAL::therm_cond_model (double T) {
+	if (lambda_model==PRANDTL) {
+		return Cp(T)*viscosity_model(T)/Pr;
 	}
 	return lambda;
 }
-
-double MATERIAL::Cp (double T) {
-	if (eos_model==IDEAL_GAS) {
-		return gamma*R/(gamma-1.);
-	} else {
-		if (Cp_model==CONSTANT) {
-			return Cp_value;
-		} else if (Cp_model==POLY) {
-			return Cp_poly.eval(T+Tref);
-		}
-	}
-	return gamma*R/(gamma-1.);
-}
@@ -41,6 +41,21 @@
 extern InputFile input;
 extern vector<InputFile> material_input;
 
+// Temperature indexed property table with linear interpolation
+class Property_Table {
+public:
+	double Tmin,Tmax; // Range of absolute temperature covered
+	double dT_inv; // Inverse of the table spacing
+	vector<double> value;
+	bool covers(double T) { return (T>=Tmin && T<Tmax); }
+	double eval(double T) {
+		double x=(T-Tmin)*dT_inv;
+		int i=int(x);
+		x-=double(i);
+		return value[i]+x*(value[i+1]-value[i]);
+	}
+};
+
 class MATERIAL {
 public:
 	int eos_model;
@@ -59,8 +74,20 @@ public:
 	// Prandtl number
 	double Pr;
 	
+	// Derived constants, filled by setup()
+	double Cp_ideal; // Cp of the calorically perfect ideal gas
+	double gammaR; // gamma*R, a^2=gammaR*T for the ideal gas
+	double sut_factor; // sut_mu_ref*(sut_T_ref+sut_S)/sut_T_ref^1.5
+	
+	// Optional temperature tables of the transport properties
+	bool use_tables;
+	Property_Table mu_table,lambda_table;
+	
 	MATERIAL(); // Constructor
 	void set(int gid);
+	void setup(void); // Derived constants, call after the model inputs are set
+	void build_tables(double Tmin,double Tmax,double tolerance);
+	void build_table(Property_Table &table,double (MATERIAL::*property)(double),double Tmin,double Tmax,double tolerance);
 	// Equation of State functions
 	double rho (double p, double T);
 	double p (double rho, double T);
@@ -70,6 +97,46 @@ public:
 	double viscosity (double T=0.);
 	double therm_cond (double T=0.);
 	double Cp (double T=0.);
+	// Direct model evaluations (bypassing the tables)
+	double viscosity_model (double T);
+	double therm_cond_model (double T);
 };
 
+// Calorically perfect ideal gas relations and table lookups are inlined as they are
+// called several times for each face
+
+inline double MATERIAL::rho (double p, double T) { 
+	return (p+Pref)/(R*(T+Tref));
+}
+
+inline double MATERIAL::p (double rho, double T) {
+	return rho*R*(T+Tref)-Pref;
+}
+
+inline double MATERIAL::T (double p, double rho) {
+	return (p+Pref)/(R*rho)-Tref;
+}
+
+inline double MATERIAL::a (double p, double T) { 
+	return sqrt(gammaR*(T+Tref));
+}
+
+inline double MATERIAL::viscosity (double T) {
+	if (visc_model==CONSTANT) return mu;
+	if (use_tables && mu_table.covers(T+Tref)) return mu_table.eval(T+Tref);
+	return viscosity_model(T);
+}
+
+inline double MATERIAL::therm_cond (double T) {
+	if (lambda_model==CONSTANT) return lambda;
+	if (use_tables && lambda_table.covers(T+Tref)) return lambda_table.eval(T+Tref);
+	return therm_cond_model(T);
+}
+
+inline double MATERIAL::Cp (double T) {
+	if (eos_model==IDEAL_GAS) return Cp_ideal;
+	if (Cp_model==CONSTANT) return Cp_value;
+	return Cp_poly.eval(T+Tref);
+}
+
 #endif
@@ -0,0 +1,282 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <mpi.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+#include "inputs.h"
+#include "grid.h"
+#include "bc.h"
+#include "utilities.h"
+#include "comm_profile.h"
+
+// On-disk cache of the grid metrics that follow the connectivity (grid_n -> metrics cache):
+// wall distances, length scales, face and node interpolation weights and gradient maps.
+// Each rank keeps its part in ./metrics_cache/grid_<n>.<np>.<rank>.bin as a header followed by
+// flat arrays (8 byte aligned) that are mapped in and copied. The key is a hash of the local
+// geometry and connectivity after the bc's are set, so the mesh file, the transforms and the
+// partitioning are all part of it, plus the bc types and the inputs the metrics depend on.
+// The keys of all the grid's ranks are hashed together (the wall distances see every rank),
+// and the cache is only used if every rank finds a file with that key.
+
+extern InputFile input;
+extern vector<Grid> grid;
+extern vector<vector<BCregion> > bc;
+
+#define METRICS_CACHE_VERSION 1
+
+// 64 bit FNV-1a
+class Metrics_Key {
+public:
+	unsigned long long value;
+	Metrics_Key(void) { value=14695981039346656037ULL; }
+	void add(const void *data,size_t bytes) {
+		const unsigned char *p=(const unsigned char*) data;
+		for (size_t i=0;i<bytes;++i) { value^=p[i]; value*=1099511628211ULL; }
+		return;
+	}
+	void add(int i) { add(&i,sizeof(int)); return; }
+	void add(double d) { add(&d,sizeof(double)); return; }
+	void add(Vec3D &v) { add(&v[0],3*sizeof(double)); return; }
+	void add(const string &s) { add(int(s.size())); add(s.c_str(),s.size()); return; }
+	void add(vector<int> &v) { add(int(v.size())); if (!v.empty()) add(&v[0],v.size()*sizeof(int)); return; }
+};
+
+class Metrics_Header {
+public:
+	char magic[8];
+	int version;
+	int np,rank;
+	int nodeCount,faceCount,cellCount,totalCellCount;
+	int faceEntries,nodeEntries,gradEntries;
+	unsigned long long key;
+	double lengthScale;
+};
+
+static inline size_t aligned(size_t bytes) { return (bytes+7)/8*8; }
+
+static string metrics_cache_file(int gid) {
+	return "./metrics_cache/grid_"+int2str(gid+1)+"."+int2str(grid[gid].np)+"."+int2str(grid[gid].Rank)+".bin";
+}
+
+// Bytes following the header
+static size_t metrics_cache_bytes(Metrics_Header &h) {
+	size_t bytes=aligned(h.totalCellCount*sizeof(double))*2; // cell wall distance and length scale
+	bytes+=aligned(h.faceCount*sizeof(double))*2; // face wall distance and dissipation factor
+	bytes+=aligned((h.faceCount+1)*sizeof(int))+aligned(h.faceEntries*sizeof(int))+aligned(h.faceEntries*sizeof(double));
+	bytes+=aligned((h.nodeCount+1)*sizeof(int))+aligned(h.nodeEntries*sizeof(int))+aligned(h.nodeEntries*sizeof(double));
+	bytes+=aligned((h.totalCellCount+1)*sizeof(int))+aligned(h.gradEntries*sizeof(int))+aligned(h.gradEntries*3*sizeof(double));
+	return bytes;
+}
+
+unsigned long long metrics_cache_key(int gid) {
+	
+	Grid &g=grid[gid];
+	Metrics_Key key;
+	
+	key.add(METRICS_CACHE_VERSION);
+	key.add(g.np); key.add(g.Rank); key.add(g.dimension);
+	key.add(g.nodeCount); key.add(g.faceCount); key.add(g.cellCount); key.add(int(g.cell.size()));
+	key.add(g.globalTotalVolume);
+	
+	// Inputs of the metrics (the methods are read from grid_1 in the builders)
+	key.add(input.section("grid",0).subsection("interpolation").get_string("method"));
+	key.add(input.section("grid",gid).subsection("interpolation").get_int("stencilsize"));
+	key.add(input.section("grid",gid).subsection("interpolation").get_double("skewnesstolerance"));
+	key.add(input.section("grid",0).subsection("gradients").get_string("hexmethod"));
+	key.add(input.section("grid",0).subsection("gradients").get_string("prismmethod"));
+	key.add(input.section("grid",0).subsection("gradients").get_string("othermethod"));
+	key.add(input.section("grid",gid).get_string("walldistance"));
+	
+	for (int b=0;b<bc[gid].size();++b) {
+		key.add(bc[gid][b].type); key.add(bc[gid][b].kind); key.add(bc[gid][b].total_area);
+	}
+	
+	for (int n=0;n<g.nodeCount;++n) { key.add(g.node[n]); key.add(g.node[n].cells); }
+	for (int f=0;f<g.faceCount;++f) {
+		key.add(g.face[f].centroid); key.add(g.face[f].normal); key.add(g.face[f].area);
+		key.add(g.face[f].parent); key.add(g.face[f].neighbor); key.add(g.face[f].bc);
+		key.add(int(g.face[f].symmetry)); key.add(g.face[f].nodes);
+	}
+	for (int c=0;c<g.cell.size();++c) {
+		key.add(g.cell[c].centroid); key.add(g.cell[c].volume); key.add(g.cell[c].type);
+		key.add(g.cell[c].nodes); key.add(g.cell[c].faces); key.add(g.cell[c].neighborCells);
+	}
+	
+	// Combine the keys of all the grid's ranks
+	vector<unsigned long long> keys (g.np);
+	MPI_Allgather(&key.value,1,MPI_UNSIGNED_LONG_LONG,&keys[0],1,MPI_UNSIGNED_LONG_LONG,g.comm);
+	Metrics_Key global;
+	global.add(&keys[0],keys.size()*sizeof(unsigned long long));
+	
+	return global.value;
+}
+
+template <class T> static void read_block(char* &p,vector<T> &v,int count) {
+	v.resize(count);
+	if (count>0) memcpy(&v[0],p,count*sizeof(T));
+	p+=aligned(count*sizeof(T));
+	return;
+}
+
+// Vec3D is stored as its 3 components
+static void read_block(char* &p,vector<Vec3D> &v,int count) {
+	v.resize(count);
+	for (int i=0;i<count;++i) memcpy(&v[i][0],p+i*3*sizeof(double),3*sizeof(double));
+	p+=aligned(count*3*sizeof(double));
+	return;
+}
+
+// data may be NULL if count is 0
+template <class T> static void write_block(ofstream &file,const T* data,int count) {
+	static const char pad[8]={0,0,0,0,0,0,0,0};
+	size_t bytes=count*sizeof(T);
+	if (count>0) file.write((const char*) data,bytes);
+	file.write(pad,aligned(bytes)-bytes);
+	return;
+}
+
+template <class T> static void write_block(ofstream &file,vector<T> &v) {
+	write_block(file,v.empty() ? (T*) NULL : &v[0],v.size());
+	return;
+}
+
+static void write_block(ofstream &file,vector<Vec3D> &v) {
+	vector<double> data (3*v.size());
+	for (int i=0;i<v.size();++i) for (int k=0;k<3;++k) data[3*i+k]=v[i][k];
+	write_block(file,data);
+	return;
+}
+
+// Returns true (on all the grid's ranks) if the metrics were read from the cache
+bool read_metrics_cache(int gid,unsigned long long key) {
+	
+	Grid &g=grid[gid];
+	int found=0;
+	Metrics_Header h;
+	void *map=MAP_FAILED;
+	size_t size=0;
+	
+	string fileName=metrics_cache_file(gid);
+	int fd=open(fileName.c_str(),O_RDONLY);
+	struct stat info;
+	if (fd>=0 && fstat(fd,&info)==0 && info.st_size>=sizeof(Metrics_Header)) {
+		size=info.st_size;
+		map=mmap(0,size,PROT_READ,MAP_PRIVATE,fd,0);
+	}
+	if (fd>=0) close(fd); // The mapping stays valid
+	if (map!=MAP_FAILED) {
+		memcpy(&h,map,sizeof(Metrics_Header));
+		if (strncmp(h.magic,"FCFDMTRC",8)==0 && h.version==METRICS_CACHE_VERSION && h.key==key
+			&& h.np==g.np && h.rank==g.Rank && h.nodeCount==g.nodeCount && h.faceCount==g.faceCount
+			&& h.cellCount==g.cellCount && h.totalCellCount==g.cell.size()
+			&& size==aligned(sizeof(Metrics_Header))+metrics_cache_bytes(h)) found=1;
+	}
+	// Only use the cache if every rank can
+	comm_profile.allreduce("metrics cache",MPI_IN_PLACE,&found,1,MPI_INT,MPI_MIN,g.comm);
+	
+	if (found) {
+		char *p=(char*) map+aligned(sizeof(Metrics_Header));
+		vector<double> data;
+		read_block(p,data,h.totalCellCount);
+		for (int c=0;c<g.cell.size();++c) g.cell[c].closest_wall_distance=data[c];
+		read_block(p,data,h.totalCellCount);
+		for (int c=0;c<g.cell.size();++c) g.cell[c].lengthScale=data[c];
+		read_block(p,data,h.faceCount);
+		for (int f=0;f<g.faceCount;++f) g.face[f].closest_wall_distance=data[f];
+		read_block(p,data,h.faceCount);
+		for (int f=0;f<g.faceCount;++f) g.face[f].dissipation_factor=data[f];
+		read_block(p,g.faceAverage.offset,h.faceCount+1);
+		read_block(p,g.faceAverage.index,h.faceEntries);
+		read_block(p,g.faceAverage.weight,h.faceEntries);
+		read_block(p,g.nodeAverage.offset,h.nodeCount+1);
+		read_block(p,g.nodeAverage.index,h.nodeEntries);
+		read_block(p,g.nodeAverage.weight,h.nodeEntries);
+		read_block(p,g.gradMap.offset,h.totalCellCount+1);
+		read_block(p,g.gradMap.index,h.gradEntries);
+		read_block(p,g.gradMap.weight,h.gradEntries);
+		g.lengthScale=h.lengthScale;
+	}
+	if (map!=MAP_FAILED) munmap(map,size);
+	
+	return found;
+}
+
+void write_metrics_cache(int gid,unsigned long long key) {
+	
+	Grid &g=grid[gid];
+	
+	Metrics_Header h;
+	memset(&h,0,sizeof(Metrics_Header));
+	memcpy(h.magic,"FCFDMTRC",8);
+	h.version=METRICS_CACHE_VERSION;
+	h.np=g.np; h.rank=g.Rank;
+	h.nodeCount=g.nodeCount; h.faceCount=g.faceCount; h.cellCount=g.cellCount; h.totalCellCount=g.cell.size();
+	h.faceEntries=g.faceAverage.index.size();
+	h.nodeEntries=g.nodeAverage.index.size();
+	h.gradEntries=g.gradMap.index.size();
+	h.key=key;
+	h.lengthScale=g.lengthScale;
+	
+	mkdir("./metrics_cache",S_IRWXU);
+	// Write to a temporary file and rename it, so that an interrupted write never looks valid
+	string fileName=metrics_cache_file(gid);
+	string tempName=fileName+".tmp";
+	ofstream file;
+	file.open(tempName.c_str(),ios::out | ios::binary);
+	write_block(file,&h,1);
+	
+	vector<double> data (max(max(h.totalCellCount,h.faceCount),1));
+	for (int c=0;c<g.cell.size();++c) data[c]=g.cell[c].closest_wall_distance;
+	write_block(file,&data[0],h.totalCellCount);
+	for (int c=0;c<g.cell.size();++c) data[c]=g.cell[c].lengthScale;
+	write_block(file,&data[0],h.totalCellCount);
+	for (int f=0;f<g.faceCount;++f) data[f]=g.face[f].closest_wall_distance;
+	write_block(file,&data[0],h.faceCount);
+	for (int f=0;f<g.faceCount;++f) data[f]=g.face[f].dissipation_factor;
+	write_block(file,&data[0],h.faceCount);
+	write_block(file,g.faceAverage.offset);
+	write_block(file,g.faceAverage.index);
+	write_block(file,g.faceAverage.weight);
+	write_block(file,g.nodeAverage.offset);
+	write_block(file,g.nodeAverage.index);
+	write_block(file,g.nodeAverage.weight);
+	write_block(file,g.gradMap.offset);
+	write_block(file,g.gradMap.index);
+	write_block(file,g.gradMap.weight);
+	
+	bool good=file.good();
+	file.close();
+	if (good) rename(tempName.c_str(),fileName.c_str());
+	else {
+		remove(tempName.c_str());
+		cerr << "[W] Could not write the metrics cache file " << fileName << endl;
+	}
+	
+	return;
+}
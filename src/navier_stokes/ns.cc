@@ -22,6 +22,8 @@
  *************************************************************************/
 #include "ns.h"
 #include "rans.h"
+#include "timers.h"
+#include "comm_profile.h"
 
 extern vector<RANS> rans;
 
@@ -48,6 +50,8 @@ void NavierStokes::initialize (int ps_max) {
 		limiter_function=NONE;
 	}
 	limiter_threshold=input.section("grid",gid).subsection("navierstokes").get_double("limiterthreshold");
+	limiter_freeze_residual=input.section("grid",gid).subsection("navierstokes").get_double("limiterfreezeresidual");
+	limiter_freeze_step=input.section("grid",gid).subsection("navierstokes").get_int("limiterfreezestep");
 	
 	if (input.section("grid",gid).subsection("navierstokes").get_string("order")=="first") {
 		order=FIRST;
@@ -77,6 +81,19 @@ void NavierStokes::initialize (int ps_max) {
 	bl_height=input.section("grid",0).subsection("navierstokes").get_double("BLheight");
 
 
+	if (input.section("grid",gid).subsection("navierstokes").get_string("linearsolver")=="krylov") {
+		linear_solver=KRYLOV;
+	} else if (input.section("grid",gid).subsection("navierstokes").get_string("linearsolver")=="lusgs") {
+		linear_solver=LUSGS;
+	} else {
+		cerr << "[E] Input entry grid_" << gid+1 << " -> navierstokes -> linearsolver is not recognized!!" << endl;
+		exit(1);
+	}
+	lusgs_sweeps=input.section("grid",gid).subsection("navierstokes").get_int("sweeps");
+	coupled=false; // Set by the RANS solver if requested
+	
+	select_face_kernel();
+
 	Minf=input.section("reference").get_double("Mach");
 	
 	if (input.section("pseudotime").get_string("preconditioner")=="none") {
@@ -87,13 +104,13 @@ void NavierStokes::initialize (int ps_max) {
 	mpi_init();
 	material.set(gid);
 	create_vars();
+	limiter_init();
 	apply_initial_conditions();
 	if (gradient_test==NONE) set_bcs();
 	mpi_update_ghost_primitives();
 	if (gradient_test==NONE) update_boundaries(); // grads are initialized to zero. This update will be first order 
 	calc_cell_grads();
 	mpi_update_ghost_gradients();
-	calc_limiter();
 	petsc_init();
 	first_residuals.resize(3);
 	first_ps_residuals.resize(3);
@@ -104,16 +121,34 @@ void NavierStokes::initialize (int ps_max) {
 void NavierStokes::solve (int ts,int pts) {
 	timeStep=ts;
 	ps_step=pts;
-	assemble_linear_system();
-	time_terms();
-	petsc_solve();
-	if (turbulent[gid]) rans[gid].solve(timeStep,ps_step);
-	update_variables();
-	mpi_update_ghost_primitives();
-	update_boundaries();
-	calc_cell_grads();
-	mpi_update_ghost_gradients();
-	calc_limiter();
+	timers.start("assembly"); assemble_linear_system(); timers.stop();
+	timers.start("time terms"); time_terms(); timers.stop();
+	if (coupled) {
+		// One linear system for the flow and turbulence updates
+		timers.start("rans"); rans[gid].assemble(timeStep,ps_step); timers.stop();
+		timers.start("linear solve"); coupled_solve(); timers.stop();
+		timers.start("rans"); rans[gid].update_variables(); timers.stop();
+	} else {
+		timers.start("linear solve");
+		if (linear_solver==LUSGS) lusgs_solve();
+		else petsc_solve();
+		timers.stop();
+		if (turbulent[gid]) {
+			timers.start("rans");
+			rans[gid].solve(timeStep,ps_step);
+			timers.stop();
+		}
+	}
+	timers.start("update"); update_variables(); timers.stop();
+	// The coupled mode exchanges k and omega along with the flow variables
+	timers.start("ghost exchange"); mpi_update_ghost_primitives(); timers.stop();
+	if (coupled) {
+		timers.start("rans"); rans[gid].update_auxiliaries(); timers.stop();
+	}
+	timers.start("boundaries"); update_boundaries(); timers.stop();
+	check_limiter_freeze();
+	timers.start("gradients and limiters"); calc_cell_grads(); timers.stop();
+	timers.start("gradient exchange"); mpi_update_ghost_gradients(); timers.stop();
 	return;
 }
 
@@ -140,7 +175,8 @@ void NavierStokes::create_vars (void) {
 
 	qdot.cellStore=false; qdot.allocate(gid); // is not stored anywhere but the BC
 	tau.cellStore=false; tau.allocate(gid);
-	mdot.cellStore=false; mdot.faceStore=true; mdot.allocate(gid);	
+	mdot.cellStore=false; mdot.faceStore=true; mdot.allocate(gid);
+	face_store.allocate(grid[gid].faceCount);	
 	
 	// This one is for other solvers to find out contribution from either left or right side
 	weightL.cellStore=false; weightL.faceStore=true; weightL.allocate(gid);
@@ -173,8 +209,8 @@ void NavierStokes::apply_initial_conditions (void) {
 				min_x=min(min_x,grid[gid].cell[c].centroid[0]);
 				max_x=max(max_x,grid[gid].cell[c].centroid[0]);
 			}
-			MPI_Allreduce(&min_x,&min_x,1, MPI_DOUBLE,MPI_MIN,MPI_COMM_WORLD);
-			MPI_Allreduce(&max_x,&max_x,1, MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+			comm_profile.allreduce("gradient test range",MPI_IN_PLACE,&min_x,1,MPI_DOUBLE,MPI_MIN,grid[gid].comm);
+			comm_profile.allreduce("gradient test range",MPI_IN_PLACE,&max_x,1,MPI_DOUBLE,MPI_MAX,grid[gid].comm);
 			
 			for (int c=0;c<grid[gid].cell.size();++c) {
 				double xc=grid[gid].cell[c].centroid[0];
@@ -300,6 +336,9 @@ void NavierStokes::apply_initial_conditions (void) {
 
 void NavierStokes::calc_cell_grads (void) {
 	vector<Vec3D> grad (3,0.);
+	// The limiters are evaluated in the same sweep, right after the gradients of each cell
+	bool limit=limiter_active();
+	if (limit) limiter_prepare();
 	for (int c=0;c<grid[gid].cellCount;++c) {
 		gradp.cell(c)=p.cell_gradient(c);
 		gradT.cell(c)=T.cell_gradient(c);
@@ -315,21 +354,19 @@ void NavierStokes::calc_cell_grads (void) {
 		gradw.cell(c)[1]=grad[1][2];
 		gradw.cell(c)[2]=grad[2][2];
 		
+		if (limit) limit_cell(c);
 	 }
 
 	// Copy parent cell gradients to the boundary ghost cells
-	int bcno,parent,neighbor;
-	for (int f=0;f<grid[gid].faceCount;++f) {
-		bcno=grid[gid].face[f].bc;
-		if (bcno>=0) {
-			parent=grid[gid].face[f].parent;
-			neighbor=grid[gid].face[f].neighbor;
-			gradp.cell(neighbor)=gradp.cell(parent);
-			gradu.cell(neighbor)=gradu.cell(parent);
-			gradv.cell(neighbor)=gradv.cell(parent);
-			gradw.cell(neighbor)=gradw.cell(parent);
-			gradT.cell(neighbor)=gradT.cell(parent);
-		}
+	int parent,neighbor;
+	for (int f=grid[gid].interiorFaceCount;f<grid[gid].faceCount;++f) {
+		parent=grid[gid].face[f].parent;
+		neighbor=grid[gid].face[f].neighbor;
+		gradp.cell(neighbor)=gradp.cell(parent);
+		gradu.cell(neighbor)=gradu.cell(parent);
+		gradv.cell(neighbor)=gradv.cell(parent);
+		gradw.cell(neighbor)=gradw.cell(parent);
+		gradT.cell(neighbor)=gradT.cell(parent);
 	}
 
 	return;
@@ -383,8 +420,8 @@ void NavierStokes::update_variables(void) {
 		
 	} // cell loop
 	
-	MPI_Allreduce(&residuals,&totalResiduals,3, MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-	if (ps_step_max>1) MPI_Allreduce(&ps_residuals,&total_ps_residuals,3, MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+	comm_profile.allreduce("ns residuals",&residuals,&totalResiduals,3,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+	if (ps_step_max>1) comm_profile.allreduce("ns pseudo time residuals",&ps_residuals,&total_ps_residuals,3,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
 		
 	if (timeStep==1) for (int i=0;i<3;++i) first_residuals[i]=sqrt(totalResiduals[i]);
 	if (ps_step_max>1 && ps_step==1) for (int i=0;i<3;++i) first_ps_residuals[i]=sqrt(total_ps_residuals[i]);
@@ -422,9 +459,9 @@ void NavierStokes::find_min_max (void) {
 		qmin[4]=min(qmin[4],p.cell(c));		
 	}
 
-	MPI_Allreduce(qmax,temp,5, MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+	comm_profile.allreduce("ns min max",qmax,temp,5,MPI_DOUBLE,MPI_MAX,grid[gid].comm);
 	for (int i=0;i<5;++i) qmax[i]=temp[i];
-	MPI_Allreduce(qmin,temp,5, MPI_DOUBLE,MPI_MIN,MPI_COMM_WORLD);
+	comm_profile.allreduce("ns min max",qmin,temp,5,MPI_DOUBLE,MPI_MIN,grid[gid].comm);
 	for (int i=0;i<5;++i) qmin[i]=temp[i];
 
 	// DEBUG
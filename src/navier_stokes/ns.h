@@ -38,6 +38,12 @@
 #include "loads.h"
 
 #define NONE -1
+// Face kernel template argument for options dispatched at run time
+#define GENERIC 0
+// Face kernel template argument for the faces it handles, boundary kernels take the
+// bc type (SYMMETRY, WALL, INLET or OUTLET) or ANY_BC to dispatch it at run time
+#define INTERIOR 0
+#define ANY_BC (OUTLET+1)
 // Options for limiter
 #define VK 1
 #define BJ 2
@@ -53,6 +59,9 @@
 #define SW 5
 // Options for preconditioner
 #define WS95 1
+// Options for linear_solver
+#define KRYLOV 1
+#define LUSGS 2
 
 extern InputFile input;
 extern vector<Grid> grid;
@@ -90,12 +99,34 @@ public:
 	int limiter_function;
 	int convective_flux_function;
 	double limiter_threshold;
+	double limiter_freeze_residual;
+	int limiter_freeze_step;
 	double Minf;
 	int preconditioner;
+	int linear_solver;
+	int lusgs_sweeps;
 	double wdiss,bl_height;
 	
 	double small_number;
-	double order_factor;
+	
+	// Face loop scratch space for each thread
+	vector<NS_Assembly_Cache> state_cache;
+	vector<double> rhsLocal; // Local rows of the rhs accumulated by the face loop
+	vector<double> faceJacobians; // Face flux Jacobians of one face color awaiting insertion
+	NS_Face_Store face_store; // Face states kept from the last face loop
+	vector<double> deltaPmax; // Largest pressure difference to the neighbor cells (WS95 preconditioner input)
+	
+	// Limiter stencil of each local cell in compressed rows (filled once by limiter_init)
+	vector<int> limiterOffset,limiterNeighbor;
+	vector<Vec3D> limiterCell2Face;
+	double limiterEps2[5]; // Venkatakrishnan smoothing parameter of the current sweep
+	bool limiter_frozen; // Limiters are kept fixed after the freeze criterion is met
+	
+	// Face loop kernels specialized for the selected flux, order and limiter (ns_face_kernel.h)
+	// Indexed by the face type: INTERIOR, each bc type and ANY_BC
+	typedef void (NavierStokes::*Face_Kernel)(NS_Assembly_Cache &cache,int f,vector<char> &cellVisited,double jacobian[]);
+	Face_Kernel face_kernel[ANY_BC+1];
+	Face_Kernel reference_kernel[ANY_BC+1]; // GENERIC kernels, for comparisons
 	
 	// Total residuals
 	vector<double> first_residuals,first_ps_residuals;
@@ -117,6 +148,19 @@ public:
 	Vec pseudo_delta; // u^k-u^n
 	Vec pseudo_right;
 	
+	// LU-SGS storage (used instead of impOP when linear_solver==LUSGS)
+	vector<double> diagBlock; // 5x5 diagonal block of each cell
+	vector<int> diagPivot; // pivots of the factored diagonal blocks
+	vector<double> faceLambda; // spectral radius times face area
+	vector<double> deltaQ; // primitive variable update (internal and ghost cells)
+	
+	// Coupled Navier-Stokes+RANS storage (turbulence -> coupling=coupled)
+	bool coupled; // p,u,v,w,T,k,omega are solved together as one 7 variable system
+	KSP coupledKsp;
+	Mat coupledOP;
+	Vec coupledRhs,coupledDelta;
+	vector<double> viscousJacobian; // d(momentum and energy diffusive fluxes)/d(mu_t) of each face
+	
 	NavierStokes (void); // Empty constructor
 	// TODO: sort the following list of functions in the proper order of application
 	void initialize(int ps_step_max);
@@ -130,18 +174,31 @@ public:
 	void set_interfaces(void);
 
 	void petsc_init(void);
+	void account_memory(void);
 	void petsc_solve(void);
 	void petsc_destroy(void);
 	
-	void calc_limiter(void);
-	void venkatakrishnan_limiter(void); 
-	void barth_jespersen_limiter(void);
-	void minmod_limiter(void);
+	void lusgs_init(void);
+	void lusgs_solve(void);
+	void lusgs_state(double q[],Vec3D &normal,double W[],double F[]);
+	void mpi_update_ghost_deltas(void);
+	
+	void coupled_init(void);
+	void coupled_solve(void);
+	void coupled_cross_jacobians(void);
+	
+	void limiter_init(void);
+	bool limiter_active(void);
+	void limiter_prepare(void);
+	void check_limiter_freeze(void);
+	void limit_cell(int c);
+	template <int LIMITER> void limit_cell_kernel(int c);
 		
 	void solve(int timeStep,int ps_step);
 	
-	void cons2prim(int cid,vector<vector<double> > &P);
-	void preconditioner_ws95(int c,vector<vector<double> > &P);
+	void cons2prim(int c,double P[5][5]);
+	void preconditioner_ws95(int c,double deltaPmax,double P[5][5]);
+	void prim_block(double density,Vec3D &velocity,double H,double c_p,double drho_dp,double drho_dT,double P[5][5]);
 	void assemble_linear_system(void);
 	void time_terms(void);
 	void left_state_update(NS_Cell_State &left,NS_Face_State &face);
@@ -153,7 +210,16 @@ public:
 	void convective_face_flux(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face,double flux[]);
 	void diffusive_face_flux(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face,double flux[]);
 	void sources(NS_Cell_State &state,double source[],bool forJacobian=false);
-	void get_jacobians(const int var);
+	void select_face_kernel(void);
+	void face_loop(Face_Kernel kernels[],bool insert);
+	template <int FLUX,int ORDER,bool LIMITED,int BOUNDARY> void assemble_face(NS_Assembly_Cache &cache,int f,vector<char> &cellVisited,double jacobian[]);
+	template <int FLUX,int ORDER,bool LIMITED,int BOUNDARY> void get_jacobians(NS_Assembly_Cache &cache,const int var);
+	template <int ORDER,bool LIMITED> void reconstruct_kernel(NS_Cell_State &state,NS_Face_State &face,int c);
+	template <int ORDER,bool LIMITED> void left_state_kernel(NS_Cell_State &left,NS_Face_State &face);
+	template <int ORDER,bool LIMITED,int BOUNDARY> void right_state_kernel(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face);
+	template <int BC> void boundary_state_kernel(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face);
+	template <int FLUX> void convective_flux_kernel(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face,double flux[]);
+	void insert_face_jacobians(int f,double jacobian[]);
 	void apply_bcs(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face);
 	void velocity_inlet(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face);
 	void mdot_inlet(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face);
@@ -21,255 +21,142 @@
 
 *************************************************************************/
 #include "ns.h"
+#include "ns_face_kernel.h"
 
-namespace ns_state {
-	NS_Cell_State left,right,leftPlus,rightPlus;
-	NS_Face_State face;
-	NS_Fluxes flux, fluxPlus;
-	vector<double> jacobianLeft,jacobianRight,sourceJacLeft,sourceJacRight;
-	vector<double> sourceLeft,sourceRight,sourceLeftPlus,sourceRightPlus;
-	bool doLeftSourceJac,doRightSourceJac;
-}
+// Reference kernel with all the options dispatched at run time
+NS_FACE_KERNEL_SET(GENERIC,GENERIC,true)
 
 void NavierStokes::assemble_linear_system(void) {
 
-	MatZeroEntries(impOP);
-	
-	using namespace ns_state;
-	using ns_state::left;
-	using ns_state::right;
-		
-	int parent,neighbor,f;
-	int row,col;
-	
-	vector<bool> cellVisited;
-	for (int c=0;c<grid[gid].cellCount;++c) cellVisited.push_back(false);
+	if (linear_solver==KRYLOV) MatZeroEntries(impOP);
 	
 	small_number=10.*sqrt(std::numeric_limits<double>::epsilon());
 	
-	PetscScalar value;
-
-	flux.convective.resize(5);
-	flux.diffusive.resize(5);
-	fluxPlus.convective.resize(5);
-	fluxPlus.diffusive.resize(5);
-	jacobianLeft.resize(5);
-	jacobianRight.resize(5);
-	left.update.resize(5);
-	right.update.resize(5);
-	leftPlus.update.resize(5);
-	rightPlus.update.resize(5);
-	sourceLeft.resize(5);
-	sourceRight.resize(5);
-	sourceLeftPlus.resize(5);
-	sourceRightPlus.resize(5);
-	sourceJacLeft.resize(5);
-	sourceJacRight.resize(5);
+	int nThreads=thread_count();
+	int nLoads=loads[gid].include_bcs.size();
 	
-	for (int m=0;m<5;++m) flux.diffusive[m]=0.;
+	// Thread private state caches
+	if (state_cache.size()!=nThreads) state_cache.resize(nThreads);
+	for (int t=0;t<nThreads;++t) state_cache[t].allocate(nLoads);
 	
-	bool implicit=true;
-	// if (TIME_INTEGRATOR==FORWARD_EULER) implicit=false; // TODO : properly implement explicit solver
-
-	// Loop through faces
-	for (f=0;f<grid[gid].faceCount;++f) {
-		
-		order_factor=1.; // This is used to kill gradients during Jacobian calculation if first order option is selected
-		
-		doLeftSourceJac=false; doRightSourceJac=false;
-		for (int m=0;m<5;++m) { 
-			sourceLeft[m]=0.;
-			sourceRight[m]=0.;
-		}
-		parent=grid[gid].face[f].parent; neighbor=grid[gid].face[f].neighbor;
-
-		// Populate the state caches
-		face_geom_update(face,f);
-		left_state_update(left,face);
-		right_state_update(left,right,face);
-		face_state_update(left,right,face);
-		// Get unperturbed flux values
-		convective_face_flux(left,right,face,&flux.convective[0]);
-		diffusive_face_flux(left,right,face,&flux.diffusive[0]);
-		
-		// Add Sources
-		if (!cellVisited[parent]){
-			sources(left,&sourceLeft[0]);
-			cellVisited[parent]=true;
-			doLeftSourceJac=true;
-		}
-
-		if(face.bc==INTERNAL_FACE && !cellVisited[neighbor]) {
-			sources(right,&sourceRight[0]);
-			cellVisited[neighbor]=true;
-			doRightSourceJac=true;
-		}
+	int maxColorSize=0;
+	for (int color=0;color<grid[gid].faceColors.size();++color) maxColorSize=max(maxColorSize,int(grid[gid].faceColors[color].size()));
+	if (linear_solver==KRYLOV) faceJacobians.resize(maxColorSize*50);
 	
-		// Integrate boundary loads
-		if ((timeStep) % loads[gid].frequency == 0) {
-			Vec3D temp;
-			for (int b=0;b<loads[gid].include_bcs.size();++b) {
-				if (face.bc==loads[gid].include_bcs[b]) {
-					for (int i=0;i<3;++i) temp[i]=flux.convective[i+1]-flux.diffusive[i+1];
-					loads[gid].force[b]+=temp;
-					loads[gid].moment[b]+=(grid[gid].face[face.index].centroid-loads[gid].moment_center).cross(temp);
-					break;
-				}
-			}
-		}
+	face_loop(face_kernel,true);
+	face_store.filled=true;
 	
-		// Fill in surface information
+	// Fill in rhs vector
+	vector<int> rows (grid[gid].cellCount*5);
+	for (int i=0;i<rows.size();++i) rows[i]=grid[gid].myOffset*5+i;
+	if (rows.size()>0) VecSetValues(rhs,rows.size(),&rows[0],&rhsLocal[0],ADD_VALUES);
 	
-		mdot.face(face.index)=(flux.convective[0]-flux.diffusive[0])/face.area;	
-		if (face.bc>=0) {
-			//if (!mdot.fixedonBC[face.bc]) mdot.bc(face.bc,face.index)=(flux.convective[0]-flux.diffusive[0])/face.area;
-			if (!qdot.fixedonBC[face.bc]) qdot.bc(face.bc,face.index)=(flux.convective[4]-flux.diffusive[4])/face.area;
-			for (int i=0;i<3;++i) tau.bc(face.bc,face.index)[i]=-flux.diffusive[i+1]/face.area;
+	// Sum up the boundary loads from each thread
+	for (int t=0;t<state_cache.size();++t) {
+		for (int b=0;b<nLoads;++b) {
+			loads[gid].force[b]+=state_cache[t].force[b];
+			loads[gid].moment[b]+=state_cache[t].moment[b];
 		}
-		
-		// Fill in rhs vector
-		for (int i=0;i<5;++i) {
-			row=(grid[gid].myOffset+parent)*5+i;
-			value=flux.diffusive[i]-flux.convective[i]+sourceLeft[i];
-			VecSetValues(rhs,1,&row,&value,ADD_VALUES);
-			if (grid[gid].face[f].bc==INTERNAL_FACE) { 
-				row=(grid[gid].myOffset+neighbor)*5+i;
-				value=-1.*(flux.diffusive[i]-flux.convective[i])+sourceRight[i];
-				VecSetValues(rhs,1,&row,&value,ADD_VALUES);
-			}
-		}
-
-		//if (implicit && ps_timeStep==1) { // TODO: Get this working
-
-			for (int i=0;i<5;++i) { // perturb each variable
-				
-				for (int m=0;m<5;++m) { 
-					sourceJacLeft[m]=0.;
-					sourceJacRight[m]=0.;
-				}
-				
-				get_jacobians(i);
-	
-				// Add change of flux (flux Jacobian) to implicit operator
-				for (int j=0;j<5;++j) {
-					col=(grid[gid].myOffset+parent)*5+i; // Effect of parent ith var perturbation
-					row=(grid[gid].myOffset+parent)*5+j; // on parent jth flux
-					value=-1.*jacobianLeft[j];
-					//if (doLeftSourceJac) value-=sourceJacLeft[j];
-					MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-					if (face.bc==INTERNAL_FACE) { 
-						row=(grid[gid].myOffset+neighbor)*5+j; // on neighbor jth flux
-						value=jacobianLeft[j]; 
-						MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-					}
-				} // for j
-
-				if (face.bc==INTERNAL_FACE) {
-					for (int j=0;j<5;++j) {
-						col=(grid[gid].myOffset+neighbor)*5+i; // Effect of neighbor ith var perturbation
-						row=(grid[gid].myOffset+neighbor)*5+j; // on neighbor jth flux
-						value=jacobianRight[j];
-						//if (doRightSourceJac) value-=sourceJacRight[j];
-						MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-						row=(grid[gid].myOffset+parent)*5+j; // on parent jth flux
-						value=-1.*jacobianRight[j];
-						MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-					}
-				} else if (face.bc==PARTITION_FACE) { 
-					// Ghost (only add effect on parent cell, effect on itself is taken care of in its own partition
-					for (int j=0;j<5;++j) {
-						row=(grid[gid].myOffset+parent)*5+j;
-						col=(grid[gid].cell[neighbor].matrix_id)*5+i;
-						value=-1.*jacobianRight[j];
-						MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-					}
-						
-				} // if 
-				
-			} // for i (each perturbed variable)
-		//} // if implicit
-
-	} // for faces
+	}
 	
 	return;
 } // end function
 
-void NavierStokes::get_jacobians(const int var) {
+void NavierStokes::face_loop(Face_Kernel kernels[],bool insert) {
 
-	using namespace ns_state;
-	using ns_state::left;
-	using ns_state::right;
-	double epsilon;
-	double factor=0.001;
-	
-	if (jac_order==FIRST) order_factor=0.;
-	
-	leftPlus=left;
-	rightPlus=right;
-	
-	for (int m=0;m<5;++m) {
-		sourceLeftPlus[m]=sourceLeft[m];
-		sourceRightPlus[m]=sourceRight[m];
-		sourceJacLeft[m]=0.;
-		sourceJacRight[m]=0.;
+	for (int t=0;t<state_cache.size();++t) {
+		for (int b=0;b<state_cache[t].force.size();++b) {
+			state_cache[t].force[b]=0.;
+			state_cache[t].moment[b]=0.;
+		}
 	}
 	
-	if (left.update[var]>small_number) {epsilon=max(small_number,factor*left.update[var]);}
-	else if (left.update[var]<-small_number) {epsilon=min(-small_number,factor*left.update[var]); }
-	else {epsilon=small_number;}
+	vector<char> cellVisited (grid[gid].cellCount,0);
+	rhsLocal.assign(grid[gid].cellCount*5,0.);
+	
+	// Faces of the same color don't share a local cell, so the writes to the cell rows
+	// (rhs, source flags) of concurrent faces never collide
+	// The interior colors come first, the boundary colors follow with faces sorted by bc type
+	// Each bc type batch of a boundary color runs the kernel of that type
+	for (int color=0;color<grid[gid].faceColors.size();++color) {
+		int colorSize=grid[gid].faceColors[color].size();
+		int batchCount=(color<grid[gid].interiorColorCount) ? 1 : OUTLET+1;
+		for (int batch=0;batch<batchCount;++batch) {
+			int begin=0,end=colorSize;
+			Face_Kernel batchKernel=kernels[INTERIOR];
+			if (color>=grid[gid].interiorColorCount) {
+				begin=grid[gid].boundaryColorTypeOffset[color-grid[gid].interiorColorCount][batch];
+				end=grid[gid].boundaryColorTypeOffset[color-grid[gid].interiorColorCount][batch+1];
+				batchKernel=kernels[(batch>=SYMMETRY) ? batch : ANY_BC]; // Batch 0 holds faces of an unknown type
+			}
+			#pragma omp parallel for schedule(static)
+			for (int k=begin;k<end;++k) {
+				double *jacobian=(linear_solver==KRYLOV) ? &faceJacobians[k*50] : NULL;
+				(this->*batchKernel)(state_cache[thread_id()],grid[gid].faceColors[color][k],cellVisited,jacobian);
+			}
+		}
+		// PETSc insertion is not thread safe
+		if (insert && linear_solver==KRYLOV) {
+			for (int k=0;k<colorSize;++k) insert_face_jacobians(grid[gid].faceColors[color][k],&faceJacobians[k*50]);
+		}
+	}
 	
-	// Perturb left state
-	state_perturb(leftPlus,face,var,epsilon);
-	// If right state is a boundary, correct the condition according to changes in left state
-	if (face.bc>=0) right_state_update(leftPlus,rightPlus,face);
+	return;
+} // end face_loop
 
-	convective_face_flux(leftPlus,rightPlus,face,&fluxPlus.convective[0]);
+void NavierStokes::insert_face_jacobians(int f,double jacobian[]) {
 	
-	face_state_adjust(leftPlus,rightPlus,face,var);
-	diffusive_face_flux(leftPlus,rightPlus,face,&fluxPlus.diffusive[0]);
-	
-	if (doLeftSourceJac) {
-		sources(left,&sourceLeft[0],true);
-		sources(leftPlus,&sourceLeftPlus[0],true);
-	}
-	
-	for (int j=0;j<5;++j){
-		jacobianLeft[j]=(fluxPlus.diffusive[j]-flux.diffusive[j]-fluxPlus.convective[j]+flux.convective[j])/epsilon;
-		if (doLeftSourceJac) sourceJacLeft[j]=(sourceLeftPlus[j]-sourceLeft[j])/epsilon;
-	}
+	int parent=grid[gid].face[f].parent;
+	int neighbor=grid[gid].face[f].neighbor;
+	int bc=grid[gid].face[f].bc;
+	int row,col;
+	PetscScalar value;
 	
-	if (face.bc==INTERNAL_FACE || face.bc==PARTITION_FACE) { 
-		
-		if (right.update[var]>small_number) {epsilon=max(small_number,factor*right.update[var]);}
-		else if (right.update[var]<-small_number) {epsilon=min(-small_number,factor*right.update[var]); }
-		else {epsilon=small_number;}
-				
-		state_perturb(rightPlus,face,var,epsilon);
-		
-		convective_face_flux(left,rightPlus,face,&fluxPlus.convective[0]);
-		face_state_adjust(left,rightPlus,face,var);
-		diffusive_face_flux(left,rightPlus,face,&fluxPlus.diffusive[0]);
-		
-		if (doRightSourceJac) {
-			sources(right,&sourceRight[0],true);
-			sources(rightPlus,&sourceRightPlus[0],true);
-		}
+	for (int i=0;i<5;++i) { // each perturbed variable
+		// Add change of flux (flux Jacobian) to implicit operator
+		for (int j=0;j<5;++j) {
+			col=(grid[gid].myOffset+parent)*5+i; // Effect of parent ith var perturbation
+			row=(grid[gid].myOffset+parent)*5+j; // on parent jth flux
+			value=-1.*jacobian[i*5+j];
+			//if (doLeftSourceJac) value-=sourceJacLeft[j];
+			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+			if (bc==INTERNAL_FACE) { 
+				row=(grid[gid].myOffset+neighbor)*5+j; // on neighbor jth flux
+				value=jacobian[i*5+j]; 
+				MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+			}
+		} // for j
+
+		if (bc==INTERNAL_FACE) {
+			for (int j=0;j<5;++j) {
+				col=(grid[gid].myOffset+neighbor)*5+i; // Effect of neighbor ith var perturbation
+				row=(grid[gid].myOffset+neighbor)*5+j; // on neighbor jth flux
+				value=jacobian[25+i*5+j];
+				//if (doRightSourceJac) value-=sourceJacRight[j];
+				MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+				row=(grid[gid].myOffset+parent)*5+j; // on parent jth flux
+				value=-1.*jacobian[25+i*5+j];
+				MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+			}
+		} else if (bc==PARTITION_FACE) { 
+			// Ghost (only add effect on parent cell, effect on itself is taken care of in its own partition
+			for (int j=0;j<5;++j) {
+				row=(grid[gid].myOffset+parent)*5+j;
+				col=(grid[gid].cell[neighbor].matrix_id)*5+i;
+				value=-1.*jacobian[25+i*5+j];
+				MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+			}
+		} // if 
 		
-		for (int j=0;j<5;++j){
-			jacobianRight[j]=(fluxPlus.diffusive[j]-flux.diffusive[j]-fluxPlus.convective[j]+flux.convective[j])/epsilon;
-			if (doRightSourceJac) sourceJacRight[j]=(sourceRightPlus[j]-sourceRight[j])/epsilon;
-		}
-	
-	}
+	} // for i (each perturbed variable)
 	
-	face_state_adjust(left,right,face,var);
-	
-}
+	return;
+} // end insert_face_jacobians
 
 void NavierStokes::left_state_update(NS_Cell_State &left,NS_Face_State &face) {
 	
 	int parent=face.parent;
-	Vec3D cell2face=order_factor*grid[gid].face[face.index].centroid-grid[gid].cell[parent].centroid;
+	Vec3D cell2face=face.order_factor*grid[gid].face[face.index].centroid-grid[gid].cell[parent].centroid;
 	Vec3D deltaV;
 	left.p_center=p.cell(parent);
 	left.p=left.p_center+limiter[0].cell(parent)*cell2face.dot(gradp.cell(parent));
@@ -303,7 +190,7 @@ void NavierStokes::right_state_update(NS_Cell_State &left,NS_Cell_State &right,N
 		apply_bcs(left,right,face);
 	} else {
 		int neighbor=face.neighbor;
-		Vec3D cell2face=order_factor*grid[gid].face[face.index].centroid-grid[gid].cell[neighbor].centroid;
+		Vec3D cell2face=face.order_factor*grid[gid].face[face.index].centroid-grid[gid].cell[neighbor].centroid;
 		Vec3D deltaV;
 		right.p_center=p.cell(neighbor);
 		right.p=right.p_center+limiter[0].cell(neighbor)*cell2face.dot(gradp.cell(neighbor));
@@ -23,14 +23,13 @@
 #include "ns.h"
 
 double beta=0.125;
-double alpha;
 
 double Mach_split_2_plus (double Mach);
 double Mach_split_2_minus (double Mach);
 double Mach_split_4_plus (double Mach);
 double Mach_split_4_minus (double Mach);
-double p_split_5_plus (double Mach);
-double p_split_5_minus (double Mach);
+double p_split_5_plus (double Mach,double alpha);
+double p_split_5_minus (double Mach,double alpha);
 
 void AUSMplusUP_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Gamma,double Pref,double Minf,double &weightL) {
 
@@ -77,10 +76,10 @@ void AUSMplusUP_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[
 		mdot=a*M*right.rho;
 	}
 	
-	alpha=3./16.*(-4.+5.*fa*fa);
+	double alpha=3./16.*(-4.+5.*fa*fa);
 			
-	p=p_split_5_plus(ML)*(left.p+Pref)+p_split_5_minus(MR)*(right.p+Pref)
-	  -Ku*p_split_5_plus(ML)*p_split_5_minus(MR)*(left.rho+right.rho)*fa*a*(right.Vn[0]-left.Vn[0]);
+	p=p_split_5_plus(ML,alpha)*(left.p+Pref)+p_split_5_minus(MR,alpha)*(right.p+Pref)
+	  -Ku*p_split_5_plus(ML,alpha)*p_split_5_minus(MR,alpha)*(left.rho+right.rho)*fa*a*(right.Vn[0]-left.Vn[0]);
 	
 	p-=Pref;
 	
@@ -131,7 +130,7 @@ double Mach_split_4_minus (double M) {
 
 }
 
-double p_split_5_plus (double M) {
+double p_split_5_plus (double M,double alpha) {
 
 	if (fabs(M)>=1.) {
 		return 0.5*(M+fabs(M))/M;
@@ -141,7 +140,7 @@ double p_split_5_plus (double M) {
 
 }
 
-double p_split_5_minus (double M) {
+double p_split_5_minus (double M,double alpha) {
 
 	if (fabs(M)>=1.) {
 		return 0.5*(M-fabs(M))/M;
@@ -151,3 +150,7 @@ double p_split_5_minus (double M) {
 	
 }
 
+
+#include "ns_face_kernel.h"
+// Face loop kernels with this flux function inlined
+NS_FACE_KERNELS(AUSM_PLUS_UP)
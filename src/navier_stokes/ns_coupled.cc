@@ -0,0 +1,251 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "ns.h"
+#include "rans.h"
+#include "memory_usage.h"
+
+extern vector<RANS> rans;
+
+#define GMRES_RESTART 300
+#define COUPLED_VARS 7
+
+// Strongly coupled Navier-Stokes+RANS solve
+// The flow (p,u,v,w,T) and turbulence (k,omega) operators are assembled as usual into their own
+// matrices and merged row by row into one system with 7 variables per cell. The cross terms
+// between the two sets are added on top:
+//	flow rows: momentum and energy diffusive fluxes through mu_t=rho*k/omega
+//	turbulence rows: convective k and omega fluxes through the mass flux (velocity)
+// The production terms depend on the velocity gradients, their cross terms are left out.
+// A single Krylov solve gives both updates, and a single ghost exchange
+// (mpi_update_ghost_primitives) distributes them.
+
+void NavierStokes::coupled_init(void) {
+	
+	if (linear_solver!=KRYLOV) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> turbulence -> coupling=coupled requires navierstokes -> linear solver=krylov" << endl;
+		exit(1);
+	}
+	
+	coupled=true;
+	viscousJacobian.assign(grid[gid].faceCount*4,0.);
+	
+	VecCreateMPI(grid[gid].comm,grid[gid].cellCount*COUPLED_VARS,grid[gid].globalCellCount*COUPLED_VARS,&coupledRhs);
+	VecSetFromOptions(coupledRhs);
+	VecDuplicate(coupledRhs,&coupledDelta);
+	VecSet(coupledDelta,0.);
+	
+	vector<int> diagonal_nonzeros, off_diagonal_nonzeros;
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		int nextCellCount=0;
+		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
+			if (grid[gid].face[grid[gid].cell[c].faces[cf]].bc==INTERNAL_FACE) nextCellCount++;
+		}
+		int cellGhostCount=0;
+		for (int cc=0;cc<grid[gid].cell[c].neighborCells.size();++cc) if (grid[gid].cell[grid[gid].cell[c].neighborCells[cc]].partition!=Rank) cellGhostCount++;
+		for (int i=0;i<COUPLED_VARS;++i) {
+			diagonal_nonzeros.push_back((nextCellCount+1)*COUPLED_VARS);
+			off_diagonal_nonzeros.push_back(cellGhostCount*COUPLED_VARS);
+		}
+	}
+	
+	MatCreateMPIAIJ(
+			grid[gid].comm,
+			grid[gid].cellCount*COUPLED_VARS,
+			grid[gid].cellCount*COUPLED_VARS,
+			grid[gid].globalCellCount*COUPLED_VARS,
+			grid[gid].globalCellCount*COUPLED_VARS,
+			0,&diagonal_nonzeros[0],
+			0,&off_diagonal_nonzeros[0],
+			&coupledOP);
+	
+	KSPCreate(grid[gid].comm,&coupledKsp);
+	KSPSetOperators(coupledKsp,coupledOP,coupledOP,SAME_NONZERO_PATTERN);
+	KSPSetTolerances(coupledKsp,rtol,abstol,1.e15,maxits);
+	KSPSetInitialGuessKnoll(coupledKsp,PETSC_TRUE);
+	KSPSetType(coupledKsp,KSPFGMRES);
+	KSPGMRESSetRestart(coupledKsp,GMRES_RESTART);
+	KSPSetOptionsPrefix(coupledKsp,"coupled_");
+	KSPSetFromOptions(coupledKsp);
+	
+	if (memory_usage.enabled) {
+		string prefix="grid "+int2str(gid+1)+"/coupled/";
+		double rows=grid[gid].cellCount*COUPLED_VARS;
+		memory_usage.account(prefix+"petsc vectors",2.*rows*sizeof(PetscScalar));
+		memory_usage.account(prefix+"work arrays",container_bytes(viscousJacobian));
+		double size=0.;
+		for (int r=0;r<diagonal_nonzeros.size();++r) size+=diagonal_nonzeros[r]+off_diagonal_nonzeros[r];
+		size=size*(sizeof(PetscScalar)+sizeof(PetscInt))+2.*rows*sizeof(PetscInt);
+		memory_usage.account(prefix+"matrix",size);
+		memory_usage.account(prefix+"krylov workspace",(2.*GMRES_RESTART+4.)*rows*sizeof(PetscScalar),true);
+		memory_usage.account(prefix+"preconditioner",size,true);
+	}
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] Navier-Stokes and RANS equations are solved coupled" << endl;
+	
+	return;
+}
+
+void NavierStokes::coupled_solve(void) {
+	
+	RANS &turb=rans[gid];
+	
+	MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
+	MatAssemblyEnd(impOP,MAT_FINAL_ASSEMBLY);
+	MatAssemblyBegin(turb.impOP,MAT_FINAL_ASSEMBLY);
+	MatAssemblyEnd(turb.impOP,MAT_FINAL_ASSEMBLY);
+	VecAssemblyBegin(rhs);
+	VecAssemblyEnd(rhs);
+	VecAssemblyBegin(turb.rhs);
+	VecAssemblyEnd(turb.rhs);
+	
+	MatZeroEntries(coupledOP);
+	
+	// Merge the local rows, each cell's columns are renumbered from 5 (2) to 7 variables
+	int ncols;
+	const PetscInt *cols;
+	const PetscScalar *values;
+	vector<PetscInt> newCols;
+	PetscInt row;
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<5;++i) {
+			PetscInt oldRow=(grid[gid].myOffset+c)*5+i;
+			MatGetRow(impOP,oldRow,&ncols,&cols,&values);
+			newCols.resize(ncols);
+			for (int j=0;j<ncols;++j) newCols[j]=(cols[j]/5)*COUPLED_VARS+cols[j]%5;
+			row=(grid[gid].myOffset+c)*COUPLED_VARS+i;
+			if (ncols>0) MatSetValues(coupledOP,1,&row,ncols,&newCols[0],values,ADD_VALUES);
+			MatRestoreRow(impOP,oldRow,&ncols,&cols,&values);
+		}
+		for (int i=0;i<2;++i) {
+			PetscInt oldRow=(grid[gid].myOffset+c)*2+i;
+			MatGetRow(turb.impOP,oldRow,&ncols,&cols,&values);
+			newCols.resize(ncols);
+			for (int j=0;j<ncols;++j) newCols[j]=(cols[j]/2)*COUPLED_VARS+5+cols[j]%2;
+			row=(grid[gid].myOffset+c)*COUPLED_VARS+5+i;
+			if (ncols>0) MatSetValues(coupledOP,1,&row,ncols,&newCols[0],values,ADD_VALUES);
+			MatRestoreRow(turb.impOP,oldRow,&ncols,&cols,&values);
+		}
+	}
+	
+	coupled_cross_jacobians();
+	
+	MatAssemblyBegin(coupledOP,MAT_FINAL_ASSEMBLY);
+	MatAssemblyEnd(coupledOP,MAT_FINAL_ASSEMBLY);
+	
+	// Interleave the right hand sides
+	PetscScalar *flowRhs,*turbRhs,*coupled;
+	VecGetArray(rhs,&flowRhs);
+	VecGetArray(turb.rhs,&turbRhs);
+	VecGetArray(coupledRhs,&coupled);
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<5;++i) coupled[c*COUPLED_VARS+i]=flowRhs[c*5+i];
+		for (int i=0;i<2;++i) coupled[c*COUPLED_VARS+5+i]=turbRhs[c*2+i];
+	}
+	VecRestoreArray(coupledRhs,&coupled);
+	VecRestoreArray(turb.rhs,&turbRhs);
+	VecRestoreArray(rhs,&flowRhs);
+	
+	KSPSetOperators(coupledKsp,coupledOP,coupledOP,SAME_NONZERO_PATTERN);
+	KSPSolve(coupledKsp,coupledRhs,coupledDelta);
+	
+	KSPGetIterationNumber(coupledKsp,&nIter);
+	KSPGetResidualNorm(coupledKsp,&rNorm);
+	turb.nIter=nIter;
+	turb.rNorm=rNorm;
+	
+	PetscScalar *delta;
+	VecGetArray(coupledDelta,&delta);
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<5;++i) update[i].cell(c)=delta[c*COUPLED_VARS+i];
+		for (int i=0;i<2;++i) turb.update[i].cell(c)=delta[c*COUPLED_VARS+5+i];
+	}
+	VecRestoreArray(coupledDelta,&delta);
+	
+	VecSet(rhs,0.);
+	VecSet(turb.rhs,0.);
+	
+	return;
+}
+
+// Cross Jacobians between the flow and turbulence variables (see the top of the file)
+// The operator rows are -d(rhs)/d(variable) as in the segregated systems
+// Boundary faces are left out, their face values depend on the boundary conditions.
+void NavierStokes::coupled_cross_jacobians(void) {
+	
+	RANS &turb=rans[gid];
+	PetscInt rows[4],cols[3];
+	PetscScalar block[12];
+	int side[2];
+	PetscInt sideId[2];
+	
+	for (int f=0;f<grid[gid].interiorFaceCount;++f) {
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		bool internal=(grid[gid].face[f].bc==INTERNAL_FACE);
+		side[0]=parent; side[1]=neighbor;
+		sideId[0]=grid[gid].myOffset+parent;
+		sideId[1]=(internal) ? grid[gid].myOffset+neighbor : grid[gid].cell[neighbor].matrix_id;
+		
+		// Flow rows: d(diffusive flux)/d(k,omega)=dF/dmu_t*dmu_t_face/d(k,omega)
+		// mu_t_face is taken as the average of the two cells, mu_t=rho*k/omega in each
+		for (int s=0;s<2;++s) {
+			int c=side[s];
+			double dmudk=0.5*turb.mu_t.cell(c)/max(turb.k.cell(c),turb.kLowLimit);
+			double dmudomega=-0.5*turb.mu_t.cell(c)/max(turb.omega.cell(c),turb.omegaLowLimit);
+			for (int i=0;i<4;++i) {
+				block[i*2]=-viscousJacobian[f*4+i]*dmudk;
+				block[i*2+1]=-viscousJacobian[f*4+i]*dmudomega;
+			}
+			cols[0]=sideId[s]*COUPLED_VARS+5; cols[1]=cols[0]+1;
+			for (int i=0;i<4;++i) rows[i]=(grid[gid].myOffset+parent)*COUPLED_VARS+1+i;
+			MatSetValues(coupledOP,4,rows,2,cols,block,ADD_VALUES);
+			if (internal) {
+				for (int i=0;i<8;++i) block[i]*=-1.;
+				for (int i=0;i<4;++i) rows[i]=(grid[gid].myOffset+neighbor)*COUPLED_VARS+1+i;
+				MatSetValues(coupledOP,4,rows,2,cols,block,ADD_VALUES);
+			}
+		}
+		
+		// Turbulence rows: d(convective flux)/d(u,v,w)=d(mdot)/dV*(upwinded k,omega)*area
+		// with d(mdot)/dV taken as half of rho_face*normal from each side
+		double wL=weightL.face(f);
+		double scalar[2];
+		scalar[0]=wL*turb.k.cell(parent)+(1.-wL)*turb.k.cell(neighbor);
+		scalar[1]=wL*turb.omega.cell(parent)+(1.-wL)*turb.omega.cell(neighbor);
+		double factor=0.5*face_store.rho_face(f)*grid[gid].face[f].area;
+		for (int i=0;i<2;++i) for (int j=0;j<3;++j) block[i*3+j]=factor*scalar[i]*grid[gid].face[f].normal[j];
+		for (int s=0;s<2;++s) {
+			for (int j=0;j<3;++j) cols[j]=sideId[s]*COUPLED_VARS+1+j;
+			rows[0]=(grid[gid].myOffset+parent)*COUPLED_VARS+5; rows[1]=rows[0]+1;
+			MatSetValues(coupledOP,2,rows,3,cols,block,ADD_VALUES);
+			if (internal) {
+				for (int i=0;i<6;++i) block[i]*=-1.;
+				rows[0]=(grid[gid].myOffset+neighbor)*COUPLED_VARS+5; rows[1]=rows[0]+1;
+				MatSetValues(coupledOP,2,rows,3,cols,block,ADD_VALUES);
+				for (int i=0;i<6;++i) block[i]*=-1.;
+			}
+		}
+	}
+	
+	return;
+}
@@ -60,6 +60,14 @@ void NavierStokes::diffusive_face_flux(NS_Cell_State &left,NS_Cell_State &right,
 	}
 	flux[4]+=qq;
 	
+	if (turbulent[gid]) {
+		face.dFdmu_t[0]=tau_x.dot(areaVec);
+		face.dFdmu_t[1]=tau_y.dot(areaVec);
+		face.dFdmu_t[2]=tau_z.dot(areaVec);
+		face.dFdmu_t[3]=tau_x.dot(face.V)*areaVec[0]+tau_y.dot(face.V)*areaVec[1]+tau_z.dot(face.V)*areaVec[2];
+		if (face.bc<0 || bc[gid][face.bc].thermalType!=FIXED_Q) face.dFdmu_t[3]+=material.Cp(face.T)/rans[gid].Pr_t*face.gradT.dot(areaVec);
+	}
+	
 	return;
 }
 
@@ -0,0 +1,64 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "ns.h"
+
+// Only the declarations are visible here, the kernels are instantiated next to the flux functions
+#define FACE_KERNEL(FLUX,ORDER,LIMITED) {&NavierStokes::assemble_face<FLUX,ORDER,LIMITED,INTERIOR>, \
+	&NavierStokes::assemble_face<FLUX,ORDER,LIMITED,SYMMETRY>,&NavierStokes::assemble_face<FLUX,ORDER,LIMITED,WALL>, \
+	&NavierStokes::assemble_face<FLUX,ORDER,LIMITED,INLET>,&NavierStokes::assemble_face<FLUX,ORDER,LIMITED,OUTLET>, \
+	&NavierStokes::assemble_face<FLUX,ORDER,LIMITED,ANY_BC>}
+
+void NavierStokes::select_face_kernel(void) {
+
+	// With first order the limiters are zero, the limiter choice doesn't matter
+	// Without a limiter, they stay at one and the multiplication is skipped
+	bool limited=(limiter_function!=NONE);
+	int flux=convective_flux_function;
+	
+	// Interior kernel and boundary kernels of each bc type
+	Face_Kernel kernels[5][3][ANY_BC+1]={
+		{FACE_KERNEL(ROE,FIRST,false),FACE_KERNEL(ROE,SECOND,false),FACE_KERNEL(ROE,SECOND,true)},
+		{FACE_KERNEL(VAN_LEER,FIRST,false),FACE_KERNEL(VAN_LEER,SECOND,false),FACE_KERNEL(VAN_LEER,SECOND,true)},
+		{FACE_KERNEL(AUSM_PLUS_UP,FIRST,false),FACE_KERNEL(AUSM_PLUS_UP,SECOND,false),FACE_KERNEL(AUSM_PLUS_UP,SECOND,true)},
+		{FACE_KERNEL(SD_SLAU,FIRST,false),FACE_KERNEL(SD_SLAU,SECOND,false),FACE_KERNEL(SD_SLAU,SECOND,true)},
+		{FACE_KERNEL(SW,FIRST,false),FACE_KERNEL(SW,SECOND,false),FACE_KERNEL(SW,SECOND,true)}
+	};
+	
+	Face_Kernel generic[ANY_BC+1]=FACE_KERNEL(GENERIC,GENERIC,true);
+	Face_Kernel *selected;
+	if (flux<ROE || flux>SW) {
+		selected=generic;
+	} else if (order==FIRST) {
+		selected=kernels[flux-ROE][0];
+	} else if (!limited) {
+		selected=kernels[flux-ROE][1];
+	} else {
+		selected=kernels[flux-ROE][2];
+	}
+	for (int i=0;i<=ANY_BC;++i) {
+		face_kernel[i]=selected[i];
+		reference_kernel[i]=generic[i];
+	}
+	
+	return;
+} // end select_face_kernel
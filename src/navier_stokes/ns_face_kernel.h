@@ -0,0 +1,357 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef NS_FACE_KERNEL_H
+#define NS_FACE_KERNEL_H
+
+// Face loop kernels of the Navier-Stokes assembly, templated on the options that don't
+// change during a run. Each flux function source file includes this after the flux
+// definition and instantiates its own kernels so the whole flux path can be inlined.
+// The GENERIC instantiation keeps the run time dispatch and is used as the reference.
+// Interior and boundary faces are colored apart (Grid::color_faces) and the boundary
+// colors are sorted by bc type (set_bcs). BOUNDARY is INTERIOR for the interior kernel,
+// which carries no boundary branches, or the bc type of the faces a boundary kernel handles.
+
+#include "ns.h"
+
+extern void roe_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Gamma,double &weightL);
+extern void vanLeer_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Gamma,double Pref,double &weightL);
+extern void AUSMplusUP_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Gamma,double Pref,double Minf,double &weightL);
+extern void SD_SLAU_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],double Pref,double &weightL);
+extern void Stegger_Warming_flux(NS_Cell_State &left,NS_Cell_State &right,double diss_factor,double closest_wall_distance,double wdiss,double bl_height,MATERIAL &material,double fluxNormal[],double &weightL);
+
+template <int FLUX>
+inline void NavierStokes::convective_flux_kernel(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face,double flux[]) {
+
+	if (FLUX==GENERIC) {
+		convective_face_flux(left,right,face,flux);
+		return;
+	}
+
+	double fluxNormal[5];
+
+	if (FLUX==ROE) {
+		roe_flux(left,right,fluxNormal,material.gamma,weightL.face(face.index));
+	} else if (FLUX==VAN_LEER) {
+		vanLeer_flux(left,right,fluxNormal,material.gamma,material.Pref,weightL.face(face.index));
+	} else if (FLUX==AUSM_PLUS_UP) {
+		AUSMplusUP_flux(left,right,fluxNormal,material.gamma,material.Pref,Minf,weightL.face(face.index));
+	} else if (FLUX==SD_SLAU) {
+		SD_SLAU_flux(left,right,fluxNormal,material.Pref,weightL.face(face.index));
+	} else if (FLUX==SW) {
+		Stegger_Warming_flux(left,right,
+					grid[gid].face[face.index].dissipation_factor,
+					grid[gid].face[face.index].closest_wall_distance,
+					wdiss,bl_height,
+					material,fluxNormal,weightL.face(face.index));
+	}
+	
+	flux[0] = fluxNormal[0]*face.area;
+	flux[1] = (fluxNormal[1]*face.normal[0]+fluxNormal[2]*face.tangent1[0]+fluxNormal[3]*face.tangent2[0])*face.area;
+	flux[2] = (fluxNormal[1]*face.normal[1]+fluxNormal[2]*face.tangent1[1]+fluxNormal[3]*face.tangent2[1])*face.area;
+	flux[3] = (fluxNormal[1]*face.normal[2]+fluxNormal[2]*face.tangent1[2]+fluxNormal[3]*face.tangent2[2])*face.area;
+	flux[4] = fluxNormal[4]*face.area;
+
+	return;
+} // end convective_flux_kernel
+
+// Reconstruct the face value of cell c. First order takes the cell values as is
+// (the limiters are zero then) and unlimited second order skips the limiter multiply.
+template <int ORDER,bool LIMITED>
+inline void NavierStokes::reconstruct_kernel(NS_Cell_State &state,NS_Face_State &face,int c) {
+
+	state.p_center=p.cell(c);
+	state.V_center=V.cell(c);
+	state.T_center=T.cell(c);
+	
+	if (ORDER==FIRST) {
+		state.p=state.p_center;
+		state.V=state.V_center;
+		state.T=state.T_center;
+	} else {
+		Vec3D cell2face=grid[gid].face[face.index].centroid-grid[gid].cell[c].centroid;
+		double phi[5];
+		for (int i=0;i<5;++i) phi[i]=(LIMITED) ? limiter[i].cell(c) : 1.;
+		state.p=state.p_center+phi[0]*cell2face.dot(gradp.cell(c));
+		state.V[0]=state.V_center[0]+phi[1]*cell2face.dot(gradu.cell(c));
+		state.V[1]=state.V_center[1]+phi[2]*cell2face.dot(gradv.cell(c));
+		state.V[2]=state.V_center[2]+phi[3]*cell2face.dot(gradw.cell(c));
+		state.T=state.T_center+phi[4]*cell2face.dot(gradT.cell(c));
+	}
+	state.rho=material.rho(state.p,state.T);
+	state.volume=grid[gid].cell[c].volume;
+	for (int i=0;i<5;++i) state.update[i]=update[i].cell(c);
+	
+	return;
+} // end reconstruct_kernel
+
+template <int ORDER,bool LIMITED>
+inline void NavierStokes::left_state_kernel(NS_Cell_State &left,NS_Face_State &face) {
+	
+	if (ORDER==GENERIC) {
+		left_state_update(left,face);
+		return;
+	}
+	
+	reconstruct_kernel<ORDER,LIMITED>(left,face,face.parent);
+	left.a=material.a(left.p,left.T);
+	left.H=left.a*left.a/(material.gamma-1.)+0.5*left.V.dot(left.V);
+	left.Vn[0]=left.V.dot(face.normal);
+	left.Vn[1]=left.V.dot(face.tangent1);
+	left.Vn[2]=left.V.dot(face.tangent2);
+	
+	return;
+} // end left_state_kernel
+
+// Ghost state of a boundary face with the bc type known at compile time
+// Only the inlet kind and the wall slip flag are left to run time
+template <int BC>
+inline void NavierStokes::boundary_state_kernel(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face) {
+	
+	for (int i=0;i<5;++i) right.update[i]=0.;
+	right.p_center=p.cell(face.neighbor);
+	right.T_center=T.cell(face.neighbor);
+	right.V_center=V.cell(face.neighbor);
+	
+	if (BC==INLET) {
+		int kind=bc[gid][face.bc].kind;
+		if (kind==VELOCITY) velocity_inlet(left,right,face);
+		else if (kind==MDOT) mdot_inlet(left,right,face);
+		else if (kind==STAGNATION) stagnation_inlet(left,right,face);
+	} else if (BC==OUTLET) {
+		outlet(left,right,face);
+	} else if (BC==WALL) {
+		wall(left,right,face,bc[gid][face.bc].kind==SLIP);
+	} else if (BC==SYMMETRY) {
+		symmetry(left,right,face);
+	}
+	
+	return;
+} // end boundary_state_kernel
+
+template <int ORDER,bool LIMITED,int BOUNDARY>
+inline void NavierStokes::right_state_kernel(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face) {
+
+	if (ORDER==GENERIC || BOUNDARY==ANY_BC) {
+		right_state_update(left,right,face);
+		return;
+	}
+	
+	if (BOUNDARY) boundary_state_kernel<BOUNDARY>(left,right,face);
+	else reconstruct_kernel<ORDER,LIMITED>(right,face,face.neighbor);
+	right.a=material.a(right.p,right.T);
+	right.H=right.a*right.a/(material.gamma-1.)+0.5*right.V.dot(right.V);
+	right.Vn[0]=right.V.dot(face.normal);
+	right.Vn[1]=right.V.dot(face.tangent1);
+	right.Vn[2]=right.V.dot(face.tangent2);
+		
+	return;
+} // end right_state_kernel
+
+template <int FLUX,int ORDER,bool LIMITED,int BOUNDARY>
+void NavierStokes::assemble_face(NS_Assembly_Cache &cache,int f,vector<char> &cellVisited,double jacobian[]) {
+
+	NS_Cell_State &left=cache.left;
+	NS_Cell_State &right=cache.right;
+	NS_Face_State &face=cache.face;
+	NS_Fluxes &flux=cache.flux;
+	
+	int parent,neighbor;
+		
+	face.order_factor=1.; // This is used to kill gradients during Jacobian calculation if first order option is selected
+		
+	cache.doLeftSourceJac=false; cache.doRightSourceJac=false;
+	for (int m=0;m<5;++m) { 
+		cache.sourceLeft[m]=0.;
+		cache.sourceRight[m]=0.;
+	}
+	parent=grid[gid].face[f].parent; neighbor=grid[gid].face[f].neighbor;
+
+	// Populate the state caches
+	face_geom_update(face,f);
+	left_state_kernel<ORDER,LIMITED>(left,face);
+	right_state_kernel<ORDER,LIMITED,BOUNDARY>(left,right,face);
+	face_state_update(left,right,face);
+	face_store.store(f,left,right,face);
+	// Get unperturbed flux values
+	convective_flux_kernel<FLUX>(left,right,face,&flux.convective[0]);
+	diffusive_face_flux(left,right,face,&flux.diffusive[0]);
+	if (coupled && jacobian!=NULL) for (int i=0;i<4;++i) viscousJacobian[f*4+i]=face.dFdmu_t[i];
+	
+	// Add Sources
+	if (!cellVisited[parent]){
+		sources(left,&cache.sourceLeft[0]);
+		cellVisited[parent]=1;
+		cache.doLeftSourceJac=true;
+	}
+
+	if (!BOUNDARY && face.bc==INTERNAL_FACE && !cellVisited[neighbor]) {
+		sources(right,&cache.sourceRight[0]);
+		cellVisited[neighbor]=1;
+		cache.doRightSourceJac=true;
+	}
+
+	// Integrate boundary loads
+	if (BOUNDARY && (timeStep) % loads[gid].frequency == 0) {
+		Vec3D temp;
+		for (int b=0;b<loads[gid].include_bcs.size();++b) {
+			if (face.bc==loads[gid].include_bcs[b]) {
+				for (int i=0;i<3;++i) temp[i]=flux.convective[i+1]-flux.diffusive[i+1];
+				cache.force[b]+=temp;
+				cache.moment[b]+=(grid[gid].face[face.index].centroid-loads[gid].moment_center).cross(temp);
+				break;
+			}
+		}
+	}
+
+	// Fill in surface information
+
+	mdot.face(face.index)=(flux.convective[0]-flux.diffusive[0])/face.area;	
+	if (BOUNDARY) {
+		//if (!mdot.fixedonBC[face.bc]) mdot.bc(face.bc,face.index)=(flux.convective[0]-flux.diffusive[0])/face.area;
+		if (!qdot.fixedonBC[face.bc]) qdot.bc(face.bc,face.index)=(flux.convective[4]-flux.diffusive[4])/face.area;
+		for (int i=0;i<3;++i) tau.bc(face.bc,face.index)[i]=-flux.diffusive[i+1]/face.area;
+	}
+	
+	// Fill in local rhs rows
+	for (int i=0;i<5;++i) {
+		rhsLocal[parent*5+i]+=flux.diffusive[i]-flux.convective[i]+cache.sourceLeft[i];
+		if (!BOUNDARY && face.bc==INTERNAL_FACE) { 
+			rhsLocal[neighbor*5+i]+=-1.*(flux.diffusive[i]-flux.convective[i])+cache.sourceRight[i];
+		}
+	}
+	
+	// LU-SGS uses its own approximate Jacobians, skip the finite difference ones
+	if (jacobian==NULL) return;
+	
+	for (int i=0;i<5;++i) { // perturb each variable
+		
+		for (int m=0;m<5;++m) { 
+			cache.sourceJacLeft[m]=0.;
+			cache.sourceJacRight[m]=0.;
+		}
+		
+		get_jacobians<FLUX,ORDER,LIMITED,BOUNDARY>(cache,i);
+		
+		// Store the effect of the ith var perturbation on each flux
+		for (int j=0;j<5;++j) {
+			jacobian[i*5+j]=cache.jacobianLeft[j];
+			jacobian[25+i*5+j]=cache.jacobianRight[j];
+		}
+	}
+	
+	return;
+} // end assemble_face
+
+template <int FLUX,int ORDER,bool LIMITED,int BOUNDARY>
+void NavierStokes::get_jacobians(NS_Assembly_Cache &cache,const int var) {
+
+	NS_Cell_State &left=cache.left;
+	NS_Cell_State &right=cache.right;
+	NS_Cell_State &leftPlus=cache.leftPlus;
+	NS_Cell_State &rightPlus=cache.rightPlus;
+	NS_Face_State &face=cache.face;
+	NS_Fluxes &flux=cache.flux;
+	NS_Fluxes &fluxPlus=cache.fluxPlus;
+	double epsilon;
+	double factor=0.001;
+	
+	if (jac_order==FIRST) face.order_factor=0.;
+	
+	leftPlus=left;
+	rightPlus=right;
+	
+	for (int m=0;m<5;++m) {
+		cache.sourceLeftPlus[m]=cache.sourceLeft[m];
+		cache.sourceRightPlus[m]=cache.sourceRight[m];
+		cache.sourceJacLeft[m]=0.;
+		cache.sourceJacRight[m]=0.;
+	}
+	
+	if (left.update[var]>small_number) {epsilon=max(small_number,factor*left.update[var]);}
+	else if (left.update[var]<-small_number) {epsilon=min(-small_number,factor*left.update[var]); }
+	else {epsilon=small_number;}
+	
+	// Perturb left state
+	state_perturb(leftPlus,face,var,epsilon);
+	// If right state is a boundary, correct the condition according to changes in left state
+	if (BOUNDARY) right_state_kernel<ORDER,LIMITED,BOUNDARY>(leftPlus,rightPlus,face);
+
+	convective_flux_kernel<FLUX>(leftPlus,rightPlus,face,&fluxPlus.convective[0]);
+	
+	face_state_adjust(leftPlus,rightPlus,face,var);
+	diffusive_face_flux(leftPlus,rightPlus,face,&fluxPlus.diffusive[0]);
+	
+	if (cache.doLeftSourceJac) {
+		sources(left,&cache.sourceLeft[0],true);
+		sources(leftPlus,&cache.sourceLeftPlus[0],true);
+	}
+	
+	for (int j=0;j<5;++j){
+		cache.jacobianLeft[j]=(fluxPlus.diffusive[j]-flux.diffusive[j]-fluxPlus.convective[j]+flux.convective[j])/epsilon;
+		if (cache.doLeftSourceJac) cache.sourceJacLeft[j]=(cache.sourceLeftPlus[j]-cache.sourceLeft[j])/epsilon;
+	}
+	
+	if (!BOUNDARY) { 
+		
+		if (right.update[var]>small_number) {epsilon=max(small_number,factor*right.update[var]);}
+		else if (right.update[var]<-small_number) {epsilon=min(-small_number,factor*right.update[var]); }
+		else {epsilon=small_number;}
+				
+		state_perturb(rightPlus,face,var,epsilon);
+		
+		convective_flux_kernel<FLUX>(left,rightPlus,face,&fluxPlus.convective[0]);
+		face_state_adjust(left,rightPlus,face,var);
+		diffusive_face_flux(left,rightPlus,face,&fluxPlus.diffusive[0]);
+		
+		if (cache.doRightSourceJac) {
+			sources(right,&cache.sourceRight[0],true);
+			sources(rightPlus,&cache.sourceRightPlus[0],true);
+		}
+		
+		for (int j=0;j<5;++j){
+			cache.jacobianRight[j]=(fluxPlus.diffusive[j]-flux.diffusive[j]-fluxPlus.convective[j]+flux.convective[j])/epsilon;
+			if (cache.doRightSourceJac) cache.sourceJacRight[j]=(cache.sourceRightPlus[j]-cache.sourceRight[j])/epsilon;
+		}
+	
+	}
+	
+	face_state_adjust(left,right,face,var);
+	
+} // end get_jacobians
+
+// Kernels instantiated by each flux function source file
+#define NS_FACE_KERNEL(FLUX,ORDER,LIMITED,BOUNDARY) \
+template void NavierStokes::assemble_face<FLUX,ORDER,LIMITED,BOUNDARY>(NS_Assembly_Cache&,int,vector<char>&,double[]);
+#define NS_FACE_KERNEL_SET(FLUX,ORDER,LIMITED) \
+NS_FACE_KERNEL(FLUX,ORDER,LIMITED,INTERIOR) \
+NS_FACE_KERNEL(FLUX,ORDER,LIMITED,SYMMETRY) \
+NS_FACE_KERNEL(FLUX,ORDER,LIMITED,WALL) \
+NS_FACE_KERNEL(FLUX,ORDER,LIMITED,INLET) \
+NS_FACE_KERNEL(FLUX,ORDER,LIMITED,OUTLET) \
+NS_FACE_KERNEL(FLUX,ORDER,LIMITED,ANY_BC)
+#define NS_FACE_KERNELS(FLUX) \
+NS_FACE_KERNEL_SET(FLUX,FIRST,false) \
+NS_FACE_KERNEL_SET(FLUX,SECOND,false) \
+NS_FACE_KERNEL_SET(FLUX,SECOND,true)
+
+#endif
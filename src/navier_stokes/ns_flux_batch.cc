@@ -0,0 +1,252 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "ns.h"
+#include "ns_flux_batch.h"
+
+#define W FLUX_BATCH_WIDTH
+
+extern void Stegger_Warming_flux(NS_Cell_State &left,NS_Cell_State &right,double diss_factor,double closest_wall_distance,double wdiss,double bl_height,MATERIAL &material,double fluxNormal[],double &weightL);
+
+void load_state_batch(NS_State_Batch &batch,int l,NS_Cell_State &state) {
+	batch.rho[l]=state.rho;
+	batch.p[l]=state.p;
+	batch.T[l]=state.T;
+	batch.a[l]=state.a;
+	batch.H[l]=state.H;
+	for (int i=0;i<3;++i) batch.Vn[i][l]=state.Vn[i];
+	return;
+}
+
+void roe_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,NS_Flux_Batch &flux,double Gamma) {
+
+	#pragma omp simd
+	for (int l=0;l<W;++l) {
+		// The Roe averaged values
+		double rho=sqrt(right.rho[l]/left.rho[l]);
+		double u=(left.Vn[0][l]+rho*right.Vn[0][l])/(1.+rho);
+		double v=(left.Vn[1][l]+rho*right.Vn[1][l])/(1.+rho);
+		double w=(left.Vn[2][l]+rho*right.Vn[2][l])/(1.+rho);
+		double H=(left.H[l]+rho*right.H[l])/(1.+rho);
+		double a=sqrt((Gamma-1.)*(H-0.5*(u*u+v*v+w*w)));
+		rho*=left.rho[l];
+		
+		double Du=right.Vn[0][l]-left.Vn[0][l];
+		double Dp=right.p[l]-left.p[l];
+		
+		// s=1: calculate from the left side, s=-1: from the right side
+		bool fromLeft=(u>=0.);
+		double s=fromLeft ? 1. : -1.;
+		
+		double deltaV=0.5*(Dp-s*rho*a*Du)/(a*a);
+		
+		// Entropy fix (written for the left running wave, mirrored for the right one)
+		double Dlambda=2.*(min(a,max(0.,2.*(s*(left.a[l]-right.a[l])+Du))));
+		double lambda=s*u-a;
+		double fixed=-0.5*(lambda-0.5*Dlambda)*(lambda-0.5*Dlambda)/Dlambda;
+		lambda=(lambda<=(-0.5*Dlambda)) ? lambda : ((lambda<(0.5*Dlambda)) ? fixed : 0.);
+		lambda*=s;
+		
+		double Vn0=fromLeft ? left.Vn[0][l] : right.Vn[0][l];
+		double Vn1=fromLeft ? left.Vn[1][l] : right.Vn[1][l];
+		double Vn2=fromLeft ? left.Vn[2][l] : right.Vn[2][l];
+		double p=fromLeft ? left.p[l] : right.p[l];
+		double Hs=fromLeft ? left.H[l] : right.H[l];
+		double rhos=fromLeft ? left.rho[l] : right.rho[l];
+		
+		double mdot=rhos*Vn0;
+		double product=s*lambda*deltaV;
+		
+		flux.f[0][l]=mdot+product;
+		flux.f[1][l]=mdot*Vn0+p+product*(u-s*a);
+		flux.f[2][l]=mdot*Vn1+product*v;
+		flux.f[3][l]=mdot*Vn2+product*w;
+		flux.f[4][l]=mdot*Hs+product*(H-s*u*a);
+		flux.weightL[l]=0.5;
+	}
+	
+	return;
+} // end roe_flux_batch
+
+void vanLeer_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,NS_Flux_Batch &flux,double Gamma,double Pref) {
+
+	double c=0.5*Gamma*Gamma/(Gamma*Gamma-1.);
+	
+	#pragma omp simd
+	for (int l=0;l<W;++l) {
+		double ML=left.Vn[0][l]/left.a[l];
+		double MR=right.Vn[0][l]/right.a[l];
+		double M=0.5*(ML+MR);
+		
+		// Split fluxes
+		double fplus=0.25*left.rho[l]*left.a[l]*(ML+1.)*(ML+1.);
+		double fminus=-0.25*right.rho[l]*right.a[l]*(1.-MR)*(1.-MR);
+		double termL=(2.*left.a[l]/Gamma)*(0.5*(Gamma-1)*ML+1.);
+		double termR=(2.*right.a[l]/Gamma)*(0.5*(Gamma-1)*MR-1.);
+		double split[5];
+		split[0]=fplus+fminus;
+		split[1]=fplus*termL+fminus*termR-Pref;
+		split[2]=fplus*left.Vn[1][l]+fminus*right.Vn[1][l];
+		split[3]=fplus*left.Vn[2][l]+fminus*right.Vn[2][l];
+		termL=c*termL*termL+0.5*(left.Vn[1][l]*left.Vn[1][l]+left.Vn[2][l]*left.Vn[2][l]);
+		termR=c*termR*termR+0.5*(right.Vn[1][l]*right.Vn[1][l]+right.Vn[2][l]*right.Vn[2][l]);
+		split[4]=fplus*termL+fminus*termR;
+		
+		// Fully upwinded fluxes
+		bool fromLeft=(M>=1.);
+		double Vn0=fromLeft ? left.Vn[0][l] : right.Vn[0][l];
+		double mdot=fromLeft ? left.rho[l]*Vn0 : right.rho[l]*Vn0;
+		double upwind[5];
+		upwind[0]=mdot;
+		upwind[1]=mdot*Vn0+(fromLeft ? left.p[l] : right.p[l]);
+		upwind[2]=mdot*(fromLeft ? left.Vn[1][l] : right.Vn[1][l]);
+		upwind[3]=mdot*(fromLeft ? left.Vn[2][l] : right.Vn[2][l]);
+		upwind[4]=mdot*(fromLeft ? left.H[l] : right.H[l]);
+		
+		bool supersonic=(M<=-1. || M>=1.);
+		for (int i=0;i<5;++i) flux.f[i][l]=supersonic ? upwind[i] : split[i];
+		flux.weightL[l]=supersonic ? (fromLeft ? 1. : 0.) : 0.5;
+	}
+
+	return;
+} // end vanLeer_flux_batch
+
+void AUSMplusUP_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,NS_Flux_Batch &flux,double Gamma,double Pref,double Minf) {
+
+	double Kp=0.25;
+	double Ku=0.75;
+	double sigma=1.;
+	double beta=0.125;
+	
+	#pragma omp simd
+	for (int l=0;l<W;++l) {
+		double aL_hat=left.a[l]*left.a[l]/max(left.a[l],left.Vn[0][l]);
+		double aR_hat=right.a[l]*right.a[l]/max(right.a[l],-1.*right.Vn[0][l]);
+		double a=min(aL_hat,aR_hat);
+
+		double rho=0.5*(left.rho[l]+right.rho[l]);
+		double ML=left.Vn[0][l]/a;
+		double MR=right.Vn[0][l]/a;
+		double Mbar2=0.5*(ML*ML+MR*MR);
+
+		double Mref=min(max(Minf,sqrt(Mbar2)),1.);
+		double Mo=sqrt(min(1.,max(Mbar2,Mref*Mref)));
+		double fa=(Mbar2>=1.) ? 1. : Mo*(2.-Mo);
+		double alpha=3./16.*(-4.+5.*fa*fa);
+		
+		// Split Mach numbers and pressures
+		double M2pL=0.25*(ML+1.)*(ML+1.);
+		double M2mL=-0.25*(ML-1.)*(ML-1.);
+		double M2pR=0.25*(MR+1.)*(MR+1.);
+		double M2mR=-0.25*(MR-1.)*(MR-1.);
+		bool superL=(fabs(ML)>=1.);
+		bool superR=(fabs(MR)>=1.);
+		double M4pL=superL ? 0.5*(ML+fabs(ML)) : M2pL*(1.-16.*beta*M2mL);
+		double M4mR=superR ? 0.5*(MR-fabs(MR)) : M2mR*(1.+16.*beta*M2pR);
+		double P5pL=superL ? 0.5*(ML+fabs(ML))/ML : M2pL*((2.-ML)-16.*alpha*ML*M2mL);
+		double P5mR=superR ? 0.5*(MR-fabs(MR))/MR : M2mR*((-2.-MR)+16.*alpha*MR*M2pR);
+
+		double M=M4pL+M4mR-Kp/fa*max(1.-sigma*Mbar2,0.)*(right.p[l]-left.p[l])/(rho*a*a);
+		double mdot=a*M*((M>0) ? left.rho[l] : right.rho[l]);
+		
+		double p=P5pL*(left.p[l]+Pref)+P5mR*(right.p[l]+Pref)
+		  -Ku*P5pL*P5mR*(left.rho[l]+right.rho[l])*fa*a*(right.Vn[0][l]-left.Vn[0][l]);
+		p-=Pref;
+		
+		bool fromLeft=(mdot>0.);
+		flux.f[0][l]=mdot;
+		flux.f[1][l]=mdot*(fromLeft ? left.Vn[0][l] : right.Vn[0][l])+p;
+		flux.f[2][l]=mdot*(fromLeft ? left.Vn[1][l] : right.Vn[1][l]);
+		flux.f[3][l]=mdot*(fromLeft ? left.Vn[2][l] : right.Vn[2][l]);
+		flux.f[4][l]=mdot*(fromLeft ? left.H[l] : right.H[l]);
+		flux.weightL[l]=fromLeft ? 1. : 0.;
+	}
+
+	return;
+} // end AUSMplusUP_flux_batch
+
+void SD_SLAU_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,NS_Flux_Batch &flux,double Pref) {
+
+	double Csd1=0.1;
+	double Csd2=10.;
+	
+	#pragma omp simd
+	for (int l=0;l<W;++l) {
+		double a=0.5*(left.a[l]+right.a[l]);
+		double V2L=left.Vn[0][l]*left.Vn[0][l]+left.Vn[1][l]*left.Vn[1][l]+left.Vn[2][l]*left.Vn[2][l];
+		double V2R=right.Vn[0][l]*right.Vn[0][l]+right.Vn[1][l]*right.Vn[1][l]+right.Vn[2][l]*right.Vn[2][l];
+		double Mhat=min(1.,sqrt(0.5*(V2L+V2R)/a));
+		double chi=(1.-Mhat)*(1.-Mhat);
+		double Mplus=left.Vn[0][l]/a;
+		double Mminus=right.Vn[0][l]/a;
+		
+		double Bplus=(fabs(Mplus)<1) ? 0.25*(2.-Mplus)*(Mplus+1.)*(Mplus+1.) : ((Mplus>0.) ? 1. : 0.);
+		double Bminus=(fabs(Mminus)<1) ? 0.25*(2.+Mminus)*(Mminus-1.)*(Mminus-1.) : ((Mminus<0.) ? 1. : 0.);
+		
+		double ave_p=0.5*(left.p[l]+right.p[l])+Pref;
+		double delta_p=right.p[l]-left.p[l];
+		double p=ave_p-0.5*(Bplus-Bminus)*delta_p+(1.-chi)*(Bplus+Bminus-1.)*ave_p;
+		double max_delta_p=fabs(delta_p);
+		
+		double g=-max(min(Mplus,0.),-1.)*min(max(Mminus,0.),1.);
+		double Vn=(left.rho[l]*fabs(left.Vn[0][l])+right.rho[l]*fabs(right.Vn[0][l]))/(left.rho[l]+right.rho[l]);
+		double Vnplus=(1.-g)*Vn+g*fabs(left.Vn[0][l]);
+		double Vnminus=(1.-g)*Vn+g*fabs(right.Vn[0][l]);
+		double theta=(Csd2*fabs(delta_p)/ave_p+Csd1)/(max_delta_p/ave_p+Csd1);
+		theta=min(1.,theta*theta);
+		double mdot=0.5*(left.rho[l]*(left.Vn[0][l]+Vnplus)+right.rho[l]*(right.Vn[0][l]-Vnminus)-theta*max(0.,(1.-Vn/a))*delta_p/a);
+		
+		p-=Pref;
+		
+		bool fromLeft=(mdot>0.);
+		flux.f[0][l]=mdot;
+		flux.f[1][l]=mdot*(fromLeft ? left.Vn[0][l] : right.Vn[0][l])+p;
+		flux.f[2][l]=mdot*(fromLeft ? left.Vn[1][l] : right.Vn[1][l]);
+		flux.f[3][l]=mdot*(fromLeft ? left.Vn[2][l] : right.Vn[2][l]);
+		flux.f[4][l]=mdot*(fromLeft ? left.H[l] : right.H[l]);
+		flux.weightL[l]=fromLeft ? 1. : 0.;
+	}
+
+	return;
+} // end SD_SLAU_flux_batch
+
+void Stegger_Warming_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,const double diss_factor[],const double closest_wall_distance[],double wdiss,double bl_height,MATERIAL &material,NS_Flux_Batch &flux) {
+
+	// The eigensystem products and the material calls don't map to a select based
+	// lane loop, so this one runs the scalar kernel lane by lane
+	NS_Cell_State leftState,rightState;
+	double fluxNormal[5];
+	for (int l=0;l<W;++l) {
+		leftState.rho=left.rho[l]; leftState.p=left.p[l]; leftState.T=left.T[l];
+		leftState.a=left.a[l]; leftState.H=left.H[l];
+		rightState.rho=right.rho[l]; rightState.p=right.p[l]; rightState.T=right.T[l];
+		rightState.a=right.a[l]; rightState.H=right.H[l];
+		for (int i=0;i<3;++i) {
+			leftState.Vn[i]=left.Vn[i][l];
+			rightState.Vn[i]=right.Vn[i][l];
+		}
+		Stegger_Warming_flux(leftState,rightState,diss_factor[l],closest_wall_distance[l],wdiss,bl_height,material,fluxNormal,flux.weightL[l]);
+		for (int i=0;i<5;++i) flux.f[i][l]=fluxNormal[i];
+	}
+	
+	return;
+} // end Stegger_Warming_flux_batch
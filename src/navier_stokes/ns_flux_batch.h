@@ -0,0 +1,64 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef NS_FLUX_BATCH_H
+#define NS_FLUX_BATCH_H
+
+// Batched convective flux kernels
+// Fluxes of FLUX_BATCH_WIDTH faces are evaluated at once from structure of arrays
+// face states. Upwinding is done with selects instead of branches so that the
+// lane loops vectorize.
+
+#ifndef FLUX_BATCH_WIDTH
+#define FLUX_BATCH_WIDTH 8
+#endif
+
+class NS_Cell_State;
+class MATERIAL;
+
+// Reconstructed face states (one side) of a batch of faces
+// Vn are the face normal and tangential velocity components
+struct NS_State_Batch {
+	double rho[FLUX_BATCH_WIDTH];
+	double p[FLUX_BATCH_WIDTH];
+	double T[FLUX_BATCH_WIDTH];
+	double a[FLUX_BATCH_WIDTH];
+	double H[FLUX_BATCH_WIDTH];
+	double Vn[3][FLUX_BATCH_WIDTH];
+};
+
+// Normal fluxes of a batch of faces
+struct NS_Flux_Batch {
+	double f[5][FLUX_BATCH_WIDTH];
+	double weightL[FLUX_BATCH_WIDTH];
+};
+
+// Copy a scalar state into lane l of a batch
+void load_state_batch(NS_State_Batch &batch,int l,NS_Cell_State &state);
+
+void roe_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,NS_Flux_Batch &flux,double Gamma);
+void vanLeer_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,NS_Flux_Batch &flux,double Gamma,double Pref);
+void AUSMplusUP_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,NS_Flux_Batch &flux,double Gamma,double Pref,double Minf);
+void SD_SLAU_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,NS_Flux_Batch &flux,double Pref);
+void Stegger_Warming_flux_batch(const NS_State_Batch &left,const NS_State_Batch &right,const double diss_factor[],const double closest_wall_distance[],double wdiss,double bl_height,MATERIAL &material,NS_Flux_Batch &flux);
+
+#endif
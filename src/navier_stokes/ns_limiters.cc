@@ -23,226 +23,155 @@
 #include "ns.h"
 #define sign(x) (( x > 0 ) - ( x < 0 ))
 
-void NavierStokes::calc_limiter(void) {
-	if(limiter_function==NONE || order==FIRST) {
-		// Do nothing
-	} else if (limiter_function==VK) {
-		venkatakrishnan_limiter();
-	} else if (limiter_function==BJ) {
-		barth_jespersen_limiter();
-	} else if (limiter_function==MINMOD) {
-		minmod_limiter();
-	}
-	return;
-}
-
 double minmod(double a1,double a2) {
 	if (a1*a2<0.) return 0.;
 	else if (a1>0.) return min(a1,a2);
 	else return max(a1,a2);
 }
 
-void NavierStokes::minmod_limiter(void) {
+void NavierStokes::limiter_init(void) {
 	
-	int neighbor,g;
-	double phi[5];
-	double deltaU,deltaUg;
-	double small=1.e-12;
+	// Flatten the face neighbors and cell to face vectors of each cell
+	limiterOffset.resize(grid[gid].cellCount+1);
+	limiterOffset[0]=0;
+	for (int c=0;c<grid[gid].cellCount;++c) limiterOffset[c+1]=limiterOffset[c]+grid[gid].cell[c].faces.size();
+	limiterNeighbor.resize(limiterOffset[grid[gid].cellCount]);
+	limiterCell2Face.resize(limiterOffset[grid[gid].cellCount]);
 	
 	for (int c=0;c<grid[gid].cellCount;++c) {
-		
-		for (int i=0;i<5;++i) phi[i]=1.;
-		
-		// Repeat the loop to calculate the limiter for each face
 		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
-			Vec3D cell2face=grid[gid].cellFace(c,cf).centroid-grid[gid].cell[c].centroid;
+			int k=limiterOffset[c]+cf;
 			if (c==grid[gid].cellFace(c,cf).parent) {
-				neighbor=grid[gid].cellFace(c,cf).neighbor;
+				limiterNeighbor[k]=grid[gid].cellFace(c,cf).neighbor;
 			} else {
-				neighbor=grid[gid].cellFace(c,cf).parent;
-			}
-			for (int var=0;var<5;++var) {
-				if (var==0) { 
-					deltaU=p.cell(neighbor)-p.cell(c);
-					deltaUg=gradp.cell(c).dot(cell2face);
-				} else if (var==1) { 
-					deltaU=V.cell(neighbor)[0]-V.cell(c)[0];
-					deltaUg=gradu.cell(c).dot(cell2face);
-				} else if (var==2) { 
-					deltaU=V.cell(neighbor)[1]-V.cell(c)[1];
-					deltaUg=gradv.cell(c).dot(cell2face);
-				} else if (var==3) { 
-					deltaU=V.cell(neighbor)[2]-V.cell(c)[2];
-					deltaUg=gradw.cell(c).dot(cell2face);
-				} else if (var==4) { 
-					deltaU=T.cell(neighbor)-T.cell(c);
-					deltaUg=gradT.cell(c).dot(cell2face);
-				}
-
-				deltaU=minmod(deltaU,deltaUg);
-				phi[var]=min(phi[var],(deltaU+sign(deltaU)*small)/(deltaUg+sign(deltaUg)*small));
+				limiterNeighbor[k]=grid[gid].cellFace(c,cf).parent;
 			}
-		} // end face loop		
-
-		for (int var=0;var<5;++var) limiter[var].cell(c)=phi[var];
-		
-	} // end cell loop
+			limiterCell2Face[k]=grid[gid].cellFace(c,cf).centroid-grid[gid].cell[c].centroid;
+		}
+	}
+	
+	limiter_frozen=false;
 	
 	return;
 }
 
-void NavierStokes::barth_jespersen_limiter(void) {
-	
-	int neighbor,g;
-	double phi[5];
-	double deltaP,deltaM;
-	double umax[5],umin[5];
+bool NavierStokes::limiter_active(void) {
+	return (order==SECOND && limiter_function!=NONE && !limiter_frozen);
+}
 
+void NavierStokes::limiter_prepare(void) {
 	
-	for (int c=0;c<grid[gid].cellCount;++c) {
-		
-		for (int i=0;i<5;++i) phi[i]=1.;
-		umax[0]=umin[0]=p.cell(c);
-		umax[1]=umin[1]=V.cell(c)[0];
-		umax[2]=umin[2]=V.cell(c)[1];
-		umax[3]=umin[3]=V.cell(c)[2];
-		umax[4]=umin[4]=T.cell(c);
-		
-		// First loop through face neighbors to find the max and min values
-		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
-			if (c==grid[gid].cellFace(c,cf).parent) {
-				neighbor=grid[gid].cellFace(c,cf).neighbor;
-			} else {
-				neighbor=grid[gid].cellFace(c,cf).parent;
-			}
-			umax[0]=max(umax[0],p.cell(neighbor));
-			umax[1]=max(umax[1],V.cell(neighbor)[0]);
-			umax[2]=max(umax[2],V.cell(neighbor)[1]);
-			umax[3]=max(umax[3],V.cell(neighbor)[2]);
-			umax[4]=max(umax[4],T.cell(neighbor));
-
-			umin[0]=min(umin[0],p.cell(neighbor));
-			umin[1]=min(umin[1],V.cell(neighbor)[0]);
-			umin[2]=min(umin[2],V.cell(neighbor)[1]);
-			umin[3]=min(umin[3],V.cell(neighbor)[2]);
-			umin[4]=min(umin[4],T.cell(neighbor));
+	if (limiter_function==VK) {
+		find_min_max();
+		double Lref=grid[gid].lengthScale;
+		double K=limiter_threshold;
+		for (int i=0;i<5;++i) {
+			double eps=fabs(qmax[i]-qmin[i])/Lref;
+			limiterEps2[i]=pow(1.e-6*K*eps,2);
 		}
+	}
+	
+	return;
+}
 
-		// Repeat the loop to calculate the limiter for each face
-		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
-			Vec3D cell2face=grid[gid].cellFace(c,cf).centroid-grid[gid].cell[c].centroid;
-			for (int var=0;var<5;++var) {
-				if (var==0) { deltaM=gradp.cell(c).dot(cell2face); deltaP=p.cell(c); } 
-				if (var==1) { deltaM=gradu.cell(c).dot(cell2face); deltaP=V.cell(c)[0]; }
-				if (var==2) { deltaM=gradv.cell(c).dot(cell2face); deltaP=V.cell(c)[1]; }
-				if (var==3) { deltaM=gradw.cell(c).dot(cell2face); deltaP=V.cell(c)[2]; }
-				if (var==4) { deltaM=gradT.cell(c).dot(cell2face); deltaP=T.cell(c); }
-
-				if (deltaM>0.) {
-					deltaP=umax[var]-deltaP;
-				} else if (deltaM<0.) {
-					deltaP=umin[var]-deltaP;
-				} else {
-					deltaP=1.; deltaM=1.;
-				}
-
-				phi[var]=min(phi[var],deltaP/deltaM);
-			}	
-
-		} // end face loop		
-		
-		for (int var=0;var<5;++var) limiter[var].cell(c)=phi[var];
+void NavierStokes::check_limiter_freeze(void) {
 	
-	} // end cell loop
+	if (order!=SECOND || limiter_function==NONE || limiter_frozen) return;
+	
+	if ((limiter_freeze_step>0 && timeStep>=limiter_freeze_step) || res<limiter_freeze_residual) {
+		limiter_frozen=true;
+		if (Rank==0) cout << "[I] Freezing the limiters of grid_" << gid+1 << " at time step " << timeStep << endl;
+	}
 	
 	return;
 }
 
-void NavierStokes::venkatakrishnan_limiter(void) {
-	
-	int neighbor,g;
-	double phi[5];
-	double deltaP,deltaP2,deltaM,deltaM2,eps,eps2;
-	double K=limiter_threshold;
-	double umax[5],umin[5];
-	//double pref,uref,tref
-	double Lref;
-	double deltaRef[5];
-
-	find_min_max();
-
-	Lref=grid[gid].lengthScale;
-	for (int i=0;i<5;++i) deltaRef[i]=fabs(qmax[i]-qmin[i]);
+// Called from the gradient sweep right after the gradients of cell c are found
+void NavierStokes::limit_cell(int c) {
+	
+	if (limiter_function==VK) limit_cell_kernel<VK>(c);
+	else if (limiter_function==BJ) limit_cell_kernel<BJ>(c);
+	else if (limiter_function==MINMOD) limit_cell_kernel<MINMOD>(c);
+	
+	return;
+}
 
-	for (int c=0;c<grid[gid].cellCount;++c) {
-		
-		for (int i=0;i<5;++i) {
-			phi[i]=1.;
-			umax[0]=umin[0]=p.cell(c);
-			umax[1]=umin[1]=V.cell(c)[0];
-			umax[2]=umin[2]=V.cell(c)[1];
-			umax[3]=umin[3]=V.cell(c)[2];
-			umax[4]=umin[4]=T.cell(c);
-		}
-		
-		// First loop through face neighbors to find the max and min values
-		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
-			if (c==grid[gid].cellFace(c,cf).parent) {
-				neighbor=grid[gid].cellFace(c,cf).neighbor;
-			} else {
-				neighbor=grid[gid].cellFace(c,cf).parent;
+template <int LIMITER>
+void NavierStokes::limit_cell_kernel(int c) {
+	
+	int neighbor;
+	double phi[5],q[5],qn[5],umax[5],umin[5];
+	double deltaP,deltaP2,deltaM,deltaM2,deltaU,deltaUg;
+	double small=1.e-12;
+	Vec3D grad[5];
+	
+	q[0]=p.cell(c);
+	q[1]=V.cell(c)[0];
+	q[2]=V.cell(c)[1];
+	q[3]=V.cell(c)[2];
+	q[4]=T.cell(c);
+	grad[0]=gradp.cell(c);
+	grad[1]=gradu.cell(c);
+	grad[2]=gradv.cell(c);
+	grad[3]=gradw.cell(c);
+	grad[4]=gradT.cell(c);
+	
+	for (int i=0;i<5;++i) {
+		phi[i]=1.;
+		umax[i]=umin[i]=q[i];
+	}
+	
+	// First loop through face neighbors to find the max and min values
+	if (LIMITER!=MINMOD) {
+		for (int k=limiterOffset[c];k<limiterOffset[c+1];++k) {
+			neighbor=limiterNeighbor[k];
+			qn[0]=p.cell(neighbor);
+			qn[1]=V.cell(neighbor)[0];
+			qn[2]=V.cell(neighbor)[1];
+			qn[3]=V.cell(neighbor)[2];
+			qn[4]=T.cell(neighbor);
+			for (int i=0;i<5;++i) {
+				umax[i]=max(umax[i],qn[i]);
+				umin[i]=min(umin[i],qn[i]);
 			}
-			umax[0]=max(umax[0],p.cell(neighbor));
-			umax[1]=max(umax[1],V.cell(neighbor)[0]);
-			umax[2]=max(umax[2],V.cell(neighbor)[1]);
-			umax[3]=max(umax[3],V.cell(neighbor)[2]);
-			umax[4]=max(umax[4],T.cell(neighbor));
-
-			umin[0]=min(umin[0],p.cell(neighbor));
-			umin[1]=min(umin[1],V.cell(neighbor)[0]);
-			umin[2]=min(umin[2],V.cell(neighbor)[1]);
-			umin[3]=min(umin[3],V.cell(neighbor)[2]);
-			umin[4]=min(umin[4],T.cell(neighbor));
 		}
-
-		// Repeat the loop to calculate the limiter for each face
-		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
-			Vec3D cell2face=grid[gid].cellFace(c,cf).centroid-grid[gid].cell[c].centroid;
-			for (int var=0;var<5;++var) {
-				if (var==0) { deltaM=gradp.cell(c).dot(cell2face); deltaP=p.cell(c); } 
-				if (var==1) { deltaM=gradu.cell(c).dot(cell2face); deltaP=V.cell(c)[0]; }
-				if (var==2) { deltaM=gradv.cell(c).dot(cell2face); deltaP=V.cell(c)[1]; }
-				if (var==3) { deltaM=gradw.cell(c).dot(cell2face); deltaP=V.cell(c)[2]; }
-				if (var==4) { deltaM=gradT.cell(c).dot(cell2face); deltaP=T.cell(c); }
-				eps=deltaRef[var]/Lref;
-
+	}
+	
+	// Repeat the loop to calculate the limiter for each face
+	for (int k=limiterOffset[c];k<limiterOffset[c+1];++k) {
+		Vec3D &cell2face=limiterCell2Face[k];
+		if (LIMITER==MINMOD) {
+			neighbor=limiterNeighbor[k];
+			qn[0]=p.cell(neighbor);
+			qn[1]=V.cell(neighbor)[0];
+			qn[2]=V.cell(neighbor)[1];
+			qn[3]=V.cell(neighbor)[2];
+			qn[4]=T.cell(neighbor);
+		}
+		for (int var=0;var<5;++var) {
+			deltaM=grad[var].dot(cell2face);
+			if (LIMITER==MINMOD) {
+				deltaUg=deltaM;
+				deltaU=minmod(qn[var]-q[var],deltaUg);
+				phi[var]=min(phi[var],(deltaU+sign(deltaU)*small)/(deltaUg+sign(deltaUg)*small));
+			} else if (LIMITER==BJ) {
 				if (deltaM>0.) {
-					deltaP=umax[var]-deltaP;
-				//	deltaM+=1.e-12;
+					phi[var]=min(phi[var],(umax[var]-q[var])/deltaM);
 				} else if (deltaM<0.) {
-					deltaP=umin[var]-deltaP;
-				//	deltaM-=1.e-12;
-				} 
-		
-				deltaP2=deltaP*deltaP;
-				deltaM2=deltaM*deltaM;
-				eps2=pow(1.e-6*K*eps,2);
-
+					phi[var]=min(phi[var],(umin[var]-q[var])/deltaM);
+				}
+			} else if (LIMITER==VK) {
 				if (deltaM!=0.) {
-					phi[var]=min(phi[var],((deltaP2+eps2)+2.*deltaM*deltaP)/(deltaP2+2.*deltaM2+deltaM*deltaP+eps2));
-				//	phi[var]=min(
-				//		phi[var],
-				//		(1./deltaM)*(((deltaP2+eps2)*deltaM+2.*deltaM2*deltaP)/(deltaP2+2.*deltaM2+deltaM*deltaP+eps2))
-				//		);
+					deltaP=(deltaM>0.) ? umax[var]-q[var] : umin[var]-q[var];
+					deltaP2=deltaP*deltaP;
+					deltaM2=deltaM*deltaM;
+					phi[var]=min(phi[var],((deltaP2+limiterEps2[var])+2.*deltaM*deltaP)/(deltaP2+2.*deltaM2+deltaM*deltaP+limiterEps2[var]));
 				}
-
-			}	
-
-		} // end face loop		
-
-		for (int var=0;var<5;++var) limiter[var].cell(c)=phi[var];
+			}
+		}
+	} // end face loop
 	
-	} // end cell loop
+	for (int var=0;var<5;++var) limiter[var].cell(c)=phi[var];
 	
 	return;
-} 
+}
@@ -0,0 +1,183 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "ns.h"
+
+// Matrix-free LU-SGS implicit solver
+// The implicit operator is approximated as D+L+U where the off-diagonal blocks come from
+// the spectral radius splitting of the flux Jacobians:
+//	L,U: 0.5*(deltaF_j-lambda*area*deltaW_j) where deltaF and deltaW are evaluated matrix-free
+//	D: time terms+0.5*sum(lambda*area)*P
+// Only the 5x5 diagonal blocks are stored. Symmetric Gauss-Seidel sweeps are performed over
+// the local cells. Partition ghost updates are lagged and exchanged after each sweep.
+
+// LU factorization of a 5x5 block with partial pivoting (in place)
+static void lu_factor_5x5(double A[],int pivot[]) {
+	for (int k=0;k<5;++k) {
+		pivot[k]=k;
+		for (int i=k+1;i<5;++i) if (fabs(A[i*5+k])>fabs(A[pivot[k]*5+k])) pivot[k]=i;
+		if (pivot[k]!=k) for (int j=0;j<5;++j) swap(A[k*5+j],A[pivot[k]*5+j]);
+		for (int i=k+1;i<5;++i) {
+			A[i*5+k]/=A[k*5+k];
+			for (int j=k+1;j<5;++j) A[i*5+j]-=A[i*5+k]*A[k*5+j];
+		}
+	}
+	return;
+}
+
+// Solve with a factored 5x5 block, b is overwritten with the solution
+static void lu_solve_5x5(double A[],int pivot[],double b[]) {
+	for (int k=0;k<5;++k) {
+		if (pivot[k]!=k) swap(b[k],b[pivot[k]]);
+		for (int i=k+1;i<5;++i) b[i]-=A[i*5+k]*b[k];
+	}
+	for (int i=4;i>=0;--i) {
+		for (int j=i+1;j<5;++j) b[i]-=A[i*5+j]*b[j];
+		b[i]/=A[i*5+i];
+	}
+	return;
+}
+
+void NavierStokes::lusgs_init(void) {
+	
+	diagBlock.resize(grid[gid].cellCount*25);
+	diagPivot.resize(grid[gid].cellCount*5);
+	faceLambda.resize(grid[gid].faceCount);
+	deltaQ.resize(grid[gid].cell.size()*5);
+	for (int i=0;i<deltaQ.size();++i) deltaQ[i]=0.;
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] Using matrix-free LU-SGS with " << lusgs_sweeps << " sweeps" << endl;
+	
+	return;
+}
+
+// Conservative variables and normal convective flux for a primitive state q=(p,u,v,w,T)
+void NavierStokes::lusgs_state(double q[],Vec3D &normal,double W[],double F[]) {
+	
+	Vec3D vel(q[1],q[2],q[3]);
+	double density=material.rho(q[0],q[4]);
+	double a=material.a(q[0],q[4]);
+	double H=a*a/(material.gamma-1.)+0.5*vel.dot(vel);
+	double Vn=vel.dot(normal);
+	
+	W[0]=density;
+	W[1]=density*vel[0];
+	W[2]=density*vel[1];
+	W[3]=density*vel[2];
+	W[4]=density*H-(q[0]+material.Pref);
+	
+	F[0]=density*Vn;
+	F[1]=F[0]*vel[0]+q[0]*normal[0];
+	F[2]=F[0]*vel[1]+q[0]*normal[1];
+	F[3]=F[0]*vel[2]+q[0]*normal[2];
+	F[4]=F[0]*H;
+	
+	return;
+}
+
+void NavierStokes::lusgs_solve(void) {
+	
+	VecAssemblyBegin(rhs);
+	VecAssemblyEnd(rhs);
+	
+	// Local portion of the residual
+	PetscScalar *residual;
+	VecGetArray(rhs,&residual);
+	
+	// Spectral radius of the convective+diffusive flux Jacobians at each face
+	// The face states are the ones reconstructed by the last face loop
+	int parent,neighbor,f;
+	double Vn,a,density,lambda,distance;
+	for (f=0;f<grid[gid].faceCount;++f) {
+		parent=grid[gid].face[f].parent;
+		neighbor=grid[gid].face[f].neighbor;
+		Vn=0.5*(face_store.Vn[0][f][0]+face_store.Vn[1][f][0]);
+		a=0.5*(face_store.a[0][f]+face_store.a[1][f]);
+		density=face_store.rho_face(f);
+		distance=fabs(grid[gid].cell[neighbor].centroid-grid[gid].cell[parent].centroid);
+		lambda=fabs(Vn)+a+2.*face_store.mu[f]/(density*distance);
+		faceLambda[f]=lambda*grid[gid].face[f].area;
+	}
+	
+	// Complete and factor the diagonal blocks (time terms are already in diagBlock)
+	double P[5][5];
+	double lambdaSum;
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		lambdaSum=0.;
+		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) lambdaSum+=faceLambda[grid[gid].cell[c].faces[cf]];
+		cons2prim(c,P);
+		for (int i=0;i<5;++i) for (int j=0;j<5;++j) diagBlock[c*25+i*5+j]+=0.5*lambdaSum*P[i][j];
+		lu_factor_5x5(&diagBlock[c*25],&diagPivot[c*5]);
+	}
+	
+	for (int i=0;i<deltaQ.size();++i) deltaQ[i]=0.;
+	
+	double q[5],qPlus[5],W[5],WPlus[5],F[5],FPlus[5],b[5];
+	Vec3D normal;
+	int c,n;
+	
+	for (int sweep=0;sweep<lusgs_sweeps;++sweep) {
+		// Forward sweep followed by a backward sweep
+		for (int dir=0;dir<2;++dir) {
+			for (int k=0;k<grid[gid].cellCount;++k) {
+				c=(dir==0) ? k : grid[gid].cellCount-1-k;
+				for (int i=0;i<5;++i) b[i]=residual[c*5+i];
+				for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
+					f=grid[gid].cell[c].faces[cf];
+					// Boundary faces only contribute to the diagonal
+					if (grid[gid].face[f].bc!=INTERNAL_FACE && grid[gid].face[f].bc!=PARTITION_FACE) continue;
+					// Outward normal and the cell across the face
+					if (grid[gid].face[f].parent==c) {
+						n=grid[gid].face[f].neighbor;
+						normal=grid[gid].face[f].normal;
+					} else {
+						n=grid[gid].face[f].parent;
+						normal=-1.*grid[gid].face[f].normal;
+					}
+					q[0]=p.cell(n); q[1]=V.cell(n)[0]; q[2]=V.cell(n)[1]; q[3]=V.cell(n)[2]; q[4]=T.cell(n);
+					for (int i=0;i<5;++i) qPlus[i]=q[i]+deltaQ[n*5+i];
+					lusgs_state(q,normal,W,F);
+					lusgs_state(qPlus,normal,WPlus,FPlus);
+					for (int i=0;i<5;++i) {
+						b[i]-=0.5*(grid[gid].face[f].area*(FPlus[i]-F[i])-faceLambda[f]*(WPlus[i]-W[i]));
+					}
+				}
+				lu_solve_5x5(&diagBlock[c*25],&diagPivot[c*5],b);
+				for (int i=0;i<5;++i) deltaQ[c*5+i]=b[i];
+			}
+		}
+		// Refresh partition ghost updates with the neighboring partitions' latest values
+		if (np>1) mpi_update_ghost_deltas();
+	}
+	
+	VecRestoreArray(rhs,&residual);
+	
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<5;++i) update[i].cell(c)=deltaQ[c*5+i];
+	}
+	
+	nIter=lusgs_sweeps;
+	
+	VecSet(rhs,0.);
+	
+	return;
+}
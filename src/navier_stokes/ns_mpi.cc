@@ -21,11 +21,15 @@
  
  *************************************************************************/
 #include "ns.h"
+#include "rans.h"
+#include "comm_profile.h"
+
+extern vector<RANS> rans;
 
 void NavierStokes::mpi_init(void) {
 	
-	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
-	MPI_Comm_size(MPI_COMM_WORLD, &np);
+	MPI_Comm_rank(grid[gid].comm, &Rank);
+	MPI_Comm_size(grid[gid].comm, &np);
 
 	long unsigned int max_send_size=0;
 	long unsigned int max_recv_size=0;
@@ -62,7 +66,7 @@ void NavierStokes::mpi_init(void) {
 void NavierStokes::mpi_update_ghost_primitives(void) {
 
 	/*
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(grid[gid].comm);
     double timeRef,timeEnd;
     timeRef=MPI_Wtime();
 	*/
@@ -75,6 +79,15 @@ void NavierStokes::mpi_update_ghost_primitives(void) {
 		update[4].cell(g)=T.cell(g);		
 	}
 	
+	// The coupled Navier-Stokes+RANS solve sends k and omega along (the buffers hold 15 values per cell)
+	int stride=(coupled) ? 7 : 5;
+	if (coupled) {
+		for (int g=grid[gid].partition_ghosts_begin;g<=grid[gid].partition_ghosts_end;++g) {
+			rans[gid].update[0].cell(g)=rans[gid].k.cell(g);
+			rans[gid].update[1].cell(g)=rans[gid].omega.cell(g);
+		}
+	}
+	
 	// The Following is convenient but not efficient
 	/*
 	p.mpi_update();
@@ -91,37 +104,46 @@ void NavierStokes::mpi_update_ghost_primitives(void) {
 				for (int g=0;g<grid[gid].sendCells[proc].size();++g) {
 					id=grid[gid].sendCells[proc][g];
 					offset=mpi_send_offset[proc];
-					sendBuffer[offset+g*5]=p.cell(id);
-					sendBuffer[offset+g*5+1]=V.cell(id)[0];
-					sendBuffer[offset+g*5+2]=V.cell(id)[1];
-					sendBuffer[offset+g*5+3]=V.cell(id)[2];
-					sendBuffer[offset+g*5+4]=T.cell(id);
+					sendBuffer[offset+g*stride]=p.cell(id);
+					sendBuffer[offset+g*stride+1]=V.cell(id)[0];
+					sendBuffer[offset+g*stride+2]=V.cell(id)[1];
+					sendBuffer[offset+g*stride+3]=V.cell(id)[2];
+					sendBuffer[offset+g*stride+4]=T.cell(id);
+					if (coupled) {
+						sendBuffer[offset+g*stride+5]=rans[gid].k.cell(id);
+						sendBuffer[offset+g*stride+6]=rans[gid].omega.cell(id);
+					}
 				}
 
-				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*5,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&send_request[send_req_count]);
+				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*stride,MPI_DOUBLE,proc,0,grid[gid].comm,&send_request[send_req_count]);
+				comm_profile.send(grid[gid].worldOffset+proc,grid[gid].sendCells[proc].size()*stride*sizeof(double));
 				send_req_count++;
 			}
 
 			if (grid[gid].recvCells[proc].size()!=0) {
 				offset=mpi_recv_offset[proc];
-				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*5,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&recv_request[recv_req_count]);
+				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*stride,MPI_DOUBLE,proc,0,grid[gid].comm,&recv_request[recv_req_count]);
 				recv_req_count++;
 			}
 		}
 	}
 
-	MPI_Waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
+	comm_profile.waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
 
 	for (int proc=0;proc<np;++proc) { 
 		if (Rank!=proc) {
 			offset=mpi_recv_offset[proc];
 			for (int g=0;g<grid[gid].recvCells[proc].size();++g) {
 				id=grid[gid].recvCells[proc][g];
-				p.cell(id)=recvBuffer[offset+g*5];
-				V.cell(id)[0]=recvBuffer[offset+g*5+1];
-				V.cell(id)[1]=recvBuffer[offset+g*5+2];
-				V.cell(id)[2]=recvBuffer[offset+g*5+3];
-				T.cell(id)=recvBuffer[offset+g*5+4];				
+				p.cell(id)=recvBuffer[offset+g*stride];
+				V.cell(id)[0]=recvBuffer[offset+g*stride+1];
+				V.cell(id)[1]=recvBuffer[offset+g*stride+2];
+				V.cell(id)[2]=recvBuffer[offset+g*stride+3];
+				T.cell(id)=recvBuffer[offset+g*stride+4];				
+				if (coupled) {
+					rans[gid].k.cell(id)=recvBuffer[offset+g*stride+5];
+					rans[gid].omega.cell(id)=recvBuffer[offset+g*stride+6];
+				}
 			}
 		}
 	}
@@ -134,6 +156,12 @@ void NavierStokes::mpi_update_ghost_primitives(void) {
 		update[4].cell(g)=T.cell(g)   -update[4].cell(g);
 		rho.cell(g)=material.rho(p.cell(g),T.cell(g));
 	}
+	if (coupled) {
+		for (int g=grid[gid].partition_ghosts_begin;g<=grid[gid].partition_ghosts_end;++g) {
+			rans[gid].update[0].cell(g)=rans[gid].k.cell(g)-rans[gid].update[0].cell(g);
+			rans[gid].update[1].cell(g)=rans[gid].omega.cell(g)-rans[gid].update[1].cell(g);
+		}
+	}
 
 	/*
 	if (Rank==0) {
@@ -175,19 +203,20 @@ void NavierStokes::mpi_update_ghost_gradients(void) {
 						}
 					}
 
-					MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*15,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&send_request[send_req_count]);
+					MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*15,MPI_DOUBLE,proc,0,grid[gid].comm,&send_request[send_req_count]);
+					comm_profile.send(grid[gid].worldOffset+proc,grid[gid].sendCells[proc].size()*15*sizeof(double));
 					send_req_count++;
 				}
 
 				if (grid[gid].recvCells[proc].size()!=0) {
 					offset=mpi_recv_offset[proc];
-					MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*15,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&recv_request[recv_req_count]);
+					MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*15,MPI_DOUBLE,proc,0,grid[gid].comm,&recv_request[recv_req_count]);
 					recv_req_count++;
 				}
 			}
 	}
 
-	MPI_Waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
+	comm_profile.waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
 
 	for (int proc=0;proc<np;++proc) { 
 		if (Rank!=proc) {
@@ -208,3 +237,50 @@ void NavierStokes::mpi_update_ghost_gradients(void) {
 	return;
 } 
 
+
+void NavierStokes::mpi_update_ghost_deltas(void) {
+
+	// Exchange the LU-SGS primitive updates of the partition ghosts
+	int id,offset;
+
+	send_req_count=0; recv_req_count=0;
+
+	for (int proc=0;proc<np;++proc) {
+		if (Rank!=proc) {
+			if (grid[gid].sendCells[proc].size()!=0) {
+				offset=mpi_send_offset[proc];
+				for (int g=0;g<grid[gid].sendCells[proc].size();++g) {
+					id=grid[gid].sendCells[proc][g];
+					for (int i=0;i<5;++i) sendBuffer[offset+g*5+i]=deltaQ[id*5+i];
+				}
+
+				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*5,MPI_DOUBLE,proc,0,grid[gid].comm,&send_request[send_req_count]);
+				comm_profile.send(grid[gid].worldOffset+proc,grid[gid].sendCells[proc].size()*5*sizeof(double));
+				send_req_count++;
+			}
+
+			if (grid[gid].recvCells[proc].size()!=0) {
+				offset=mpi_recv_offset[proc];
+				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*5,MPI_DOUBLE,proc,0,grid[gid].comm,&recv_request[recv_req_count]);
+				recv_req_count++;
+			}
+		}
+	}
+
+	comm_profile.waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
+
+	for (int proc=0;proc<np;++proc) { 
+		if (Rank!=proc) {
+			offset=mpi_recv_offset[proc];
+			for (int g=0;g<grid[gid].recvCells[proc].size();++g) {
+				id=grid[gid].recvCells[proc][g];
+				for (int i=0;i<5;++i) deltaQ[id*5+i]=recvBuffer[offset+g*5+i];
+			}
+		}
+	}
+	
+	// Send buffer is reused by the next sweep, make sure it is free
+	comm_profile.waitall(send_request.size(),&send_request[0],MPI_STATUSES_IGNORE);
+
+	return;
+}
@@ -21,16 +21,16 @@
 
 *************************************************************************/
 #include "ns.h"
+#include "memory_usage.h"
+
+#define GMRES_RESTART 300
 
 void NavierStokes::petsc_init(void) {
 	
 	vector<Cell>::iterator cit;
 	vector<int>::iterator it;
 	
-	//Create nonlinear solver context
-	KSPCreate(PETSC_COMM_WORLD,&ksp);
-	
-	VecCreateMPI(PETSC_COMM_WORLD,grid[gid].cellCount*nVars,grid[gid].globalCellCount*nVars,&rhs);
+	VecCreateMPI(grid[gid].comm,grid[gid].cellCount*nVars,grid[gid].globalCellCount*nVars,&rhs);
 	VecSetFromOptions(rhs);
 	VecDuplicate(rhs,&deltaU);
 	if (ps_step_max>1) {
@@ -41,6 +41,12 @@ void NavierStokes::petsc_init(void) {
 	VecSet(rhs,0.);
 	VecSet(deltaU,0.);
 
+	// LU-SGS doesn't need the implicit operator matrix or the Krylov solver
+	if (linear_solver==LUSGS) {
+		lusgs_init();
+		return;
+	}
+	
 	vector<int> diagonal_nonzeros, off_diagonal_nonzeros;
 	int nextCellCount;
 	
@@ -60,8 +66,11 @@ void NavierStokes::petsc_init(void) {
 		}
 	}
 	
+	//Create nonlinear solver context
+	KSPCreate(grid[gid].comm,&ksp);
+	
 	MatCreateMPIAIJ(
-			PETSC_COMM_WORLD,
+			grid[gid].comm,
    			grid[gid].cellCount*nVars,
  			grid[gid].cellCount*nVars,
    			grid[gid].globalCellCount*nVars,
@@ -76,12 +85,56 @@ void NavierStokes::petsc_init(void) {
 	//KSPSetType(ksp,KSPGMRES);
 	KSPSetType(ksp,KSPFGMRES);
 	//KSPGMRESSetOrthogonalization(ksp,KSPGMRESModifiedGramSchmidtOrthogonalization);
-	KSPGMRESSetRestart(ksp,300);
+	KSPGMRESSetRestart(ksp,GMRES_RESTART);
 	KSPSetFromOptions(ksp);
 	
 	return;
 } 
 
+void NavierStokes::account_memory(void) {
+	
+	string prefix="grid "+int2str(gid+1)+"/navier stokes/";
+	double size;
+	
+	size=rho.bytes()+p.bytes()+T.bytes()+qdot.bytes()+mdot.bytes()+weightL.bytes()+p_total.bytes()+T_total.bytes()
+		+V.bytes()+gradu.bytes()+gradv.bytes()+gradw.bytes()+gradp.bytes()+gradT.bytes()+tau.bytes()
+		+dt[gid].bytes()+dtau[gid].bytes();
+	for (int i=0;i<update.size();++i) size+=update[i].bytes();
+	for (int i=0;i<limiter.size();++i) size+=limiter[i].bytes();
+	memory_usage.account(prefix+"variables",size);
+	
+	size=container_bytes(rhsLocal)+container_bytes(faceJacobians)+container_bytes(deltaPmax)
+		+container_bytes(limiterOffset)+container_bytes(limiterNeighbor)+container_bytes(limiterCell2Face)
+		+container_bytes(sendBuffer)+container_bytes(recvBuffer)+container_bytes(state_cache);
+	for (int s=0;s<2;++s) {
+		size+=container_bytes(face_store.rho[s])+container_bytes(face_store.a[s])+container_bytes(face_store.H[s])
+			+container_bytes(face_store.Vn[s])+container_bytes(face_store.T[s]);
+	}
+	size+=container_bytes(face_store.mu)+container_bytes(face_store.lambda);
+	memory_usage.account(prefix+"work arrays",size);
+	
+	double rows=grid[gid].cellCount*nVars;
+	memory_usage.account(prefix+"petsc vectors",rows*sizeof(PetscScalar)*((ps_step_max>1) ? 5 : 2));
+	
+	if (linear_solver==LUSGS) {
+		size=container_bytes(diagBlock)+container_bytes(diagPivot)+container_bytes(faceLambda)+container_bytes(deltaQ);
+		memory_usage.account(prefix+"lu-sgs blocks",size);
+		return;
+	}
+	
+	MatInfo info;
+	MatGetInfo(impOP,MAT_LOCAL,&info);
+	size=info.nz_allocated*(sizeof(PetscScalar)+sizeof(PetscInt))+2.*rows*sizeof(PetscInt);
+	memory_usage.account(prefix+"matrix",size);
+	// The Krylov vectors and the preconditioner are only allocated at the first solve
+	// FGMRES keeps the basis and the preconditioned basis plus a few work vectors
+	memory_usage.account(prefix+"krylov workspace",(2.*GMRES_RESTART+4.)*rows*sizeof(PetscScalar),true);
+	// The default block Jacobi ILU(0) factors are about the size of the matrix
+	memory_usage.account(prefix+"preconditioner",size,true);
+	
+	return;
+}
+
 void NavierStokes::petsc_solve(void) {
 
 	MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
@@ -110,13 +163,21 @@ void NavierStokes::petsc_solve(void) {
 } 
 
 void NavierStokes::petsc_destroy(void) {
-	KSPDestroy(ksp);
-	MatDestroy(impOP);
+	if (linear_solver==KRYLOV) {
+		KSPDestroy(ksp);
+		MatDestroy(impOP);
+		PCDestroy(pc);
+	}
+	if (coupled) {
+		KSPDestroy(coupledKsp);
+		MatDestroy(coupledOP);
+		VecDestroy(coupledRhs);
+		VecDestroy(coupledDelta);
+	}
 	VecDestroy(rhs);
 	VecDestroy(deltaU);
 	VecDestroy(soln_n);
 	VecDestroy(pseudo_delta);
 	VecDestroy(pseudo_right);	
-	PCDestroy(pc);
 	return;
 } 
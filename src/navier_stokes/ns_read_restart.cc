@@ -35,7 +35,6 @@ void NavierStokes::read_restart(int restart_step,vector<vector<int> > &partition
 	mpi_update_ghost_primitives();
 	calc_cell_grads();
 	mpi_update_ghost_gradients();
-	calc_limiter();
 
 	return;
 }
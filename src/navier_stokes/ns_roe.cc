@@ -96,3 +96,7 @@ void roe_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],doubl
 	
 	return;
 } // end roe_flux
+
+#include "ns_face_kernel.h"
+// Face loop kernels with this flux function inlined
+NS_FACE_KERNELS(ROE)
@@ -92,3 +92,7 @@ void SD_SLAU_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],d
 		
 	return;
 } // end SD_SLAU_flux
+
+#include "ns_face_kernel.h"
+// Face loop kernels with this flux function inlined
+NS_FACE_KERNELS(SD_SLAU)
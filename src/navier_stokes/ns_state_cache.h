@@ -27,24 +27,7 @@ class NS_Cell_State {
 	public:
 		double p,p_center,T,T_center,rho,a,H,volume;
 		Vec3D V,V_center,Vn;
-		vector<double> update;
-		NS_Cell_State &operator= (const NS_Cell_State & rhs) {
-			// TODO: simplify this
-			// Is this even needed? What about default copy constructor?
-			p=rhs.p;
-			p_center=rhs.p_center;
-			T=rhs.T;
-			T_center=rhs.T_center;
-			rho=rhs.rho;
-			a=rhs.a;
-			H=rhs.H;
-			V=rhs.V;
-			V_center=rhs.V_center;
-			Vn=rhs.Vn;
-			volume=rhs.volume;
-			copy(rhs.update.begin(),rhs.update.end(),update.begin());
-			return *this;
-		}
+		double update[5];
 };
 
 class NS_Face_State {
@@ -56,16 +39,68 @@ class NS_Face_State {
 		Vec3D normal,tangent1,tangent2,left2right;
 		double area;
 		int bc;
+		double order_factor; // Used to kill gradients during Jacobian calculation if first order option is selected
+		double dFdmu_t[4]; // Derivatives of the momentum and energy diffusive fluxes with respect to mu_t
 };
 
 class NS_Fluxes {
 	public:
-		vector<double> convective,diffusive;
-		NS_Fluxes &operator= (const NS_Fluxes & rhs) {
-			copy(rhs.convective.begin(),rhs.convective.end(),convective.begin());
-			copy(rhs.diffusive.begin(),rhs.diffusive.end(),diffusive.begin());
-			return *this;
+		double convective[5],diffusive[5];
+};
+
+// Everything the face loop needs as scratch space
+// Each thread owns one of these so that the face loop can run concurrently
+class NS_Assembly_Cache {
+	public:
+		NS_Cell_State left,right,leftPlus,rightPlus;
+		NS_Face_State face;
+		NS_Fluxes flux,fluxPlus;
+		double jacobianLeft[5],jacobianRight[5],sourceJacLeft[5],sourceJacRight[5];
+		double sourceLeft[5],sourceRight[5],sourceLeftPlus[5],sourceRightPlus[5];
+		bool doLeftSourceJac,doRightSourceJac;
+		vector<Vec3D> force,moment; // Boundary loads integrated by this thread
+		void allocate(int nLoads) {
+			for (int m=0;m<5;++m) flux.diffusive[m]=0.;
+			force.resize(nLoads);
+			moment.resize(nLoads);
+			return;
+		}
+};
+
+// Reconstructed face states of the last face loop, one entry per face
+// Read by the consumers that need face values after the assembly
+// (LU-SGS spectral radii, RANS face properties, interface coupling, surface output)
+// The boundary values are the states the integrated loads were computed from
+class NS_Face_Store {
+	public:
+		vector<double> rho[2],a[2],H[2],T[2]; // [0] left and [1] right (boundary) states
+		vector<Vec3D> Vn[2]; // Velocity in the face frame (normal, tangent1, tangent2)
+		vector<double> mu,lambda; // Face viscosity and thermal conductivity
+		bool filled; // False until the first face loop
+		void allocate(int faceCount) {
+			filled=false;
+			for (int s=0;s<2;++s) {
+				rho[s].resize(faceCount);
+				a[s].resize(faceCount);
+				H[s].resize(faceCount);
+				Vn[s].resize(faceCount);
+				T[s].resize(faceCount);
+			}
+			mu.resize(faceCount);
+			lambda.resize(faceCount);
+			return;
+		}
+		void store(int f,NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face) {
+			rho[0][f]=left.rho; rho[1][f]=right.rho;
+			a[0][f]=left.a; a[1][f]=right.a;
+			H[0][f]=left.H; H[1][f]=right.H;
+			Vn[0][f]=left.Vn; Vn[1][f]=right.Vn;
+			T[0][f]=left.T; T[1][f]=right.T;
+			mu[f]=face.mu;
+			lambda[f]=face.lambda;
+			return;
 		}
+		double rho_face(int f) { return 0.5*(rho[0][f]+rho[1][f]); }
 };
 
 #endif
@@ -153,3 +153,7 @@ void mtx_out(double L[5][5],int dim){
          cout<<endl;
       }
 }
+
+#include "ns_face_kernel.h"
+// Face loop kernels with this flux function inlined
+NS_FACE_KERNELS(SW)
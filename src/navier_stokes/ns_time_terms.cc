@@ -23,155 +23,155 @@
 #include "ns.h"
 
 // Conservative to primitive variable set conversion matrix
-void NavierStokes::cons2prim(int c,vector<vector<double> > &P) {
+void NavierStokes::cons2prim(int c,double P[5][5]) {
 	
+	double density=rho.cell(c);
+	Vec3D &velocity=V.cell(c);
 	double pressure=p.cell(c)+material.Pref;
 	double temperature=T.cell(c)+material.Tref;
 	double drho_dT; // Derivative of density w.r.t temp. @ const. press
 	double drho_dp; // Derivative of density w.r.t press. @ const temp.
 	
 	// For ideal gas
-	drho_dT=-1.*rho.cell(c)/temperature;
-	drho_dp=rho.cell(c)/pressure;
+	drho_dT=-1.*density/temperature;
+	drho_dp=density/pressure;
 	
-	//double c_p=material.gamma/(material.gamma-1.)*pressure/(rho.cell(c)*temperature);
+	//double c_p=material.gamma/(material.gamma-1.)*pressure/(density*temperature);
 	double c_p=material.Cp(T.cell(c));
 	
-	double H=c_p*temperature+0.5*V.cell(c).dot(V.cell(c));
+	double H=c_p*temperature+0.5*velocity.dot(velocity);
 	
-	// Conservative to primite Jacobian
-	P[0][0]=drho_dp; P[0][4]=drho_dT;
-	
-	P[1][0]=drho_dp*V.cell(c)[0]; P[1][1]=rho.cell(c); P[1][4]=drho_dT*V.cell(c)[0];
-	P[2][0]=drho_dp*V.cell(c)[1]; P[2][2]=rho.cell(c); P[2][4]=drho_dT*V.cell(c)[1];
-	P[3][0]=drho_dp*V.cell(c)[2]; P[3][3]=rho.cell(c); P[3][4]=drho_dT*V.cell(c)[2];
-	
-	P[4][0]=drho_dp*H-1.;
-	P[4][1]=rho.cell(c)*V.cell(c)[0];
-	P[4][2]=rho.cell(c)*V.cell(c)[1];
-	P[4][3]=rho.cell(c)*V.cell(c)[2];
-	P[4][4]=drho_dT*H+rho.cell(c)*c_p;
+	prim_block(density,velocity,H,c_p,drho_dp,drho_dT,P);
 	
 	return;
 }
 
-void NavierStokes::preconditioner_ws95(int c,vector<vector<double> > &P) {
+void NavierStokes::preconditioner_ws95(int c,double deltaPmax,double P[5][5]) {
 	
-	double pressure=p.cell(c)+material.Pref;
+	double density=rho.cell(c);
+	Vec3D &velocity=V.cell(c);
 	double temperature=T.cell(c)+material.Tref;
 	double drho_dT; // Derivative of density w.r.t temp. @ const. press
 	double drho_dp; // Derivative of density w.r.t press. @ const temp.
 	
 	// For ideal gas
-	drho_dT=-1.*rho.cell(c)/temperature;
+	drho_dT=-1.*density/temperature;
 
 	double c_p=material.Cp(T.cell(c));
 	// Speed of sound 
 	double a=material.a(p.cell(c),T.cell(c));
 	// Reference velocity
-	double Ur=max(fabs(V.cell(c)),1.e-5*a);
+	double Ur=max(fabs(velocity),1.e-5*a);
 	Ur=min(Ur,a);
-	if (material.viscosity(T.cell(c))>1.e-8) Ur=max(Ur,material.viscosity(T.cell(c))/(rho.cell(c)*grid[gid].cell[c].lengthScale));
+	double mu=material.viscosity(T.cell(c));
+	if (mu>1.e-8) Ur=max(Ur,mu/(density*grid[gid].cell[c].lengthScale));
+	// deltaPmax is the largest pressure difference to the neighbor cells (see time_terms)
+	Ur=max(Ur,1.e-5*sqrt(deltaPmax/density));
 	
-	double deltaPmax=0.;
-	// Now loop through neighbor cells to check pressure differences
-	vector<int>::iterator it;
-	for (it=grid[gid].cell[c].neighborCells.begin();it!=grid[gid].cell[c].neighborCells.end();it++) {
-		deltaPmax=max(deltaPmax,fabs(p.cell(c)-p.cell(*it)));
-	}
-	// TODO loop ghosts too
+	drho_dp=1./(Ur*Ur)-drho_dT/(density*c_p); // This is the only change over non-preconditioned
+	
+	double H=c_p*temperature+0.5*velocity.dot(velocity);
 	
-	Ur=max(Ur,1.e-5*sqrt(deltaPmax/rho.cell(c)));
+	prim_block(density,velocity,H,c_p,drho_dp,drho_dT,P);
 	
-	drho_dp=1./(Ur*Ur)-drho_dT/(rho.cell(c)*c_p); // This is the only change over non-preconditioned
+	return;
 	
-	double H=c_p*temperature+0.5*V.cell(c).dot(V.cell(c));
+}
+
+// Conservative to primite Jacobian given the density derivatives
+void NavierStokes::prim_block(double density,Vec3D &velocity,double H,double c_p,double drho_dp,double drho_dT,double P[5][5]) {
 	
-	// Conservative to primite Jacobian
-	P[0][0]=drho_dp; P[0][4]=drho_dT;
+	P[0][0]=drho_dp; P[0][1]=0.; P[0][2]=0.; P[0][3]=0.; P[0][4]=drho_dT;
 	
-	P[1][0]=drho_dp*V.cell(c)[0]; P[1][1]=rho.cell(c); P[1][4]=drho_dT*V.cell(c)[0];
-	P[2][0]=drho_dp*V.cell(c)[1]; P[2][2]=rho.cell(c); P[2][4]=drho_dT*V.cell(c)[1];
-	P[3][0]=drho_dp*V.cell(c)[2]; P[3][3]=rho.cell(c); P[3][4]=drho_dT*V.cell(c)[2];
+	for (int i=0;i<3;++i) {
+		P[i+1][0]=drho_dp*velocity[i];
+		P[i+1][1]=0.; P[i+1][2]=0.; P[i+1][3]=0.;
+		P[i+1][i+1]=density;
+		P[i+1][4]=drho_dT*velocity[i];
+	}
 	
-	P[4][0]=drho_dp*H-1.; 
-	P[4][1]=rho.cell(c)*V.cell(c)[0];
-	P[4][2]=rho.cell(c)*V.cell(c)[1];
-	P[4][3]=rho.cell(c)*V.cell(c)[2];
-	P[4][4]=drho_dT*H+rho.cell(c)*c_p; 
+	P[4][0]=drho_dp*H-1.;
+	P[4][1]=density*velocity[0];
+	P[4][2]=density*velocity[1];
+	P[4][3]=density*velocity[2];
+	P[4][4]=drho_dT*H+density*c_p;
 	
 	return;
-	
 }
 
 void NavierStokes::time_terms() {
 
-	PetscInt row,col;
-	PetscScalar value;
+	PetscInt rows[5];
+	PetscScalar values[5];
+	double *pressure=&p.cellData[0];
 	
+	bool ws95=(ps_step_max>1 && preconditioner==WS95);
+	if (ws95) deltaPmax.resize(grid[gid].cellCount);
+	
+	// Fused pass over the cells, fills the pseudo time vectors and the preconditioner inputs
 	if (ps_step_max>1) {
-		if (ps_step==1) {
-			for (int c=0;c<grid[gid].cellCount;++c) {
-				row=(grid[gid].myOffset+c)*5;
-				value=p.cell(c);
-				VecSetValues(soln_n,1,&row,&value,INSERT_VALUES);
-				row++; value=V.cell(c)[0]; VecSetValues(soln_n,1,&row,&value,INSERT_VALUES);
-				row++; value=V.cell(c)[1]; VecSetValues(soln_n,1,&row,&value,INSERT_VALUES);
-				row++; value=V.cell(c)[2]; VecSetValues(soln_n,1,&row,&value,INSERT_VALUES);
-				row++; value=T.cell(c); VecSetValues(soln_n,1,&row,&value,INSERT_VALUES);		
+		for (int c=0;c<grid[gid].cellCount;++c) {
+			for (int i=0;i<5;++i) rows[i]=(grid[gid].myOffset+c)*5+i;
+			values[0]=pressure[c];
+			values[1]=V.cell(c)[0];
+			values[2]=V.cell(c)[1];
+			values[3]=V.cell(c)[2];
+			values[4]=T.cell(c);
+			if (ps_step==1) VecSetValues(soln_n,5,rows,values,INSERT_VALUES);
+			else VecSetValues(pseudo_delta,5,rows,values,INSERT_VALUES); // pseudo_delta=soln_k
+			if (ws95) {
+				// Now loop through neighbor cells to check pressure differences
+				// TODO loop ghosts too
+				deltaPmax[c]=0.;
+				for (int nc=0;nc<grid[gid].cell[c].neighborCells.size();++nc) {
+					deltaPmax[c]=max(deltaPmax[c],fabs(pressure[c]-pressure[grid[gid].cell[c].neighborCells[nc]]));
+				}
 			}
+		}
+		if (ps_step==1) {
 			VecAssemblyBegin(soln_n); VecAssemblyEnd(soln_n);
-		} else if (ps_step>1) {
-			for (int c=0;c<grid[gid].cellCount;++c) {
-				row=(grid[gid].myOffset+c)*5;
-				value=p.cell(c);
-				VecSetValues(pseudo_delta,1,&row,&value,INSERT_VALUES);
-				row++; value=V.cell(c)[0]; VecSetValues(pseudo_delta,1,&row,&value,INSERT_VALUES);
-				row++; value=V.cell(c)[1]; VecSetValues(pseudo_delta,1,&row,&value,INSERT_VALUES);
-				row++; value=V.cell(c)[2]; VecSetValues(pseudo_delta,1,&row,&value,INSERT_VALUES);
-				row++; value=T.cell(c); VecSetValues(pseudo_delta,1,&row,&value,INSERT_VALUES);		
-			} // pseudo_delta=soln_k
-			VecAXPY(pseudo_delta,-1.,soln_n); // pseudo_delta-=soln_n
+		} else {
 			VecAssemblyBegin(pseudo_delta); VecAssemblyEnd(pseudo_delta);
+			VecAXPY(pseudo_delta,-1.,soln_n); // pseudo_delta-=soln_n
 			VecSet(pseudo_right,0.);
 		}
 	}
 	
-	vector<vector<double> > P;
-	P.resize(5);
-	for (int i=0;i<5;++i) {
-		P[i].resize(5);
-		for (int j=0;j<5;++j) P[i][j]=0.;
-	}
+	double P[5][5];
+	double block[25];
+	double ps_delta[5];
+	double factor;
+	
+	if (linear_solver==LUSGS) for (int i=0;i<diagBlock.size();++i) diagBlock[i]=0.;
 	
 	for (int c=0;c<grid[gid].cellCount;++c) {
 
+		for (int i=0;i<5;++i) rows[i]=(grid[gid].myOffset+c)*5+i;
+		
 		cons2prim(c,P);
-		double ps_delta;
-		for (int i=0;i<5;++i) {
-			row=(grid[gid].myOffset+c)*5+i;
-			for (int j=0;j<5;++j) {
-				col=(grid[gid].myOffset+c)*5+j;
-				value=P[i][j]*grid[gid].cell[c].volume/dt[gid].cell(c);
-				MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-				if (ps_step>1) {
-					VecGetValues(pseudo_delta,1,&col,&ps_delta);
-					value*=ps_delta;
-					VecSetValues(pseudo_right,1,&row,&value,ADD_VALUES);
-				}
+		factor=grid[gid].cell[c].volume/dt[gid].cell(c);
+		for (int i=0;i<5;++i) for (int j=0;j<5;++j) block[i*5+j]=P[i][j]*factor;
+		
+		if (ps_step>1) {
+			VecGetValues(pseudo_delta,5,rows,ps_delta);
+			for (int i=0;i<5;++i) {
+				values[i]=0.;
+				for (int j=0;j<5;++j) values[i]+=block[i*5+j]*ps_delta[j];
 			}
+			VecSetValues(pseudo_right,5,rows,values,ADD_VALUES);
 		}
 	
 		if (ps_step_max>1) {
-			if (preconditioner==WS95) preconditioner_ws95(c,P);	
-			for (int i=0;i<5;++i) {
-				row=(grid[gid].myOffset+c)*5+i;
-				for (int j=0;j<5;++j) {
-					col=(grid[gid].myOffset+c)*5+j;
-					value=P[i][j]*grid[gid].cell[c].volume/dtau[gid].cell(c);
-					MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-				}
-			}
+			if (ws95) preconditioner_ws95(c,deltaPmax[c],P);
+			factor=grid[gid].cell[c].volume/dtau[gid].cell(c);
+			for (int i=0;i<5;++i) for (int j=0;j<5;++j) block[i*5+j]+=P[i][j]*factor;
+		}
+		
+		// Insert the diagonal block at once
+		if (linear_solver==LUSGS) {
+			for (int i=0;i<25;++i) diagBlock[c*25+i]+=block[i];
+		} else {
+			MatSetValues(impOP,5,rows,5,rows,block,ADD_VALUES);
 		}
 		
 	}
@@ -184,4 +184,3 @@ void NavierStokes::time_terms() {
 	
 	return;
 }
-
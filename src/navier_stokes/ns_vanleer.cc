@@ -65,3 +65,7 @@ void vanLeer_flux(NS_Cell_State &left,NS_Cell_State &right,double fluxNormal[],d
 	return;
 } // end vanLeer_flux
 
+
+#include "ns_face_kernel.h"
+// Face loop kernels with this flux function inlined
+NS_FACE_KERNELS(VAN_LEER)
@@ -48,23 +48,10 @@ double Polynomial::eval(double x) {
 	int p;
 	
 	if (type==REGULAR) {
-		for (p=0;p<begin.size()-1;p++) {
-			if (x<begin[p+1]) {
-				// for each coefficient
-				sum+=coeff[p][0];
-				for (int c=1;c<coeff.size();++c) {
-					sum+=coeff[p][c]*pow(x,double(c));	
-				}
-				return sum;
-			}
-		}
-		// If function didn't return above, x is at the last piece
-		// for each coefficient
-		p=begin.size()-1;
-		sum+=coeff[p][0];
-		for (int c=1;c<coeff.size();++c) {
-			sum+=coeff[p][c]*pow(x,double(c));	
-		}
+		// Find the piece x belongs to, x is at the last piece if not found before
+		for (p=0;p<begin.size()-1;p++) if (x<begin[p+1]) break;
+		// Horner's rule
+		for (int c=coeff[p].size()-1;c>=0;--c) sum=sum*x+coeff[p][c];
 		return sum;
 	} else if (type==SCHOMATE) {
 		for (p=0;p<begin.size()-1;p++) {
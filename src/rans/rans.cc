@@ -21,6 +21,8 @@
 
 *************************************************************************/
 #include "rans.h"
+#include "timers.h"
+#include "comm_profile.h"
 
 RANS_Model komega,kepsilon;
 
@@ -79,21 +81,43 @@ void RANS::initialize (int ps_max) {
 	mpi_update_ghost_gradients();
 	petsc_init();
 	first_residuals.resize(2);
+	
+	string coupling=input.section("grid",gid).subsection("turbulence").get_string("coupling");
+	if (coupling=="coupled") {
+		ns[gid].coupled_init();
+	} else if (coupling!="segregated") {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> turbulence -> coupling=" << coupling << " is not recognized" << endl;
+		exit(1);
+	}
 	return;
 }
 
 void RANS::solve  (int ts,int pts) {
+	assemble(ts,pts);
+	timers.start("linear solve"); petsc_solve(); timers.stop();
+	timers.start("update"); update_variables(); timers.stop();
+	timers.start("ghost exchange"); mpi_update_ghost_primitives(); timers.stop();
+	update_auxiliaries();
+	return;
+}
+
+// The coupled Navier-Stokes+RANS solve calls the following separately
+void RANS::assemble (int ts,int pts) {
 	timeStep=ts;
 	ps_step=pts;
-	terms();
-	time_terms();
-	petsc_solve();
-	update_variables();
-	mpi_update_ghost_primitives();
+	timers.start("assembly"); terms(); timers.stop();
+	timers.start("time terms"); time_terms(); timers.stop();
+	return;
+}
+
+// Boundary values, eddy viscosity and gradients after k and omega are updated
+void RANS::update_auxiliaries (void) {
+	timers.start("boundaries");
 	update_boundaries();
 	update_eddy_viscosity();
-	calc_cell_grads();
-	mpi_update_ghost_gradients();
+	timers.stop();
+	timers.start("gradients"); calc_cell_grads(); timers.stop();
+	timers.start("gradient exchange"); mpi_update_ghost_gradients(); timers.stop();
 	return;
 }
 
@@ -238,8 +262,8 @@ void RANS::update_variables(void) {
 		
 	} // cell loop
 
-	MPI_Allreduce(&residuals,&totalResiduals,2, MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-	if (ps_step_max>1) MPI_Allreduce(&ps_residuals,&total_ps_residuals,2, MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+	comm_profile.allreduce("rans residuals",&residuals,&totalResiduals,2,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+	if (ps_step_max>1) comm_profile.allreduce("rans pseudo time residuals",&ps_residuals,&total_ps_residuals,2,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
 	
 	if (timeStep==1) for (int i=0;i<2;++i) first_residuals[i]=sqrt(totalResiduals[i]);
 	if (ps_step_max>1 && ps_step==1) for (int i=0;i<2;++i) first_ps_residuals[i]=sqrt(total_ps_residuals[i]);
@@ -55,6 +55,18 @@ public:
 	double sigma_k,sigma_omega,beta,beta_star,kappa,alpha;
 };
 
+// Working state of the face being assembled
+// Each thread owns one of these so that the face loop can run concurrently
+class RANS_Face_State {
+public:
+	int index,parent,neighbor;
+	double lam_visc,turb_visc;
+	double leftK,leftOmega,rightK,rightOmega,faceK,faceOmega,faceRho;
+	Vec3D gradK,gradOmega,left2right;
+	double mdot,weightL,weightR;
+	bool extrapolated;
+};
+
 class RANS {
 public:
 	int gid; // Grid id
@@ -83,6 +95,11 @@ public:
 	int send_req_count,recv_req_count;
 	vector<MPI_Request> send_request, recv_request;
 	
+	// Assembly buffers
+	vector<double> rhsLocal; // Right hand side of the local cells
+	vector<double> faceJacobians; // Diagonals of the left and right flux Jacobians of the faces of a color
+	vector<double> cellJacobians; // Source Jacobian blocks of the local cells
+	
 	// PETSC variables
 	KSP ksp; // linear solver context
 	PC pc; // preconditioner context
@@ -105,12 +122,18 @@ public:
 	void calc_cell_grads(void);
 	void mpi_update_ghost_gradients(void);
 	void petsc_init(void);
+	void account_memory(void);
 	void petsc_solve(void);
 	void petsc_destroy(void);
 	void solve (int timeStep,int ps_step);
+	void assemble (int timeStep,int ps_step);
+	void update_auxiliaries (void);
 	void initialize_linear_system(void);
-	void get_kOmega(void);
+	void get_kOmega(RANS_Face_State &face);
 	void terms(void);
+	void face_terms(RANS_Face_State &face,int f,double jacobian[]);
+	void insert_face_jacobians(int f,double jacobian[]);
+	void cell_terms(int c,double jacobian[]);
 	void time_terms(void);
 	void update_eddy_viscosity(void);
 	void update_variables(void);
@@ -21,11 +21,12 @@
  
  *************************************************************************/
 #include "rans.h"
+#include "comm_profile.h"
 
 void RANS::mpi_init(void) {
 	
-	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
-	MPI_Comm_size(MPI_COMM_WORLD, &np);
+	MPI_Comm_rank(grid[gid].comm, &Rank);
+	MPI_Comm_size(grid[gid].comm, &np);
 		
 	long unsigned int max_send_size=0;
 	long unsigned int max_recv_size=0;
@@ -80,19 +81,20 @@ void RANS::mpi_update_ghost_primitives(void) {
 					sendBuffer[offset+g*2+1]=omega.cell(id);
 				}
 				
-				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*2,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&send_request[send_req_count]);
+				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*2,MPI_DOUBLE,proc,0,grid[gid].comm,&send_request[send_req_count]);
+				comm_profile.send(grid[gid].worldOffset+proc,grid[gid].sendCells[proc].size()*2*sizeof(double));
 				send_req_count++;
 			}
 			
 			if (grid[gid].recvCells[proc].size()!=0) {
 				offset=mpi_recv_offset[proc];
-				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*2,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&recv_request[recv_req_count]);
+				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*2,MPI_DOUBLE,proc,0,grid[gid].comm,&recv_request[recv_req_count]);
 				recv_req_count++;
 			}
 		}
 	}
 	
-    MPI_Waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
+    comm_profile.waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
 	
 	for (int proc=0;proc<np;++proc) { 
 		if (Rank!=proc) {
@@ -131,19 +133,20 @@ void RANS::mpi_update_ghost_gradients(void) {
 					}
 				}
 				
-				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*6,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&send_request[send_req_count]);
+				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*6,MPI_DOUBLE,proc,0,grid[gid].comm,&send_request[send_req_count]);
+				comm_profile.send(grid[gid].worldOffset+proc,grid[gid].sendCells[proc].size()*6*sizeof(double));
 				send_req_count++;
 			}
 			
 			if (grid[gid].recvCells[proc].size()!=0) {
 				offset=mpi_recv_offset[proc];
-				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*6,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&recv_request[recv_req_count]);
+				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*6,MPI_DOUBLE,proc,0,grid[gid].comm,&recv_request[recv_req_count]);
 				recv_req_count++;
 			}
 		}
 	}
 	
-	MPI_Waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
+	comm_profile.waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
 	
 	for (int proc=0;proc<np;++proc) { 
 		if (Rank!=proc) {
@@ -21,6 +21,9 @@
  
  *************************************************************************/
 #include "rans.h"
+#include "memory_usage.h"
+
+#define GMRES_RESTART 300
 
 void RANS::petsc_init(void) {
 	
@@ -28,9 +31,9 @@ void RANS::petsc_init(void) {
 	vector<int>::iterator it;
 	
 	//Create nonlinear solver context
-	KSPCreate(PETSC_COMM_WORLD,&ksp);
+	KSPCreate(grid[gid].comm,&ksp);
 	
-	VecCreateMPI(PETSC_COMM_WORLD,grid[gid].cellCount*nVars,grid[gid].globalCellCount*nVars,&rhs);
+	VecCreateMPI(grid[gid].comm,grid[gid].cellCount*nVars,grid[gid].globalCellCount*nVars,&rhs);
 	VecSetFromOptions(rhs);
 	VecDuplicate(rhs,&deltaU);
 	if (ps_step_max>1) {
@@ -61,7 +64,7 @@ void RANS::petsc_init(void) {
 	}
 	
 	MatCreateMPIAIJ(
-					PETSC_COMM_WORLD,
+					grid[gid].comm,
 					grid[gid].cellCount*nVars,
 					grid[gid].cellCount*nVars,
 					grid[gid].globalCellCount*nVars,
@@ -76,12 +79,37 @@ void RANS::petsc_init(void) {
 	KSPSetTolerances(ksp,rtol,abstol,1.e15,maxits);
 	KSPSetInitialGuessKnoll(ksp,PETSC_TRUE);
 	KSPSetType(ksp,KSPFGMRES);
-	KSPGMRESSetRestart(ksp,300);
+	KSPGMRESSetRestart(ksp,GMRES_RESTART);
 	KSPSetFromOptions(ksp);
 	
 	return;
 } 
 
+void RANS::account_memory(void) {
+	
+	string prefix="grid "+int2str(gid+1)+"/rans/";
+	double size;
+	
+	size=k.bytes()+omega.bytes()+mu_t.bytes()+strainRate.bytes()+yplus.bytes()+gradk.bytes()+gradomega.bytes();
+	for (int i=0;i<update.size();++i) size+=update[i].bytes();
+	memory_usage.account(prefix+"variables",size);
+	memory_usage.account(prefix+"work arrays",container_bytes(sendBuffer)+container_bytes(recvBuffer)
+		+container_bytes(rhsLocal)+container_bytes(faceJacobians)+container_bytes(cellJacobians));
+	
+	double rows=grid[gid].cellCount*nVars;
+	memory_usage.account(prefix+"petsc vectors",rows*sizeof(PetscScalar)*((ps_step_max>1) ? 5 : 2));
+	
+	MatInfo info;
+	MatGetInfo(impOP,MAT_LOCAL,&info);
+	size=info.nz_allocated*(sizeof(PetscScalar)+sizeof(PetscInt))+2.*rows*sizeof(PetscInt);
+	memory_usage.account(prefix+"matrix",size);
+	// Allocated at the first solve, see NavierStokes::account_memory
+	memory_usage.account(prefix+"krylov workspace",(2.*GMRES_RESTART+4.)*rows*sizeof(PetscScalar),true);
+	memory_usage.account(prefix+"preconditioner",size,true);
+	
+	return;
+}
+
 void RANS::petsc_solve(void) {
 	
 	MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
@@ -49,15 +49,9 @@ void RANS::set_bcs(void) {
 			k.fixedonBC[b]=true; omega.fixedonBC[b]=true;
 			k.bcValue[b].resize(1); omega.bcValue[b].resize(1);
 
-			// TODO: This could be done better
-			// Find a face index that is on this boundary (if any on this partition)
+			// Take a face index that is on this boundary (if any on this partition)
 			int fid=0;
-			for (int f=0;f<grid[gid].faceCount;++f) {
-				if (grid[gid].face[f].bc==b) {
-					fid=f;
-					break;
-				}
-			}
+			if (grid[gid].boundaryFaces[b].size()>0) fid=grid[gid].boundaryFaces[b][0];
 			double rho,T;
 			rho=ns[gid].rho.face(fid);
 			T=ns[gid].T.face(fid);
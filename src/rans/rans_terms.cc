@@ -24,296 +24,328 @@
 
 extern RANS_Model komega,kepsilon;
 
-void get_kOmega(void);
 double get_blending(double &k,double &omega,double &rho,double &y,double &visc,Vec3D &gradK,Vec3D &gradOmega);
 
-int parent,neighbor,f;
-double lam_visc,turb_visc;
-
-double leftK,leftOmega, rightK, rightOmega, faceK, faceOmega, faceRho;
-Vec3D faceGradK, faceGradOmega, left2right;
-
-double mdot,weightL,weightR;
-bool extrapolated;
+// The face loop runs over the face colors as in the Navier-Stokes assembly. Faces of a color
+// are assembled concurrently into the local rhs and a buffer of flux Jacobians, which are
+// then inserted into the PETSc matrix as 2x2 blocks serially.
+// The face viscosity and density come from the Navier-Stokes face store of this iteration
+// and mdot and weightL are stored by the Riemann solver, so none of them are recomputed here.
 
 void RANS::terms(void) {
 
-	double blending;
-	double sigma_k,sigma_omega,beta,beta_star,alpha;
-	double value;
-	double dudx,dudy,dudz,dvdx,dvdy,dvdz,dwdx,dwdy,dwdz;
-	int row,col;
-	double convectiveFlux[2],diffusiveFlux[2],source[2];
-	double jacL[2],jacR[2];
-	double cross_diffusion;
-	double closest_wall_distance;
-
 	MatZeroEntries(impOP); // Flush the implicit operator
 	VecSet(rhs,0.); // Flush the right hand side
 
-	// Loop through faces
-	for (f=0;f<grid[gid].faceCount;++f) {
-		extrapolated=false;
-		if (model==KOMEGA) blending=1.;
-		if (model==KEPSILON) blending=0.;
-		
-		parent=grid[gid].face[f].parent; neighbor=grid[gid].face[f].neighbor;
-		
-		lam_visc=ns[gid].material.viscosity(ns[gid].T.face(f));
-		turb_visc=mu_t.face(f);
-		
-		// Fill in the yplus info for output
+	// Fill in the yplus info for output
+	for (int f=grid[gid].interiorFaceCount;f<grid[gid].faceCount;++f) {
 		int bcno=grid[gid].face[f].bc;
-		if (bcno>=0) {
-			Vec3D tau=ns[gid].tau.bc(bcno,f);
-			double tau_w=fabs((tau-tau.dot(grid[gid].face[f].normal)*grid[gid].face[f].normal));
-			double u_star=sqrt(tau_w/ns[gid].rho.face(f));
-			double height=(grid[gid].face[f].centroid-grid[gid].cell[parent].centroid).dot(grid[gid].face[f].normal);
-			yplus.bc(bcno,f)=ns[gid].rho.face(f)*u_star*height/lam_visc;
+		int parent=grid[gid].face[f].parent;
+		Vec3D tau=ns[gid].tau.bc(bcno,f);
+		double tau_w=fabs((tau-tau.dot(grid[gid].face[f].normal)*grid[gid].face[f].normal));
+		double u_star=sqrt(tau_w/ns[gid].face_store.rho_face(f));
+		double height=(grid[gid].face[f].centroid-grid[gid].cell[parent].centroid).dot(grid[gid].face[f].normal);
+		yplus.bc(bcno,f)=ns[gid].face_store.rho_face(f)*u_star*height/ns[gid].face_store.mu[f];
+	}
+
+	rhsLocal.assign(grid[gid].cellCount*2,0.);
+	
+	int maxColorSize=0;
+	for (int color=0;color<grid[gid].faceColors.size();++color) maxColorSize=max(maxColorSize,int(grid[gid].faceColors[color].size()));
+	faceJacobians.resize(maxColorSize*4);
+	
+	// Thread private face states
+	vector<RANS_Face_State> faceState (thread_count());
+	
+	// Faces of the same color don't share a local cell, so the rhs rows never collide
+	for (int color=0;color<grid[gid].faceColors.size();++color) {
+		int colorSize=grid[gid].faceColors[color].size();
+		#pragma omp parallel for schedule(static)
+		for (int k=0;k<colorSize;++k) {
+			face_terms(faceState[thread_id()],grid[gid].faceColors[color][k],&faceJacobians[k*4]);
 		}
-		
-		// Convective flux is based on mdot calculated through the Riemann solver right after
-		// main flow was updated
-		
-		// The following weights are consistent with the splitting of the Riemann solver.
-		mdot=ns[gid].mdot.face(f);
-		weightL=ns[gid].weightL.face(f);
-		weightR=1.-weightL;
+		// PETSc insertion is not thread safe
+		for (int k=0;k<colorSize;++k) insert_face_jacobians(grid[gid].faceColors[color][k],&faceJacobians[k*4]);
+	}
+	
+	// Now do a cell loop to add the source terms
+	// Cells are independent, the source Jacobians are inserted afterwards
+	cellJacobians.resize(grid[gid].cellCount*4);
+	int cellTotal=grid[gid].cell.size();
+	#pragma omp parallel for schedule(static)
+	for (int c=0;c<cellTotal;++c) {
+		cell_terms(c,(c<grid[gid].cellCount) ? &cellJacobians[c*4] : NULL);
+	}
+	
+	PetscInt rows[2];
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		rows[0]=(grid[gid].myOffset+c)*2; rows[1]=rows[0]+1;
+		MatSetValues(impOP,2,rows,2,rows,&cellJacobians[c*4],ADD_VALUES);
+	}
+	
+	// Fill in rhs vector
+	vector<int> rhsRows (grid[gid].cellCount*2);
+	for (int i=0;i<rhsRows.size();++i) rhsRows[i]=grid[gid].myOffset*2+i;
+	if (rhsRows.size()>0) VecSetValues(rhs,rhsRows.size(),&rhsRows[0],&rhsLocal[0],ADD_VALUES);
+	
+	MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
+	MatAssemblyEnd(impOP,MAT_FINAL_ASSEMBLY);
 
-		// Get left, right and face values of k and omega as well as the face normal gradients
-		get_kOmega();
+	VecAssemblyBegin(rhs);
+	VecAssemblyEnd(rhs);
+	
+	return;
+} // end RANS::terms
 
-		convectiveFlux[0]=mdot*(weightL*leftK+weightR*rightK)*grid[gid].face[f].area;
-		convectiveFlux[1]=mdot*(weightL*leftOmega+weightR*rightOmega)*grid[gid].face[f].area;
+// Fluxes of face f into rhsLocal and the diagonals of its flux Jacobians into
+// jacobian (dF_k/dk_left, dF_omega/dOmega_left, dF_k/dk_right, dF_omega/dOmega_right)
+void RANS::face_terms(RANS_Face_State &face,int f,double jacobian[]) {
+	
+	double blending;
+	double sigma_k,sigma_omega;
+	double convectiveFlux[2],diffusiveFlux[2];
+	double value;
+	
+	face.index=f;
+	face.extrapolated=false;
+	if (model==KOMEGA) blending=1.;
+	if (model==KEPSILON) blending=0.;
+	
+	face.parent=grid[gid].face[f].parent; face.neighbor=grid[gid].face[f].neighbor;
+	double area=grid[gid].face[f].area;
+	int bc=grid[gid].face[f].bc;
+	
+	// Face properties reconstructed by the Navier-Stokes face loop of this iteration
+	face.lam_visc=ns[gid].face_store.mu[f];
+	face.turb_visc=mu_t.face(f);
+	
+	// Convective flux is based on mdot calculated through the Riemann solver right after
+	// main flow was updated
+	
+	// The following weights are consistent with the splitting of the Riemann solver.
+	face.mdot=ns[gid].mdot.face(f);
+	face.weightL=ns[gid].weightL.face(f);
+	face.weightR=1.-face.weightL;
 
-		// Diffusive k and omega fluxes	
-		if (model==BSL || model==SST) {
-			closest_wall_distance=grid[gid].cell[parent].closest_wall_distance;
-			blending=get_blending(faceK,faceOmega,faceRho,closest_wall_distance,lam_visc,faceGradK,faceGradOmega);
-		}
-		
-		sigma_omega=blending*komega.sigma_omega+(1.-blending)*kepsilon.sigma_omega;
-		sigma_k=blending*komega.sigma_k+(1.-blending)*kepsilon.sigma_k;
-		alpha=blending*komega.alpha+(1.-blending)*kepsilon.alpha;
-		beta=blending*komega.beta+(1.-blending)*kepsilon.beta;
-		beta_star=blending*komega.beta_star+(1.-blending)*kepsilon.beta_star;
-	
-		diffusiveFlux[0]=(lam_visc+turb_visc*sigma_k)*faceGradK.dot(grid[gid].face[f].normal)*grid[gid].face[f].area;
-		diffusiveFlux[1]=(lam_visc+turb_visc*sigma_omega)*faceGradOmega.dot(grid[gid].face[f].normal)*grid[gid].face[f].area;
-
-		// Fill in rhs vector for rans scalars
-		for (int i=0;i<2;++i) {
-			row=(grid[gid].myOffset+parent)*2+i;
-			value=diffusiveFlux[i]-convectiveFlux[i];
-			VecSetValues(rhs,1,&row,&value,ADD_VALUES);
-			if (grid[gid].face[f].bc==INTERNAL_FACE) { 
-				row=(grid[gid].myOffset+neighbor)*2+i;
-				value*=-1.;
-				VecSetValues(rhs,1,&row,&value,ADD_VALUES);
-			}
-		}
-		
-		// Calculate flux jacobians
-		
-		// Assumes k flux doesn't change with omega and vice versa 
-		// This is true for convective flux (effect of mu_t in diffusive flux ignored)
-		double l2rmag=fabs(left2right);
-		double AoverH=grid[gid].face[f].area*grid[gid].face[f].normal.dot(left2right.norm())/(l2rmag);
-		// dF_k/dk_left
-		jacL[0]=weightL*mdot*grid[gid].face[f].area; // convective
-		if (extrapolated) jacL[0]+=weightR*mdot*grid[gid].face[f].area; // convective
-		if (!extrapolated) jacL[0]+=(lam_visc+turb_visc*sigma_k)*AoverH; // diffusive
-
-		// dF_omega/dOmega_left
-		jacL[1]=weightL*mdot*grid[gid].face[f].area; // convective
-		if (extrapolated) jacL[1]+=weightR*mdot*grid[gid].face[f].area; // convective
-		if (!extrapolated) jacL[1]+=(lam_visc+turb_visc*sigma_omega)*AoverH; // diffusive
-
-		if (grid[gid].face[f].bc<0) {
-			// dF_k/dk_right
-			jacR[0]=weightR*mdot*grid[gid].face[f].area; // convective
-			jacR[0]-=(lam_visc+turb_visc*sigma_k)*AoverH; // diffusive
-			// dF_omega/dOmega_right
-			jacR[1]=weightR*mdot*grid[gid].face[f].area; // convective
-			jacR[1]-=(lam_visc+turb_visc*sigma_omega)*AoverH; // diffusive
-		}
-		
-		// Insert flux jacobians for the parent cell
-		// left_k/left_k
-		row=(grid[gid].myOffset+parent)*2; col=row; value=jacL[0];
-		MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-		// left_omega/left_omega
-		row++; col++; value=jacL[1];
-		MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-		if (grid[gid].face[f].bc==INTERNAL_FACE) { 
-			// left_k/right_k
-			row=(grid[gid].myOffset+parent)*2; col=(grid[gid].myOffset+neighbor)*2; value=jacR[0];
-			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-			// left_omega/right_omega
-			row++; col++; value=jacR[1];
-			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-			
-			// Insert flux jacobians for the neighbor cell
-			// right_k/right_k
-			row=(grid[gid].myOffset+neighbor)*2; col=row; value=-jacR[0];
-			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-			// right_omega/right_omega
-			row++; col++; value=-jacR[1];
-			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-			// right_k/left_k
-			row=(grid[gid].myOffset+neighbor)*2; col=(grid[gid].myOffset+parent)*2; value=-jacL[0];
-			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-			// right_omega/left_omega
-			row++; col++; value=-jacL[1];
-			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-		} else if (grid[gid].face[f].bc==PARTITION_FACE) { 
-			// left_k/right_k
-			row=(grid[gid].myOffset+parent)*2; col=(grid[gid].cell[neighbor].matrix_id)*2; value=jacR[0];
-			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-			// left_omega/right_omega
-			row++; col++; value=jacR[1];
-			MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-		}
+	// Get left, right and face values of k and omega as well as the face normal gradients
+	get_kOmega(face);
+
+	convectiveFlux[0]=face.mdot*(face.weightL*face.leftK+face.weightR*face.rightK)*area;
+	convectiveFlux[1]=face.mdot*(face.weightL*face.leftOmega+face.weightR*face.rightOmega)*area;
 
-	} // for faces
+	// Diffusive k and omega fluxes	
+	if (model==BSL || model==SST) {
+		double closest_wall_distance=grid[gid].cell[face.parent].closest_wall_distance;
+		blending=get_blending(face.faceK,face.faceOmega,face.faceRho,closest_wall_distance,face.lam_visc,face.gradK,face.gradOmega);
+	}
 	
-	// Now do a cell loop to add the unsteady and source terms
-	double divU,Prod_k,Dest_k;
-	for (int c=0;c<grid[gid].cell.size();++c) {
+	sigma_omega=blending*komega.sigma_omega+(1.-blending)*kepsilon.sigma_omega;
+	sigma_k=blending*komega.sigma_k+(1.-blending)*kepsilon.sigma_k;
 
-		if (model==BSL || model==SST) {
-			blending=get_blending(k.cell(c),omega.cell(c),ns[gid].rho.cell(c),grid[gid].cell[c].closest_wall_distance,lam_visc,gradk.cell(c),gradomega.cell(c));
-		}
+	diffusiveFlux[0]=(face.lam_visc+face.turb_visc*sigma_k)*face.gradK.dot(grid[gid].face[f].normal)*area;
+	diffusiveFlux[1]=(face.lam_visc+face.turb_visc*sigma_omega)*face.gradOmega.dot(grid[gid].face[f].normal)*area;
 
-		sigma_omega=blending*komega.sigma_omega+(1.-blending)*kepsilon.sigma_omega;
-		sigma_k=blending*komega.sigma_k+(1.-blending)*kepsilon.sigma_k;
-		alpha=blending*komega.alpha+(1.-blending)*kepsilon.alpha;
-		beta=blending*komega.beta+(1.-blending)*kepsilon.beta;
-		beta_star=blending*komega.beta_star+(1.-blending)*kepsilon.beta_star;
-		
-		// Calculate the source terms
-			
-		dudx=ns[gid].gradu.cell(c)[0];
-		dudy=ns[gid].gradu.cell(c)[1];
-		dudz=ns[gid].gradu.cell(c)[2];
-		
-		dvdx=ns[gid].gradv.cell(c)[0];
-		dvdy=ns[gid].gradv.cell(c)[1];
-		dvdz=ns[gid].gradv.cell(c)[2];
-		
-		dwdx=ns[gid].gradw.cell(c)[0];
-		dwdy=ns[gid].gradw.cell(c)[1];
-		dwdz=ns[gid].gradw.cell(c)[2];
-		
-		divU=dudx+dvdy+dwdz;
-		// sr or strainRate variable here is actually the term: sqrt(2*S_ij*S_ij)
-		// Where S_ij=1/2*(du_i/dx_j+du_j/dx_i) is the proper strain rate tensor
-		double sr=sqrt(2.*(dudx*dudx + dvdy*dvdy + dwdz*dwdz)
-				+ (dudy+dvdx)*(dudy+dvdx) + (dudz+dwdx)*(dudz+dwdx)
-				+ (dvdz+dwdy)*(dvdz+dwdy)
-			       );
-		
-		// Store this for sst model
-		strainRate.cell(c)=sr;
+	// Fill in rhs for rans scalars
+	for (int i=0;i<2;++i) {
+		value=diffusiveFlux[i]-convectiveFlux[i];
+		rhsLocal[face.parent*2+i]+=value;
+		if (bc==INTERNAL_FACE) rhsLocal[face.neighbor*2+i]-=value;
+	}
 	
-		if (c>=grid[gid].cellCount) continue;
+	// Calculate flux jacobians
 	
-		Prod_k=mu_t.cell(c)*(sr*sr-2./3.*divU*divU)-2./3.*ns[gid].rho.cell(c)*k.cell(c)*divU;
-		Dest_k=beta_star*ns[gid].rho.cell(c)*omega.cell(c)*k.cell(c);
-		
-		// Limit production of k
-		Prod_k=min(Prod_k,10.*Dest_k);
-		
-		cross_diffusion=0.;
-		if (model!=KOMEGA) cross_diffusion=gradk.cell(c).dot(gradomega.cell(c));
-			
-		source[0]=Prod_k; // k production
-		source[0]-=Dest_k; // k destruction
-		
-		source[1]=alpha*ns[gid].rho.cell(c)/mu_t.cell(c)*Prod_k; // omega production
-		source[1]-=beta*ns[gid].rho.cell(c)*omega.cell(c)*omega.cell(c); // omega destruction
-				
-		source[1]+=2.*(1.-blending)*ns[gid].rho.cell(c)*komega.sigma_omega*cross_diffusion/omega.cell(c);
-		
-		// Add source terms to rhs
-		for (int i=0;i<2;++i) {
-			row=(grid[gid].myOffset+c)*2+i;
-			value=source[i]*grid[gid].cell[c].volume;
-			VecSetValues(rhs,1,&row,&value,ADD_VALUES);
-		}
-		
-		// Add source jacobians
-		// Only include destruction terms
-		
-		// dS_k/dk
-		row=(grid[gid].myOffset+c)*2; col=row;
-		value=beta_star*ns[gid].rho.cell(c)*omega.cell(c)*grid[gid].cell[c].volume; // approximate 
-		MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-		
-		// dS_k/dOmega
-		col++; 
-		value=beta_star*ns[gid].rho.cell(c)*k.cell(c)*grid[gid].cell[c].volume; 
-		MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-		
-		// dS_omega/dOmega
-		row++; 
-		value=2.*beta*ns[gid].rho.cell(c)*omega.cell(c)*grid[gid].cell[c].volume; // approximate
-		// Add cross-diffusion term jacobian
-		value+=2.*(1.-blending)*komega.sigma_omega*komega.sigma_omega*cross_diffusion/(omega.cell(c)*omega.cell(c))*grid[gid].cell[c].volume;
-		MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+	// Assumes k flux doesn't change with omega and vice versa 
+	// This is true for convective flux (effect of mu_t in diffusive flux ignored)
+	double l2rmag=fabs(face.left2right);
+	double AoverH=area*grid[gid].face[f].normal.dot(face.left2right.norm())/(l2rmag);
+	// dF_k/dk_left
+	jacobian[0]=face.weightL*face.mdot*area; // convective
+	if (face.extrapolated) jacobian[0]+=face.weightR*face.mdot*area; // convective
+	if (!face.extrapolated) jacobian[0]+=(face.lam_visc+face.turb_visc*sigma_k)*AoverH; // diffusive
+
+	// dF_omega/dOmega_left
+	jacobian[1]=face.weightL*face.mdot*area; // convective
+	if (face.extrapolated) jacobian[1]+=face.weightR*face.mdot*area; // convective
+	if (!face.extrapolated) jacobian[1]+=(face.lam_visc+face.turb_visc*sigma_omega)*AoverH; // diffusive
+
+	jacobian[2]=jacobian[3]=0.;
+	if (bc<0) {
+		// dF_k/dk_right
+		jacobian[2]=face.weightR*face.mdot*area; // convective
+		jacobian[2]-=(face.lam_visc+face.turb_visc*sigma_k)*AoverH; // diffusive
+		// dF_omega/dOmega_right
+		jacobian[3]=face.weightR*face.mdot*area; // convective
+		jacobian[3]-=(face.lam_visc+face.turb_visc*sigma_omega)*AoverH; // diffusive
+	}
+	
+	return;
+} // end face_terms
 
+void RANS::insert_face_jacobians(int f,double jacobian[]) {
+	
+	int parent=grid[gid].face[f].parent;
+	int neighbor=grid[gid].face[f].neighbor;
+	int bc=grid[gid].face[f].bc;
+	PetscInt rows[2],cols[2];
+	double block[4];
+	
+	// k and omega fluxes are decoupled, so each 2x2 block is diagonal
+	rows[0]=(grid[gid].myOffset+parent)*2; rows[1]=rows[0]+1;
+	// left/left
+	block[0]=jacobian[0]; block[1]=0.;
+	block[2]=0.; block[3]=jacobian[1];
+	MatSetValues(impOP,2,rows,2,rows,block,ADD_VALUES);
+	if (bc==INTERNAL_FACE) {
+		cols[0]=(grid[gid].myOffset+neighbor)*2; cols[1]=cols[0]+1;
+		// right/left
+		block[0]=-jacobian[0]; block[3]=-jacobian[1];
+		MatSetValues(impOP,2,cols,2,rows,block,ADD_VALUES);
+		// right/right
+		block[0]=-jacobian[2]; block[3]=-jacobian[3];
+		MatSetValues(impOP,2,cols,2,cols,block,ADD_VALUES);
+		// left/right
+		block[0]=jacobian[2]; block[3]=jacobian[3];
+		MatSetValues(impOP,2,rows,2,cols,block,ADD_VALUES);
+	} else if (bc==PARTITION_FACE) {
+		// left/right, the effect on the ghost is taken care of in its own partition
+		cols[0]=(grid[gid].cell[neighbor].matrix_id)*2; cols[1]=cols[0]+1;
+		block[0]=jacobian[2]; block[3]=jacobian[3];
+		MatSetValues(impOP,2,rows,2,cols,block,ADD_VALUES);
+	}
+	
+	return;
+} // end insert_face_jacobians
+
+// Strain rate of cell c and, for the local cells, the source terms into rhsLocal and
+// the source Jacobian block into jacobian
+void RANS::cell_terms(int c,double jacobian[]) {
+
+	double blending;
+	double beta,beta_star,alpha;
+	double dudx,dudy,dudz,dvdx,dvdy,dvdz,dwdx,dwdy,dwdz;
+	double divU,Prod_k,Dest_k;
+	double source[2];
+	double cross_diffusion;
+	
+	if (model==KOMEGA) blending=1.;
+	if (model==KEPSILON) blending=0.;
+	if (model==BSL || model==SST) {
+		double lam_visc=ns[gid].material.viscosity(ns[gid].T.cell(c));
+		blending=get_blending(k.cell(c),omega.cell(c),ns[gid].rho.cell(c),grid[gid].cell[c].closest_wall_distance,lam_visc,gradk.cell(c),gradomega.cell(c));
+	}
+
+	alpha=blending*komega.alpha+(1.-blending)*kepsilon.alpha;
+	beta=blending*komega.beta+(1.-blending)*kepsilon.beta;
+	beta_star=blending*komega.beta_star+(1.-blending)*kepsilon.beta_star;
+	
+	// Calculate the source terms
 		
-	} // end cell loop
+	dudx=ns[gid].gradu.cell(c)[0];
+	dudy=ns[gid].gradu.cell(c)[1];
+	dudz=ns[gid].gradu.cell(c)[2];
 	
-	MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
-	MatAssemblyEnd(impOP,MAT_FINAL_ASSEMBLY);
+	dvdx=ns[gid].gradv.cell(c)[0];
+	dvdy=ns[gid].gradv.cell(c)[1];
+	dvdz=ns[gid].gradv.cell(c)[2];
+	
+	dwdx=ns[gid].gradw.cell(c)[0];
+	dwdy=ns[gid].gradw.cell(c)[1];
+	dwdz=ns[gid].gradw.cell(c)[2];
+	
+	divU=dudx+dvdy+dwdz;
+	// sr or strainRate variable here is actually the term: sqrt(2*S_ij*S_ij)
+	// Where S_ij=1/2*(du_i/dx_j+du_j/dx_i) is the proper strain rate tensor
+	double sr=sqrt(2.*(dudx*dudx + dvdy*dvdy + dwdz*dwdz)
+			+ (dudy+dvdx)*(dudy+dvdx) + (dudz+dwdx)*(dudz+dwdx)
+			+ (dvdz+dwdy)*(dvdz+dwdy)
+		       );
+	
+	// Store this for sst model
+	strainRate.cell(c)=sr;
 
-	VecAssemblyBegin(rhs);
-	VecAssemblyEnd(rhs);
+	if (c>=grid[gid].cellCount) return;
+
+	double rho=ns[gid].rho.cell(c);
+	double volume=grid[gid].cell[c].volume;
+	
+	Prod_k=mu_t.cell(c)*(sr*sr-2./3.*divU*divU)-2./3.*rho*k.cell(c)*divU;
+	Dest_k=beta_star*rho*omega.cell(c)*k.cell(c);
+	
+	// Limit production of k
+	Prod_k=min(Prod_k,10.*Dest_k);
+	
+	cross_diffusion=0.;
+	if (model!=KOMEGA) cross_diffusion=gradk.cell(c).dot(gradomega.cell(c));
+		
+	source[0]=Prod_k; // k production
+	source[0]-=Dest_k; // k destruction
+	
+	source[1]=alpha*rho/mu_t.cell(c)*Prod_k; // omega production
+	source[1]-=beta*rho*omega.cell(c)*omega.cell(c); // omega destruction
+			
+	source[1]+=2.*(1.-blending)*rho*komega.sigma_omega*cross_diffusion/omega.cell(c);
+	
+	// Add source terms to rhs
+	for (int i=0;i<2;++i) rhsLocal[c*2+i]+=source[i]*volume;
+	
+	// Source jacobians
+	// Only include destruction terms
+	
+	// dS_k/dk
+	jacobian[0]=beta_star*rho*omega.cell(c)*volume; // approximate 
+	// dS_k/dOmega
+	jacobian[1]=beta_star*rho*k.cell(c)*volume; 
+	// dS_omega/dk
+	jacobian[2]=0.;
+	// dS_omega/dOmega
+	jacobian[3]=2.*beta*rho*omega.cell(c)*volume; // approximate
+	// Add cross-diffusion term jacobian
+	jacobian[3]+=2.*(1.-blending)*komega.sigma_omega*komega.sigma_omega*cross_diffusion/(omega.cell(c)*omega.cell(c))*volume;
 	
 	return;
-} // end RANS::terms
+} // end cell_terms
 
-void RANS::get_kOmega() {
+void RANS::get_kOmega(RANS_Face_State &face) {
 	
-	leftK=k.cell(parent);
-	leftOmega=omega.cell(parent);
-	rightK=k.cell(neighbor);
-	rightOmega=omega.cell(neighbor);
+	int f=face.index;
+	face.leftK=k.cell(face.parent);
+	face.leftOmega=omega.cell(face.parent);
+	face.rightK=k.cell(face.neighbor);
+	face.rightOmega=omega.cell(face.neighbor);
 	
 	int bcno=grid[gid].face[f].bc;
 	if (bcno>=0) {
 		if (bc[gid][bcno].type==SYMMETRY || bc[gid][bcno].type==OUTLET) {
-			extrapolated=true;
+			face.extrapolated=true;
 		} else if (bc[gid][bcno].type==WALL && bc[gid][bcno].kind==SLIP) {
-			extrapolated=true;
+			face.extrapolated=true;
 		}
-		faceGradK=gradk.cell(parent);
-		faceGradOmega=gradomega.cell(parent);
+		face.gradK=gradk.cell(face.parent);
+		face.gradOmega=gradomega.cell(face.parent);
 	} else {
-		faceGradK=gradk.face(f);
-		faceGradOmega=gradomega.face(f);
+		face.gradK=gradk.face(f);
+		face.gradOmega=gradomega.face(f);
 	}
 
-	faceK=k.face(f);
-	faceOmega=omega.face(f);
-	faceRho=ns[gid].rho.face(f);
+	// Face values are only needed for the blending function
+	if (model==BSL || model==SST) {
+		face.faceK=k.face(f);
+		face.faceOmega=omega.face(f);
+	}
+	face.faceRho=ns[gid].face_store.rho_face(f);
 
 	// Find distance between left and right centroids 
-	Vec3D leftCentroid,rightCentroid;
-	leftCentroid=grid[gid].cell[parent].centroid;
-	rightCentroid=grid[gid].cell[neighbor].centroid;
-	left2right=rightCentroid-leftCentroid;
+	face.left2right=grid[gid].cell[face.neighbor].centroid-grid[gid].cell[face.parent].centroid;
 	
-	Vec3D l2rnormal=left2right;
+	Vec3D l2rnormal=face.left2right;
 	l2rnormal=l2rnormal.norm();
-	double l2rmag=fabs(left2right);
+	double l2rmag=fabs(face.left2right);
 	
-	faceGradK-=faceGradK.dot(l2rnormal)*l2rnormal;
-	faceGradK+=((rightK-leftK)/(l2rmag))*l2rnormal;
+	face.gradK-=face.gradK.dot(l2rnormal)*l2rnormal;
+	face.gradK+=((face.rightK-face.leftK)/(l2rmag))*l2rnormal;
 	
-	faceGradOmega-=faceGradOmega.dot(l2rnormal)*l2rnormal;
-	faceGradOmega+=((rightOmega-leftOmega)/(l2rmag))*l2rnormal;
+	face.gradOmega-=face.gradOmega.dot(l2rnormal)*l2rnormal;
+	face.gradOmega+=((face.rightOmega-face.leftOmega)/(l2rmag))*l2rnormal;
 
 	return;	
 }
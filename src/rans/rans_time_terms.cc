@@ -24,56 +24,50 @@
 
 void RANS::time_terms() {
 
-	PetscInt row,col;
-	PetscScalar value;
+	PetscInt rows[2];
+	PetscScalar values[2];
 	
 	if (ps_step_max>1) {
+		for (int c=0;c<grid[gid].cellCount;++c) {
+			rows[0]=(grid[gid].myOffset+c)*2; rows[1]=rows[0]+1;
+			values[0]=k.cell(c);
+			values[1]=omega.cell(c);
+			if (ps_step==1) VecSetValues(soln_n,2,rows,values,INSERT_VALUES);
+			else VecSetValues(pseudo_delta,2,rows,values,INSERT_VALUES); // pseudo_delta=soln_k
+		}
 		if (ps_step==1) {
-			for (int c=0;c<grid[gid].cellCount;++c) {
-				row=(grid[gid].myOffset+c)*2;
-				value=k.cell(c);
-				VecSetValues(soln_n,1,&row,&value,INSERT_VALUES);
-				row++; value=omega.cell(c); VecSetValues(soln_n,1,&row,&value,INSERT_VALUES);
-			}
 			VecAssemblyBegin(soln_n); VecAssemblyEnd(soln_n);
-		} else if (ps_step>1) {
-			for (int c=0;c<grid[gid].cellCount;++c) {
-				row=(grid[gid].myOffset+c)*2;
-				value=k.cell(c);
-				VecSetValues(pseudo_delta,1,&row,&value,INSERT_VALUES);
-				row++; value=omega.cell(c); VecSetValues(pseudo_delta,1,&row,&value,INSERT_VALUES);
-			} // pseudo_delta=soln_k
-			VecAXPY(pseudo_delta,-1.,soln_n); // pseudo_delta-=soln_n
+		} else {
 			VecAssemblyBegin(pseudo_delta); VecAssemblyEnd(pseudo_delta);
+			VecAXPY(pseudo_delta,-1.,soln_n); // pseudo_delta-=soln_n
 			VecSet(pseudo_right,0.);
 		}
 	}
 	
+	double block[4];
+	double ps_delta[2];
+	double value;
+	
 	for (int c=0;c<grid[gid].cellCount;++c) {
 
-		double ps_delta;
+		rows[0]=(grid[gid].myOffset+c)*2; rows[1]=rows[0]+1;
 		
-		// Insert unsteady term
+		// Unsteady term
+		value=ns[gid].rho.cell(c)*grid[gid].cell[c].volume/dt[gid].cell(c);
 		
-		for (int i=0;i<2;++i) {
-			row=(grid[gid].myOffset+c)*2+i;
-			value=ns[gid].rho.cell(c)*grid[gid].cell[c].volume/dt[gid].cell(c);
-			MatSetValues(impOP,1,&row,1,&row,&value,ADD_VALUES);
-			if (ps_step>1) {
-				VecGetValues(pseudo_delta,1,&row,&ps_delta);
-				value*=ps_delta;
-				VecSetValues(pseudo_right,1,&row,&value,ADD_VALUES);
-			}
+		if (ps_step>1) {
+			VecGetValues(pseudo_delta,2,rows,ps_delta);
+			values[0]=value*ps_delta[0];
+			values[1]=value*ps_delta[1];
+			VecSetValues(pseudo_right,2,rows,values,ADD_VALUES);
 		}
 
-
-		if (ps_step_max>1) {
-			for (int i=0;i<2;++i) {
-				row=(grid[gid].myOffset+c)*2+i;
-				value=ns[gid].rho.cell(c)*grid[gid].cell[c].volume/dtau[gid].cell(c);
-				MatSetValues(impOP,1,&row,1,&row,&value,ADD_VALUES);
-			}
-		}
+		if (ps_step_max>1) value+=ns[gid].rho.cell(c)*grid[gid].cell[c].volume/dtau[gid].cell(c);
+		
+		// Insert the diagonal block at once
+		block[0]=value; block[1]=0.;
+		block[2]=0.; block[3]=value;
+		MatSetValues(impOP,2,rows,2,rows,block,ADD_VALUES);
 		
 	}
 	
@@ -85,4 +79,3 @@ void RANS::time_terms() {
 	
 	return;
 }
-
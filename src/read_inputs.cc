@@ -38,11 +38,24 @@ void read_inputs(void) {
 	input.read("reference");
 	
 	input.registerSection("grid",numbered,required);
-	input.section("grid",0).register_string("file",required);
+	input.section("grid",0).register_string("file",optional,"none");
 	input.section("grid",0).register_string("format",optional,"cgns");
 	input.section("grid",0).register_int("dimension",optional,3);
+	input.section("grid",0).register_string("walldistance",optional,"tree");
+	input.section("grid",0).register_int("ranks",optional,0);
+	input.section("grid",0).register_string("metricscache",optional,"off");
 	input.section("grid",0).register_string("equations",required);
 
+	input.section("grid",0).registerSubsection("box",single,optional);
+	input.section("grid",0).subsection("box").register_Vec3D("cells",optional,Vec3D(10.,10.,10.));
+	input.section("grid",0).subsection("box").register_Vec3D("corner_1",optional,0.);
+	input.section("grid",0).subsection("box").register_Vec3D("corner_2",optional,1.);
+	input.section("grid",0).subsection("box").register_Vec3D("stretching",optional,1.);
+	input.section("grid",0).subsection("box").register_string("elements",optional,"hex");
+	input.section("grid",0).subsection("box").register_double("perturbation",optional,0.);
+	input.section("grid",0).subsection("box").register_int("seed",optional,1);
+	input.section("grid",0).subsection("box").register_stringList("patches",optional);
+
 	input.section("grid",0).registerSubsection("gradients",single,optional);
 	input.section("grid",0).subsection("gradients").register_string("hexmethod",optional,"curvilinear");
 	input.section("grid",0).subsection("gradients").register_string("prismmethod",optional,"curvilinear");
@@ -115,6 +128,7 @@ void read_inputs(void) {
 	input.section("grid",0).subsection("turbulence").register_double("absolutetolerance",optional,1.e-12);
 	input.section("grid",0).subsection("turbulence").register_int("maximumiterations",optional,10);	
 	input.section("grid",0).subsection("turbulence").register_string("model",optional,"sst");
+	input.section("grid",0).subsection("turbulence").register_string("coupling",optional,"segregated");
 	input.section("grid",0).subsection("turbulence").register_double("klowlimit",optional,1.e-10);
 	input.section("grid",0).subsection("turbulence").register_double("khighlimit",optional,1.e8);
 	input.section("grid",0).subsection("turbulence").register_double("omegalowlimit",optional,1.e-2);
@@ -127,17 +141,22 @@ void read_inputs(void) {
 	input.section("grid",0).subsection("navierstokes").register_int("maximumiterations",optional,10);	
 	input.section("grid",0).subsection("navierstokes").register_string("limiter",optional,"vk");
 	input.section("grid",0).subsection("navierstokes").register_double("limiterthreshold",optional,0.);
+	input.section("grid",0).subsection("navierstokes").register_double("limiterfreezeresidual",optional,0.);
+	input.section("grid",0).subsection("navierstokes").register_int("limiterfreezestep",optional,0);
 	input.section("grid",0).subsection("navierstokes").register_string("order",optional,"second");
 	input.section("grid",0).subsection("navierstokes").register_string("jacobianorder",optional,"first");
 	input.section("grid",0).subsection("navierstokes").register_string("convectiveflux",optional,"AUSM+up");
 	input.section("grid",0).subsection("navierstokes").register_double("walldissipation",optional,0.3);
 	input.section("grid",0).subsection("navierstokes").register_double("BLheight",optional,0.);
+	input.section("grid",0).subsection("navierstokes").register_string("linearsolver",optional,"krylov");
+	input.section("grid",0).subsection("navierstokes").register_int("sweeps",optional,2);
 	
 	
 	input.section("grid",0).registerSubsection("heatconduction",single,optional);
 	input.section("grid",0).subsection("heatconduction").register_double("relativetolerance",optional,1.e-6);
 	input.section("grid",0).subsection("heatconduction").register_double("absolutetolerance",optional,1.e-12);
 	input.section("grid",0).subsection("heatconduction").register_int("maximumiterations",optional,10);	
+	input.section("grid",0).subsection("heatconduction").register_int("operatorrefresh",optional,0);
 	
 	input.section("grid",0).registerSubsection("transform",numbered,optional);
 	input.section("grid",0).subsection("transform",0).register_string("function",optional);
@@ -175,6 +194,17 @@ void read_inputs(void) {
 	input.section("pseudotime").register_int("updatefrequency",optional,1000000);
 	input.read("pseudotime");
 	
+	input.registerSection("profiling",single,optional);
+	input.section("profiling").register_string("timers",optional,"off");
+	input.section("profiling").register_string("trace",optional,"off");
+	input.section("profiling").register_string("memory",optional,"off");
+	input.section("profiling").register_string("communication",optional,"off");
+	input.read("profiling");
+	
+	input.registerSection("multiplegrids",single,optional);
+	input.section("multiplegrids").register_string("execution",optional,"sequential");
+	input.read("multiplegrids");
+	
 	input.readEntries();
 	
 	// Read the material file for each grid
@@ -210,6 +240,11 @@ void read_inputs(void) {
 			material_input[gid].section("thermalconductivity").register_string("model",optional,"constantPrandtl");
 			material_input[gid].section("thermalconductivity").register_double("Pr",optional,0.7);
 			material_input[gid].read("thermalconductivity");
+			material_input[gid].registerSection("propertytables",single,optional);
+			material_input[gid].section("propertytables").register_double("Tmin",optional,50.);
+			material_input[gid].section("propertytables").register_double("Tmax",optional,5000.);
+			material_input[gid].section("propertytables").register_double("tolerance",optional,1.e-5);
+			material_input[gid].read("propertytables");
 			material_input[gid].readEntries();
 		}
 	}
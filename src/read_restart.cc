@@ -48,10 +48,10 @@ void read_restart(int gid,int restart_step,double &time) {
 	// Read partitionMap
 	string fileName="./restart/partitionMap_"+int2str(gid+1)+".dat";
 	int nprocs,cellGlobalId;
-	int ncells[np],nnodes[np];
+	int ncells[grid[gid].np],nnodes[grid[gid].np];
 	file.open(fileName.c_str(),ios::in);	
 	if (!file.is_open()) {
-		if (Rank==0) cerr << "[E] Restart file " << fileName  << " couldn't be opened" << endl;
+		if (grid[gid].Rank==0) cerr << "[E] Restart file " << fileName  << " couldn't be opened" << endl;
 		exit(1);
 	}
 	file >> nprocs;
@@ -72,7 +72,7 @@ void read_restart(int gid,int restart_step,double &time) {
 	string dirname="./restart/"+int2str(restart_step);
 	fileName=dirname+"/time.dat";
 	double dump;
-	if (Rank==0) { 
+	if (grid[gid].Rank==0) { 
 		file.open(fileName.c_str());
 		// Read physical time
 		file >> time;
@@ -24,6 +24,7 @@
 #include "inputs.h"
 #include "bc.h"
 #include "bc_interface.h"
+#include "comm_profile.h"
 
 extern InputFile input;
 extern vector<Grid> grid;
@@ -32,6 +33,47 @@ extern vector<vector<BC_Interface> > interface;
 extern vector<int> equations;
 extern vector<bool> turbulent;
 
+// Interfaces received by each BC region of the grid
+// This only needs the input, it runs on every rank so that the interface setup and
+// exchanges can span the ranks of both grids when the grids run concurrently
+void set_interfaces(int gid) {
+	
+	int count=input.section("grid",gid).subsection("BC",0).count;
+	for (int b=0;b<count;++b) {
+		string inter=input.section("grid",gid).subsection("BC",b).get_string("interface");
+		if (inter!="none") {
+			int id=interface[gid].size();
+			interface[gid].resize(id+1);
+			string var,temp;
+			int donor_grid,donor_bc;
+			extract_in_between(inter,"get","from",var);
+			extract_in_between(inter,"grid","bc",temp);
+			interface[gid][id].donor_grid=atoi(temp.c_str())-1;
+			interface[gid][id].donor_bc=atoi(inter.c_str())-1;
+			interface[gid][id].donor_var=var;
+			interface[gid][id].donor_eqn=equations[interface[gid][id].donor_grid];			
+			interface[gid][id].recv_grid=gid;
+			interface[gid][id].recv_bc=b;
+			interface[gid][id].recv_eqn=equations[gid];
+		} // end if interface!=none
+	}
+	
+	// Loop each interface to fill in recv_var
+	for (int g=0;g<grid.size();++g) {
+		for (int i=0;i<interface[g].size();++i) {
+			// Loop donor interfaces
+			for (int d=0;d<interface[interface[g][i].recv_grid].size();++d) {
+				if (interface[g][i].recv_bc==interface[interface[g][i].recv_grid][d].donor_bc) {
+					interface[g][i].recv_var=interface[interface[g][i].recv_grid][d].donor_var;
+					break;
+				}
+			}
+		}
+	}
+	
+	return;
+}
+
 void set_bcs(int gid) {
 	
 	// Loop through each boundary condition region and apply sequentially
@@ -56,7 +98,7 @@ void set_bcs(int gid) {
 		}
 
 		if (region.get_string("region")=="box") {
-			for (int f=0;f<grid[gid].faceCount;++f) {
+			for (int f=grid[gid].interiorFaceCount;f<grid[gid].faceCount;++f) {
 				// if the face is not already marked as internal or partition boundary
 				// And if the face centroid falls within the defined box
 				if ((grid[gid].face[f].bc>=0 || grid[gid].face[f].bc==UNASSIGNED_FACE ) && withinBox(grid[gid].face[f].centroid,region.get_Vec3D("corner_1"),region.get_Vec3D("corner_2"))) {
@@ -83,7 +125,7 @@ void set_bcs(int gid) {
 		// Integrate boundary areas
 		bcRegion.area=0.;
 		bcRegion.total_area=0.;
-		for (int f=0;f<grid[gid].faceCount;++f) {
+		for (int f=grid[gid].interiorFaceCount;f<grid[gid].faceCount;++f) {
 			if (grid[gid].face[f].bc==b) {
 				grid[gid].face[f].symmetry=false;
 				grid[gid].maps.face2bc[f]=bc_counter[b];
@@ -94,62 +136,64 @@ void set_bcs(int gid) {
 			}
 		}
 		// Get the total area
-		MPI_Allreduce (&bcRegion.area,&bcRegion.total_area,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+		comm_profile.allreduce("bc area",&bcRegion.area,&bcRegion.total_area,1,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
 		bc[gid].push_back(bcRegion);
-		
-		string inter=region.get_string("interface");
-		if (inter!="none") {
-			int id=interface[gid].size();
-			interface[gid].resize(id+1);
-			string var,temp;
-			int donor_grid,donor_bc;
-			extract_in_between(inter,"get","from",var);
-			extract_in_between(inter,"grid","bc",temp);
-			interface[gid][id].donor_grid=atoi(temp.c_str())-1;
-			interface[gid][id].donor_bc=atoi(inter.c_str())-1;
-			interface[gid][id].donor_var=var;
-			interface[gid][id].donor_eqn=equations[interface[gid][id].donor_grid];			
-			interface[gid][id].recv_grid=gid;
-			interface[gid][id].recv_bc=b;
-			interface[gid][id].recv_eqn=equations[gid];
-		} // end if interface!=none
 	
 	} // bc loop
 	
-	// Loop each interface to fill in recv_var
-	for (int g=0;g<grid.size();++g) {
-		for (int i=0;i<interface[g].size();++i) {
-			// Loop donor interfaces
-			for (int d=0;d<interface[interface[g][i].recv_grid].size();++d) {
-				if (interface[g][i].recv_bc==interface[interface[g][i].recv_grid][d].donor_bc) {
-					interface[g][i].recv_var=interface[interface[g][i].recv_grid][d].donor_var;
-					break;
-				}
+
+	// Boundary face lists of each region and each bc type with the final assignments
+	// (a later box region may have taken over faces of an earlier one)
+	grid[gid].boundaryFaces.assign(count,vector<int>());
+	grid[gid].boundaryTypeFaces.assign(OUTLET+1,vector<int>());
+	for (int f=grid[gid].interiorFaceCount;f<grid[gid].faceCount;++f) {
+		int b=grid[gid].face[f].bc;
+		if (b>=0) {
+			grid[gid].maps.face2bc[f]=grid[gid].boundaryFaces[b].size();
+			grid[gid].boundaryFaces[b].push_back(f);
+			if (bc[gid][b].type>=SYMMETRY && bc[gid][b].type<=OUTLET) grid[gid].boundaryTypeFaces[bc[gid][b].type].push_back(f);
+		}
+	}
+	
+	// Order the faces within each boundary color by bc type so that each batch runs
+	// the boundary kernel of its type (type 0 collects faces of an unknown type)
+	vector<int> faceType (grid[gid].faceCount,0);
+	for (int t=0;t<grid[gid].boundaryTypeFaces.size();++t) {
+		for (int i=0;i<grid[gid].boundaryTypeFaces[t].size();++i) faceType[grid[gid].boundaryTypeFaces[t][i]]=t;
+	}
+	int boundaryColorCount=grid[gid].faceColors.size()-grid[gid].interiorColorCount;
+	grid[gid].boundaryColorTypeOffset.assign(boundaryColorCount,vector<int>(grid[gid].boundaryTypeFaces.size()+1,0));
+	for (int color=grid[gid].interiorColorCount;color<grid[gid].faceColors.size();++color) {
+		vector<int> &offset=grid[gid].boundaryColorTypeOffset[color-grid[gid].interiorColorCount];
+		vector<int> sorted;
+		sorted.reserve(grid[gid].faceColors[color].size());
+		for (int t=0;t<grid[gid].boundaryTypeFaces.size();++t) {
+			offset[t]=sorted.size();
+			for (int k=0;k<grid[gid].faceColors[color].size();++k) {
+				if (faceType[grid[gid].faceColors[color][k]]==t) sorted.push_back(grid[gid].faceColors[color][k]);
 			}
 		}
+		offset[grid[gid].boundaryTypeFaces.size()]=sorted.size();
+		grid[gid].faceColors[color].swap(sorted);
 	}
 
-
 	grid[gid].boundaryFaceCount.resize(count);
 	for (int b=0;b<count;++b) grid[gid].boundaryFaceCount[b].resize(np);
 	grid[gid].globalBoundaryFaceCount.resize(count);
 	for (int b=0;b<count;++b) {
-		grid[gid].boundaryFaceCount[b][Rank]=0;
-		for (int f=0;f<grid[gid].faceCount;++f) if(grid[gid].face[f].bc==b) grid[gid].boundaryFaceCount[b][Rank]++; 
-		MPI_Allgather(&grid[gid].boundaryFaceCount[b][Rank],1,MPI_INT,&grid[gid].boundaryFaceCount[b][0],1,MPI_INT,MPI_COMM_WORLD);
+		grid[gid].boundaryFaceCount[b][Rank]=grid[gid].boundaryFaces[b].size();
+		MPI_Allgather(&grid[gid].boundaryFaceCount[b][Rank],1,MPI_INT,&grid[gid].boundaryFaceCount[b][0],1,MPI_INT,grid[gid].comm);
 		//cout << "[I rank=" << Rank << " grid=" << gid+1 << " BC=" << b+1 << "] Number of Faces=" << grid[gid].boundaryFaceCount[b][Rank] << endl;
 		for (int p=0;p<np;++p) grid[gid].globalBoundaryFaceCount[b]+=grid[gid].boundaryFaceCount[b][p];
 	}
 		
-	vector<int> number_of_nsf (np,0); // number of noslip faces in each partition
 	// Mark nodes that touch boundaries
-	for (int f=0;f<grid[gid].faceCount;++f) {
+	for (int f=grid[gid].interiorFaceCount;f<grid[gid].faceCount;++f) {
 		if (grid[gid].face[f].bc==UNASSIGNED_FACE) {
 			cerr << "[E rank=" << Rank << "] Boundary condition could not be found for face " << f << endl;
 			exit(1);
 		}
 		if (grid[gid].face[f].bc>=0) { // if a boundary face
-			if (bc[gid][grid[gid].face[f].bc].type==WALL && bc[gid][grid[gid].face[f].bc].kind!=SLIP) number_of_nsf[Rank]++;
 			// A fix for centroids of inlet and outlet boundary ghost cells:
 			if (bc[gid][grid[gid].face[f].bc].type==INLET || bc[gid][grid[gid].face[f].bc].type==OUTLET) {
 				int neighbor=grid[gid].face[f].neighbor;
@@ -161,100 +205,5 @@ void set_bcs(int gid) {
 	}
 
 
-
-	if (Rank==0) cout << "[I] Finding closest wall distances" << endl;
-	
-	MPI_Allgather(&number_of_nsf[Rank],1,MPI_INT,&number_of_nsf[0],1,MPI_INT,MPI_COMM_WORLD);
-
-	int nsf_sum=0;
-	int displacements[np];
-	// Total number of wall faces
-	for (int p=0;p<np;++p) {
-		displacements[p]=nsf_sum;
-		nsf_sum+=number_of_nsf[p];
-	}
-
-	// Collect wall face centroids
-	vector<double> noSlipFaces_x(nsf_sum);
-	vector<double> noSlipFaces_y(nsf_sum);
-	vector<double> noSlipFaces_z(nsf_sum);
-
-	// Collect wall face normals
-	vector<double> noSlipFaces_Nx(nsf_sum);
-	vector<double> noSlipFaces_Ny(nsf_sum);
-	vector<double> noSlipFaces_Nz(nsf_sum);
-
-	count=0;
-	for (int f=0;f<grid[gid].faceCount;++f) { // loop all the local faces
-		if (grid[gid].face[f].bc>=0 && bc[gid][grid[gid].face[f].bc].type==WALL && bc[gid][grid[gid].face[f].bc].kind!=SLIP) {
-			noSlipFaces_x[displacements[Rank]+count]=grid[gid].face[f].centroid[0];
-			noSlipFaces_y[displacements[Rank]+count]=grid[gid].face[f].centroid[1];
-			noSlipFaces_z[displacements[Rank]+count]=grid[gid].face[f].centroid[2];
-			noSlipFaces_Nx[displacements[Rank]+count]=grid[gid].face[f].normal[0];
-			noSlipFaces_Ny[displacements[Rank]+count]=grid[gid].face[f].normal[1];
-			noSlipFaces_Nz[displacements[Rank]+count]=grid[gid].face[f].normal[2];
-			count++;
-		}
-	}
-
-	MPI_Allgatherv(&noSlipFaces_x[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_x[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-	MPI_Allgatherv(&noSlipFaces_y[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_y[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-	MPI_Allgatherv(&noSlipFaces_z[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_z[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-
-	MPI_Allgatherv(&noSlipFaces_Nx[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_Nx[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-	MPI_Allgatherv(&noSlipFaces_Ny[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_Ny[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-	MPI_Allgatherv(&noSlipFaces_Nz[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_Nz[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-
-	Vec3D thisCentroid;
-	Vec3D fN;
-	double thisDistance;
-	// Loop all cells to find the closest distance to the wall
-	for (int c=0;c<grid[gid].cell.size();++c) {
-		grid[gid].cell[c].closest_wall_distance=1.e20;
-               
-		for (int nsf=0;nsf<nsf_sum;++nsf) {
-			thisCentroid[0]=noSlipFaces_x[nsf];
-			thisCentroid[1]=noSlipFaces_y[nsf];
-			thisCentroid[2]=noSlipFaces_z[nsf];
-			thisDistance=fabs(grid[gid].cell[c].centroid-thisCentroid);
-			if (grid[gid].cell[c].closest_wall_distance>thisDistance) {
-				grid[gid].cell[c].closest_wall_distance=thisDistance;
-			}
-	        }
-	}
-
-	// Loop all faces to find the closest distance to the wall
-        for (int f=0;f<grid[gid].faceCount;++f) {
-        	grid[gid].face[f].closest_wall_distance=1.e20;
-
-		// If the face is not a no-slip wall
-                if (grid[gid].face[f].bc<0 || bc[gid][grid[gid].face[f].bc].type!=WALL || bc[gid][grid[gid].face[f].bc].kind==SLIP) {
-                    for (int nsf=0;nsf<nsf_sum;++nsf) {
-                        thisCentroid[0]=noSlipFaces_x[nsf];
-                        thisCentroid[1]=noSlipFaces_y[nsf];
-                        thisCentroid[2]=noSlipFaces_z[nsf];
-                        thisDistance=fabs(grid[gid].face[f].centroid-thisCentroid);
-                        if (grid[gid].face[f].closest_wall_distance>thisDistance) {
-                                grid[gid].face[f].closest_wall_distance=thisDistance;
-                                fN[0]=noSlipFaces_Nx[nsf];
-                                fN[1]=noSlipFaces_Ny[nsf];
-                                fN[2]=noSlipFaces_Nz[nsf];
-                        }
-                    }
-                    grid[gid].face[f].dissipation_factor=1.-fabs(fN[0]*grid[gid].face[f].normal[0]+fN[1]*grid[gid].face[f].normal[1]+fN[2]*grid[gid].face[f].normal[2]);
-                } else {
-                       grid[gid].face[f].closest_wall_distance=0.;
-                       grid[gid].face[f].dissipation_factor=0.;
-        	}
-	}
-
-
-	noSlipFaces_x.clear();
-	noSlipFaces_Nx.clear();
-	noSlipFaces_y.clear();
-	noSlipFaces_Ny.clear();
-	noSlipFaces_z.clear();
-	noSlipFaces_Nz.clear();
-
 	return;
 }
@@ -21,6 +21,7 @@
 
 *************************************************************************/
 #include "time_step.h"
+#include "comm_profile.h"
 
 void set_time_step_options(void) {
 	
@@ -176,18 +177,21 @@ void update_time_step(int timeStep,double &time,double &max_cfl,int gid) {
 			file.close();
 		}
 		
+		// The time step is shared by all the grids, the ones held by other ranks
+		// (when the grids run concurrently) take part through the world reduction
 		double min_dt=1.e20;
 		for (int gid=0;gid<grid.size();++gid) {
-			if (equations[gid]==NS) {
-				time_step_current=1.e20;
+			if (equations[gid]==NS && grid[gid].active) {
 				for (int c=0;c<grid[gid].cellCount;++c) {
 					a=ns[gid].material.a(ns[gid].p.cell(c),ns[gid].T.cell(c));
-					time_step_current=min(time_step_current,CFLmax*grid[gid].cell[c].lengthScale/(fabs(ns[gid].V.cell(c))+a));
+					min_dt=min(min_dt,CFLmax*grid[gid].cell[c].lengthScale/(fabs(ns[gid].V.cell(c))+a));
 				}
-				MPI_Allreduce(&time_step_current,&time_step_current,1, MPI_DOUBLE,MPI_MIN,MPI_COMM_WORLD);
-				if (min_dt>time_step_current) min_dt=time_step_current;
 			}
-			time_step_current=min_dt;
+		}
+		comm_profile.allreduce("time step",MPI_IN_PLACE,&min_dt,1,MPI_DOUBLE,MPI_MIN);
+		time_step_current=min_dt;
+		for (int gid=0;gid<grid.size();++gid) {
+			if (!grid[gid].active) continue;
 			for (int c=0;c<grid[gid].cellCount;++c) dt[gid].cell(c)=time_step_current;
 		}
 	} else if (time_step_type==CFL_LOCAL) {
@@ -208,9 +212,9 @@ void update_time_step(int timeStep,double &time,double &max_cfl,int gid) {
 			if (time_step_type==CFL_LOCAL) min_dt=min(min_dt,dt[gid].cell(c));
 		}
 		if (time_step_type==CFL_LOCAL) {
-			MPI_Allreduce(&min_dt,&min_dt,1, MPI_DOUBLE,MPI_MIN,MPI_COMM_WORLD);
+			comm_profile.allreduce("time step",MPI_IN_PLACE,&min_dt,1,MPI_DOUBLE,MPI_MIN,grid[gid].comm);
 		} else {
-			MPI_Allreduce(&max_cfl,&max_cfl,1, MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+			comm_profile.allreduce("max cfl",MPI_IN_PLACE,&max_cfl,1,MPI_DOUBLE,MPI_MAX,grid[gid].comm);
 		}
 	}
 	
@@ -239,22 +243,16 @@ void update_pseudo_time_step(int ps_step,double &max_cfl,int gid) {
 	
 	double a;
 	if (ps_time_step_type==FIXED) {
-		for (int gid=0;gid<grid.size();++gid) for (int c=0;c<grid[gid].cellCount;++c) dtau[gid].cell(c)=ps_time_step_current;
+		for (int c=0;c<grid[gid].cellCount;++c) dtau[gid].cell(c)=ps_time_step_current;
 	} else if (ps_time_step_type==CFL_MAX) {
-		double min_dt=1.e20;
-		for (int gid=0;gid<grid.size();++gid) {
-			if (equations[gid]==NS) {
-				ps_time_step_current=1.e20;
-				for (int c=0;c<grid[gid].cellCount;++c) {
-					a=ns[gid].material.a(ns[gid].p.cell(c),ns[gid].T.cell(c));
-					ps_time_step_current=min(ps_time_step_current,ps_CFLmax*grid[gid].cell[c].lengthScale/(fabs(ns[gid].V.cell(c))+a));
-				}
-				MPI_Allreduce(&ps_time_step_current,&ps_time_step_current,1, MPI_DOUBLE,MPI_MIN,MPI_COMM_WORLD);
-				if (min_dt>ps_time_step_current) min_dt=ps_time_step_current;
-			}
-			ps_time_step_current=min_dt;
-			for (int c=0;c<grid[gid].cellCount;++c) dtau[gid].cell(c)=ps_time_step_current;
+		// Each grid runs its own pseudo time iterations, so the step is taken over the grid only
+		ps_time_step_current=1.e20;
+		for (int c=0;c<grid[gid].cellCount;++c) {
+			a=ns[gid].material.a(ns[gid].p.cell(c),ns[gid].T.cell(c));
+			ps_time_step_current=min(ps_time_step_current,ps_CFLmax*grid[gid].cell[c].lengthScale/(fabs(ns[gid].V.cell(c))+a));
 		}
+		comm_profile.allreduce("pseudo time step",MPI_IN_PLACE,&ps_time_step_current,1,MPI_DOUBLE,MPI_MIN,grid[gid].comm);
+		for (int c=0;c<grid[gid].cellCount;++c) dtau[gid].cell(c)=ps_time_step_current;
 	} else if (ps_time_step_type==CFL_LOCAL) {
 		// Determine ps_time step with CFL condition
 		for (int c=0;c<grid[gid].cellCount;++c) {
@@ -274,9 +272,9 @@ void update_pseudo_time_step(int ps_step,double &max_cfl,int gid) {
 			if (ps_time_step_type==CFL_LOCAL) min_dt=min(min_dt,dtau[gid].cell(c));
 		}
 		if (ps_time_step_type==CFL_LOCAL) {
-			MPI_Allreduce(&min_dt,&min_dt,1, MPI_DOUBLE,MPI_MIN,MPI_COMM_WORLD);
+			comm_profile.allreduce("pseudo time step",MPI_IN_PLACE,&min_dt,1,MPI_DOUBLE,MPI_MIN,grid[gid].comm);
 		} else {
-			MPI_Allreduce(&max_cfl,&max_cfl,1, MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+			comm_profile.allreduce("max pseudo cfl",MPI_IN_PLACE,&max_cfl,1,MPI_DOUBLE,MPI_MAX,grid[gid].comm);
 		}
 	}
 	
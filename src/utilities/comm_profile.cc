@@ -0,0 +1,239 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "comm_profile.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <set>
+
+Comm_Profile comm_profile;
+
+Comm_Profile::Comm_Profile(void) {
+	enabled=false;
+	Rank=0; np=1;
+	waitTime=0.; waitCount=0;
+	steps=0;
+}
+
+void Comm_Profile::initialize(bool enable) {
+	
+	MPI_Comm_rank(MPI_COMM_WORLD,&Rank);
+	MPI_Comm_size(MPI_COMM_WORLD,&np);
+	enabled=enable;
+	sendBytes.assign(np,0.);
+	sendCount.assign(np,0);
+	
+	return;
+}
+
+int Comm_Profile::waitall(int count,MPI_Request requests[],MPI_Status statuses[]) {
+	
+	if (!enabled) return MPI_Waitall(count,requests,statuses);
+	double begin=MPI_Wtime();
+	int result=MPI_Waitall(count,requests,statuses);
+	waited(begin);
+	
+	return result;
+}
+
+int Comm_Profile::allreduce(const char *name,void *sendbuf,void *recvbuf,int count,MPI_Datatype type,MPI_Op op,MPI_Comm comm) {
+	
+	if (!enabled) return MPI_Allreduce(sendbuf,recvbuf,count,type,op,comm);
+	double begin=MPI_Wtime();
+	int result=MPI_Allreduce(sendbuf,recvbuf,count,type,op,comm);
+	int size;
+	MPI_Type_size(type,&size);
+	record(name,double(count)*size,begin);
+	
+	return result;
+}
+
+void Comm_Profile::record(const char *name,double bytes,double begin) {
+	
+	if (!enabled) return;
+	double time=MPI_Wtime()-begin;
+	map<string,int>::iterator it=collectiveIndex.find(name);
+	int n;
+	if (it==collectiveIndex.end()) {
+		n=collective.size();
+		collectiveIndex[name]=n;
+		Comm_Collective temp;
+		temp.name=name;
+		temp.calls=0;
+		temp.bytes=0.;
+		temp.time=0.;
+		collective.push_back(temp);
+	} else {
+		n=it->second;
+	}
+	collective[n].calls++;
+	collective[n].bytes+=bytes;
+	collective[n].time+=time;
+	
+	return;
+}
+
+// Prints min, max, mean over the ranks and the imbalance (max/mean) of a value on rank 0
+static void print_row(string name,double value,int precision) {
+	
+	int Rank,np;
+	MPI_Comm_rank(MPI_COMM_WORLD,&Rank);
+	MPI_Comm_size(MPI_COMM_WORLD,&np);
+	double minValue,maxValue,sum;
+	MPI_Reduce(&value,&minValue,1,MPI_DOUBLE,MPI_MIN,0,MPI_COMM_WORLD);
+	MPI_Reduce(&value,&maxValue,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+	MPI_Reduce(&value,&sum,1,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+	if (Rank==0) {
+		double mean=sum/double(np);
+		cout << fixed << setprecision(precision);
+		cout << setw(44) << left << "  "+name << right << setw(12) << minValue << setw(12) << maxValue << setw(12) << mean;
+		if (mean>0.) cout << setprecision(2) << setw(11) << maxValue/mean;
+		else cout << setw(11) << "-";
+		cout << endl << scientific;
+	}
+	
+	return;
+}
+
+// Sorted union of the collective names recorded on any rank
+void union_names(vector<string> &localNames,vector<string> &names) {
+	
+	int np;
+	MPI_Comm_size(MPI_COMM_WORLD,&np);
+	string list;
+	for (int n=0;n<localNames.size();++n) list+=localNames[n]+"\n";
+	int size=list.size();
+	vector<int> sizes (np),offsets (np+1,0);
+	MPI_Allgather(&size,1,MPI_INT,&sizes[0],1,MPI_INT,MPI_COMM_WORLD);
+	for (int p=0;p<np;++p) offsets[p+1]=offsets[p]+sizes[p];
+	string all (offsets[np],' ');
+	list.resize(max(size,1)); // Keep a valid buffer address
+	MPI_Allgatherv(&list[0],size,MPI_CHAR,(offsets[np]>0) ? &all[0] : &list[0],&sizes[0],&offsets[0],MPI_CHAR,MPI_COMM_WORLD);
+	
+	set<string> unique;
+	istringstream stream(all);
+	string line;
+	while (getline(stream,line)) if (!line.empty()) unique.insert(line);
+	names.assign(unique.begin(),unique.end());
+	
+	return;
+}
+
+void Comm_Profile::report(void) {
+	
+	if (!enabled) return;
+	
+	double bytes=0.,messages=0.,neighbors=0.;
+	for (int p=0;p<np;++p) {
+		bytes+=sendBytes[p];
+		messages+=sendCount[p];
+		if (sendCount[p]>0) neighbors+=1.;
+	}
+	double stepCount=max(steps,1L);
+	
+	if (Rank==0) {
+		cout << "[I] Communication profile over " << np << " ranks and " << steps << " time steps" << endl;
+		cout << setw(44) << left << "halo exchange (per rank)" << right << setw(12) << "min" << setw(12) << "max"
+		     << setw(12) << "mean" << setw(11) << "imbalance" << endl;
+	}
+	print_row("neighbors",neighbors,0);
+	print_row("messages sent per step",messages/stepCount,1);
+	print_row("MB sent per step",bytes/stepCount/1048576.,3);
+	print_row("mean message size (kB)",(messages>0.) ? bytes/messages/1024. : 0.,3);
+	print_row("waits per step",double(waitCount)/stepCount,1);
+	print_row("wait time (s)",waitTime,4);
+	
+	// The ranks of different grids (when the grids run concurrently) call different collectives,
+	// so the rows are the union of the names over all the ranks, absent names count as zero
+	if (Rank==0) {
+		cout << setw(44) << left << "collective" << right << setw(10) << "calls" << setw(12) << "calls/step"
+		     << setw(12) << "kB/call" << setw(12) << "max time" << setw(11) << "imbalance" << endl;
+	}
+	vector<string> localNames,names;
+	for (int n=0;n<collective.size();++n) localNames.push_back(collective[n].name);
+	union_names(localNames,names);
+	for (int i=0;i<names.size();++i) {
+		map<string,int>::iterator it=collectiveIndex.find(names[i]);
+		// time, calls, bytes and whether this rank takes part
+		double local[4]={0.,0.,0.,0.};
+		if (it!=collectiveIndex.end()) {
+			local[0]=collective[it->second].time;
+			local[1]=collective[it->second].calls;
+			local[2]=collective[it->second].bytes;
+			local[3]=1.;
+		}
+		double maxTime,sums[4];
+		MPI_Reduce(&local[0],&maxTime,1,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+		MPI_Reduce(local,sums,4,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+		if (Rank==0) {
+			// Per rank values are averaged over the ranks taking part
+			double ranks=max(sums[3],1.);
+			double calls=sums[1]/ranks;
+			double mean=sums[0]/ranks;
+			cout << fixed << setprecision(2);
+			cout << setw(44) << left << "  "+names[i] << right << setw(10) << long(calls+0.5)
+			     << setw(12) << calls/stepCount
+			     << setprecision(3) << setw(12) << ((sums[1]>0.) ? sums[2]/sums[1]/1024. : 0.)
+			     << setprecision(4) << setw(12) << maxTime;
+			if (mean>0.) cout << setprecision(2) << setw(11) << maxTime/mean;
+			else cout << setw(11) << "-";
+			cout << endl << scientific;
+		}
+	}
+	
+	// Rank x rank matrix of the bytes and messages sent (row: sender, column: receiver)
+	vector<double> allBytes (np*np),allCount (np*np),count (np);
+	for (int p=0;p<np;++p) count[p]=sendCount[p];
+	MPI_Gather(&sendBytes[0],np,MPI_DOUBLE,&allBytes[0],np,MPI_DOUBLE,0,MPI_COMM_WORLD);
+	MPI_Gather(&count[0],np,MPI_DOUBLE,&allCount[0],np,MPI_DOUBLE,0,MPI_COMM_WORLD);
+	if (Rank==0) {
+		ofstream file ("comm_matrix.dat");
+		file << "# Bytes sent from the row rank to the column rank over " << steps << " time steps" << endl;
+		for (int i=0;i<np;++i) {
+			for (int j=0;j<np;++j) file << allBytes[i*np+j] << "\t";
+			file << endl;
+		}
+		file << "# Messages sent from the row rank to the column rank" << endl;
+		for (int i=0;i<np;++i) {
+			for (int j=0;j<np;++j) file << long(allCount[i*np+j]) << "\t";
+			file << endl;
+		}
+		file.close();
+		if (np<=16) {
+			cout << "kB sent per step (row: sender, column: receiver)" << endl;
+			cout << fixed << setprecision(1) << setw(6) << " ";
+			for (int j=0;j<np;++j) cout << setw(10) << j;
+			cout << endl;
+			for (int i=0;i<np;++i) {
+				cout << setw(6) << i;
+				for (int j=0;j<np;++j) cout << setw(10) << allBytes[i*np+j]/stepCount/1024.;
+				cout << endl;
+			}
+			cout << scientific;
+		}
+		cout << "[I] Wrote the communication matrix to comm_matrix.dat" << endl;
+	}
+	
+	return;
+}
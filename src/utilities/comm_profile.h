@@ -0,0 +1,77 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef COMM_PROFILE_H
+#define COMM_PROFILE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mpi.h>
+using namespace std;
+
+// Communication profiler
+// The halo exchanges record the bytes and messages they send to each rank and the time
+// spent waiting for the messages to arrive. The collectives go through allreduce() (or
+// record() for the other kinds) and are counted per name. report() prints the summary
+// over the ranks and writes the rank x rank communication matrix. When the profiler is
+// off, the hooks only check a flag. send() takes world ranks, the exchanges within a grid
+// add the grid's worldOffset to their ranks.
+
+class Comm_Collective {
+public:
+	string name;
+	long int calls;
+	double bytes,time;
+};
+
+class Comm_Profile {
+public:
+	bool enabled;
+	int Rank,np;
+	vector<double> sendBytes; // to each rank
+	vector<long int> sendCount;
+	double waitTime;
+	long int waitCount;
+	vector<Comm_Collective> collective;
+	map<string,int> collectiveIndex;
+	long int steps;
+	
+	Comm_Profile(void);
+	void initialize(bool enable);
+	inline void send(int proc,double bytes) { if (enabled) { sendBytes[proc]+=bytes; sendCount[proc]++; } }
+	inline double clock(void) { return (enabled) ? MPI_Wtime() : 0.; }
+	inline void waited(double begin) { if (enabled) { waitTime+=MPI_Wtime()-begin; waitCount++; } }
+	inline void step(void) { steps++; }
+	int waitall(int count,MPI_Request requests[],MPI_Status statuses[]);
+	int allreduce(const char *name,void *sendbuf,void *recvbuf,int count,MPI_Datatype type,MPI_Op op,MPI_Comm comm=MPI_COMM_WORLD);
+	void record(const char *name,double bytes,double begin);
+	void report(void); // collective
+};
+
+extern Comm_Profile comm_profile;
+
+// Sorted union of the names known to each rank, so that the reports also list the entries
+// rank 0 doesn't have
+void union_names(vector<string> &localNames,vector<string> &names); // collective
+
+#endif
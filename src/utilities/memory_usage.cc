@@ -0,0 +1,237 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "memory_usage.h"
+#include "comm_profile.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+#include <sys/resource.h>
+#include <mpi.h>
+
+#define MB 1048576.
+
+// Layout of MPI_DOUBLE_INT for the MPI_MAXLOC reduction
+struct Value_Rank {
+	double value;
+	int rank;
+};
+
+Memory_Usage memory_usage;
+
+Memory_Usage::Memory_Usage(void) {
+	enabled=false;
+	Rank=0; np=1;
+}
+
+void Memory_Usage::initialize(bool enable) {
+	
+	MPI_Comm_rank(MPI_COMM_WORLD,&Rank);
+	MPI_Comm_size(MPI_COMM_WORLD,&np);
+	enabled=enable;
+	
+	return;
+}
+
+void Memory_Usage::account(string name,double size,bool prediction) {
+	
+	map<string,int>::iterator it=index.find(name);
+	if (it==index.end()) {
+		index[name]=names.size();
+		names.push_back(name);
+		bytes.push_back(size);
+		predicted.push_back(prediction);
+	} else {
+		bytes[it->second]=max(bytes[it->second],size);
+	}
+	
+	return;
+}
+
+void process_memory(double &rss,double &hwm) {
+	
+	rss=0.; hwm=0.;
+	// Linux reports both in kB
+	ifstream status ("/proc/self/status");
+	string line;
+	while (getline(status,line)) {
+		if (line.compare(0,6,"VmRSS:")==0) rss=1024.*atof(line.substr(6).c_str());
+		else if (line.compare(0,6,"VmHWM:")==0) hwm=1024.*atof(line.substr(6).c_str());
+	}
+	if (hwm==0.) {
+		struct rusage usage;
+		getrusage(RUSAGE_SELF,&usage);
+		hwm=1024.*double(usage.ru_maxrss);
+		if (rss==0.) rss=hwm;
+	}
+	
+	return;
+}
+
+void Memory_Usage::sample(string name) {
+	
+	Memory_Stage temp;
+	temp.name=name;
+	process_memory(temp.rss,temp.hwm);
+	stages.push_back(temp);
+	
+	return;
+}
+
+// The union of the names over all the ranks, each rank's values are matched by name and
+// the ranks that don't have a name are flagged as not taking part
+static void match_names(vector<string> &localNames,vector<double> &localValues,vector<string> &names,vector<double> &values,vector<double> &present) {
+	
+	union_names(localNames,names);
+	map<string,int> local;
+	for (int i=0;i<localNames.size();++i) local[localNames[i]]=i;
+	values.assign(names.size(),0.);
+	present.assign(names.size(),0.);
+	for (int i=0;i<names.size();++i) {
+		map<string,int>::iterator it=local.find(names[i]);
+		if (it==local.end()) continue;
+		values[i]=localValues[it->second];
+		present[i]=1.;
+	}
+	
+	return;
+}
+
+// Min, max, mean and the rank of the max of each entry on rank 0, over the ranks taking part
+static void print_rows(vector<string> &names,vector<double> &values,vector<double> &present,vector<string> &suffix) {
+	
+	int Rank;
+	MPI_Comm_rank(MPI_COMM_WORLD,&Rank);
+	int count=values.size();
+	if (count==0) return;
+	vector<Value_Rank> in (count),out (count);
+	vector<double> minIn (count);
+	for (int i=0;i<count;++i) {
+		in[i].value=(present[i]>0.) ? values[i] : -DBL_MAX;
+		in[i].rank=Rank;
+		minIn[i]=(present[i]>0.) ? values[i] : DBL_MAX;
+	}
+	vector<double> minValues (count),sumValues (count),ranks (count);
+	MPI_Reduce(&minIn[0],&minValues[0],count,MPI_DOUBLE,MPI_MIN,0,MPI_COMM_WORLD);
+	MPI_Reduce(&values[0],&sumValues[0],count,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+	MPI_Reduce(&present[0],&ranks[0],count,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+	MPI_Reduce(&in[0],&out[0],count,MPI_DOUBLE_INT,MPI_MAXLOC,0,MPI_COMM_WORLD);
+	
+	if (Rank==0) {
+		cout << fixed << setprecision(1);
+		for (int i=0;i<count;++i) {
+			cout << setw(44) << left << "  "+names[i]+suffix[i] << right
+			     << setw(12) << minValues[i]/MB << setw(12) << out[i].value/MB
+			     << setw(12) << sumValues[i]/max(ranks[i],1.)/MB << setw(10) << out[i].rank << endl;
+		}
+		cout << scientific;
+	}
+	
+	return;
+}
+
+void Memory_Usage::report(void) {
+	
+	if (!enabled) return;
+	
+	double rss,hwm;
+	process_memory(rss,hwm);
+	
+	// Container bytes of each subsystem
+	vector<string> allNames,suffix;
+	vector<double> values,present;
+	match_names(names,bytes,allNames,values,present);
+	double accounted=0.,prediction=0.;
+	vector<int> isPredicted (allNames.size(),0);
+	for (int i=0;i<allNames.size();++i) {
+		map<string,int>::iterator it=index.find(allNames[i]);
+		if (it!=index.end() && predicted[it->second]) isPredicted[i]=1;
+		if (isPredicted[i]) prediction+=values[i];
+		else accounted+=values[i];
+	}
+	// Rank 0 may not have the entry to know whether it is a prediction
+	if (!isPredicted.empty()) MPI_Allreduce(MPI_IN_PLACE,&isPredicted[0],isPredicted.size(),MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+	for (int i=0;i<allNames.size();++i) suffix.push_back(isPredicted[i] ? " (predicted)" : "");
+	allNames.push_back("total accounted"); values.push_back(accounted); present.push_back(1.); suffix.push_back("");
+	allNames.push_back("total predicted"); values.push_back(prediction); present.push_back(1.); suffix.push_back("");
+	
+	if (Rank==0) {
+		cout << "[I] Memory usage over " << np << " ranks (MB)" << endl;
+		cout << setw(44) << left << "subsystem" << right << setw(12) << "min" << setw(12) << "max"
+		     << setw(12) << "mean" << setw(10) << "max rank" << endl;
+	}
+	print_rows(allNames,values,present,suffix);
+	
+	// High-water mark of the process after each stage
+	vector<string> stageNames,stageList;
+	vector<double> stageValues,hwmValues,stagePresent;
+	for (int i=0;i<stages.size();++i) {
+		stageNames.push_back(stages[i].name);
+		stageValues.push_back(stages[i].hwm);
+	}
+	match_names(stageNames,stageValues,stageList,hwmValues,stagePresent);
+	// The union is sorted by name, put the stages back in the order the ranks went through them
+	vector<int> position (stageList.size(),INT_MAX);
+	for (int i=0;i<stageList.size();++i) {
+		for (int s=0;s<stageNames.size();++s) if (stageNames[s]==stageList[i]) { position[i]=s; break; }
+	}
+	if (!position.empty()) MPI_Allreduce(MPI_IN_PLACE,&position[0],position.size(),MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+	vector<pair<int,int> > order;
+	for (int i=0;i<stageList.size();++i) order.push_back(make_pair(position[i],i));
+	sort(order.begin(),order.end());
+	vector<string> sortedList;
+	vector<double> sortedValues,sortedPresent;
+	for (int i=0;i<order.size();++i) {
+		sortedList.push_back(stageList[order[i].second]);
+		sortedValues.push_back(hwmValues[order[i].second]);
+		sortedPresent.push_back(stagePresent[order[i].second]);
+	}
+	stageList.swap(sortedList); hwmValues.swap(sortedValues); stagePresent.swap(sortedPresent);
+	suffix.assign(stageList.size(),"");
+	if (Rank==0) {
+		cout << setw(44) << left << "high-water mark after" << right << setw(12) << "min" << setw(12) << "max"
+		     << setw(12) << "mean" << setw(10) << "max rank" << endl;
+	}
+	print_rows(stageList,hwmValues,stagePresent,suffix);
+	
+	// Per rank breakdown
+	double local[4]={accounted,rss,hwm,hwm+prediction};
+	vector<double> all (4*np);
+	MPI_Gather(local,4,MPI_DOUBLE,&all[0],4,MPI_DOUBLE,0,MPI_COMM_WORLD);
+	if (Rank==0) {
+		cout << setw(8) << "rank" << setw(14) << "accounted" << setw(14) << "resident"
+		     << setw(14) << "high-water" << setw(18) << "predicted peak" << endl;
+		cout << fixed << setprecision(1);
+		for (int p=0;p<np;++p) {
+			cout << setw(8) << p;
+			for (int i=0;i<3;++i) cout << setw(14) << all[4*p+i]/MB;
+			cout << setw(18) << all[4*p+3]/MB << endl;
+		}
+		cout << scientific;
+	}
+	
+	return;
+}
@@ -0,0 +1,85 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+using namespace std;
+
+// Memory accounting of the major containers and the process high-water mark
+// Each subsystem reports the bytes held by its containers with account(). The largest
+// value seen for a subsystem is kept, so transient data (e.g. the raw grid) still shows up.
+// Estimates of memory that is only allocated later (e.g. the Krylov workspace, allocated at
+// the first solve) are marked as predicted. stage() samples the resident set size and the
+// high-water mark of the process after a setup stage.
+
+// Bookkeeping overhead of a std::map/std::set node (color and three pointers)
+#define TREE_NODE_OVERHEAD 32
+
+class Memory_Stage {
+public:
+	string name;
+	double rss,hwm; // bytes
+};
+
+class Memory_Usage {
+public:
+	bool enabled;
+	int Rank,np;
+	vector<string> names; // subsystems in the order they were first accounted
+	vector<double> bytes;
+	vector<bool> predicted;
+	map<string,int> index;
+	vector<Memory_Stage> stages;
+	
+	Memory_Usage(void);
+	void initialize(bool enable);
+	void account(string name,double size,bool prediction=false);
+	inline void stage(string name) { if (enabled) sample(name); }
+	void sample(string name);
+	void report(void); // collective
+};
+
+extern Memory_Usage memory_usage;
+
+// Resident set size and high-water mark of this process in bytes
+void process_memory(double &rss,double &hwm);
+
+template <class T> inline double container_bytes(const vector<T> &v) { return double(v.capacity())*sizeof(T); }
+template <class T> inline double container_bytes(const set<T> &s) { return double(s.size())*(sizeof(T)+TREE_NODE_OVERHEAD); }
+template <class K,class T> inline double container_bytes(const map<K,T> &m) { return double(m.size())*(sizeof(K)+sizeof(T)+TREE_NODE_OVERHEAD); }
+template <class T> inline double container_bytes(const vector<vector<T> > &v) {
+	double size=double(v.capacity())*sizeof(vector<T>);
+	for (int i=0;i<v.size();++i) size+=container_bytes(v[i]);
+	return size;
+}
+template <class T> inline double container_bytes(const vector<set<T> > &v) {
+	double size=double(v.capacity())*sizeof(set<T>);
+	for (int i=0;i<v.size();++i) size+=container_bytes(v[i]);
+	return size;
+}
+
+#endif
@@ -0,0 +1,204 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "timers.h"
+#include "comm_profile.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cfloat>
+#include <mpi.h>
+
+// Trace recording stops after this many phases to bound the memory use
+#define MAX_TRACE_EVENTS 2000000
+
+Timers timers;
+
+Timers::Timers(void) {
+	enabled=false;
+	trace=false;
+	Rank=0; np=1;
+	origin=0.;
+	node.resize(1);
+	node[0].name="total";
+	node[0].parent=-1;
+	node[0].depth=-1;
+	node[0].total=0.;
+	node[0].calls=0;
+	stack.push_back(0);
+	startTime.push_back(0.);
+}
+
+void Timers::initialize(bool enable,bool enable_trace) {
+	
+	MPI_Comm_rank(MPI_COMM_WORLD,&Rank);
+	MPI_Comm_size(MPI_COMM_WORLD,&np);
+	enabled=enable;
+	trace=enable && enable_trace;
+	origin=MPI_Wtime();
+	startTime[0]=origin;
+	if (trace) events.reserve(4096);
+	
+	return;
+}
+
+void Timers::push(const char *name) {
+	
+	int parent=stack.back();
+	int n;
+	map<string,int>::iterator it=node[parent].children.find(name);
+	if (it==node[parent].children.end()) {
+		n=node.size();
+		node[parent].children[name]=n;
+		Timer_Node temp;
+		temp.name=name;
+		temp.parent=parent;
+		temp.depth=node[parent].depth+1;
+		temp.total=0.;
+		temp.calls=0;
+		node.push_back(temp);
+	} else {
+		n=it->second;
+	}
+	stack.push_back(n);
+	startTime.push_back(MPI_Wtime());
+	
+	return;
+}
+
+void Timers::pop(void) {
+	
+	if (stack.size()<2) return;
+	double end=MPI_Wtime();
+	int n=stack.back();
+	node[n].total+=end-startTime.back();
+	node[n].calls++;
+	if (trace && events.size()<MAX_TRACE_EVENTS) {
+		Trace_Event event;
+		event.node=n;
+		event.begin=startTime.back();
+		event.end=end;
+		events.push_back(event);
+	}
+	stack.pop_back();
+	startTime.pop_back();
+	
+	return;
+}
+
+string Timers::path(int n) {
+	if (node[n].parent<=0) return node[n].name;
+	return path(node[n].parent)+"/"+node[n].name;
+}
+
+void Timers::report(void) {
+	
+	if (!enabled) return;
+	
+	node[0].total=MPI_Wtime()-origin;
+	node[0].calls=1;
+	
+	// The ranks of different grids (when the grids run concurrently) go through different phases,
+	// so the table lists the union of the paths over all the ranks, in tree order
+	map<string,int> local;
+	vector<string> localPaths,paths;
+	for (int n=0;n<node.size();++n) {
+		local[path(n)]=n;
+		if (n>0) localPaths.push_back(path(n));
+	}
+	union_names(localPaths,paths);
+	vector<string> keys (paths);
+	for (int i=0;i<keys.size();++i) replace(keys[i].begin(),keys[i].end(),'/','\001');
+	sort(keys.begin(),keys.end());
+	for (int i=0;i<keys.size();++i) replace(keys[i].begin(),keys[i].end(),'\001','/');
+	paths.assign(1,path(0));
+	paths.insert(paths.end(),keys.begin(),keys.end());
+	
+	// time (DBL_MAX for the min if the rank doesn't go through the phase), calls and whether this rank takes part
+	int count=paths.size();
+	vector<double> times (count),minIn (count),calls (count),ranks (count);
+	for (int i=0;i<count;++i) {
+		map<string,int>::iterator it=local.find(paths[i]);
+		bool found=(it!=local.end());
+		times[i]=(found) ? node[it->second].total : 0.;
+		minIn[i]=(found) ? times[i] : DBL_MAX;
+		calls[i]=(found) ? double(node[it->second].calls) : 0.;
+		ranks[i]=(found) ? 1. : 0.;
+	}
+	
+	vector<double> minTimes (count),maxTimes (count),sumTimes (count),maxCalls (count),sumRanks (count);
+	MPI_Reduce(&minIn[0],&minTimes[0],count,MPI_DOUBLE,MPI_MIN,0,MPI_COMM_WORLD);
+	MPI_Reduce(&times[0],&maxTimes[0],count,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+	MPI_Reduce(&times[0],&sumTimes[0],count,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+	MPI_Reduce(&calls[0],&maxCalls[0],count,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+	MPI_Reduce(&ranks[0],&sumRanks[0],count,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+	
+	if (Rank==0) {
+		cout << "[I] Phase timers over " << np << " ranks (seconds)" << endl;
+		cout << setw(44) << left << "phase" << right << setw(10) << "calls"
+		     << setw(12) << "min" << setw(12) << "max" << setw(12) << "mean" << setw(11) << "imbalance" << endl;
+		cout << fixed;
+		for (int i=0;i<count;++i) {
+			// The depth and the name come from the path, rank 0 may not have the phase
+			int depth=(i==0) ? -1 : int(std::count(paths[i].begin(),paths[i].end(),'/'));
+			string name=string(2*(depth+1),' ')+paths[i].substr(paths[i].rfind('/')+1);
+			// Averaged over the ranks taking part
+			double mean=sumTimes[i]/max(sumRanks[i],1.);
+			cout << setw(44) << left << name << right << setw(10) << long(maxCalls[i]) << setprecision(4)
+			     << setw(12) << minTimes[i] << setw(12) << maxTimes[i] << setw(12) << mean;
+			if (mean>0.) cout << setprecision(2) << setw(11) << maxTimes[i]/mean;
+			else cout << setw(11) << "-";
+			cout << endl;
+		}
+		cout << scientific;
+	}
+	
+	return;
+}
+
+void Timers::write_trace(void) {
+	
+	if (!trace) return;
+	
+	// Chrome trace event format, load in chrome://tracing or Perfetto
+	stringstream ss;
+	ss << "trace_" << Rank << ".json";
+	ofstream file (ss.str().c_str());
+	file << fixed << setprecision(3);
+	file << "{\"traceEvents\":[" << endl;
+	for (int i=0;i<events.size();++i) {
+		file << "{\"name\":\"" << node[events[i].node].name << "\",\"cat\":\"fcfd\",\"ph\":\"X\""
+		     << ",\"ts\":" << (events[i].begin-origin)*1.e6
+		     << ",\"dur\":" << (events[i].end-events[i].begin)*1.e6
+		     << ",\"pid\":" << Rank << ",\"tid\":0}";
+		if (i!=events.size()-1) file << ",";
+		file << endl;
+	}
+	file << "]}" << endl;
+	file.close();
+	
+	if (Rank==0 && events.size()==MAX_TRACE_EVENTS) cout << "[W] Trace was truncated at " << MAX_TRACE_EVENTS << " phases" << endl;
+	
+	return;
+}
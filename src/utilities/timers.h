@@ -0,0 +1,81 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+// Hierarchical wall clock timers of the program phases
+// A phase opened while another one is running is nested under it. The phases are only
+// opened and closed outside threaded regions. When the timers are off, start and stop
+// only check a flag.
+
+class Timer_Node {
+public:
+	string name;
+	int parent,depth;
+	double total; // accumulated wall time
+	long int calls;
+	map<string,int> children;
+};
+
+class Trace_Event {
+public:
+	int node;
+	double begin,end;
+};
+
+class Timers {
+public:
+	bool enabled,trace;
+	int Rank,np;
+	vector<Timer_Node> node; // node 0 is the root
+	vector<int> stack; // currently open phases
+	vector<double> startTime;
+	vector<Trace_Event> events; // completed phases for the Chrome trace
+	double origin;
+	
+	Timers(void);
+	void initialize(bool enable,bool enable_trace);
+	inline void start(const char *name) { if (enabled) push(name); }
+	inline void stop(void) { if (enabled) pop(); }
+	void push(const char *name);
+	void pop(void);
+	string path(int n);
+	void report(void); // collective
+	void write_trace(void);
+};
+
+extern Timers timers;
+
+// Times the enclosing scope
+class Scoped_Timer {
+public:
+	Scoped_Timer(const char *name) { timers.start(name); }
+	~Scoped_Timer(void) { timers.stop(); }
+};
+
+#endif
@@ -21,6 +21,9 @@
 
 *************************************************************************/
 #include "utilities.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 string int2str(int number) {
         std::stringstream ss;
@@ -99,3 +102,19 @@ int gelimd(vector<vector<double> > &a,vector<double> &b,vector<double> &x) {
 	}
 	return 0;
 }
+
+int thread_count(void) {
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+int thread_id(void) {
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
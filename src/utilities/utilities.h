@@ -29,6 +29,7 @@
 #include <sstream>
 #include <limits>
 #include <fstream>
+#include <cmath>
 using namespace std;
 
 #include "vec3d.h"
@@ -43,4 +44,38 @@ bool withinSphere(Vec3D point, Vec3D center, double radius);
 
 int gelimd(vector<vector<double> > &a,vector<double> &b,vector<double> &x);
 
+// Gaussian elimination of small fixed size systems on the stack
+// Returns 1 (and leaves x untouched) if the matrix is singular
+template <int N> int gelimd(double (&a)[N][N],double (&b)[N],double (&x)[N]) {
+	double tmp,pvt;
+	int i,j,k;
+	for (i=0;i<N;i++) {
+		pvt=a[i][i];
+		if (fabs(pvt)<EPS) {
+			for (j=i+1;j<N;j++) {
+				if (fabs(pvt=a[j][i])>=EPS) break;
+			}
+			if (fabs(pvt)<EPS) return 1;
+			for (k=0;k<N;k++) { tmp=a[i][k]; a[i][k]=a[j][k]; a[j][k]=tmp; }
+			tmp=b[j]; b[j]=b[i]; b[i]=tmp;
+		}
+		for (k=i+1;k<N;k++) {
+			tmp=a[k][i]/pvt;
+			for (j=i+1;j<N;j++) a[k][j]-=tmp*a[i][j];
+			b[k]-=tmp*b[i];
+		}
+	}
+	for (i=N-1;i>=0;i--) {
+		x[i]=b[i];
+		for (j=N-1;j>i;j--) x[i]-=a[i][j]*x[j];
+		x[i]/=a[i][i];
+	}
+	return 0;
+}
+
+// Number of threads available to parallel regions and the id of the calling thread
+// (1 and 0 if not compiled with OpenMP)
+int thread_count(void);
+int thread_id(void);
+
 #endif
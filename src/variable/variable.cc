@@ -22,6 +22,7 @@
  *************************************************************************/
 
 #include "variable.h"
+#include "comm_profile.h"
 
 template <>
 void Variable<double>::mpi_update (void) {
@@ -43,7 +44,10 @@ void Variable<double>::mpi_update (void) {
 				sendBuffer[g]=cell(id);
 			}
 			
-			MPI_Sendrecv(&sendBuffer[0],sendBuffer.size(),MPI_DOUBLE,proc,0,&recvBuffer[0],recvBuffer.size(),MPI_DOUBLE,proc,MPI_ANY_TAG,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+			double begin=comm_profile.clock();
+			MPI_Sendrecv(&sendBuffer[0],sendBuffer.size(),MPI_DOUBLE,proc,0,&recvBuffer[0],recvBuffer.size(),MPI_DOUBLE,proc,MPI_ANY_TAG,grid[gid].comm,MPI_STATUS_IGNORE);
+			comm_profile.send(grid[gid].worldOffset+proc,sendBuffer.size()*sizeof(double));
+			comm_profile.waited(begin);
 
 			for (int g=0;g<grid[gid].recvCells[proc].size();++g) {
 				id=grid[gid].recvCells[proc][g];
@@ -77,7 +81,10 @@ void Variable<Vec3D>::mpi_update (void) {
 				for (int i=0;i<3;++i) sendBuffer[g*3+i]=cell(id)[i];
 			}
 			
-			MPI_Sendrecv(&sendBuffer[0],sendBuffer.size(),MPI_DOUBLE,proc,0,&recvBuffer[0],recvBuffer.size(),MPI_DOUBLE,proc,MPI_ANY_TAG,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+			double begin=comm_profile.clock();
+			MPI_Sendrecv(&sendBuffer[0],sendBuffer.size(),MPI_DOUBLE,proc,0,&recvBuffer[0],recvBuffer.size(),MPI_DOUBLE,proc,MPI_ANY_TAG,grid[gid].comm,MPI_STATUS_IGNORE);
+			comm_profile.send(grid[gid].worldOffset+proc,sendBuffer.size()*sizeof(double));
+			comm_profile.waited(begin);
 			
 			for (int g=0;g<grid[gid].recvCells[proc].size();++g) {
 				id=grid[gid].maps.cellGlobal2Local[grid[gid].recvCells[proc][g]];
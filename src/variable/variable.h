@@ -25,6 +25,7 @@
 #define VARIABLE
 
 #include "grid.h"
+#include "utilities.h"
 
 extern vector<Grid> grid;
 
@@ -36,9 +37,7 @@ public:
 	vector<vector<TYPE> > bcValue; // Stores the bc data if specified on a certain bc
 	vector<TYPE> cellData, faceData, nodeData;
 	bool cellStore, faceStore, nodeStore;
-	TYPE temp;
-	map<int,double>::iterator it;
-	set<int>::iterator sit;
+	vector<TYPE> temp; // Scratch for on-demand evaluations (one per thread)
 	// Function pointers
 	// Store addresses of functions to be used when data is requested
 	// Can be simple fetch from array if the variable is stored
@@ -76,6 +75,7 @@ public:
 	void mpi_update(void);
 	void dump_cell_data(string fileName);
 	void read_cell_data(string fileName,vector<vector<int> > &partitionMap);
+	double bytes(void) { return double(cellData.capacity()+faceData.capacity()+nodeData.capacity()+temp.capacity())*sizeof(TYPE); }
 	
 };
 
@@ -100,6 +100,8 @@ void Variable<TYPE>::allocate (int g) {
 		get_node=&Variable::node_calculate;
 	}
 	
+	temp.resize(thread_count());
+	
 	fixedonBC.resize(grid[gid].bcCount);
 	bcValue.resize(grid[gid].bcCount);
 	for (int i=0;i<fixedonBC.size();++i) fixedonBC[i]=false;
@@ -136,14 +138,12 @@ TYPE &Variable<TYPE>::face_calculate (int f) {
 	if ( (grid[gid].face[f].bc>=0 && fixedonBC[grid[gid].face[f].bc]) || !cellStore) {	// TODO: Check this
 		return bc(grid[gid].face[f].bc,f);
 	}
-	// Run the face averaging map from the grid class
-	std::map<int,double>::iterator it;
-	temp=0.;
-	it=grid[gid].face[f].average.begin();
-	for ( it=grid[gid].face[f].average.begin() ; it != grid[gid].face[f].average.end(); it++ ) {
-			temp+=(*it).second*(this->*get_cell)((*it).first);
-	}
-	return temp;
+	// Run the face averaging stencil from the grid class
+	Stencil<double> &average=grid[gid].faceAverage;
+	TYPE &value=temp[thread_id()];
+	value=0.;
+	for (int i=average.offset[f];i<average.offset[f+1];++i) value+=average.weight[i]*(this->*get_cell)(average.index[i]);
+	return value;
 }
 
 template <class TYPE>
@@ -181,13 +181,12 @@ TYPE &Variable<TYPE>::node_calculate (int n) {
 //		temp/=double(count);
 //		return temp;
 //	}
-	// Run the node averaging map from the grid class
-	temp=0.;
-	it=grid[gid].node[n].average.begin();
-	for ( it=grid[gid].node[n].average.begin() ; it != grid[gid].node[n].average.end(); it++ ) {
-		temp+=(*it).second*(this->*get_cell)((*it).first);
-	}
-	return temp;
+	// Run the node averaging stencil from the grid class
+	Stencil<double> &average=grid[gid].nodeAverage;
+	TYPE &value=temp[thread_id()];
+	value=0.;
+	for (int i=average.offset[n];i<average.offset[n+1];++i) value+=average.weight[i]*(this->*get_cell)(average.index[i]);
+	return value;
 }
 
 template <class TYPE>
@@ -195,10 +194,11 @@ vector<TYPE> Variable<TYPE>::cell_gradient (int c) {
 
 	vector<TYPE> grad (3,0.);
 
-	if (grid[gid].cell[c].gradMap.size()!=0) {
-		map<int,Vec3D>::iterator it;
-		for (it=grid[gid].cell[c].gradMap.begin();it!=grid[gid].cell[c].gradMap.end(); it++ ) {
-			for (int i=0;i<3;++i) grad[i]+=(*it).second[i]*(this->*get_cell)((*it).first);
+	Stencil<Vec3D> &gradMap=grid[gid].gradMap;
+	if (gradMap.size(c)!=0) {
+		for (int j=gradMap.offset[c];j<gradMap.offset[c+1];++j) {
+			TYPE &value=(this->*get_cell)(gradMap.index[j]);
+			for (int i=0;i<3;++i) grad[i]+=gradMap.weight[j][i]*value;
 		} // end gradMap loop
 	} else {
 		int f;
@@ -239,7 +239,7 @@ void Variable<TYPE>::dump_cell_data(string fileName) {
 			for (int c=0;c<grid[gid].cellCount;++c) file.write((char*) &cell(c),size);
 			file.close();
 		}
-		MPI_Barrier(MPI_COMM_WORLD);
+		MPI_Barrier(grid[gid].comm);
 	}
 	return;
 }
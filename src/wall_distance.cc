@@ -0,0 +1,741 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mpi.h>
+using namespace std;
+#include <petscksp.h>
+#include "inputs.h"
+#include "grid.h"
+#include "bc.h"
+#include "variable.h"
+#include "timers.h"
+#include "comm_profile.h"
+
+// Closest wall distances of the cells and faces
+// Two methods are available (grid_n -> wall distance):
+// tree: The no-slip wall faces are indexed in a bounding volume hierarchy and each point is measured
+// against the closest point on the wall faces rather than their centroids. The wall faces are
+// not replicated on every rank: a few sample points on the walls of every rank bound the wall
+// distance of the points in each rank's bounding box, and a rank only receives the wall faces
+// whose bounding boxes lie within that bound.
+// poisson: The Poisson equation lap(phi)=-1 with phi=0 on the no-slip walls and zero normal
+// gradient elsewhere is solved on the grid, d=sqrt(|grad(phi)|^2+2*phi)-|grad(phi)| (Tucker 2003)
+// is exact for a single plane wall but overestimates the distance away from curved walls (60% at
+// one diameter from a cylinder). It is the initial guess of the eikonal equation |grad(d)|=1,
+// solved in the form div(U*d)-d*div(U)=1 with U=grad(d)/|grad(d)| (Tucker 2003), upwinded along U
+// with second order face values from the cell gradients of the grid. A few steps give the distance
+// to the wall faces within a fraction of a percent. Only the local cells and the halos are used.
+// The direction of grad(d) stands in for the closest wall normal.
+// compare: Both are computed, the differences are reported and the tree distances are kept.
+
+extern InputFile input;
+extern vector<Grid> grid;
+extern vector<vector<BCregion> > bc;
+
+#define WALL_SAMPLES 8 // sample wall points contributed by each rank to the distance bound
+#define WALL_LEAF_SIZE 4 // faces in a leaf of the wall face tree
+#define EIKONAL_STEPS 20 // limit of the eikonal correction steps of the poisson method
+#define EIKONAL_TOLERANCE 1.e-4 // largest change of the distance, relative to the largest distance
+
+// Wall faces as polygons, the distance is evaluated on the triangle fan from the first node
+class Wall_Faces {
+public:
+	vector<int> offset; // beginning of each face in node, size()+1 entries
+	vector<double> node; // x,y,z of the face nodes
+	vector<double> normal; // unit normal of each face
+	vector<double> box; // lower and upper corners of each face
+	
+	Wall_Faces(void) { offset.push_back(0); }
+	int size(void) { return offset.size()-1; }
+	
+	void add(int count,const double coords[],const double n[]) {
+		for (int i=0;i<3*count;++i) node.push_back(coords[i]);
+		offset.push_back(node.size());
+		double lo[3],hi[3];
+		for (int i=0;i<3;++i) {
+			normal.push_back(n[i]);
+			lo[i]=coords[i]; hi[i]=coords[i];
+			for (int k=1;k<count;++k) {
+				lo[i]=min(lo[i],coords[3*k+i]);
+				hi[i]=max(hi[i],coords[3*k+i]);
+			}
+		}
+		box.insert(box.end(),lo,lo+3);
+		box.insert(box.end(),hi,hi+3);
+		return;
+	}
+	
+	// Buffer layout of a face: node count, normal, node coordinates
+	void pack(int face,vector<double> &buffer) {
+		int count=(offset[face+1]-offset[face])/3;
+		buffer.push_back(count);
+		for (int i=0;i<3;++i) buffer.push_back(normal[3*face+i]);
+		for (int i=offset[face];i<offset[face+1];++i) buffer.push_back(node[i]);
+		return;
+	}
+	
+	void unpack(const vector<double> &buffer) {
+		int i=0;
+		while (i<buffer.size()) {
+			int count=int(buffer[i]);
+			add(count,&buffer[i+4],&buffer[i+1]);
+			i+=4+3*count;
+		}
+		return;
+	}
+};
+
+// Squared distance between a point and a box given by its lower and upper corners
+static inline double box_distance2(const double p[],const double box[]) {
+	double d2=0.,d;
+	for (int i=0;i<3;++i) {
+		d=max(max(box[i]-p[i],p[i]-box[3+i]),0.);
+		d2+=d*d;
+	}
+	return d2;
+}
+
+// Squared distance between a point and the farthest corner of a box
+static inline double box_max_distance2(const double p[],const double box[]) {
+	double d2=0.,d;
+	for (int i=0;i<3;++i) {
+		d=max(fabs(p[i]-box[i]),fabs(p[i]-box[3+i]));
+		d2+=d*d;
+	}
+	return d2;
+}
+
+static inline bool noslip_wall(int gid,int f) {
+	return grid[gid].face[f].bc>=0 && bc[gid][grid[gid].face[f].bc].type==WALL && bc[gid][grid[gid].face[f].bc].kind!=SLIP;
+}
+
+static inline double dot3(const double a[],const double b[]) { return a[0]*b[0]+a[1]*b[1]+a[2]*b[2]; }
+
+// Squared distance between a point and a triangle (closest point by Voronoi regions, Ericson 2005)
+static double triangle_distance2(const double p[],const double a[],const double b[],const double c[]) {
+	double ab[3],ac[3],ap[3],q[3];
+	for (int i=0;i<3;++i) { ab[i]=b[i]-a[i]; ac[i]=c[i]-a[i]; ap[i]=p[i]-a[i]; }
+	double d1=dot3(ab,ap),d2=dot3(ac,ap);
+	if (d1<=0. && d2<=0.) {
+		for (int i=0;i<3;++i) q[i]=a[i];
+	} else {
+		double bp[3],cp[3];
+		for (int i=0;i<3;++i) { bp[i]=p[i]-b[i]; cp[i]=p[i]-c[i]; }
+		double d3=dot3(ab,bp),d4=dot3(ac,bp),d5=dot3(ab,cp),d6=dot3(ac,cp);
+		double va=d3*d6-d5*d4,vb=d5*d2-d1*d6,vc=d1*d4-d3*d2;
+		if (d3>=0. && d4<=d3) {
+			for (int i=0;i<3;++i) q[i]=b[i];
+		} else if (d6>=0. && d5<=d6) {
+			for (int i=0;i<3;++i) q[i]=c[i];
+		} else if (vc<=0. && d1>=0. && d3<=0.) {
+			double v=d1/(d1-d3);
+			for (int i=0;i<3;++i) q[i]=a[i]+v*ab[i];
+		} else if (vb<=0. && d2>=0. && d6<=0.) {
+			double w=d2/(d2-d6);
+			for (int i=0;i<3;++i) q[i]=a[i]+w*ac[i];
+		} else if (va<=0. && (d4-d3)>=0. && (d5-d6)>=0.) {
+			double w=(d4-d3)/((d4-d3)+(d5-d6));
+			for (int i=0;i<3;++i) q[i]=b[i]+w*(c[i]-b[i]);
+		} else {
+			double denom=1./(va+vb+vc);
+			double v=vb*denom,w=vc*denom;
+			for (int i=0;i<3;++i) q[i]=a[i]+v*ab[i]+w*ac[i];
+		}
+	}
+	double d2sum=0.;
+	for (int i=0;i<3;++i) d2sum+=(p[i]-q[i])*(p[i]-q[i]);
+	return d2sum;
+}
+
+// Bounding volume hierarchy over the wall faces
+class Wall_Tree {
+public:
+	Wall_Faces &faces;
+	vector<int> order; // face indices, each leaf holds a contiguous range
+	vector<double> box; // 6 entries per tree node
+	vector<int> child; // index of the first of the two adjacent children, -1 for leaves
+	vector<int> begin,end; // face range of each tree node
+	vector<double> centroid; // face box centers used for splitting
+	
+	Wall_Tree(Wall_Faces &f) : faces(f) {
+		int count=faces.size();
+		order.resize(count);
+		centroid.resize(3*count);
+		for (int i=0;i<count;++i) {
+			order[i]=i;
+			for (int k=0;k<3;++k) centroid[3*i+k]=0.5*(faces.box[6*i+k]+faces.box[6*i+3+k]);
+		}
+		if (count>0) {
+			new_node(0,count);
+			build(0);
+		}
+	}
+	
+	int new_node(int b,int e) {
+		int n=begin.size();
+		begin.push_back(b);
+		end.push_back(e);
+		child.push_back(-1);
+		for (int k=0;k<3;++k) box.push_back(numeric_limits<double>::max());
+		for (int k=0;k<3;++k) box.push_back(-numeric_limits<double>::max());
+		for (int i=b;i<e;++i) {
+			for (int k=0;k<3;++k) {
+				box[6*n+k]=min(box[6*n+k],faces.box[6*order[i]+k]);
+				box[6*n+3+k]=max(box[6*n+3+k],faces.box[6*order[i]+3+k]);
+			}
+		}
+		return n;
+	}
+	
+	class Axis_Compare {
+	public:
+		vector<double> &centroid;
+		int axis;
+		Axis_Compare(vector<double> &c,int a) : centroid(c),axis(a) {}
+		bool operator() (int i,int j) { return centroid[3*i+axis]<centroid[3*j+axis]; }
+	};
+	
+	void build(int n) {
+		int b=begin[n],e=end[n];
+		if (e-b<=WALL_LEAF_SIZE) return;
+		// Split at the median along the longest extent of the face centers
+		double lo[3],hi[3];
+		for (int k=0;k<3;++k) { lo[k]=centroid[3*order[b]+k]; hi[k]=lo[k]; }
+		for (int i=b+1;i<e;++i) {
+			for (int k=0;k<3;++k) {
+				lo[k]=min(lo[k],centroid[3*order[i]+k]);
+				hi[k]=max(hi[k],centroid[3*order[i]+k]);
+			}
+		}
+		int axis=0;
+		for (int k=1;k<3;++k) if (hi[k]-lo[k]>hi[axis]-lo[axis]) axis=k;
+		int m=(b+e)/2;
+		nth_element(order.begin()+b,order.begin()+m,order.begin()+e,Axis_Compare(centroid,axis));
+		int left=new_node(b,m);
+		new_node(m,e);
+		child[n]=left;
+		build(left);
+		build(left+1);
+		return;
+	}
+	
+	double face_distance2(const double p[],int face) {
+		const double *x=&faces.node[faces.offset[face]];
+		int count=(faces.offset[face+1]-faces.offset[face])/3;
+		double d2=numeric_limits<double>::max();
+		for (int k=1;k<count-1;++k) d2=min(d2,triangle_distance2(p,x,x+3*k,x+3*k+3));
+		return d2;
+	}
+	
+	// Squared distance to the closest wall face, which is returned in face
+	double nearest(const double p[],int &face) {
+		double best=numeric_limits<double>::max();
+		face=-1;
+		if (begin.empty()) return best;
+		int stack[128];
+		int top=0;
+		stack[top++]=0;
+		while (top>0) {
+			int n=stack[--top];
+			if (box_distance2(p,&box[6*n])>=best) continue;
+			if (child[n]<0) {
+				for (int i=begin[n];i<end[n];++i) {
+					double d2=face_distance2(p,order[i]);
+					if (d2<best) { best=d2; face=order[i]; }
+				}
+			} else {
+				// Visit the closer child first
+				int first=child[n],second=child[n]+1;
+				if (box_distance2(p,&box[6*first])>box_distance2(p,&box[6*second])) swap(first,second);
+				stack[top++]=second;
+				stack[top++]=first;
+			}
+		}
+		return best;
+	}
+};
+
+static void tree_wall_distance(int gid) {
+	
+	int Rank=grid[gid].Rank;
+	int np=grid[gid].np;
+	
+	// Local no-slip wall faces
+	Wall_Faces walls;
+	vector<double> coords;
+	double normal[3];
+	for (int i=0;i<grid[gid].boundaryTypeFaces[WALL].size();++i) {
+		int f=grid[gid].boundaryTypeFaces[WALL][i];
+		if (!noslip_wall(gid,f)) continue;
+		coords.clear();
+		for (int n=0;n<grid[gid].face[f].nodes.size();++n) {
+			for (int k=0;k<3;++k) coords.push_back(grid[gid].faceNode(f,n)[k]);
+		}
+		for (int k=0;k<3;++k) normal[k]=grid[gid].face[f].normal[k];
+		walls.add(grid[gid].face[f].nodes.size(),&coords[0],normal);
+	}
+	int localCount=walls.size();
+	
+	// Per rank summary: bounding box of the query points, bounding box of the walls,
+	// number of samples and the sample wall points
+	int infoSize=6+6+1+3*WALL_SAMPLES;
+	vector<double> info (infoSize,0.);
+	for (int k=0;k<3;++k) { info[k]=numeric_limits<double>::max(); info[3+k]=-numeric_limits<double>::max(); }
+	for (int c=0;c<grid[gid].cell.size();++c) {
+		for (int k=0;k<3;++k) {
+			info[k]=min(info[k],grid[gid].cell[c].centroid[k]);
+			info[3+k]=max(info[3+k],grid[gid].cell[c].centroid[k]);
+		}
+	}
+	for (int f=0;f<grid[gid].faceCount;++f) {
+		for (int k=0;k<3;++k) {
+			info[k]=min(info[k],grid[gid].face[f].centroid[k]);
+			info[3+k]=max(info[3+k],grid[gid].face[f].centroid[k]);
+		}
+	}
+	for (int k=0;k<3;++k) { info[6+k]=numeric_limits<double>::max(); info[9+k]=-numeric_limits<double>::max(); }
+	for (int i=0;i<localCount;++i) {
+		for (int k=0;k<3;++k) {
+			info[6+k]=min(info[6+k],walls.box[6*i+k]);
+			info[9+k]=max(info[9+k],walls.box[6*i+3+k]);
+		}
+	}
+	int samples=min(localCount,WALL_SAMPLES);
+	info[12]=samples;
+	for (int s=0;s<samples;++s) {
+		// Spread the samples over the face list, the samples are face nodes so they lie on the wall
+		int i=(long(s)*localCount)/samples;
+		for (int k=0;k<3;++k) info[13+3*s+k]=walls.node[walls.offset[i]+k];
+	}
+	vector<double> allInfo (infoSize*np);
+	MPI_Allgather(&info[0],infoSize,MPI_DOUBLE,&allInfo[0],infoSize,MPI_DOUBLE,grid[gid].comm);
+	
+	// Upper bound of the wall distance in each rank's query box
+	vector<double> bound2 (np,numeric_limits<double>::max());
+	bool wallFound=false;
+	for (int r=0;r<np;++r) {
+		int count=int(allInfo[infoSize*r+12]);
+		if (count>0) wallFound=true;
+		for (int s=0;s<count;++s) {
+			double *sample=&allInfo[infoSize*r+13+3*s];
+			for (int p=0;p<np;++p) bound2[p]=min(bound2[p],box_max_distance2(sample,&allInfo[infoSize*p]));
+		}
+	}
+	
+	if (!wallFound) {
+		for (int c=0;c<grid[gid].cell.size();++c) grid[gid].cell[c].closest_wall_distance=1.e20;
+		for (int f=0;f<grid[gid].faceCount;++f) {
+			grid[gid].face[f].closest_wall_distance=1.e20;
+			grid[gid].face[f].dissipation_factor=1.;
+		}
+		return;
+	}
+	
+	// Send each rank the local wall faces that can be within its bound
+	vector<vector<double> > sendBuffer (np);
+	vector<int> sendCount (np,0),recvCount (np,0);
+	for (int p=0;p<np;++p) {
+		if (p==Rank) continue;
+		// Enlarge the bound slightly against round-off
+		double limit=bound2[p]*(1.+1.e-8);
+		for (int i=0;i<localCount;++i) {
+			// Squared distance between the face box and the query box of rank p
+			double d2=0.,d;
+			for (int k=0;k<3;++k) {
+				d=max(max(allInfo[infoSize*p+k]-walls.box[6*i+3+k],walls.box[6*i+k]-allInfo[infoSize*p+3+k]),0.);
+				d2+=d*d;
+			}
+			if (d2<=limit) walls.pack(i,sendBuffer[p]);
+		}
+		sendCount[p]=sendBuffer[p].size();
+	}
+	MPI_Alltoall(&sendCount[0],1,MPI_INT,&recvCount[0],1,MPI_INT,grid[gid].comm);
+	
+	vector<vector<double> > recvBuffer (np);
+	vector<MPI_Request> requests;
+	for (int p=0;p<np;++p) {
+		if (recvCount[p]>0) {
+			recvBuffer[p].resize(recvCount[p]);
+			requests.push_back(MPI_Request());
+			MPI_Irecv(&recvBuffer[p][0],recvCount[p],MPI_DOUBLE,p,0,grid[gid].comm,&requests.back());
+		}
+	}
+	for (int p=0;p<np;++p) {
+		if (sendCount[p]>0) {
+			requests.push_back(MPI_Request());
+			MPI_Isend(&sendBuffer[p][0],sendCount[p],MPI_DOUBLE,p,0,grid[gid].comm,&requests.back());
+			comm_profile.send(grid[gid].worldOffset+p,sendCount[p]*sizeof(double));
+		}
+	}
+	if (!requests.empty()) comm_profile.waitall(requests.size(),&requests[0],MPI_STATUSES_IGNORE);
+	for (int p=0;p<np;++p) walls.unpack(recvBuffer[p]);
+	
+	Wall_Tree tree (walls);
+	
+	// The tree is only read, the queries are independent
+	#pragma omp parallel for schedule(dynamic,256)
+	for (int c=0;c<grid[gid].cell.size();++c) {
+		double point[3];
+		int face;
+		for (int k=0;k<3;++k) point[k]=grid[gid].cell[c].centroid[k];
+		grid[gid].cell[c].closest_wall_distance=sqrt(tree.nearest(point,face));
+	}
+	
+	#pragma omp parallel for schedule(dynamic,256)
+	for (int f=0;f<grid[gid].faceCount;++f) {
+		// No-slip wall faces
+		if (noslip_wall(gid,f)) {
+			grid[gid].face[f].closest_wall_distance=0.;
+			grid[gid].face[f].dissipation_factor=0.;
+			continue;
+		}
+		double point[3];
+		int face;
+		for (int k=0;k<3;++k) point[k]=grid[gid].face[f].centroid[k];
+		grid[gid].face[f].closest_wall_distance=sqrt(tree.nearest(point,face));
+		double cosine=0.;
+		for (int k=0;k<3;++k) cosine+=walls.normal[3*face+k]*grid[gid].face[f].normal[k];
+		grid[gid].face[f].dissipation_factor=1.-fabs(cosine);
+	}
+	
+	return;
+}
+
+// Boundary ghosts mirror the boundary conditions: zero on the no-slip walls, zero normal gradient elsewhere
+static void mirror_ghosts(int gid,Variable<double> &var) {
+	for (int f=grid[gid].interiorFaceCount;f<grid[gid].faceCount;++f) {
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		var.cell(neighbor)=(noslip_wall(gid,f)) ? -var.cell(parent) : var.cell(parent);
+	}
+	return;
+}
+
+// Cell gradients from the gradient maps of the grid, exchanged with the other partitions
+static void update_gradients(int gid,Variable<double> &var,Variable<Vec3D> &grad) {
+	var.mpi_update();
+	mirror_ghosts(gid,var);
+	for (int c=0;c<grid[gid].cellCount;++c) grad.cell(c)=var.cell_gradient(c);
+	grad.mpi_update();
+	return;
+}
+
+static void poisson_wall_distance(int gid) {
+	
+	int cellCount=grid[gid].cellCount;
+	int faceCount=grid[gid].faceCount;
+	
+	int wallCount=0;
+	for (int i=0;i<grid[gid].boundaryTypeFaces[WALL].size();++i) if (noslip_wall(gid,grid[gid].boundaryTypeFaces[WALL][i])) wallCount++;
+	comm_profile.allreduce("wall face count",MPI_IN_PLACE,&wallCount,1,MPI_INT,MPI_SUM,grid[gid].comm);
+	if (wallCount==0) {
+		for (int c=0;c<grid[gid].cell.size();++c) grid[gid].cell[c].closest_wall_distance=1.e20;
+		for (int f=0;f<faceCount;++f) {
+			grid[gid].face[f].closest_wall_distance=1.e20;
+			grid[gid].face[f].dissipation_factor=1.;
+		}
+		return;
+	}
+	
+	// Two point diffusion coefficient of each face, as in the diffusive face fluxes
+	// Other boundary faces have zero flux
+	vector<double> coefficient (faceCount,0.);
+	vector<int> diagonal_nonzeros (cellCount,1),off_diagonal_nonzeros (cellCount,0);
+	for (int f=0;f<faceCount;++f) {
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		Vec3D normal=grid[gid].face[f].normal;
+		if (grid[gid].face[f].bc==INTERNAL_FACE || grid[gid].face[f].bc==PARTITION_FACE) {
+			Vec3D left2right=grid[gid].cell[neighbor].centroid-grid[gid].cell[parent].centroid;
+			coefficient[f]=grid[gid].face[f].area/left2right.dot(normal);
+			diagonal_nonzeros[parent]++;
+			if (grid[gid].face[f].bc==INTERNAL_FACE) diagonal_nonzeros[neighbor]++;
+			else off_diagonal_nonzeros[parent]++;
+		} else if (noslip_wall(gid,f)) {
+			Vec3D cell2face=grid[gid].face[f].centroid-grid[gid].cell[parent].centroid;
+			coefficient[f]=grid[gid].face[f].area/cell2face.dot(normal);
+		}
+	}
+	
+	// Both equations have the same nonzero pattern
+	Mat A;
+	Vec rhs,solution;
+	KSP ksp;
+	MatCreateMPIAIJ(grid[gid].comm,cellCount,cellCount,grid[gid].globalCellCount,grid[gid].globalCellCount,
+			0,&diagonal_nonzeros[0],0,&off_diagonal_nonzeros[0],&A);
+	VecCreateMPI(grid[gid].comm,cellCount,grid[gid].globalCellCount,&rhs);
+	VecSetFromOptions(rhs);
+	VecDuplicate(rhs,&solution);
+	VecSet(solution,0.);
+	
+	// sum(a_f*(phi_P-phi_N))=V_P
+	int row,col;
+	PetscScalar value;
+	for (int c=0;c<cellCount;++c) {
+		row=grid[gid].myOffset+c;
+		value=grid[gid].cell[c].volume;
+		VecSetValues(rhs,1,&row,&value,INSERT_VALUES);
+	}
+	for (int f=0;f<faceCount;++f) {
+		if (coefficient[f]==0.) continue;
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		row=grid[gid].myOffset+parent;
+		value=coefficient[f];
+		MatSetValues(A,1,&row,1,&row,&value,ADD_VALUES);
+		if (grid[gid].face[f].bc==INTERNAL_FACE) {
+			col=grid[gid].myOffset+neighbor;
+			MatSetValues(A,1,&col,1,&col,&value,ADD_VALUES);
+			value=-coefficient[f];
+			MatSetValues(A,1,&row,1,&col,&value,ADD_VALUES);
+			MatSetValues(A,1,&col,1,&row,&value,ADD_VALUES);
+		} else if (grid[gid].face[f].bc==PARTITION_FACE) {
+			// The other partition adds the neighbor row
+			col=grid[gid].cell[neighbor].matrix_id;
+			value=-coefficient[f];
+			MatSetValues(A,1,&row,1,&col,&value,ADD_VALUES);
+		}
+	}
+	MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY);
+	MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY);
+	VecAssemblyBegin(rhs);
+	VecAssemblyEnd(rhs);
+	
+	// The operator is symmetric positive definite
+	KSPCreate(grid[gid].comm,&ksp);
+	KSPSetOperators(ksp,A,A,SAME_NONZERO_PATTERN);
+	KSPSetType(ksp,KSPCG);
+	KSPSetTolerances(ksp,1.e-10,1.e-30,1.e15,10000);
+	KSPSetOptionsPrefix(ksp,"walldistance_");
+	KSPSetFromOptions(ksp);
+	KSPSolve(ksp,rhs,solution);
+	int iterations;
+	KSPGetIterationNumber(ksp,&iterations);
+	if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Wall distance Poisson equation converged in " << iterations << " iterations" << endl;
+	KSPDestroy(ksp);
+	
+	// The face values of phi and d are zero on the no-slip walls
+	Variable<double> phi,distance;
+	Variable<Vec3D> grad;
+	phi.allocate(gid);
+	distance.allocate(gid);
+	grad.allocate(gid);
+	for (int b=0;b<grid[gid].bcCount;++b) {
+		if (bc[gid][b].type==WALL && bc[gid][b].kind!=SLIP) {
+			phi.fixedonBC[b]=true; phi.bcValue[b].assign(1,0.);
+			distance.fixedonBC[b]=true; distance.bcValue[b].assign(1,0.);
+		}
+	}
+	PetscScalar *values;
+	VecGetArray(solution,&values);
+	for (int c=0;c<cellCount;++c) phi.cell(c)=values[c];
+	VecRestoreArray(solution,&values);
+	update_gradients(gid,phi,grad);
+	
+	// Initial distances d=sqrt(|grad(phi)|^2+2*phi)-|grad(phi)|
+	for (int c=0;c<cellCount;++c) {
+		double magnitude=fabs(grad.cell(c));
+		distance.cell(c)=sqrt(max(magnitude*magnitude+2.*phi.cell(c),0.))-magnitude;
+	}
+	
+	// Eikonal correction: div(U*d)-d*div(U)=1 with U=grad(d)/|grad(d)|, upwinded along U
+	// The upwind face value is reconstructed with the cell gradient, the walls are the inflow with d=0
+	// Each step freezes U and the reconstruction and solves for d
+	KSPCreate(grid[gid].comm,&ksp);
+	KSPSetType(ksp,KSPGMRES);
+	KSPSetTolerances(ksp,1.e-8,1.e-30,1.e15,10000);
+	KSPSetOptionsPrefix(ksp,"walldistance_eikonal_");
+	KSPSetFromOptions(ksp);
+	KSPSetInitialGuessNonzero(ksp,PETSC_TRUE);
+	int step;
+	double change=1.;
+	for (step=1;step<=EIKONAL_STEPS && change>EIKONAL_TOLERANCE;++step) {
+		update_gradients(gid,distance,grad);
+		MatZeroEntries(A);
+		vector<double> source (cellCount),inflow (cellCount,0.);
+		for (int c=0;c<cellCount;++c) source[c]=grid[gid].cell[c].volume;
+		for (int f=0;f<faceCount;++f) {
+			int parent=grid[gid].face[f].parent;
+			int neighbor=grid[gid].face[f].neighbor;
+			Vec3D normal=grid[gid].face[f].normal;
+			Vec3D U=grad.cell(parent)/max(fabs(grad.cell(parent)),1.e-30);
+			bool interior=(grid[gid].face[f].bc==INTERNAL_FACE || grid[gid].face[f].bc==PARTITION_FACE);
+			if (interior) U=0.5*(U+grad.cell(neighbor)/max(fabs(grad.cell(neighbor)),1.e-30));
+			double flux=U.dot(normal)*grid[gid].face[f].area;
+			if (interior) {
+				int upwind=(flux>0.) ? parent : neighbor;
+				int downwind=(flux>0.) ? neighbor : parent;
+				double correction=grad.cell(upwind).dot(grid[gid].face[f].centroid-grid[gid].cell[upwind].centroid);
+				int upwind_id=(upwind<cellCount) ? grid[gid].myOffset+upwind : grid[gid].cell[upwind].matrix_id;
+				int downwind_id=(downwind<cellCount) ? grid[gid].myOffset+downwind : grid[gid].cell[downwind].matrix_id;
+				// The other partition adds the row of its own cell
+				if (downwind<cellCount) {
+					value=fabs(flux);
+					MatSetValues(A,1,&downwind_id,1,&downwind_id,&value,ADD_VALUES);
+					value=-fabs(flux);
+					MatSetValues(A,1,&downwind_id,1,&upwind_id,&value,ADD_VALUES);
+					source[downwind]+=fabs(flux)*correction;
+					inflow[downwind]+=fabs(flux);
+				}
+				if (upwind<cellCount) {
+					// Keeps the nonzero pattern of the Poisson operator
+					value=0.;
+					MatSetValues(A,1,&upwind_id,1,&downwind_id,&value,ADD_VALUES);
+					source[upwind]-=fabs(flux)*correction;
+				}
+			} else if (noslip_wall(gid,f)) {
+				row=grid[gid].myOffset+parent;
+				if (flux<0.) {
+					value=-flux;
+					MatSetValues(A,1,&row,1,&row,&value,ADD_VALUES);
+					inflow[parent]-=flux;
+				} else {
+					source[parent]-=flux*grad.cell(parent).dot(grid[gid].face[f].centroid-grid[gid].cell[parent].centroid);
+				}
+			}
+			// Zero normal gradient on the other boundaries, the upwind and cell values cancel
+		}
+		for (int c=0;c<cellCount;++c) {
+			row=grid[gid].myOffset+c;
+			// Cells without an inflow face (local maxima of d) keep their distance
+			value=(inflow[c]>0.) ? 0. : 1.;
+			MatSetValues(A,1,&row,1,&row,&value,ADD_VALUES);
+			if (inflow[c]==0.) source[c]=distance.cell(c);
+			VecSetValues(rhs,1,&row,&source[c],INSERT_VALUES);
+			VecSetValues(solution,1,&row,&distance.cell(c),INSERT_VALUES);
+		}
+		MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY);
+		MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY);
+		VecAssemblyBegin(rhs);
+		VecAssemblyEnd(rhs);
+		VecAssemblyBegin(solution);
+		VecAssemblyEnd(solution);
+		
+		KSPSetOperators(ksp,A,A,SAME_NONZERO_PATTERN);
+		KSPSolve(ksp,rhs,solution);
+		
+		// Largest change relative to the largest distance
+		double norms[2]={0.,0.};
+		VecGetArray(solution,&values);
+		for (int c=0;c<cellCount;++c) {
+			norms[0]=max(norms[0],fabs(values[c]-distance.cell(c)));
+			norms[1]=max(norms[1],values[c]);
+			distance.cell(c)=values[c];
+		}
+		VecRestoreArray(solution,&values);
+		comm_profile.allreduce("wall distance check",MPI_IN_PLACE,norms,2,MPI_DOUBLE,MPI_MAX,grid[gid].comm);
+		change=norms[0]/max(norms[1],1.e-30);
+	}
+	if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Wall distance eikonal correction took " << step-1 << " steps, last change " << change << endl;
+	
+	KSPDestroy(ksp);
+	MatDestroy(A);
+	VecDestroy(rhs);
+	VecDestroy(solution);
+	
+	update_gradients(gid,distance,grad);
+	
+	// Cells (boundary ghosts take their parent's distance)
+	for (int c=0;c<grid[gid].cell.size();++c) grid[gid].cell[c].closest_wall_distance=0.;
+	for (int c=0;c<=grid[gid].partition_ghosts_end;++c) grid[gid].cell[c].closest_wall_distance=distance.cell(c);
+	for (int f=grid[gid].interiorFaceCount;f<faceCount;++f) {
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		grid[gid].cell[neighbor].closest_wall_distance=grid[gid].cell[parent].closest_wall_distance;
+	}
+	
+	// Faces: interpolated distance, grad(d) points away from the closest wall
+	// The averaged gradient gets its normal component from the two point difference
+	for (int f=0;f<faceCount;++f) {
+		if (noslip_wall(gid,f)) {
+			grid[gid].face[f].closest_wall_distance=0.;
+			grid[gid].face[f].dissipation_factor=0.;
+			continue;
+		}
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		Vec3D normal=grid[gid].face[f].normal;
+		Vec3D left2right=grid[gid].cell[neighbor].centroid-grid[gid].cell[parent].centroid;
+		Vec3D gradient=grad.cell(parent);
+		if (grid[gid].face[f].bc==INTERNAL_FACE || grid[gid].face[f].bc==PARTITION_FACE) {
+			double weight=(grid[gid].face[f].centroid-grid[gid].cell[parent].centroid).dot(normal)/left2right.dot(normal);
+			gradient=(1.-weight)*gradient+weight*grad.cell(neighbor);
+		}
+		gradient-=gradient.dot(normal)*normal;
+		gradient+=((distance.cell(neighbor)-distance.cell(parent))/left2right.dot(normal))*normal;
+		double magnitude=fabs(gradient);
+		grid[gid].face[f].closest_wall_distance=max(distance.face(f),0.);
+		grid[gid].face[f].dissipation_factor=(magnitude>0.) ? 1.-fabs(gradient.dot(normal))/magnitude : 1.;
+	}
+	
+	return;
+}
+
+void wall_distance(int gid) {
+	
+	Scoped_Timer timer("wall distance");
+	string method=input.section("grid",gid).get_string("walldistance");
+	
+	if (method=="tree") {
+		tree_wall_distance(gid);
+	} else if (method=="poisson") {
+		poisson_wall_distance(gid);
+	} else if (method=="compare") {
+		// Validation: report the Poisson distances against the tree distances, keep the latter
+		poisson_wall_distance(gid);
+		vector<double> cellDistance (grid[gid].cellCount);
+		for (int c=0;c<grid[gid].cellCount;++c) cellDistance[c]=grid[gid].cell[c].closest_wall_distance;
+		tree_wall_distance(gid);
+		double maxDistance=0.;
+		for (int c=0;c<grid[gid].cellCount;++c) maxDistance=max(maxDistance,grid[gid].cell[c].closest_wall_distance);
+		comm_profile.allreduce("wall distance check",MPI_IN_PLACE,&maxDistance,1,MPI_DOUBLE,MPI_MAX,grid[gid].comm);
+		// Relative errors over all cells and within the wall layer (closest 10% of the largest distance)
+		double sums[4]={0.,0.,0.,0.},maxima[2]={0.,0.};
+		for (int c=0;c<grid[gid].cellCount;++c) {
+			double exact=grid[gid].cell[c].closest_wall_distance;
+			if (exact<=0.) continue;
+			double error=fabs(cellDistance[c]-exact)/exact;
+			sums[0]+=error; sums[1]+=1.;
+			maxima[0]=max(maxima[0],error);
+			if (exact<0.1*maxDistance) {
+				sums[2]+=error; sums[3]+=1.;
+				maxima[1]=max(maxima[1],error);
+			}
+		}
+		comm_profile.allreduce("wall distance check",MPI_IN_PLACE,sums,4,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+		comm_profile.allreduce("wall distance check",MPI_IN_PLACE,maxima,2,MPI_DOUBLE,MPI_MAX,grid[gid].comm);
+		if (grid[gid].Rank==0) {
+			cout << "[I grid=" << gid+1 << " ] Poisson wall distance relative error: mean " << sums[0]/max(sums[1],1.) << " max " << maxima[0] << endl;
+			cout << "[I grid=" << gid+1 << " ] Within the wall layer (d<" << 0.1*maxDistance << "): mean " << sums[2]/max(sums[3],1.) << " max " << maxima[1] << endl;
+		}
+	} else {
+		if (grid[gid].Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> wall distance=" << method << " is not recognized" << endl;
+		exit(1);
+	}
+	
+	return;
+}
@@ -53,24 +53,24 @@ void write_restart(int gid,int timeStep,double time) {
 	mkdir(dirname.c_str(),S_IRWXU);
 
 	// write partition map
-	for (int p=0;p<np;++p) {
-		if (Rank==p) {
+	for (int p=0;p<grid[gid].np;++p) {
+		if (grid[gid].Rank==p) {
 			fileName="./restart/partitionMap_"+int2str(gid+1)+".dat";
-			if (Rank==0) { 
+			if (grid[gid].Rank==0) { 
 				file.open(fileName.c_str());
-				file << np << endl;
+				file << grid[gid].np << endl;
 			}
 			else { file.open(fileName.c_str(), ios::app); }
 			file << grid[gid].nodeCount << "\t" << grid[gid].cellCount << endl;
 			for (int c=0;c<grid[gid].cellCount;++c) file << grid[gid].cell[c].globalId << endl;
 			file.close();
 		}
-		MPI_Barrier(MPI_COMM_WORLD);
+		MPI_Barrier(grid[gid].comm);
 	}
 	
 	// Write time file
 	fileName=dirname+"/time.dat";
-	if (Rank==0) { 
+	if (grid[gid].Rank==0) { 
 		file.open(fileName.c_str());
 		// Write physical time
 		file << time << endl;
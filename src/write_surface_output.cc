@@ -76,13 +76,13 @@ void write_surface_output(int gridid, int step) {
 	
 		for (int b=0;b<grid[gid].bcCount;++b) {
 			// Write tecplot output file
-			if (Rank==0) write_surface_tec_header(b);
+			if (grid[gid].Rank==0) write_surface_tec_header(b);
 			
 			if (b==0) {
 				for (int i=0;i<3;++i) {
-					for (int p=0;p<np;++p) {
-						if(Rank==p) write_surface_tec_nodes(i);
-						MPI_Barrier(MPI_COMM_WORLD);
+					for (int p=0;p<grid[gid].np;++p) {
+						if(grid[gid].Rank==p) write_surface_tec_nodes(i);
+						MPI_Barrier(grid[gid].comm);
 					}
 				}
 			}
@@ -91,17 +91,17 @@ void write_surface_output(int gridid, int step) {
 				int nn=1;
 				if (var_is_vec3d[ov]) nn=3;
 				for (int i=0;i<nn;++i) {
-					for (int p=0;p<np;++p) {
-						if(Rank==p) write_surface_tec_var(ov,i,b);
-						MPI_Barrier(MPI_COMM_WORLD);
+					for (int p=0;p<grid[gid].np;++p) {
+						if(grid[gid].Rank==p) write_surface_tec_var(ov,i,b);
+						MPI_Barrier(grid[gid].comm);
 					}
 					
 				}
 			}
 			
-			for (int p=0;p<np;++p) {
-				if(Rank==p) write_surface_tec_cells(b);
-				MPI_Barrier(MPI_COMM_WORLD);
+			for (int p=0;p<grid[gid].np;++p) {
+				if(grid[gid].Rank==p) write_surface_tec_cells(b);
+				MPI_Barrier(grid[gid].comm);
 			}
 		}
 	} 	
@@ -222,14 +222,21 @@ void write_surface_tec_var(int ov,int i,int b) {
 			else file << "\t";
 		}
 	} else if (varList[ov]=="mu") {
+		// The face loop's boundary states are reused when available (the ones the loads come from)
+		bool stored=ns[gid].face_store.filled;
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].material.viscosity(ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
+			int f=grid[gid].boundaryFaces[b][bf];
+			if (stored) file << ns[gid].face_store.mu[f];
+			else file << ns[gid].material.viscosity(ns[gid].T.face(f));
 			if ((bf+1)%10==0) file << "\n";
 			else file << "\t";
 		}
 	} else if (varList[ov]=="lambda") {
+		bool stored=ns[gid].face_store.filled;
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].material.therm_cond(ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
+			int f=grid[gid].boundaryFaces[b][bf];
+			if (stored) file << ns[gid].face_store.lambda[f];
+			else file << ns[gid].material.therm_cond(ns[gid].T.face(f));
 			if ((bf+1)%10==0) file << "\n";
 			else file << "\t";
 		}
@@ -308,14 +315,27 @@ void write_surface_tec_var(int ov,int i,int b) {
 			else file << "\t";
 		}
 	} else if (varList[ov]=="Mach") {
+		bool stored=ns[gid].face_store.filled;
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << fabs(ns[gid].V.face(grid[gid].boundaryFaces[b][bf]))/ns[gid].material.a(ns[gid].p.face(grid[gid].boundaryFaces[b][bf]),ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
+			int f=grid[gid].boundaryFaces[b][bf];
+			if (stored) file << fabs(ns[gid].face_store.Vn[1][f])/ns[gid].face_store.a[1][f];
+			else file << fabs(ns[gid].V.face(f))/ns[gid].material.a(ns[gid].p.face(f),ns[gid].T.face(f));
+			if ((bf+1)%10==0) file << "\n";
+			else file << "\t";
+		}
+	} else if (varList[ov]=="H") {
+		// Total enthalpy, only available from the face loop's boundary states
+		bool stored=ns[gid].face_store.filled;
+		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
+			int f=grid[gid].boundaryFaces[b][bf];
+			if (stored) file << ns[gid].face_store.H[1][f];
+			else file << 0.;
 			if ((bf+1)%10==0) file << "\n";
 			else file << "\t";
 		}
 	} else if (varList[ov]=="rank") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << Rank;
+			file << grid[gid].Rank;
 			if ((bf+1)%10==0) file << "\n";
 			else file << "\t";
 		}
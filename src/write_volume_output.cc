@@ -33,6 +33,7 @@ using namespace std;
 #include "rans.h"
 #include "hc.h"
 #include "commons.h"
+#include "comm_profile.h"
 
 extern vector<Grid> grid;
 extern InputFile input;
@@ -66,13 +67,13 @@ void write_loads(int gid,int step,double time) {
 	ofstream file;
 	for (int b=0;b<loads[gid].include_bcs.size();++b) {
 		double force_x,force_y,force_z,moment_x,moment_y,moment_z;
-		MPI_Allreduce (&loads[gid].force[b][0],&force_x,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-		MPI_Allreduce (&loads[gid].force[b][1],&force_y,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-		MPI_Allreduce (&loads[gid].force[b][2],&force_z,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-		MPI_Allreduce (&loads[gid].moment[b][0],&moment_x,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-		MPI_Allreduce (&loads[gid].moment[b][1],&moment_y,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-		MPI_Allreduce (&loads[gid].moment[b][2],&moment_z,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-		if (Rank==0) {
+		comm_profile.allreduce("loads",&loads[gid].force[b][0],&force_x,1,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+		comm_profile.allreduce("loads",&loads[gid].force[b][1],&force_y,1,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+		comm_profile.allreduce("loads",&loads[gid].force[b][2],&force_z,1,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+		comm_profile.allreduce("loads",&loads[gid].moment[b][0],&moment_x,1,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+		comm_profile.allreduce("loads",&loads[gid].moment[b][1],&moment_y,1,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+		comm_profile.allreduce("loads",&loads[gid].moment[b][2],&moment_z,1,MPI_DOUBLE,MPI_SUM,grid[gid].comm);
+		if (grid[gid].Rank==0) {
 			string fileName="./volume_output/loads_grid_"+int2str(gid+1)+"_BC_"+int2str(loads[gid].include_bcs[b]+1)+".dat";
 			file.open((fileName).c_str(),ios::app);
 			file << scientific << setprecision(8);
@@ -103,54 +104,54 @@ void write_volume_output(int gridid, int step) {
 	string format=input.section("grid",gid).subsection("writeoutput").get_string("format");
 	if (format=="tecplot") {
 		// Write tecplot output file		
-		if (Rank==0) write_tec_header();
+		if (grid[gid].Rank==0) write_tec_header();
 		for (int i=0;i<3;++i) {
-			for (int p=0;p<np;++p) {
-				if(Rank==p) write_tec_nodes(i);
-				MPI_Barrier(MPI_COMM_WORLD);
+			for (int p=0;p<grid[gid].np;++p) {
+				if(grid[gid].Rank==p) write_tec_nodes(i);
+				MPI_Barrier(grid[gid].comm);
 			}
 		}
 		for (int ov=0;ov<varList.size();++ov) {
 			int nn=1;
 			if (var_is_vec3d[ov]) nn=3;
 			for (int i=0;i<nn;++i) {
-				for (int p=0;p<np;++p) {
-					if(Rank==p) write_tec_var(ov,i);
-					MPI_Barrier(MPI_COMM_WORLD);
+				for (int p=0;p<grid[gid].np;++p) {
+					if(grid[gid].Rank==p) write_tec_var(ov,i);
+					MPI_Barrier(grid[gid].comm);
 				}
 				
 			}
 		}
 		
-		for (int p=0;p<np;++p) {
-			if(Rank==p) write_tec_face_node_counts();
-			MPI_Barrier(MPI_COMM_WORLD);
+		for (int p=0;p<grid[gid].np;++p) {
+			if(grid[gid].Rank==p) write_tec_face_node_counts();
+			MPI_Barrier(grid[gid].comm);
 		}
 		 
-		for (int p=0;p<np;++p) {
-			if(Rank==p) write_tec_face_nodes();
-			MPI_Barrier(MPI_COMM_WORLD);
+		for (int p=0;p<grid[gid].np;++p) {
+			if(grid[gid].Rank==p) write_tec_face_nodes();
+			MPI_Barrier(grid[gid].comm);
 		}
 
-		for (int p=0;p<np;++p) {
-			if(Rank==p) write_tec_left();
-			MPI_Barrier(MPI_COMM_WORLD);
+		for (int p=0;p<grid[gid].np;++p) {
+			if(grid[gid].Rank==p) write_tec_left();
+			MPI_Barrier(grid[gid].comm);
 		}
 
-		for (int p=0;p<np;++p) {
-			if(Rank==p) write_tec_right();
-			MPI_Barrier(MPI_COMM_WORLD);
+		for (int p=0;p<grid[gid].np;++p) {
+			if(grid[gid].Rank==p) write_tec_right();
+			MPI_Barrier(grid[gid].comm);
 		}
 
 	} else if (format=="vtk") {
 		// Write vtk output file
-		if (Rank==0) write_vtk_parallel();
-		MPI_Barrier(MPI_COMM_WORLD);
+		if (grid[gid].Rank==0) write_vtk_parallel();
+		MPI_Barrier(grid[gid].comm);
 		write_vtk();	
 	} else if (format=="vtklegacy") {
 		// Write vtk output file
-		if (Rank==0) write_visit_parallel();
-		MPI_Barrier(MPI_COMM_WORLD);
+		if (grid[gid].Rank==0) write_visit_parallel();
+		MPI_Barrier(grid[gid].comm);
 		write_vtk_legacy();	
 	}
 
@@ -332,7 +333,7 @@ void write_tec_var(int ov, int i) {
 		}
 	} else if (varList[ov]=="rank") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << Rank;
+			file << grid[gid].Rank;
 			if ((c+1)%10==0) file << "\n";
 			else file << "\t";
 		}
@@ -449,7 +450,7 @@ void write_tec_face_node_counts () {
 	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
 	file.open((fileName).c_str(),ios::app);
 
-	if (Rank==0) file << "\n# node count per face" << endl;
+	if (grid[gid].Rank==0) file << "\n# node count per face" << endl;
 	int count=0;
 	int g;
 	bool write;
@@ -457,7 +458,7 @@ void write_tec_face_node_counts () {
 		write=true;
 		if (grid[gid].face[f].bc==PARTITION_FACE) {
 			g=grid[gid].face[f].neighbor;
-			if (grid[gid].cell[g].partition<Rank) write=false;
+			if (grid[gid].cell[g].partition<grid[gid].Rank) write=false;
 		}
 		if (write) {
 			file << grid[gid].face[f].nodes.size() << endl;
@@ -476,14 +477,14 @@ void write_tec_face_nodes() {
 	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
 	file.open((fileName).c_str(),ios::app);
 
-	if (Rank==0) file << "# face nodes" << endl;
+	if (grid[gid].Rank==0) file << "# face nodes" << endl;
 	int g;
 	bool write;	
 	for (int f=0;f<grid[gid].faceCount;++f) { 
 		write=true;
 		if (grid[gid].face[f].bc==PARTITION_FACE) {
 			g=grid[gid].face[f].neighbor;
-			if (grid[gid].cell[g].partition<Rank) write=false;
+			if (grid[gid].cell[g].partition<grid[gid].Rank) write=false;
 		}
 
 		if (write) {
@@ -506,17 +507,17 @@ void write_tec_left() {
 	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
 	file.open((fileName).c_str(),ios::app);
 
-	if (Rank==0) file << "# left elements" << endl;
+	if (grid[gid].Rank==0) file << "# left elements" << endl;
 	int g;
 	bool write;
 	for (int f=0;f<grid[gid].faceCount;++f) { 
 		write=true;
 		if (grid[gid].face[f].bc==PARTITION_FACE) {
 			g=grid[gid].face[f].neighbor;
-			if (grid[gid].cell[g].partition<Rank) write=false;
+			if (grid[gid].cell[g].partition<grid[gid].Rank) write=false;
 		}
 
-		if (write) file << grid[gid].face[f].parent+grid[gid].partitionOffset[Rank]+1 << endl;
+		if (write) file << grid[gid].face[f].parent+grid[gid].partitionOffset[grid[gid].Rank]+1 << endl;
 	}
 
 	file.close();
@@ -530,20 +531,20 @@ void write_tec_right() {
 	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
 	file.open((fileName).c_str(),ios::app);
 
-	if (Rank==0) file << "# right elements" << endl;
+	if (grid[gid].Rank==0) file << "# right elements" << endl;
 	int g;
 	bool write;	
 	for (int f=0;f<grid[gid].faceCount;++f) { 
 		write=true;
 		if (grid[gid].face[f].bc==PARTITION_FACE) {
 			g=grid[gid].face[f].neighbor;
-			if (grid[gid].cell[g].partition<Rank) write=false;
+			if (grid[gid].cell[g].partition<grid[gid].Rank) write=false;
 		}
 
 		if (write) {
 			if (grid[gid].face[f].bc==PARTITION_FACE) file << grid[gid].cell[g].id_in_owner+grid[gid].partitionOffset[grid[gid].cell[g].partition]+1 << endl;
 			else if (grid[gid].face[f].bc>=0) file << 0 << endl;
-			else file << grid[gid].face[f].neighbor+grid[gid].partitionOffset[Rank]+1 << endl;
+			else file << grid[gid].face[f].neighbor+grid[gid].partitionOffset[grid[gid].Rank]+1 << endl;
 		}
 	}
 
@@ -555,7 +556,7 @@ void write_tec_right() {
 void write_vtk(void) {
 	
 	string filePath="./volume_output/"+int2str(timeStep);
-	string fileName=filePath+"/grid_" + int2str(gid+1) + "_proc_"+int2str(Rank)+".vtu";
+	string fileName=filePath+"/grid_" + int2str(gid+1) + "_proc_"+int2str(grid[gid].Rank)+".vtu";
 	ofstream file;
 	file.open((fileName).c_str(),ios::out);
 	file << "<?xml version=\"1.0\"?>" << endl;
@@ -630,7 +631,7 @@ void write_vtk(void) {
 		else if (varList[ov]=="Mach") {
 			for (int c=0;c<grid[gid].cellCount;++c) file << fabs(ns[gid].V.cell(c))/ns[gid].material.a(ns[gid].p.cell(c),ns[gid].T.cell(c)) << endl;
 		}
-		else if (varList[ov]=="rank")     for (int c=0;c<grid[gid].cellCount;++c) file << Rank << endl;
+		else if (varList[ov]=="rank")     for (int c=0;c<grid[gid].cellCount;++c) file << grid[gid].Rank << endl;
 		// Vectors
 		else if (varList[ov]=="V")       { for (int c=0;c<grid[gid].cellCount;++c) {  for (int i=0;i<3;++i) { file << ns[gid].V.cell(c)[i]     << " "; } file << endl;}} 
 		else if (varList[ov]=="gradp")   { for (int c=0;c<grid[gid].cellCount;++c) {  for (int i=0;i<3;++i) { file << ns[gid].gradp.cell(c)[i] << " "; } file << endl;}}
@@ -690,7 +691,7 @@ void write_vtk_parallel(void) {
 	}
 	
 	file << "</PCellData>" << endl;
-	for (int p=0;p<np;++p) file << "<Piece Source=\"grid_" << gid+1 << "_proc_" << int2str(p) << ".vtu\" />" << endl;
+	for (int p=0;p<grid[gid].np;++p) file << "<Piece Source=\"grid_" << gid+1 << "_proc_" << int2str(p) << ".vtu\" />" << endl;
 	file << "</PUnstructuredGrid>" << endl;
 	file << "</VTKFile>" << endl;
 	file.close();
@@ -701,7 +702,7 @@ void write_vtk_parallel(void) {
 void write_vtk_legacy(void) {
 	
 	string filePath="./volume_output/"+int2str(timeStep);
-	string fileName=filePath+"/grid_" + int2str(gid+1) + "_proc_"+int2str(Rank)+".vtk";
+	string fileName=filePath+"/grid_" + int2str(gid+1) + "_proc_"+int2str(grid[gid].Rank)+".vtk";
 	ofstream file;
 	file.open((fileName).c_str(),ios::out);
 	file << "# vtk DataFile Version 2.0" << endl;
@@ -758,7 +759,7 @@ void write_vtk_legacy(void) {
 			else if (varList[ov]=="k")         for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].k.cell(c) << endl;
 			else if (varList[ov]=="omega")     for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].omega.cell(c) << endl;
 			else if (varList[ov]=="mu_t")      for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].mu_t.cell(c) << endl;
-			else if (varList[ov]=="rank")      for (int c=0;c<grid[gid].cellCount;++c) file << Rank << endl;
+			else if (varList[ov]=="rank")      for (int c=0;c<grid[gid].cellCount;++c) file << grid[gid].Rank << endl;
 			// Vectors
 			else if (varList[ov]=="V")         for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].V.cell(c)[i]            << endl; 
 			else if (varList[ov]=="gradp")     for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].gradp.cell(c)[i]        << endl;
@@ -800,8 +801,8 @@ void write_visit_parallel(void) {
 	
 	ofstream file;
 	file.open((fileName).c_str(),ios::out);
-	file << "!NBLOCKS " << np << endl;
-	for(int p=0;p<np;++p) file << "./" << int2str(timeStep) << "/grid_" + int2str(gid+1) + "_proc_"+int2str(p)+".vtk" << endl;
+	file << "!NBLOCKS " << grid[gid].np << endl;
+	for(int p=0;p<grid[gid].np;++p) file << "./" << int2str(timeStep) << "/grid_" + int2str(gid+1) + "_proc_"+int2str(p)+".vtk" << endl;
 	file.close();
 
 	return;